@@ -0,0 +1,109 @@
+#pragma once
+
+#include "offsetAllocator.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// where a suballocation currently lives. compaction may move it, generation goes up every time
+struct BufferRange
+{
+    unsigned int buffer     = 0;
+    size_t       offset     = 0;
+    size_t       size       = 0;
+    uint32_t     generation = 0;
+};
+
+struct BufferAllocatorStats
+{
+    int    bufferCount     = 0;
+    int    allocationCount = 0;
+    size_t capacity        = 0;
+    size_t usedBytes       = 0; // requested sizes
+    size_t paddingBytes    = 0; // lost to rounding up to the alignment
+    size_t freeBytes       = 0;
+    size_t largestFree     = 0; // biggest free region of any buffer
+    float  fragmentation   = 0.0f; // share of free memory outside the largest free region of its buffer
+    double averageAllocUs  = 0.0;
+    double maxAllocUs      = 0.0;
+    size_t movedBytes      = 0; // copied by compaction
+    int    releasedBuffers = 0; // emptied by compaction and deleted
+};
+
+// hands out ranges of a few big immutable buffers instead of a buffer object per user. each buffer
+// is managed by an OffsetAllocator, so allocating and freeing take constant time whatever the number
+// of ranges. compact() moves ranges on the GPU a few megabytes per call, emptying the least used
+// buffer into the others until it can be deleted. GL thread only
+class BufferAllocator
+{
+public:
+    static const uint32_t INVALID_RANGE = 0xffffffff;
+
+    explicit BufferAllocator(size_t blockSize = 64 * 1024 * 1024, size_t alignment = 16);
+    BufferAllocator(const BufferAllocator&) = delete;
+    BufferAllocator& operator=(const BufferAllocator&) = delete;
+    ~BufferAllocator();
+
+    // the one every Mesh takes its vertices and indices from, created on first use
+    static BufferAllocator* geometry();
+    // delete it, call before the context goes away
+    static void releaseGeometry();
+
+    // a new buffer is added when none has room, ranges bigger than a buffer get one of their own
+    uint32_t allocate(size_t size);
+    void     free(uint32_t range);
+    // copy data into the range, offset is relative to its start
+    void upload(uint32_t range, size_t offset, const void* data, size_t size);
+    // the same from another buffer, copied on the GPU
+    void copy(uint32_t range, size_t offset, unsigned int buffer, size_t bufferOffset, size_t size);
+
+    const BufferRange& range(uint32_t range) const;
+
+    // call once per frame. moves at most maxBytes, returns the bytes moved
+    size_t compact(size_t maxBytes = 4 * 1024 * 1024);
+
+    BufferAllocatorStats stats() const;
+    void                 logStats() const;
+
+private:
+    struct Block
+    {
+        unsigned int    buffer;
+        size_t          size;
+        OffsetAllocator allocator; // in units of the alignment
+        size_t          usedBytes;
+        int             rangeCount;
+    };
+
+    struct Allocation
+    {
+        Block*                      block;
+        OffsetAllocator::Allocation allocation;
+        BufferRange                 range;
+        bool                        isLive;
+    };
+
+    Block* createBlock(size_t size);
+    void   releaseBlock(Block* block);
+    bool   allocateIn(Block* block, size_t size, OffsetAllocator::Allocation& allocation) const;
+    // move a range into another block or lower in its own, false if there is no better spot
+    bool   move(uint32_t range, Block* target);
+    size_t units(size_t size) const;
+
+private:
+    size_t                              m_blockSize;
+    size_t                              m_alignment;
+    std::vector<std::unique_ptr<Block>> m_blocks;
+    std::vector<Allocation>             m_allocations;
+    std::vector<uint32_t>               m_freeAllocations;
+
+    // stats
+    double m_allocUs       = 0.0;
+    double m_maxAllocUs    = 0.0;
+    int    m_allocCalls    = 0;
+    size_t m_movedBytes    = 0;
+    int    m_releasedCount = 0;
+
+    static std::unique_ptr<BufferAllocator> s_geometry;
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// reports watched files that were written since the last poll(). on linux it listens to inotify
+// on the parent directories (editors often replace a file instead of writing it), elsewhere it
+// compares modification times at most every POLL_INTERVAL_MS.
+class FileWatcher
+{
+public:
+    FileWatcher();
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+    ~FileWatcher();
+
+    // paths are normalized, the same file watched under two spellings is reported once
+    void watch(const std::string& path);
+    // never blocks. every changed file once, normalized
+    std::vector<std::string> poll();
+
+    static std::string normalize(const std::string& path);
+
+private:
+    std::unordered_set<std::string> m_files;
+#ifdef __linux__
+    int                                  m_fd = -1;
+    std::unordered_map<int, std::string> m_directories; // watch descriptor -> directory
+    std::unordered_set<std::string>      m_watchedDirectories;
+#else
+    static const int                                                  POLL_INTERVAL_MS = 500;
+    std::unordered_map<std::string, std::filesystem::file_time_type> m_writeTimes;
+    std::chrono::steady_clock::time_point                             m_lastPoll;
+#endif
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "renderTarget.h"
+#include <functional>
+#include <string>
+#include <vector>
+
+using FrameGraphResource = int;
+
+#define FRAME_GRAPH_INVALID_RESOURCE -1
+
+enum FrameGraphAccess
+{
+    ACCESS_SAMPLED = 0,   // texture() in a shader
+    ACCESS_RENDER_TARGET, // bound as framebuffer attachment
+    ACCESS_STORAGE,       // image load/store or compute
+};
+
+class FrameGraph;
+
+// handed to a pass' setup function to declare what the pass reads and writes
+class FrameGraphBuilder
+{
+public:
+    FrameGraphResource create(const std::string& name, const RenderTargetDesc& desc);
+    FrameGraphResource read(FrameGraphResource resource, FrameGraphAccess access = ACCESS_SAMPLED);
+    FrameGraphResource write(FrameGraphResource resource, FrameGraphAccess access = ACCESS_RENDER_TARGET);
+    // the pass has effects outside the graph and is never culled
+    void sideEffect();
+
+private:
+    friend class FrameGraph;
+    FrameGraphBuilder(FrameGraph& graph, int passIdx);
+
+    FrameGraph& m_graph;
+    int         m_passIdx;
+};
+
+// handed to a pass' execute function, resolves handles to the allocated targets
+class FrameGraphResources
+{
+public:
+    // nullptr for the imported backbuffer
+    RenderTarget* target(FrameGraphResource resource) const;
+    unsigned int  colorTexture(FrameGraphResource resource, size_t idx = 0) const;
+    // bind the resource for rendering, including the backbuffer
+    void bind(FrameGraphResource resource) const;
+
+private:
+    friend class FrameGraph;
+    FrameGraphResources(const FrameGraph& graph);
+
+    const FrameGraph& m_graph;
+};
+
+// passes declare the render targets they read and write. compile() culls passes whose results
+// nobody reads and computes the lifetime of every transient target, execute() then allocates
+// transient targets from the pool right before their first use and hands them back after their
+// last use, so later passes with the same descriptor reuse the same memory within a frame.
+class FrameGraph
+{
+public:
+    using SetupFunc   = std::function<void(FrameGraphBuilder&)>;
+    using ExecuteFunc = std::function<void(const FrameGraphResources&)>;
+
+    FrameGraph(RenderTargetPool& pool);
+    FrameGraph(const FrameGraph&) = delete;
+    FrameGraph& operator=(const FrameGraph&) = delete;
+
+    FrameGraphResource importBackbuffer(const std::string& name, int width, int height);
+    FrameGraphResource importTarget(const std::string& name, RenderTarget* target);
+
+    void addPass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute);
+
+    void compile();
+    void execute();
+    // drop all passes and resources, keeps the allocated memory of the containers
+    void reset();
+
+    int culledPassCount() const
+    {
+        return m_culledPassCount;
+    }
+
+    // highest sum of transient target memory alive at the same time in the last execute()
+    size_t peakTransientMemory() const
+    {
+        return m_peakTransientMemory;
+    }
+
+private:
+    friend class FrameGraphBuilder;
+    friend class FrameGraphResources;
+
+    struct ResourceNode
+    {
+        std::string      name;
+        RenderTargetDesc desc;
+        bool             imported;
+        bool             isBackbuffer;
+        RenderTarget*    target;
+        int              firstPass;
+        int              lastPass;
+        FrameGraphAccess lastWriteAccess;
+        bool             written;
+    };
+
+    struct ResourceAccess
+    {
+        FrameGraphResource resource;
+        FrameGraphAccess   access;
+    };
+
+    struct PassNode
+    {
+        std::string                 name;
+        ExecuteFunc                 execute;
+        std::vector<ResourceAccess> reads;
+        std::vector<ResourceAccess> writes;
+        bool                        sideEffect;
+        bool                        culled;
+    };
+
+    void checkResource(FrameGraphResource resource) const;
+    void insertBarriers(PassNode& pass);
+
+private:
+    RenderTargetPool&         m_pool;
+    std::vector<ResourceNode> m_resources;
+    std::vector<PassNode>     m_passes;
+    bool                      m_compiled            = false;
+    int                       m_culledPassCount     = 0;
+    size_t                    m_peakTransientMemory = 0;
+};
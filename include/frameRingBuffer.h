@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// a range written this frame. data stays valid until the same section comes round again
+struct RingAllocation
+{
+    void*        data   = nullptr;
+    unsigned int buffer = 0;
+    size_t       offset = 0; // into buffer
+    size_t       size   = 0;
+};
+
+// per frame data like transforms and light parameters, written straight into a buffer that stays
+// mapped persistently and coherently. the buffer has one section per frame in flight, so the CPU
+// fills frame N+1 while the GPU still reads frame N. each section is fenced at endFrame and
+// beginFrame only waits when the GPU is still on the frame that used it last. GL thread only
+class FrameRingBuffer
+{
+public:
+    explicit FrameRingBuffer(size_t frameSize = 4 * 1024 * 1024, int frameCount = 3);
+    FrameRingBuffer(const FrameRingBuffer&) = delete;
+    FrameRingBuffer& operator=(const FrameRingBuffer&) = delete;
+    ~FrameRingBuffer();
+
+    // move to the next section, waiting for the GPU if it still reads it
+    void beginFrame();
+    // fence the section, after the last draw that reads it was issued
+    void endFrame();
+
+    // bump allocations in the current section. running out of it aborts, the ring needs a bigger frameSize then
+    RingAllocation allocate(size_t size, size_t alignment);
+    RingAllocation allocateUniform(size_t size);
+    RingAllocation allocateStorage(size_t size);
+
+    // copy a std140/std430 laid out struct into a new range
+    template<typename T>
+    RingAllocation pushUniform(const T& value)
+    {
+        RingAllocation allocation = allocateUniform(sizeof(T));
+        memcpy(allocation.data, &value, sizeof(T));
+        return allocation;
+    }
+
+    template<typename T>
+    RingAllocation pushStorage(const T* values, size_t count)
+    {
+        RingAllocation allocation = allocateStorage(sizeof(T) * count);
+        memcpy(allocation.data, values, sizeof(T) * count);
+        return allocation;
+    }
+
+    // glBindBufferRange to a uniform or shader storage block binding
+    void bindUniform(unsigned int binding, const RingAllocation& allocation) const;
+    void bindStorage(unsigned int binding, const RingAllocation& allocation) const;
+
+    unsigned int buffer() const
+    {
+        return m_buffer;
+    }
+
+    // stats, logged on destruction. waits mean the ring is too short for how far the GPU lags behind
+    int fenceWaitCount() const
+    {
+        return m_waitCount;
+    }
+
+    double fenceWaitMs() const
+    {
+        return m_waitMs;
+    }
+
+    size_t peakFrameBytes() const
+    {
+        return m_peakBytes;
+    }
+
+private:
+    unsigned int       m_buffer = 0;
+    unsigned char*     m_mapped = nullptr;
+    size_t             m_frameSize;
+    int                m_frameCount;
+    std::vector<void*> m_fences; // GLsync per section
+    int                m_section          = 0;
+    size_t             m_head             = 0; // next free byte of the current section
+    bool               m_isInFrame        = false;
+    size_t             m_uniformAlignment = 256;
+    size_t             m_storageAlignment = 256;
+
+    // stats
+    int    m_frames    = 0;
+    int    m_waitCount = 0;
+    double m_waitMs    = 0.0;
+    size_t m_peakBytes = 0;
+};
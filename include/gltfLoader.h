@@ -0,0 +1,104 @@
+#pragma once
+
+#include "packFile.h"
+#include <memory>
+#include <string>
+#include <vector>
+// clang-format off
+#include <glm/glm.hpp>
+// clang-format on
+
+// typed elements in a buffer of the file, read in place from the mapping
+struct GltfAccessor
+{
+    const unsigned char* data          = nullptr; // first element, nullptr if the primitive has none
+    size_t               count         = 0;
+    size_t               stride        = 0; // bytes from one element to the next
+    int                  size          = 0; // components, 1 for SCALAR to 4 for VEC4
+    unsigned int         componentType = 0; // a GL type, glTF uses the same values
+    bool                 isNormalized  = false;
+    bool                 hasBounds     = false; // min and max given by the file, always for positions
+    glm::vec3            min           = glm::vec3(0.0f);
+    glm::vec3            max           = glm::vec3(0.0f);
+
+    size_t elementSize() const;
+    // element i as floats, normalized integers mapped to [0, 1] or [-1, 1]
+    glm::vec4    read(size_t i) const;
+    unsigned int readIndex(size_t i) const;
+};
+
+enum GltfAttribute
+{
+    GLTF_POSITION = 0,
+    GLTF_NORMAL,
+    GLTF_TEXCOORD_0,
+    GLTF_ATTRIBUTE_COUNT
+};
+
+// bytes of the file a vertex buffer needs as they are, accessors sharing an interleaved buffer
+// view share one span
+struct GltfSpan
+{
+    const unsigned char* data   = nullptr;
+    size_t               size   = 0;
+    size_t               offset = 0; // in the vertex bytes, the spans one after another
+};
+
+struct GltfPrimitive
+{
+    GltfAccessor          attributes[GLTF_ATTRIBUTE_COUNT];
+    GltfAccessor          indices; // data is nullptr when the primitive isn't indexed
+    int                   material = -1;
+    std::vector<GltfSpan> spans;
+    size_t                vertexSize = 0;                            // of all the spans
+    size_t                attributeOffsets[GLTF_ATTRIBUTE_COUNT] = {}; // of the first element in the vertex bytes
+};
+
+struct GltfMesh
+{
+    std::string                name;
+    std::vector<GltfPrimitive> primitives; // triangles only, others are skipped
+};
+
+// in a file next to the model or in a buffer view of it. embedded ones have a made up path
+struct GltfImage
+{
+    std::string          path;
+    const unsigned char* data = nullptr; // encoded, for embedded images
+    size_t               size = 0;
+};
+
+struct GltfMaterial
+{
+    std::string name;
+    int         baseColorImage = -1; // into GltfScene::images
+};
+
+struct GltfNode
+{
+    std::string name;
+    int         parent    = -1; // into GltfScene::nodes, parents come before their children
+    glm::mat4   transform = glm::mat4(1.0f); // relative to the parent
+    int         mesh      = -1;
+};
+
+struct GltfScene
+{
+    std::vector<GltfMesh>                    meshes;
+    std::vector<GltfMaterial>                materials;
+    std::vector<GltfImage>                   images;
+    std::vector<GltfNode>                    nodes; // of the default scene, depth first
+    std::vector<std::unique_ptr<MappedFile>> files; // the accessors and images point into these
+};
+
+// glTF 2.0 reader, .glb with its binary chunk or .gltf with buffers in files next to it. the files
+// are mapped and nothing is converted, accessors point into the mappings so importers can copy the
+// buffers as they are. reads the positions, normals and first texture coordinates of triangle
+// primitives, base color textures and the node hierarchy of the default scene
+class GltfLoader
+{
+public:
+    static bool isGltf(const std::string& path);
+    // logs and returns false on a malformed file or anything it doesn't support, like sparse accessors
+    static bool load(const std::string& path, GltfScene& scene);
+};
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "fileWatcher.h"
+#include "shader.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class Texture;
+class Model;
+
+// rebuilds resources when their files change. file io, decoding and importing run on a worker
+// thread, the GL part runs in update() on the GL thread, so a resource is only ever swapped at a
+// frame boundary. a failed rebuild logs and leaves the old resource in place.
+class HotReloader
+{
+public:
+    // GL thread: upload and swap, false if the new resource is unusable
+    using ApplyFunc = std::function<bool()>;
+    // worker thread: load everything that doesn't need GL, an empty ApplyFunc means failure
+    using PrepareFunc = std::function<ApplyFunc()>;
+
+    HotReloader();
+    HotReloader(const HotReloader&) = delete;
+    HotReloader& operator=(const HotReloader&) = delete;
+    ~HotReloader();
+
+    void watch(const std::string& name, const std::vector<std::string>& paths, const PrepareFunc& prepare);
+
+    // the resources have to outlive the reloader
+    void watch(ShaderProgram& program, const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines = ShaderDefines());
+    void watch(Texture& texture);
+    void watch(Model& model);
+
+    // call once per frame on the GL thread, before anything is drawn
+    void update();
+
+private:
+    struct Entry
+    {
+        std::string name;
+        PrepareFunc prepare;
+        bool        isBusy;  // queued or running on the worker
+        bool        isDirty; // changed again while busy
+    };
+
+    struct Job
+    {
+        size_t      entry;
+        PrepareFunc prepare;
+    };
+
+    struct Result
+    {
+        size_t    entry;
+        ApplyFunc apply;
+    };
+
+    void enqueue(size_t entry);
+    void workerLoop();
+
+private:
+    FileWatcher                                  m_watcher;
+    std::vector<Entry>                           m_entries;
+    std::unordered_multimap<std::string, size_t> m_fileEntries; // normalized path -> entry
+
+    std::thread             m_worker;
+    std::mutex              m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Job>         m_jobs;
+    std::vector<Result>     m_results;
+    bool                    m_isStopping = false;
+};
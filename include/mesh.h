@@ -4,6 +4,8 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "bufferAllocator.h"
+#include "resourceManager.h"
 #include "texture.h"
 #include <vector>
 
@@ -14,11 +16,97 @@ struct Vertex
     glm::vec2 texCoords;
 };
 
+// the locations the model shaders read the attributes from
+enum VertexAttributeLocation
+{
+    VERTEX_POSITION = 0,
+    VERTEX_NORMAL,
+    VERTEX_TEXCOORDS,
+    VERTEX_ATTRIBUTE_COUNT
+};
+
+// an attribute in the vertex bytes of a mesh, in the terms of glVertexArrayAttribFormat
+struct VertexAttribute
+{
+    bool         isEnabled    = false;
+    size_t       offset       = 0; // of the first element, from the start of the vertex bytes
+    unsigned int stride       = 0;
+    int          size         = 0; // components
+    unsigned int type         = GL_FLOAT;
+    bool         isNormalized = false;
+};
+
+// vertex bytes are interleaved Vertex unless attributes are enabled here, e.g. by an importer that
+// uploads a file's buffers the way they are stored. disabled attributes read the shader's default
+struct VertexLayout
+{
+    VertexAttribute attributes[VERTEX_ATTRIBUTE_COUNT];
+    size_t          vertexSize = 0; // bytes of vertex data when attributes are enabled
+    unsigned int    indexType  = GL_UNSIGNED_INT;
+
+    bool isInterleaved() const
+    {
+        for(const auto& attribute : attributes)
+        {
+            if(attribute.isEnabled)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// vertices and indices already laid out somewhere, e.g. written there by Model::import. with buffer
+// set they are copied on the GPU from its offsets, otherwise uploaded from the pointers
+struct MeshGeometry
+{
+    unsigned int        buffer       = 0;
+    size_t              vertexOffset = 0;
+    size_t              indexOffset  = 0;
+    const Vertex*       vertices     = nullptr; // the vertex bytes, whatever the layout
+    const unsigned int* indices      = nullptr; // the index bytes, of the layout's index type
+    size_t              vertexCount  = 0;
+    size_t              indexCount   = 0;
+    VertexLayout        layout;
+    glm::vec3           boundsCenter = glm::vec3(0.0f); // see Mesh::boundsCenter
+    float               boundsRadius = 0.0f;
+    float               uvDensity    = 0.0f;
+
+    size_t vertexSize() const
+    {
+        return layout.isInterleaved() ? sizeof(Vertex) * vertexCount : layout.vertexSize;
+    }
+
+    size_t indexSize() const
+    {
+        return indexCount * (layout.indexType == GL_UNSIGNED_BYTE ? 1 : layout.indexType == GL_UNSIGNED_SHORT ? 2 : 4);
+    }
+};
+
+// what a mesh keeps of its geometry in memory once it is uploaded. drawing needs none of it
+enum GeometryResidency
+{
+    GEOMETRY_RESIDENCY_NONE = 0,  // only in video memory
+    GEOMETRY_RESIDENCY_POSITIONS, // positions and indices, enough for cpu queries like picking and culling
+    GEOMETRY_RESIDENCY_FULL,      // every vertex attribute and the indices
+};
+
+// the cpu copy a mesh is built with, filled as residency says
+struct MeshCpuGeometry
+{
+    GeometryResidency         residency = GEOMETRY_RESIDENCY_NONE;
+    std::vector<Vertex>       vertices;  // full only
+    std::vector<glm::vec3>    positions; // positions only
+    std::vector<unsigned int> indices;   // positions and full
+};
+
 class ShaderProgram;
 class Mesh
 {
 public:
-    Mesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<Texture>& textures);
+    Mesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<Texture>& textures, GeometryResidency residency = GEOMETRY_RESIDENCY_FULL);
+    Mesh(const MeshGeometry& geometry, std::vector<Texture>& textures, MeshCpuGeometry cpuGeometry = MeshCpuGeometry());
     Mesh(const Mesh& other);
     Mesh& operator=(const Mesh& other);
     Mesh(Mesh&& other);
@@ -27,15 +115,91 @@ public:
 
     void draw(ShaderProgram& shader);
 
+    const std::vector<Texture>& textures() const
+    {
+        return m_texture;
+    }
+
+    // bounding sphere in model space
+    const glm::vec3& boundsCenter() const
+    {
+        return m_boundsCenter;
+    }
+
+    float boundsRadius() const
+    {
+        return m_boundsRadius;
+    }
+
+    // texture coordinate units per model space unit, averaged over the triangles
+    float uvDensity() const
+    {
+        return m_uvDensity;
+    }
+
+    GeometryResidency residency() const
+    {
+        return m_residency;
+    }
+
+    // only drops data, a dropped copy can't come back without loading the model again
+    void setResidency(GeometryResidency residency);
+
+    // empty unless the residency keeps them
+    const std::vector<Vertex>& vertices() const
+    {
+        return m_vertices;
+    }
+
+    const std::vector<unsigned int>& indices() const
+    {
+        return m_indices;
+    }
+
+    size_t vertexCount() const
+    {
+        return m_vertexCount;
+    }
+
+    size_t indexCount() const
+    {
+        return m_indexCount;
+    }
+
+    // position of a vertex, with positions or full residency
+    const glm::vec3& position(size_t idx) const
+    {
+        return m_residency == GEOMETRY_RESIDENCY_FULL ? m_vertices[idx].position : m_positions[idx];
+    }
+
+    // bytes of the cpu copy, and what it would take with a residency
+    size_t cpuMemorySize() const;
+    size_t cpuMemorySize(GeometryResidency residency) const;
+
 private:
-    void setupMesh();
+    void setupMesh(const MeshGeometry& geometry);
+    // point the vertex array at the current location of the geometry range
+    void bindBuffers(const BufferRange& range);
+    void computeBounds();
+    // drop this mesh's references, the last one queues the vertex array and range for deletion
+    void releaseResources();
 
 private:
     std::vector<Vertex>       m_vertices;
+    std::vector<glm::vec3>    m_positions;
     std::vector<unsigned int> m_indices;
+    GeometryResidency         m_residency = GEOMETRY_RESIDENCY_FULL;
     std::vector<Texture>      m_texture;
-    unsigned                  m_VAO;
-    unsigned                  m_VBO;
-    unsigned                  m_EBO;
-    unsigned int*             m_refCnt = nullptr;
+    ResourceHandle            m_vertexArray;
+    ResourceHandle            m_geometry;
+    VertexLayout              m_layout;
+    unsigned                  m_VAO             = 0;                              // name of m_vertexArray
+    uint32_t                  m_range           = BufferAllocator::INVALID_RANGE; // of m_geometry, vertices then indices, see BufferAllocator::geometry
+    size_t                    m_indexOffset     = 0;
+    size_t                    m_vertexCount     = 0;
+    size_t                    m_indexCount      = 0;
+    uint32_t                  m_rangeGeneration = 0;
+    glm::vec3                 m_boundsCenter    = glm::vec3(0.0f);
+    float                     m_boundsRadius    = 0.0f;
+    float                     m_uvDensity       = 0.0f;
 };
\ No newline at end of file
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "gltfLoader.h"
 #include "mesh.h"
+#include "objLoader.h"
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -9,21 +12,143 @@
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
+// a node of a model's hierarchy, e.g. from a glTF scene. parents come before their children
+struct ModelNode
+{
+    std::string         name;
+    int                 parent          = -1;
+    glm::mat4           transform       = glm::mat4(1.0f); // relative to the parent
+    glm::mat4           globalTransform = glm::mat4(1.0f); // relative to the model
+    std::vector<size_t> meshes;                            // into Model::meshes
+};
+
+// everything a Model is built from, imported without touching GL so it can run on any thread
+struct ModelData
+{
+    struct MeshData
+    {
+        MeshGeometry        geometry;    // offsets into the staging ranges or the arena, with the bounds
+        MeshCpuGeometry     cpuGeometry; // as much as the residency of the import keeps
+        std::vector<size_t> textures;    // index into ModelData::textures
+    };
+
+    struct TextureData
+    {
+        TextureImage   image;
+        TextureType    type; // of the first mesh using it
+        TextureOptions options;
+    };
+
+    std::vector<MeshData>    meshes;
+    std::vector<TextureData> textures; // every texture file once
+    std::vector<ModelNode>   nodes;    // empty when the importer keeps no hierarchy
+
+    // every mesh's vertices and indices, sized up front and written once. in the texture uploader's
+    // mapped buffer if one is set and has room, copied from there on the GPU. otherwise in one arena
+    std::shared_ptr<TextureStaging>  geometryStaging;
+    std::unique_ptr<unsigned char[]> geometryArena;
+    size_t                           geometrySize = 0;
+};
+
 class ShaderProgram;
 class Model
 {
 public:
-    Model(const std::string path);
+    // streamed models start with small textures, a TextureStreamer brings in the rest. residency is
+    // what each mesh keeps of its geometry in memory after the upload
+    Model(const std::string path, bool isStreamed = false, GeometryResidency residency = GEOMETRY_RESIDENCY_NONE);
     void draw(ShaderProgram& shader);
+    // sets the shader's model matrix to transform, times each node's own for models with nodes
+    void draw(ShaderProgram& shader, const glm::mat4& transform);
+
+    // obj files through ObjLoader, glTF files through GltfLoader, anything else through assimp, then texture decode and mip
+    // generation. logs and returns false if anything can't be loaded
+    static bool import(const std::string& path, ModelData& data, bool isStreamed = false, GeometryResidency residency = GEOMETRY_RESIDENCY_NONE);
+
+    // on by default, off sends obj files through assimp as well
+    static void setNativeObj(bool enabled)
+    {
+        s_nativeObj = enabled;
+    }
+
+    // the same for glTF files
+    static void setNativeGltf(bool enabled)
+    {
+        s_nativeGltf = enabled;
+    }
+
+    // replace every mesh and texture, runs on the GL thread
+    void reload(ModelData& data);
+
+    const std::string& path() const
+    {
+        return m_path;
+    }
+
+    bool isStreamed() const
+    {
+        return m_isStreamed;
+    }
+
+    GeometryResidency residency() const
+    {
+        return m_residency;
+    }
+
+    // drop cpu geometry of every mesh, e.g. once picking isn't needed anymore. reloads drop down to it as well
+    void setResidency(GeometryResidency residency);
+
+    // bytes of cpu geometry the meshes hold now, and would hold with a residency
+    size_t cpuGeometrySize() const;
+    size_t cpuGeometrySize(GeometryResidency residency) const;
+    void   logGeometryMemory() const;
+
+    const std::vector<Mesh>& meshes() const
+    {
+        return m_meshes;
+    }
+
+    // empty unless the model was imported with its hierarchy, each mesh is then drawn for every node holding it
+    const std::vector<ModelNode>& nodes() const
+    {
+        return m_nodes;
+    }
+
+    // every texture once, the meshes hold copies sharing the GL names
+    std::vector<Texture>& textures()
+    {
+        return m_loadedTextures;
+    }
+
+    // the model file and every texture it uses
+    std::vector<std::string> dependencies() const;
 
 private:
-    void                 loadModel(const std::string& path);
-    void                 processNode(aiNode* node, const aiScene* scene);
-    Mesh                 processMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType* type, std::string typeName);
+    static bool importAssimp(const std::string& path, ModelData& data, bool isStreamed, GeometryResidency residency);
+    static bool importObj(const std::string& path, ModelData& data, bool isStreamed, GeometryResidency residency);
+    static bool importGltf(const std::string& path, ModelData& data, bool isStreamed, GeometryResidency residency);
+
+    static void processNode(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes);
+    // lays out the vertex and index counts set in data.meshes
+    static void reserveGeometry(ModelData& data);
+    static void processGeometry(aiMesh* mesh, GeometryResidency residency, ModelData& data, ModelData::MeshData& meshData);
+    static bool processMesh(aiMesh* mesh, const aiScene* scene, const std::string& directory, bool isStreamed, GeometryResidency residency, ModelData& data, ModelData::MeshData& meshData);
+    static bool loadMaterialTextures(aiMaterial* material, aiTextureType type, const std::string& directory, bool isStreamed, ModelData& data, ModelData::MeshData& meshData);
+    static void processObjGeometry(const ObjScene& scene, const ObjMesh& mesh, GeometryResidency residency, ModelData& data, ModelData::MeshData& meshData);
+    static void processGltfGeometry(const GltfPrimitive& primitive, GeometryResidency residency, ModelData& data, ModelData::MeshData& meshData);
+    // bytes, when given, are the encoded image and path only names it
+    static bool loadTexture(const std::string& path, TextureType type, bool isStreamed, ModelData& data, ModelData::MeshData& meshData, const unsigned char* bytes = nullptr, size_t size = 0);
+
+    void create(ModelData& data);
 
 private:
-    std::vector<Mesh>    m_meshes;
-    std::string          m_directory;
-    std::vector<Texture> m_loadedTextures;
-};
\ No newline at end of file
+    std::vector<Mesh>      m_meshes;
+    std::vector<ModelNode> m_nodes;
+    std::string            m_path;
+    std::vector<Texture>   m_loadedTextures;
+    bool                   m_isStreamed = false;
+    GeometryResidency      m_residency  = GEOMETRY_RESIDENCY_NONE;
+
+    static bool s_nativeObj;
+    static bool s_nativeGltf;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+#include <vector>
+// clang-format off
+#include <glm/glm.hpp>
+// clang-format on
+
+// a corner of a face, into the arrays of ObjScene. -1 where the face doesn't have one
+struct ObjIndex
+{
+    int position = -1;
+    int texCoord = -1;
+    int normal   = -1;
+};
+
+struct ObjMaterial
+{
+    std::string name;
+    std::string diffuseMap; // relative to the obj file, empty if the material has none
+    std::string specularMap;
+    std::string ambientMap;
+};
+
+struct ObjMesh
+{
+    std::string               name;          // of the last o or g statement before it
+    int                       material = -1; // into ObjScene::materials
+    std::vector<ObjIndex>     vertices;      // every distinct corner once, each becomes a Vertex
+    std::vector<unsigned int> indices;       // triangles, into vertices
+    bool                      hasTexCoords = false;
+};
+
+struct ObjScene
+{
+    std::vector<glm::vec3>   positions;
+    std::vector<glm::vec3>   normals;
+    std::vector<glm::vec2>   texCoords; // v flipped for GL, like aiProcess_FlipUVs
+    std::vector<ObjMesh>     meshes;    // one per object or group and material, in file order
+    std::vector<ObjMaterial> materials;
+};
+
+// wavefront obj reader for what the assets use: v, vt, vn, polygons with negative or missing
+// indices, o, g, usemtl and mtllib, with the diffuse, specular and ambient maps of the materials.
+// the file is mapped and cut at line ends into chunks parsed on every thread, once to count the
+// vertex statements and once to parse them straight into place. files in a mounted pack are read
+// from it
+class ObjLoader
+{
+public:
+    static bool isObj(const std::string& path);
+    // logs and returns false on a malformed file
+    static bool load(const std::string& path, ObjScene& scene);
+};
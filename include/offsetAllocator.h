@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// two level segregated fit allocator over a range of abstract units, e.g. the bytes of a gpu buffer.
+// free regions sit in 256 size bins spaced like a float with 3 mantissa bits, a bitmask per level
+// finds a bin big enough in constant time. freeing merges with free neighbours, also in constant
+// time. only bookkeeping, it never touches the memory it manages.
+class OffsetAllocator
+{
+public:
+    static const uint32_t NO_SPACE = 0xffffffff;
+
+    struct Allocation
+    {
+        uint32_t offset = NO_SPACE;
+        uint32_t node   = NO_SPACE;
+    };
+
+    explicit OffsetAllocator(uint32_t size);
+
+    // NO_SPACE offset when no free region is big enough
+    Allocation allocate(uint32_t size);
+    void       free(Allocation allocation);
+    void       reset();
+
+    uint32_t size() const
+    {
+        return m_size;
+    }
+
+    uint32_t freeSize() const
+    {
+        return m_freeSize;
+    }
+
+    // lower bound of the biggest free region, exact up to the bin spacing
+    uint32_t largestFreeRegion() const;
+
+private:
+    struct Node
+    {
+        uint32_t offset;
+        uint32_t size;
+        uint32_t binPrev;
+        uint32_t binNext;
+        uint32_t neighborPrev;
+        uint32_t neighborNext;
+        bool     isUsed;
+    };
+
+    uint32_t insertIntoBin(uint32_t size, uint32_t offset);
+    void     removeFromBin(uint32_t node);
+    uint32_t newNode();
+
+private:
+    uint32_t              m_size;
+    uint32_t              m_freeSize = 0;
+    uint32_t              m_usedTopBins;
+    uint8_t               m_usedLeafBins[32];
+    uint32_t              m_binHeads[256];
+    std::vector<Node>     m_nodes;
+    std::vector<uint32_t> m_freeNodes;
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// layout of a pack: a PackHeader, the entry data, the directory of PackEntry sorted by name hash,
+// then the names. little endian, written and read as is
+struct PackHeader
+{
+    char     magic[4]; // "PACK"
+    uint32_t version;
+    uint32_t entryCount;
+    uint32_t reserved;
+    uint64_t directoryOffset;
+    uint64_t namesOffset;
+};
+
+enum PackMethod
+{
+    PACK_METHOD_STORED = 0, // read straight from the mapping
+    PACK_METHOD_ZLIB,
+};
+
+struct PackEntry
+{
+    uint64_t hash;        // of the name, see PackFile::hash
+    uint64_t offset;      // of the data in the pack
+    uint64_t packedSize;  // in the pack
+    uint64_t size;        // once inflated
+    uint64_t contentHash; // of the inflated data, stands in for the modification time of a loose file
+    uint32_t nameOffset;  // into the names
+    uint16_t nameLength;
+    uint8_t  method;
+    uint8_t  reserved;
+};
+
+// bytes of a file, pointing into the mapping of a pack for stored entries or owned otherwise
+struct FileData
+{
+    const unsigned char*       data = nullptr;
+    size_t                     size = 0;
+    std::vector<unsigned char> storage; // inflated or read from disk
+};
+
+// a whole file in memory, mapped where it can be so only the pages touched are read. files in a
+// mounted pack come from it, anything else that can't be mapped is read
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    bool isOpen() const
+    {
+        return m_isOpen;
+    }
+
+    const unsigned char* data() const
+    {
+        return m_file.data;
+    }
+
+    size_t size() const
+    {
+        return m_file.size;
+    }
+
+private:
+    FileData m_file;
+    void*    m_mapping = nullptr;
+    bool     m_isOpen  = false;
+};
+
+// read only archive of many files, mapped at once so opening an entry is a binary search and reading
+// it touches only its pages. compressed entries are inflated on every read. packs are mounted at a
+// directory and then answer for every path below it, Texture, Model and ShaderProgram load through
+// PackFile::load and fall back to the loose files. a loose file changed after the pack was made wins
+// over its entry, so hot reload sees edits. mount before loading starts, reads are thread safe
+class PackFile
+{
+public:
+    static const uint32_t VERSION = 1;
+
+    explicit PackFile(const std::string& path);
+    PackFile(const PackFile&) = delete;
+    PackFile& operator=(const PackFile&) = delete;
+    ~PackFile();
+
+    bool isOpen() const
+    {
+        return m_data != nullptr;
+    }
+
+    size_t entryCount() const
+    {
+        return m_entryCount;
+    }
+
+    // name relative to the directory the pack was made from, with '/' separators. nullptr if missing
+    const PackEntry* find(const std::string& name) const;
+    bool             read(const PackEntry& entry, FileData& file) const;
+    std::string      name(const PackEntry& entry) const;
+
+    // from the pack mounted at the deepest directory holding path, or from disk
+    static bool load(const std::string& path, FileData& file);
+    // true for files read from a mounted pack, with their inflated size and content hash
+    static bool isPacked(const std::string& path, uint64_t* size = nullptr, uint64_t* contentHash = nullptr);
+    static bool mount(const std::string& packPath, const std::string& directory);
+    static void unmountAll();
+    static bool hasMounts();
+
+    static uint64_t hash(const void* data, size_t size);
+    static uint64_t hash(const std::string& name);
+
+    // files are (name in the pack, path on disk). an entry is stored when deflating it saves less than
+    // minSaving of its size, like already compressed images. level is zlib's, 0 stores everything
+    static bool write(const std::string& packPath, const std::vector<std::pair<std::string, std::string>>& files, int level = 6, float minSaving = 0.05f);
+
+private:
+    // the pack mounted for path and the name of path inside it
+    static const PackFile* resolve(const std::string& path, std::string& name);
+    // the entry path is read from, nullptr when it's missing or the loose file is newer than the pack
+    static const PackEntry* lookup(const std::string& path, const PackFile*& pack);
+    // header, directory and every entry inside the pack, so reads never need to check again
+    bool validate() const;
+
+private:
+    std::string                     m_path;
+    const unsigned char*            m_data       = nullptr;
+    size_t                          m_size       = 0;
+    std::vector<unsigned char>      m_buffer; // the whole pack where it can't be mapped
+    const PackEntry*                m_entries    = nullptr;
+    const char*                     m_names      = nullptr;
+    size_t                          m_entryCount = 0;
+    std::filesystem::file_time_type m_modifiedTime; // loose files newer than this are read instead
+
+    static std::vector<std::pair<std::string, std::unique_ptr<PackFile>>> s_mounts;
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// split [0, count) into contiguous ranges, one per hardware thread, and run func on each. the
+// calling thread takes the first range. small jobs use fewer threads: every thread gets at least
+// minCost worth of work, where one item costs costPerItem
+void parallelFor(int count, size_t costPerItem, size_t minCost, const std::function<void(int begin, int end)>& func);
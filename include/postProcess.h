@@ -0,0 +1,96 @@
+#pragma once
+
+#include "frameGraph.h"
+#include "programPipeline.h"
+#include "shader.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+enum PostEffectType
+{
+    // per pixel, only read the pixel they write
+    POST_EFFECT_TONE_MAPPING = 0, // param: exposure
+    POST_EFFECT_GAMMA,            // param: gamma
+    POST_EFFECT_INVERSION,
+    POST_EFFECT_GRAYSCALE,
+    // 3x3 kernels, read the neighbours of their input
+    POST_EFFECT_SHARPEN,
+    POST_EFFECT_EDGE_DETECT,
+    // separable gaussian, two compute passes. param: radius in pixels
+    POST_EFFECT_BLUR,
+};
+
+#define POST_BLUR_MAX_RADIUS 16
+#define POST_BLUR_GROUP_SIZE 128
+
+struct PostEffect
+{
+    PostEffectType type;
+    float          param;
+};
+
+// a configurable list of screen effects. with fusion on, consecutive effects are merged into one
+// generated fragment shader: a kernel effect can only start a pass (it needs neighbours of its input),
+// per pixel effects are appended to whatever pass is open. blurs always run as their own compute passes.
+class PostProcessChain
+{
+public:
+    PostProcessChain();
+    PostProcessChain(const PostProcessChain&) = delete;
+    PostProcessChain& operator=(const PostProcessChain&) = delete;
+    ~PostProcessChain();
+
+    void add(PostEffectType type, float param = 0.0f);
+    void clear();
+    void setFusion(bool isFused);
+
+    bool isFused() const
+    {
+        return m_isFused;
+    }
+
+    // number of full screen passes the chain currently needs, a blur counts as two
+    int passCount();
+
+    // add the chain's passes to the graph: read input (sampled), write output (render target)
+    void addPasses(FrameGraph& graph, FrameGraphResource input, FrameGraphResource output, int width, int height);
+
+    // average gpu time of the whole chain over the frames since the last call, 0 if nothing finished yet
+    double averageGpuTimeMs();
+
+private:
+    struct Stage
+    {
+        bool                             isCompute;
+        std::vector<PostEffect>          effects;
+        std::unique_ptr<ShaderProgram>   program;
+        std::unique_ptr<ShaderProgram>   verticalProgram; // blur only
+        std::unique_ptr<ProgramPipeline> pipeline;        // fragment stages only
+    };
+
+    void        build();
+    std::string generateFragmentShader(const Stage& stage) const;
+    std::string generateBlurShader(bool isHorizontal) const;
+    void        executeFragmentStage(Stage& stage, unsigned int inputTexture);
+    void        executeBlurPass(Stage& stage, bool isHorizontal, unsigned int inputTexture, unsigned int outputTexture, int width, int height);
+    void        beginTiming();
+    void        endTiming();
+
+private:
+    std::vector<PostEffect>        m_effects;
+    std::vector<Stage>             m_stages;
+    std::unique_ptr<ShaderProgram> m_vertexProgram; // fullscreen triangle, shared by all fragment stages
+    bool                           m_isFused = true;
+    bool                           m_isDirty = true;
+    unsigned int                   m_emptyVAO;
+
+    // ring of timer queries, read back a few frames later so the cpu never waits on them
+    static const int   TIMER_QUERY_COUNT = 4;
+    unsigned int       m_timerQueries[TIMER_QUERY_COUNT];
+    bool               m_timerPending[TIMER_QUERY_COUNT] = {};
+    int                m_timerIdx                        = 0;
+    bool               m_isTiming                        = false;
+    double             m_gpuTimeSumMs                    = 0.0;
+    int                m_gpuTimeSamples                  = 0;
+};
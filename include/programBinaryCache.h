@@ -0,0 +1,33 @@
+#pragma once
+
+#include "shader.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// on-disk cache of linked program binaries. a program is keyed by all of its stage sources (after
+// preprocessing, so defines are part of them) plus the driver's vendor, renderer and version
+// strings, a driver update therefore never sees an old blob.
+class ProgramBinaryCache
+{
+public:
+    // default "program-cache" next to the working directory, an empty path disables the cache
+    static void setDirectory(const std::string& directory);
+    static void setEnabled(bool isEnabled);
+    static bool isEnabled();
+
+    static uint64_t hash(const std::vector<ShaderSource>& sources, bool isSeparable = false);
+
+    // true if the cached binary was accepted and program is linked
+    static bool load(unsigned int program, uint64_t key);
+    // call on a successfully linked program that had GL_PROGRAM_BINARY_RETRIEVABLE_HINT set
+    static void store(unsigned int program, uint64_t key);
+
+private:
+    static std::string filePath(uint64_t key);
+    static bool        isSupported();
+
+private:
+    static std::string s_directory;
+    static bool        s_isEnabled;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+class ShaderProgram;
+
+// combines separable programs stage by stage, e.g. one vertex program with many fragment programs,
+// without linking every combination. a bound program (glUseProgram) takes precedence over the
+// pipeline, bind() therefore unbinds it.
+class ProgramPipeline
+{
+public:
+    ProgramPipeline();
+    ProgramPipeline(const ProgramPipeline&) = delete;
+    ProgramPipeline& operator=(const ProgramPipeline&) = delete;
+    ~ProgramPipeline();
+
+    // use every stage of a separable program, replacing whatever was set for those stages
+    void setProgram(const ShaderProgram& program);
+    // use only the given GL_*_SHADER_BIT stages of the program
+    void setStages(unsigned int stageBits, const ShaderProgram& program);
+
+    void bind();
+    // check that the interfaces between the stages match, logs the driver's message if not
+    bool validate();
+
+    unsigned int id() const
+    {
+        return m_id;
+    }
+
+private:
+    unsigned int m_id;
+};
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "texture.h"
+#include <memory>
+#include <vector>
+
+enum RenderTargetFormat
+{
+    RT_FORMAT_NONE = 0,
+    RT_FORMAT_RGBA8,
+    RT_FORMAT_RGBA16F,
+    RT_FORMAT_R11G11B10F,
+    RT_FORMAT_R8,
+    RT_FORMAT_R16F,
+    RT_FORMAT_DEPTH24_STENCIL8,
+    RT_FORMAT_DEPTH32F,
+};
+
+struct RenderTargetDesc
+{
+    int                             width   = 0;
+    int                             height  = 0;
+    int                             samples = 1; // > 1 renders into multisample renderbuffers, resolve() fills the textures
+    std::vector<RenderTargetFormat> colorFormats;
+    RenderTargetFormat              depthFormat  = RT_FORMAT_NONE;
+    bool                            sampledDepth = false; // depth as a texture instead of a renderbuffer
+
+    bool operator==(const RenderTargetDesc& other) const;
+    bool operator!=(const RenderTargetDesc& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+class RenderTarget
+{
+public:
+    RenderTarget(const RenderTargetDesc& desc);
+    RenderTarget(const RenderTarget&) = delete;
+    RenderTarget& operator=(const RenderTarget&) = delete;
+    ~RenderTarget();
+
+public:
+    static unsigned int translateInternalFormat(RenderTargetFormat format);
+    static int          bytesPerPixel(RenderTargetFormat format);
+
+    // bind the default framebuffer and set the viewport to it
+    static void bindDefault(int width, int height);
+
+public:
+    // bind for rendering and set the viewport to the target size
+    void bind();
+    // copy multisample attachments into the sampled textures, no-op without MSAA
+    void resolve();
+    // reallocate every attachment, contents are lost. no-op if the size doesn't change
+    void resize(int width, int height);
+    // attach the depth buffer of another target of the same size instead of owning one
+    void shareDepth(const RenderTarget& other);
+
+    unsigned int id() const
+    {
+        return m_fbo;
+    }
+
+    const RenderTargetDesc& desc() const
+    {
+        return m_desc;
+    }
+
+    int width() const
+    {
+        return m_desc.width;
+    }
+
+    int height() const
+    {
+        return m_desc.height;
+    }
+
+    // texture ids to sample from, resolved when the target is multisampled
+    unsigned int colorTexture(size_t idx = 0) const;
+    unsigned int depthTexture() const;
+
+    // gpu memory owned by this target, shared depth not included
+    size_t memorySize() const;
+
+private:
+    void create();
+    void release();
+    void checkStatus(unsigned int fbo) const;
+
+private:
+    RenderTargetDesc          m_desc;
+    unsigned int              m_fbo        = 0;
+    unsigned int              m_resolveFbo = 0;
+    std::vector<Texture>      m_colorTextures;
+    std::vector<unsigned int> m_msaaColorRbos;
+    std::unique_ptr<Texture>  m_depthTexture;
+    unsigned int              m_depthRbo     = 0;
+    unsigned int              m_msaaDepthRbo = 0;
+};
+
+// hands out render targets for transient passes and keeps released ones around,
+// so a pass asking for the same descriptor next frame gets the same gpu memory back.
+class RenderTargetPool
+{
+public:
+    RenderTargetPool() = default;
+    RenderTargetPool(const RenderTargetPool&) = delete;
+    RenderTargetPool& operator=(const RenderTargetPool&) = delete;
+
+    RenderTarget* acquire(const RenderTargetDesc& desc);
+    void          release(RenderTarget* target);
+
+    // advance the frame counter and free targets that stayed unused for maxIdleFrames,
+    // e.g. the old sizes after a window resize
+    void endFrame(unsigned int maxIdleFrames = 3);
+    void clear();
+
+    size_t targetCount() const
+    {
+        return m_entries.size();
+    }
+    size_t memorySize() const;
+
+private:
+    struct Entry
+    {
+        std::unique_ptr<RenderTarget> target;
+        bool                          inUse;
+        unsigned long                 lastUsedFrame;
+    };
+
+    std::vector<Entry> m_entries;
+    unsigned long      m_frame = 0;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum ResourceType
+{
+    RESOURCE_TEXTURE = 0,
+    RESOURCE_BUFFER,
+    RESOURCE_VERTEX_ARRAY,
+    RESOURCE_PROGRAM,
+    RESOURCE_GEOMETRY_RANGE, // a range id of BufferAllocator::geometry, not a GL name
+    RESOURCE_TYPE_COUNT
+};
+
+// a slot in the pool of its type and the generation the slot had when the handle was made. the
+// generation goes up when the resource is released, so a stale handle resolves to nothing instead
+// of to whatever took the slot next
+struct ResourceHandle
+{
+    static const uint32_t INVALID_INDEX = 0xffffffff;
+
+    uint32_t     index      = INVALID_INDEX;
+    uint32_t     generation = 0;
+    ResourceType type       = RESOURCE_TEXTURE;
+
+    bool isValid() const
+    {
+        return index != INVALID_INDEX;
+    }
+};
+
+struct ResourceManagerStats
+{
+    int    liveCount[RESOURCE_TYPE_COUNT] = {};
+    int    createdCount                   = 0;
+    int    deletedCount                   = 0;
+    int    pendingCount                   = 0; // released, waiting for the GPU to be done with them
+    int    peakPendingCount               = 0;
+    size_t poolBytes                      = 0;
+};
+
+// owner of GL objects shared by several Textures, Meshes and ShaderPrograms. every type has a pool
+// of slots holding the name and an atomic refcount, so handles can be copied and released on any
+// thread, e.g. by loader threads handing meshes over. slots are allocated in chunks that never move
+// and are reused through a free list. the last release only queues the name, collect() deletes it
+// on the GL thread DELETE_DELAY frames later, when no draw still in flight can use it
+class ResourceManager
+{
+public:
+    static const uint64_t DELETE_DELAY = 3;
+
+    // any thread, though GL names are only made on the GL thread. the handle holds the first reference
+    static ResourceHandle create(ResourceType type, unsigned int name);
+    // any thread. another reference to a resource the caller already holds one of
+    static void acquire(const ResourceHandle& handle);
+    // any thread. invalid handles are ignored
+    static void release(const ResourceHandle& handle);
+
+    // any thread. 0 for invalid and stale handles
+    static unsigned int name(const ResourceHandle& handle);
+    static bool         isAlive(const ResourceHandle& handle);
+    static uint32_t     refCount(const ResourceHandle& handle);
+
+    // GL thread, once a frame. nothing released is deleted until this runs
+    static void collect();
+    // GL thread, deletes everything still queued and logs stats. call before the context goes away
+    static void shutdown();
+
+    static ResourceManagerStats stats();
+    static void                 logStats();
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// filtering and wrapping of a texture, kept apart from its pixels. zero enums are filled in by
+// SamplerCache::get with linear filtering and repeat wrapping
+struct SamplerDesc
+{
+    unsigned int         minFilter   = 0;
+    unsigned int         magFilter   = 0;
+    unsigned int         wrapS       = 0;
+    unsigned int         wrapT       = 0;
+    unsigned int         wrapR       = 0;
+    float                anisotropy  = 1.0f;
+    std::array<float, 4> borderColor = {0.0f, 0.0f, 0.0f, 0.0f};
+
+    bool operator==(const SamplerDesc& other) const;
+    bool operator!=(const SamplerDesc& other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// one GL sampler object per distinct SamplerDesc, shared by every texture sampled that way. a scene
+// ends up with a handful of them however many textures it has. GL thread only
+class SamplerCache
+{
+public:
+    // created on first use, lives until clear()
+    static unsigned int get(const SamplerDesc& desc);
+    // deletes every sampler, call before the context goes away
+    static void clear();
+
+    static size_t samplerCount()
+    {
+        return s_samplers.size();
+    }
+
+private:
+    static std::vector<std::pair<SamplerDesc, unsigned int>> s_samplers;
+};
@@ -1,59 +1,164 @@
 #pragma once
 
+#include "resourceManager.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
 #include <string>
+#include <vector>
 
 enum ShaderType
 {
     VERTEX_SHADER   = 0,
     FRAGMENT_SHADER = 1,
     GEOMETRY_SHADER = 2,
+    COMPUTE_SHADER  = 3,
+};
+
+// name -> value, an empty value is a plain "#define NAME". ordered so equal sets produce equal sources
+using ShaderDefines = std::map<std::string, std::string>;
+
+struct ShaderSource
+{
+    ShaderType  type;
+    std::string source;
+    std::string name; // shown in logs, usually the file path
 };
 
 class ShaderProgram
 {
 public:
+    // submits the compile, the status is only queried by checkError()
     class Shader
     {
     public:
         Shader(const std::string& path, ShaderType type);
+        Shader(const ShaderSource& source);
+        Shader(const Shader&) = delete;
+        Shader& operator=(const Shader&) = delete;
         unsigned int id() const
         {
             return m_id;
         }
+        const std::string& name() const
+        {
+            return m_name;
+        }
+        bool checkError();
         ~Shader();
 
     private:
-        bool checkError();
+        void compile(const std::string& source);
 
     private:
         ShaderType   m_type;
         unsigned int m_id;
+        std::string  m_name;
     };
 
 public:
     ShaderProgram(const std::string& vertextPath, const std::string& fragmentPath);
     ShaderProgram(const std::string& vertextPath, const std::string& fragmentPath, const std::string& geometryPath);
+    // build from in-memory sources, e.g. generated shaders. every constructor goes through the
+    // program binary cache first and only compiles from source on a miss.
+    // compile and link are only submitted here, errors are reported (and abort) on first use, so
+    // the driver can work on several programs at once.
+    // a separable program can be combined with other separable programs in a ProgramPipeline
+    ShaderProgram(const std::vector<ShaderSource>& sources, bool isSeparable = false);
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
     ~ShaderProgram();
 
+    static std::string readFile(const std::string& path);
+    // read a shader file, resolve #include "file" (relative to the including file, every file
+    // is included once) and insert the defines right after #version. a file that can't be read
+    // becomes an #error, so it fails the compile instead of aborting. dependencies, if given,
+    // receives every file that was read
+    static std::string preprocess(const std::string& path, const ShaderDefines& defines = ShaderDefines(), std::vector<std::string>* dependencies = nullptr);
+
+    // submit all compiles first and then all links, so nothing waits for a single program.
+    // with GL_KHR_parallel_shader_compile the driver spreads them over its compiler threads
+    static std::vector<std::unique_ptr<ShaderProgram>> createBatch(const std::vector<std::vector<ShaderSource>>& programs, bool isSeparable = false);
+
+    // number of work groups needed to cover size invocations
+    static unsigned int groupCount(unsigned int size, unsigned int localSize)
+    {
+        return (size + localSize - 1) / localSize;
+    }
+    // glMemoryBarrier, e.g. GL_SHADER_IMAGE_ACCESS_BARRIER_BIT before reading what a dispatch wrote
+    static void memoryBarrier(unsigned int barrierBits);
+
     unsigned int id() const
     {
+        finish();
         return m_id;
     }
+    // false while the driver is still compiling/linking, never blocks. always true without
+    // GL_KHR_parallel_shader_compile since there is no way to ask
+    bool isReady() const;
+    // wait for the link and check it, called by every function that needs the program
+    void finish() const;
     void use();
 
+    bool isSeparable() const
+    {
+        return m_isSeparable;
+    }
+    // GL_*_SHADER_BIT of every stage in the program
+    unsigned int stageBits() const
+    {
+        return m_stageBits;
+    }
+
+    // compute programs only. dispatch binds the program, memory barriers are up to the caller
+    void dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1);
+    // group counts come from a DispatchIndirectCommand at offset in buffer, e.g. written by a previous dispatch
+    void dispatchIndirect(unsigned int buffer, size_t offset = 0);
+    // layout(local_size_x/y/z) of a compute program
+    void localSize(int size[3]) const;
+
+    // build a new program from the sources and replace this one with it. on errors the old
+    // program stays and false is returned. uniform values are carried over
+    bool reload(const std::vector<ShaderSource>& sources);
+
     // uniform util function
     void setBool(const std::string& name, bool value) const;
     void setInt(const std::string& name, int value) const;
     void setFloat(const std::string& name, float value) const;
     void setMat4(const std::string& name, const float* value) const;
     void setVec3(const std::string& name, const float* value) const;
+    void setVec4(const std::string& name, const float* value) const;
 
 private:
-    void linkShader(unsigned int vertexId, unsigned int fragmentId);
-    void linkShader(unsigned int vertexId, unsigned int fragmentId, unsigned int geometryId);
+    struct DeferredTag
+    {
+    };
+    // only loads from the cache or submits the compiles, submitLink() has to follow
+    ShaderProgram(const std::vector<ShaderSource>& sources, bool isSeparable, DeferredTag);
 
-    bool checkError();
+    static void enableParallelCompile();
+    static void appendFile(const std::string& path, std::string& out, std::set<std::string>& included, int depth);
+
+    void submitCompile(const std::vector<ShaderSource>& sources);
+    void submitLink();
+
+    bool checkError() const;
+    bool checkCompute() const;
+    static void copyUniforms(unsigned int from, unsigned int to);
 
 private:
-    unsigned int m_id;
+    unsigned int   m_id;
+    ResourceHandle m_handle; // of m_id, deleted through ResourceManager so draws in flight can finish
+    bool           m_isSeparable = false;
+    unsigned int   m_stageBits   = 0;
+
+    // state of a program whose link status hasn't been checked yet
+    mutable bool                                 m_isPending = false;
+    bool                                         m_isCached  = false;
+    uint64_t                                     m_cacheKey  = 0;
+    std::string                                  m_name;
+    mutable std::vector<std::unique_ptr<Shader>> m_shaders;
+    std::chrono::steady_clock::time_point        m_startTime;
 };
\ No newline at end of file
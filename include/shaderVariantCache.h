@@ -0,0 +1,31 @@
+#pragma once
+
+#include "shader.h"
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// all permutations of one vertex + fragment shader pair. a variant is preprocessed and compiled
+// the first time its define set is requested, later requests return the same program.
+class ShaderVariantCache
+{
+public:
+    ShaderVariantCache(const std::string& vertexPath, const std::string& fragmentPath);
+    ShaderVariantCache(const ShaderVariantCache&) = delete;
+    ShaderVariantCache& operator=(const ShaderVariantCache&) = delete;
+
+    ShaderProgram& get(const ShaderDefines& defines = ShaderDefines());
+
+    size_t variantCount() const
+    {
+        return m_variants.size();
+    }
+
+private:
+    static std::string key(const ShaderDefines& defines);
+
+private:
+    std::string                                                     m_vertexPath;
+    std::string                                                     m_fragmentPath;
+    std::unordered_map<std::string, std::unique_ptr<ShaderProgram>> m_variants;
+};
@@ -1,7 +1,14 @@
 #pragma once
+#include "resourceManager.h"
+#include <memory>
 #include <string>
 #include <vector>
 
+struct TextureSampler;
+struct TextureStaging;
+struct TextureStream;
+class TextureUploader;
+
 enum TextureType
 {
     TEXTURE_BUFFER = 0,
@@ -12,6 +19,39 @@ enum TextureType
     TEXTURE_AMBIENT
 };
 
+enum MipFilter
+{
+    MIP_FILTER_NONE = 0, // level 0 only
+    MIP_FILTER_BOX,      // average of the covered texels, cheap and a little soft
+    MIP_FILTER_KAISER,   // kaiser windowed sinc, keeps distant detail sharper
+};
+
+enum TextureCompression
+{
+    TEXTURE_COMPRESSION_NONE = 0,
+    TEXTURE_COMPRESSION_AUTO, // bc1 for rgb, bc3 for rgba
+    TEXTURE_COMPRESSION_BC1,  // rgb, 4 bits per texel
+    TEXTURE_COMPRESSION_BC3,  // rgba, 8 bits per texel
+    TEXTURE_COMPRESSION_BC5,  // red and green only, for data like normals, 8 bits per texel
+    TEXTURE_COMPRESSION_BC7,  // rgba, 8 bits per texel, best quality
+};
+
+struct TextureOptions
+{
+    MipFilter          mipFilter    = MIP_FILTER_BOX;
+    bool               isSrgb       = false; // pixels are srgb colors, mips are averaged in linear space
+    bool               isSrgbFormat = false; // sample through an srgb format, only right if the output is gamma corrected
+    bool               isTrilinear  = true;  // blend between the two nearest mips
+    float              anisotropy   = 8.0f;  // clamped to the driver limit, 1 turns it off
+    TextureCompression compression  = TEXTURE_COMPRESSION_NONE;
+    bool               isCached     = true; // keep compressed results next to the source, see TextureCompressor
+    bool               isStreamed   = false; // only the small mips go to video memory at first, see TextureStreamer
+
+    // diffuse and ambient maps hold colors, the others hold data. all of them are compressed, normal
+    // maps keep x and y only (bc5) and need z rebuilt in the shader
+    static TextureOptions forType(TextureType textureType);
+};
+
 struct TextureProperty
 {
     int         width;
@@ -20,13 +60,37 @@ struct TextureProperty
     std::string path;
 };
 
+// decoded pixels of one image. decoding doesn't touch GL, so it can run on any thread
+struct TextureImage
+{
+    int                        width      = 0;
+    int                        height     = 0;
+    int                        nrChannels = 0;
+    std::vector<unsigned char> pixels;
+    std::string                path;
+    // levels 1 and down, same layout as pixels. filled by Texture::generateMips, built at upload if empty
+    std::vector<std::vector<unsigned char>> mips;
+    // blocks of every level, level 0 first. once compressed, pixels and mips are empty
+    TextureCompression                      compression = TEXTURE_COMPRESSION_NONE;
+    std::vector<std::vector<unsigned char>> levels;
+    // every level written to a TextureUploader by Texture::load, pixels, mips and levels are empty then
+    std::shared_ptr<TextureStaging> staging;
+};
+
 class Texture
 {
 public:
     Texture(const std::string& path, TextureType textureType = TextureType::TEXTURE_DIFFUSE, bool isFlip = true);
-    Texture(const std::vector<std::string>& paths, TextureType textureType = TextureType::TEXTURE_DIFFUSE, bool isFlip = true);
+    Texture(const std::string& path, TextureType textureType, bool isFlip, const TextureOptions& options);
+    // cube map from 6 equally sized square faces, +x -x +y -y +z -z. with bakedPath every face and its
+    // mips are also written to that one file, later runs read it instead while the faces are unchanged
+    Texture(const std::vector<std::string>& paths, TextureType textureType = TextureType::TEXTURE_DIFFUSE, bool isFlip = true, const std::string& bakedPath = "");
+    Texture(const TextureImage& image, TextureType textureType = TextureType::TEXTURE_DIFFUSE, bool isFlip = true);
+    Texture(const TextureImage& image, TextureType textureType, bool isFlip, const TextureOptions& options);
 
     Texture(int width, int height, int nrChannels);
+    // empty immutable storage, e.g. a render target attachment. internalFormat has to be a sized one
+    Texture(int width, int height, unsigned int internalFormat, unsigned int format);
     Texture(const Texture&);
     Texture& operator=(const Texture&);
     Texture(Texture&&);
@@ -35,10 +99,39 @@ public:
 
 public:
     static std::string translateTextureTypeName(TextureType textureType);
+    // always 3 or 4 channels, gray images are expanded. logs and returns false on failure
+    static bool decode(const std::string& path, bool isFlip, TextureImage& image);
+    // an encoded image already in memory, e.g. embedded in a model file. name takes the place of the path
+    static bool decode(const std::string& name, const unsigned char* data, size_t size, bool isFlip, TextureImage& image);
+    // decode, mips and compression as options ask, compressed images come from the cache when it
+    // is up to date. doesn't touch GL. isStaged false keeps the levels in memory even with an uploader
+    static bool load(const std::string& path, bool isFlip, const TextureOptions& options, TextureImage& image, bool isStaged = true);
+    // the same from memory. there's no file to keep a compressed copy next to, nothing is cached
+    static bool load(const std::string& name, const unsigned char* data, size_t size, bool isFlip, const TextureOptions& options, TextureImage& image, bool isStaged = true);
+
+    // with an uploader set, Texture::load stages images into it and uploads copy from there
+    static void setUploader(TextureUploader* uploader);
+
+    static TextureUploader* uploader()
+    {
+        return s_uploader;
+    }
+    // full mip chain of image into image.mips, filtered on worker threads. doesn't touch GL
+    static void generateMips(TextureImage& image, const TextureOptions& options);
+    static int  mipLevelCount(int width, int height);
+    // bind a texture name that has no Texture, e.g. a render target attachment, sampled linear with
+    // repeat through the shared sampler its Texture has
+    static void bindUnit(unsigned int unit, unsigned int id);
 
 public:
+    // bind the texture and its sampler to a texture unit
+    void bind(unsigned int unit) const;
+
+    // sampling state lives in a sampler object shared with every texture sampled the same way, see
+    // SamplerCache. changing it changes every copy of this texture, nothing is bound
     void setWarpType(unsigned int SWarpType, unsigned int TWarpType, const std::vector<float>& borderColor = std::vector<float>());
     void setFilterType(unsigned int minFilter, unsigned int magFilter);
+    void setAnisotropy(float anisotropy);
 
     unsigned int id() const
     {
@@ -52,9 +145,96 @@ public:
 
     std::string path(int idx = 0) const;
 
+    int width() const
+    {
+        return m_properties.empty() ? 0 : m_properties[0].width;
+    }
+
+    int height() const
+    {
+        return m_properties.empty() ? 0 : m_properties[0].height;
+    }
+
+    bool isFlip() const
+    {
+        return m_isFlip;
+    }
+
+    bool isCubeMap() const
+    {
+        return m_properties.size() > 1;
+    }
+
+    const TextureOptions& options() const
+    {
+        return m_options;
+    }
+
+    int mipLevels() const
+    {
+        return m_levels;
+    }
+
+    TextureCompression compression() const
+    {
+        return m_compression;
+    }
+
+    // bytes of all resident levels in video memory, rgb counts as rgba as drivers pad it
+    size_t memorySize() const;
+    // bytes of level firstLevel and all smaller ones
+    size_t levelsMemorySize(int firstLevel) const;
+    // the same texture as uncompressed rgba8
+    size_t uncompressedSize() const;
+
+    // replace the pixels of a 2d texture. the GL name stays the same, so every copy of this
+    // texture (e.g. the ones held by meshes) sees the new image. the storage is immutable, the
+    // new image must have the same size and channel count
+    bool reload(const TextureImage& image);
+
+    // streamed textures keep their levels in memory and only have levels residentLevel and down in
+    // video memory. with sparse texture support the other levels take no memory, without it they
+    // are still allocated and only never sampled
+    bool isStreamed() const
+    {
+        return m_stream != nullptr;
+    }
+
+    // 0 unless streamed
+    int residentLevel() const;
+    // largest level a streamed texture may drop to, 0 unless streamed
+    int minResidentLevel() const;
+    // GL thread. uploads the levels down to level or releases the ones above it, clamped to
+    // minResidentLevel
+    void setResidentLevel(int level);
+
+private:
+    using MipChain = std::vector<std::vector<unsigned char>>;
+
+    static TextureImage loadImage(const std::string& path, bool isFlip, const TextureOptions& options);
+    static MipChain     buildMipChain(const TextureImage& image, const TextureOptions& options);
+    static void         stage(TextureImage& image);
+    // mips, compression and staging of a decoded image. cacheKey stores the compressed result for it
+    static void         prepare(TextureImage& image, const TextureOptions& options, bool isStaged, const uint64_t* cacheKey);
+    static int          levelCount(const TextureImage& image);
+    static void         levelData(const TextureImage& image, int level, const void*& data, size_t& size);
+    // face is the cube map face, -1 for 2d textures. lastLevel -1 is the last one
+    void                uploadLevels(const TextureImage& image, int face = -1, int firstLevel = 0, int lastLevel = -1);
+    void                commitLevels(int firstLevel, int lastLevel, bool isCommitted);
+    void                initSampler(unsigned int minFilter, unsigned int wrap);
+    void                updateSampler();
+
 private:
-    unsigned int                 m_id;
-    TextureType                  m_type;
-    std::vector<TextureProperty> m_properties;
-    unsigned int*                m_refCnt = nullptr;
+    unsigned int                    m_id = 0; // name of m_handle
+    ResourceHandle                  m_handle;
+    TextureType                     m_type;
+    std::vector<TextureProperty>    m_properties;
+    bool                            m_isFlip = true;
+    TextureOptions                  m_options;
+    int                             m_levels      = 1;
+    TextureCompression              m_compression = TEXTURE_COMPRESSION_NONE;
+    std::shared_ptr<TextureStream>  m_stream;  // shared by every copy
+    std::shared_ptr<TextureSampler> m_sampler; // shared by every copy
+
+    static TextureUploader* s_uploader;
 };
\ No newline at end of file
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "texture.h"
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+// where one image ended up in the atlas
+struct AtlasRegion
+{
+    int       layer;
+    int       x, y, width, height; // texels in the layer
+    glm::vec4 uvTransform;         // uv * xy + zw maps the image's 0..1 uvs into the layer
+};
+
+// packs small images into the layers of one GL_TEXTURE_2D_ARRAY, so draws using any of them share
+// a single bind. images are placed with a skyline packer, every image is surrounded by padding
+// texels repeating its edge and mips stop where the padding runs out, so neighbours never bleed.
+// an image filling a whole layer, or one that is repeated, gets a layer of its own and keeps
+// GL_REPEAT working. every layer is rgba8 (or the compression in options), rgb and gray images are
+// expanded
+class TextureAtlas
+{
+public:
+    explicit TextureAtlas(int layerSize = 1024, int padding = 8, const TextureOptions& options = defaultOptions());
+    TextureAtlas(const TextureAtlas&) = delete;
+    TextureAtlas& operator=(const TextureAtlas&) = delete;
+    ~TextureAtlas();
+
+    // queue an image, returns its region index. repeated images must be layerSize square
+    int add(const std::string& path, bool isFlip = true, bool isRepeated = false);
+    int add(const TextureImage& image, bool isRepeated = false);
+
+    // decode the queued files on worker threads, pack, build the mips and upload. GL thread, once
+    void build();
+
+    // bind the array and its sampler to a texture unit
+    void bind(unsigned int unit) const;
+
+    unsigned int id() const
+    {
+        return m_id;
+    }
+
+    const AtlasRegion& region(int index) const
+    {
+        return m_regions[index];
+    }
+
+    int layerCount() const
+    {
+        return m_layerCount;
+    }
+
+    static TextureOptions defaultOptions();
+
+private:
+    struct Pending
+    {
+        std::string  path;
+        bool         isFlip;
+        bool         isRepeated;
+        TextureImage image;
+    };
+
+private:
+    unsigned int             m_id      = 0;
+    unsigned int             m_sampler = 0;
+    int                      m_layerSize;
+    int                      m_padding;
+    TextureOptions           m_options;
+    int                      m_layerCount = 0;
+    std::vector<Pending>     m_pending;
+    std::vector<AtlasRegion> m_regions;
+};
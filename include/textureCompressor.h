@@ -0,0 +1,46 @@
+#pragma once
+
+#include "texture.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// cpu block compression of texture levels, and the cache of the results kept next to the source
+// image. nothing here touches GL, so all of it can run on a loader thread.
+//
+// cache file layout, modelled on KTX2 but without its data format descriptor:
+//   header     magic, version, key, compression, width, height, nrChannels, levelCount, faceCount
+//   level index offset and size of every level of every face, face 0 level 0 first
+//   levels     the blocks or pixels, each level 8 byte aligned
+// a cache holds one face, a baked cube map six
+class TextureCompressor
+{
+public:
+    // AUTO picks by channel count
+    static TextureCompression resolve(TextureCompression compression, int nrChannels);
+    static const char*        name(TextureCompression compression);
+    static size_t             blockSize(TextureCompression compression);
+    // NONE counts nrChannels bytes per texel
+    static size_t             levelSize(TextureCompression compression, int width, int height, int nrChannels = 4);
+    static unsigned int       internalFormat(TextureCompression compression, bool isSrgb);
+
+    // one level of nrChannels 8 bit pixels, encoded on worker threads. partial blocks at the
+    // right and top edge repeat the last texel
+    static std::vector<unsigned char> encode(const unsigned char* pixels, int width, int height, int nrChannels, TextureCompression compression);
+    // encode level 0 and every mip into image.levels, the pixels are dropped afterwards
+    static void compress(TextureImage& image, TextureCompression compression);
+
+    // source file size and modification time plus everything that changes the encoded data
+    static uint64_t    cacheKey(const std::string& path, bool isFlip, const TextureOptions& options);
+    static uint64_t    cacheKey(const std::vector<std::string>& paths, bool isFlip, const TextureOptions& options);
+    static std::string cachePath(const std::string& path);
+    // false if there is no cache file or it was written for another key
+    static bool loadCache(const std::string& path, uint64_t key, TextureImage& image);
+    static void storeCache(const std::string& path, uint64_t key, const TextureImage& image);
+    // the same for a file of several equally sized faces, compressed or not
+    static bool loadContainer(const std::string& file, uint64_t key, std::vector<TextureImage>& faces);
+    static void storeContainer(const std::string& file, uint64_t key, const std::vector<const TextureImage*>& faces);
+
+    // every level of image in memory, level 0 first. empty once it was staged
+    static std::vector<const std::vector<unsigned char>*> levelsOf(const TextureImage& image);
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "texture.h"
+#include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+class Camera;
+class Model;
+
+// keeps streamed textures (TextureOptions::isStreamed) at the level their meshes need on screen,
+// within a video memory budget. the level a mesh needs is how many texels of its uv mapping land on
+// one pixel, from its bounding sphere and the camera. when the wanted levels don't fit the budget,
+// textures covering little of the screen give up levels first.
+//
+// every frame, request each drawn model with its transform, then update once on the GL thread
+class TextureStreamer
+{
+public:
+    explicit TextureStreamer(size_t budget = 256 * 1024 * 1024, size_t uploadPerFrame = 16 * 1024 * 1024);
+    ~TextureStreamer();
+
+    void request(const Model& model, const glm::mat4& transform);
+    void update(const Camera& camera, float viewportWidth, float viewportHeight);
+
+    // bytes of the resident levels of every tracked texture
+    size_t residentSize() const
+    {
+        return m_residentSize;
+    }
+
+    size_t budget() const
+    {
+        return m_budget;
+    }
+
+private:
+    struct Request
+    {
+        const Model* model;
+        glm::mat4    transform;
+    };
+
+    struct Entry
+    {
+        Texture texture;     // a copy, keeps the GL name alive while it's tracked
+        int     wantedLevel; // what the screen asks for
+        int     targetLevel; // what fits the budget
+        float   coverage;    // part of the screen covered by meshes using it this frame
+        int     idleFrames;  // frames since it was last requested
+    };
+
+    void fitBudget();
+    void apply();
+
+private:
+    size_t                                  m_budget;
+    size_t                                  m_uploadPerFrame;
+    std::vector<Request>                    m_requests;
+    std::unordered_map<unsigned int, Entry> m_entries; // by GL name
+    size_t                                  m_residentSize = 0;
+
+    // stats, logged on destruction
+    size_t m_streamedBytes = 0;
+    size_t m_evictedBytes  = 0;
+    size_t m_peakSize      = 0;
+};
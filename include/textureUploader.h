@@ -0,0 +1,99 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TextureUploader;
+
+// levels of one image, or any other ranges like a model's geometry, written into the uploader's buffer.
+// dropping it hands the memory back once the GL copies made from it have finished
+struct TextureStaging
+{
+    TextureUploader*    uploader;
+    uint64_t            allocation;
+    unsigned int        buffer;
+    unsigned char*      mapped;  // the whole mapped buffer, range i is written at mapped + offsets[i]
+    std::vector<size_t> offsets; // per level, into buffer
+    std::vector<size_t> sizes;
+
+    TextureStaging() = default;
+    TextureStaging(const TextureStaging&) = delete;
+    TextureStaging& operator=(const TextureStaging&) = delete;
+    ~TextureStaging();
+};
+
+// a ring of pixel unpack memory, mapped once and kept mapped. loader threads copy decoded levels
+// straight into it, the GL thread then copies from the buffer with glTexSubImage2D, which returns
+// without waiting on the driver. every range is fenced when it was used and recycled once the fence
+// passed. create it on the GL thread.
+class TextureUploader
+{
+public:
+    explicit TextureUploader(size_t capacity = 64 * 1024 * 1024);
+    TextureUploader(const TextureUploader&) = delete;
+    TextureUploader& operator=(const TextureUploader&) = delete;
+    ~TextureUploader();
+
+    // any thread. copies every level into the ring. a loader thread waits while the ring is full, the
+    // GL thread recycles what it can instead. nullptr if it doesn't fit, the caller keeps its pixels then
+    std::shared_ptr<TextureStaging> stage(const std::vector<const std::vector<unsigned char>*>& levels);
+    // any thread. like stage, but only reserves the ranges, the caller writes them through mapped
+    std::shared_ptr<TextureStaging> reserve(const std::vector<size_t>& sizes);
+
+    // GL thread, after the copies from staging were issued
+    void fence(const TextureStaging& staging);
+
+    // GL thread, once per frame. recycles finished ranges and wakes waiting loaders
+    void update();
+
+    unsigned int buffer() const
+    {
+        return m_buffer;
+    }
+
+private:
+    enum AllocationState
+    {
+        ALLOCATION_LIVE = 0, // a TextureStaging owns it
+        ALLOCATION_RELEASED, // free once its fence passed
+        ALLOCATION_PADDING,  // end of the buffer skipped when wrapping
+    };
+
+    struct Allocation
+    {
+        uint64_t        id;
+        size_t          offset;
+        size_t          size;
+        AllocationState state;
+        void*           fence; // GLsync of the last copy from it
+    };
+
+    friend struct TextureStaging;
+    void        release(uint64_t allocation);
+    bool        tryAllocate(size_t size, size_t& offset, uint64_t& id);
+    void        recycle(bool isBlocking);
+    Allocation* find(uint64_t id);
+
+private:
+    unsigned int    m_buffer   = 0;
+    unsigned char*  m_mapped   = nullptr;
+    size_t          m_capacity = 0;
+    std::thread::id m_glThread;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_recycled;
+    std::deque<Allocation>  m_allocations; // oldest first, the ring runs from front to back
+    size_t                  m_head   = 0;  // where the next allocation starts
+    uint64_t                m_nextId = 1;
+
+    // stats, logged on destruction
+    size_t m_stagedBytes = 0;
+    int    m_waitCount   = 0;
+    int    m_rejectCount = 0;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+struct TransparentDraw
+{
+    glm::vec3    position;
+    unsigned int id; // user data, e.g. index of the object in the caller's own array
+};
+
+class TransparentSorter
+{
+public:
+    TransparentSorter() = default;
+
+    // sort draws back to front by view-space depth. draws at the same depth keep their submission order.
+    // returns indices into draws, valid until the next call to sort().
+    const std::vector<unsigned int>& sort(const TransparentDraw* draws, size_t count, const glm::mat4& view);
+    const std::vector<unsigned int>& sort(const std::vector<TransparentDraw>& draws, const glm::mat4& view);
+
+    void reserve(size_t count);
+
+private:
+    void computeDepthKeys(const TransparentDraw* draws, size_t count, const glm::mat4& view);
+    void radixSort(size_t count);
+
+private:
+    // all buffers are reused across frames, they only grow
+    std::vector<unsigned int> m_keys;
+    std::vector<unsigned int> m_tmpKeys;
+    std::vector<unsigned int> m_indices;
+    std::vector<unsigned int> m_tmpIndices;
+};
@@ -23,6 +23,9 @@ public:
     void        setKeyCallback(KeyCallbackFunc cb);
     void        setMouseCallback(MouseCallback cb);
     void        setScrollCallback(ScrollCallback cb);
+    // ends a frame: deletes the GL objects released a few frames ago, see ResourceManager::collect,
+    // then presents. every render loop calls it instead of glfwSwapBuffers
+    void swapBuffers();
 
 public:
     // clang-format off
@@ -8,14 +8,32 @@ out vec2 TexCoords;
 out vec3 FragPos;
 out vec3 Normal;
 
+#ifdef USE_FRAME_UBO
+// ranges of a FrameRingBuffer, the camera once per frame and the object once per draw
+layout(std140, binding = 0) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+};
+layout(std140, binding = 1) uniform Object
+{
+    mat4 model;
+    mat4 normalMatrix; // transpose(inverse(model)), done once on the cpu instead of per vertex
+};
+#else
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+#endif
 
 void main()
 {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
+#ifdef USE_FRAME_UBO
+    Normal      = mat3(normalMatrix) * aNormal;
+#else
     Normal      = mat3(transpose(inverse(model))) * aNormal;
+#endif
     FragPos     = vec3(model * vec4(aPos, 1.0));
     TexCoords   = aTexCoords;
 }
\ No newline at end of file
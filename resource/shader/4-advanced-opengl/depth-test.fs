@@ -4,7 +4,12 @@ in vec2 TexCoords;
 
 out vec4 FragColor;
 
+#ifdef USE_ATLAS
+uniform sampler2DArray texture1;
+uniform float          atlasLayer;
+#else
 uniform sampler2D texture1;
+#endif
 uniform float     near;
 uniform float     far;
 
@@ -16,7 +21,11 @@ float LinearizeDepth(float depth)
 
 void main()
 {
+#ifdef USE_ATLAS
+    vec4 texColor = texture(texture1, vec3(TexCoords, atlasLayer));
+#else
     vec4 texColor = texture(texture1, TexCoords);
+#endif
     if(texColor.a < 0.1)
         discard;
     FragColor = texColor;
@@ -8,9 +8,17 @@ out vec2 TexCoords;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+#ifdef USE_ATLAS
+// scale and offset of the image's region in its atlas layer
+uniform vec4 uvTransform;
+#endif
 
 void main()
 {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
-    TexCoords   = aTexCoords;
+#ifdef USE_ATLAS
+    TexCoords = aTexCoords * uvTransform.xy + uvTransform.zw;
+#else
+    TexCoords = aTexCoords;
+#endif
 }
\ No newline at end of file
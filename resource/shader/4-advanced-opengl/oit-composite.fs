@@ -0,0 +1,26 @@
+#version 460 core
+
+out vec4 FragColor;
+
+uniform sampler2D accumTexture;
+uniform sampler2D revealTexture;
+
+const float EPSILON = 0.00001;
+
+void main()
+{
+    ivec2 coords = ivec2(gl_FragCoord.xy);
+
+    float revealage = texelFetch(revealTexture, coords, 0).r;
+    // nothing transparent covers this pixel
+    if(abs(revealage - 1.0) <= EPSILON)
+        discard;
+
+    vec4 accumulation = texelFetch(accumTexture, coords, 0);
+    // avoid inf / inf when the weights overflow half float
+    if(isinf(max(max(abs(accumulation.r), abs(accumulation.g)), abs(accumulation.b))))
+        accumulation.rgb = vec3(accumulation.a);
+
+    vec3 averageColor = accumulation.rgb / max(accumulation.a, EPSILON);
+    FragColor         = vec4(averageColor, 1.0 - revealage);
+}
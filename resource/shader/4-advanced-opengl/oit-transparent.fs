@@ -0,0 +1,31 @@
+#version 460 core
+
+in vec2 TexCoords;
+
+layout(location = 0) out vec4  accum;
+layout(location = 1) out float reveal;
+
+#ifdef USE_ATLAS
+uniform sampler2DArray texture1;
+uniform float          atlasLayer;
+#else
+uniform sampler2D texture1;
+#endif
+
+void main()
+{
+#ifdef USE_ATLAS
+    vec4 color = texture(texture1, vec3(TexCoords, atlasLayer));
+#else
+    vec4 color = texture(texture1, TexCoords);
+#endif
+    if(color.a < 0.1)
+        discard;
+
+    // weighted blended OIT, McGuire & Bavoil 2013 (eq. 10)
+    float weight = clamp(pow(min(1.0, color.a * 10.0) + 0.01, 3.0) * 1e8 * pow(1.0 - gl_FragCoord.z * 0.9, 3.0), 1e-2, 3e3);
+
+    // accum: blended with (ONE, ONE), reveal: blended with (ZERO, ONE_MINUS_SRC_COLOR)
+    accum  = vec4(color.rgb * color.a, color.a) * weight;
+    reveal = color.a;
+}
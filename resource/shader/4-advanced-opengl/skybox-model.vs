@@ -1,21 +0,0 @@
-#version 460 core
-
-layout(location = 0) in vec3 aPos;
-layout(location = 1) in vec3 aNormal;
-layout(location = 2) in vec2 aTexCoords;
-
-out vec2 TexCoords;
-out vec3 FragPos;
-out vec3 Normal;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-
-void main()
-{
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-    Normal      = mat3(transpose(inverse(model))) * aNormal;
-    FragPos     = vec3(model * vec4(aPos, 1.0));
-    TexCoords   = aTexCoords;
-}
\ No newline at end of file
@@ -0,0 +1,121 @@
+// phong lighting shared by the lit shaders. the callers sample their material once and pass the
+// colors in, every light reuses them.
+//
+// defines:
+//   HAS_DIR_LIGHT      uniform DirLight dirLight
+//   NUM_POINT_LIGHTS   uniform PointLight pointLights[NUM_POINT_LIGHTS], 0 if not defined
+//   HAS_SPOT_LIGHT     uniform SpotLight spotLight
+//   HAS_SPECULAR_MAP   without it the specular term is compiled out
+
+#ifndef NUM_POINT_LIGHTS
+#    define NUM_POINT_LIGHTS 0
+#endif
+
+struct DirLight
+{
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight
+{
+    vec3 position;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+struct SpotLight
+{
+    vec3  position;
+    vec3  direction;
+    vec3  ambient;
+    vec3  diffuse;
+    vec3  specular;
+    float cutOff;
+    float outerCutOff;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+#ifdef HAS_DIR_LIGHT
+uniform DirLight dirLight;
+#endif
+#if NUM_POINT_LIGHTS > 0
+uniform PointLight pointLights[NUM_POINT_LIGHTS];
+#endif
+#ifdef HAS_SPOT_LIGHT
+uniform SpotLight spotLight;
+#endif
+
+vec3 calcPhong(vec3 ambientLight, vec3 diffuseLight, vec3 specularLight, vec3 lightDir, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    vec3 ambient = ambientLight * diffuseColor;
+
+    float diff    = max(dot(normal, lightDir), 0.0);
+    vec3  diffuse = diffuseLight * (diff * diffuseColor);
+#ifdef HAS_SPECULAR_MAP
+    vec3  reflectDir = reflect(-lightDir, normal);
+    float spec       = pow(max(dot(viewDir, reflectDir), 0.0), shininess);
+    vec3  specular   = specularLight * (spec * specularColor);
+    return ambient + diffuse + specular;
+#else
+    return ambient + diffuse;
+#endif
+}
+
+float calcAttenuation(float constant, float linear, float quadratic, vec3 lightPos, vec3 fragPos)
+{
+    float _distance = length(lightPos - fragPos);
+    return 1.0 / (constant + linear * _distance + quadratic * (_distance * _distance));
+}
+
+vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    vec3 lightDir = normalize(-light.direction);
+    return calcPhong(light.ambient, light.diffuse, light.specular, lightDir, normal, viewDir, diffuseColor, specularColor, shininess);
+}
+
+vec3 calcPointLight(PointLight light, vec3 normal, vec3 viewDir, vec3 fragPos, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    vec3  lightDir    = normalize(light.position - fragPos);
+    float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, light.position, fragPos);
+    return attenuation * calcPhong(light.ambient, light.diffuse, light.specular, lightDir, normal, viewDir, diffuseColor, specularColor, shininess);
+}
+
+vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 viewDir, vec3 fragPos, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    vec3  lightDir    = normalize(light.position - fragPos);
+    float attenuation = calcAttenuation(light.constant, light.linear, light.quadratic, light.position, fragPos);
+    // spotlight intensity
+    float theta     = dot(lightDir, normalize(-light.direction));
+    float epsilon   = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    return attenuation * intensity * calcPhong(light.ambient, light.diffuse, light.specular, lightDir, normal, viewDir, diffuseColor, specularColor, shininess);
+}
+
+// sum of every light enabled by the defines
+vec3 calcLights(vec3 normal, vec3 viewDir, vec3 fragPos, vec3 diffuseColor, vec3 specularColor, float shininess)
+{
+    vec3 result = vec3(0.0);
+#ifdef HAS_DIR_LIGHT
+    result += calcDirLight(dirLight, normal, viewDir, diffuseColor, specularColor, shininess);
+#endif
+#if NUM_POINT_LIGHTS > 0
+    for(int i = 0; i < NUM_POINT_LIGHTS; i++)
+    {
+        result += calcPointLight(pointLights[i], normal, viewDir, fragPos, diffuseColor, specularColor, shininess);
+    }
+#endif
+#ifdef HAS_SPOT_LIGHT
+    result += calcSpotLight(spotLight, normal, viewDir, fragPos, diffuseColor, specularColor, shininess);
+#endif
+    return result;
+}
@@ -0,0 +1,337 @@
+#include "bufferAllocator.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+// a buffer is worth sliding ranges around in once this share of its free memory is scattered
+static const float COMPACT_FRAGMENTATION = 0.25f;
+// a buffer is only emptied into the others below this use, and only if they keep half their free
+// space afterwards. otherwise the next allocations would just need a new buffer again
+static const float EVACUATE_USAGE = 0.25f;
+
+std::unique_ptr<BufferAllocator> BufferAllocator::s_geometry;
+
+BufferAllocator* BufferAllocator::geometry()
+{
+    if(!s_geometry)
+    {
+        s_geometry = std::make_unique<BufferAllocator>();
+    }
+    return s_geometry.get();
+}
+
+void BufferAllocator::releaseGeometry()
+{
+    s_geometry.reset();
+}
+
+BufferAllocator::BufferAllocator(size_t blockSize, size_t alignment)
+    : m_blockSize(blockSize)
+    , m_alignment(alignment)
+{
+    if(alignment == 0 || (alignment & (alignment - 1)) != 0 || blockSize / alignment > 0xfffffffe)
+    {
+        GL_LOG_E("invalid buffer allocator block size %zu alignment %zu", blockSize, alignment);
+        std::abort();
+    }
+}
+
+BufferAllocator::~BufferAllocator()
+{
+    logStats();
+    for(auto& block : m_blocks)
+    {
+        glDeleteBuffers(1, &block->buffer);
+    }
+}
+
+size_t BufferAllocator::units(size_t size) const
+{
+    return (size + m_alignment - 1) / m_alignment;
+}
+
+BufferAllocator::Block* BufferAllocator::createBlock(size_t size)
+{
+    size_t blockUnits = units(size);
+    auto   block      = std::unique_ptr<Block>(new Block {0, blockUnits * m_alignment, OffsetAllocator(static_cast<uint32_t>(blockUnits)), 0, 0});
+    // immutable, written with glNamedBufferSubData and copied on the GPU by compaction
+    glCreateBuffers(1, &block->buffer);
+    glNamedBufferStorage(block->buffer, block->size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    GL_LOG_D("buffer allocator: new buffer %d of %.2f MB", block->buffer, block->size / (1024.0 * 1024.0));
+    m_blocks.push_back(std::move(block));
+    return m_blocks.back().get();
+}
+
+void BufferAllocator::releaseBlock(Block* block)
+{
+    GL_LOG_D("buffer allocator: release empty buffer %d", block->buffer);
+    glDeleteBuffers(1, &block->buffer);
+    m_blocks.erase(std::find_if(m_blocks.begin(), m_blocks.end(), [block](const std::unique_ptr<Block>& item) { return item.get() == block; }));
+    m_releasedCount++;
+}
+
+bool BufferAllocator::allocateIn(Block* block, size_t size, OffsetAllocator::Allocation& allocation) const
+{
+    size_t count = units(size);
+    if(count > block->allocator.freeSize())
+    {
+        return false;
+    }
+    allocation = block->allocator.allocate(static_cast<uint32_t>(count));
+    return allocation.offset != OffsetAllocator::NO_SPACE;
+}
+
+uint32_t BufferAllocator::allocate(size_t size)
+{
+    if(size == 0)
+    {
+        return INVALID_RANGE;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // the newest buffer first, it is the one most likely to have room
+    Block*                      block = nullptr;
+    OffsetAllocator::Allocation allocation;
+    for(auto iter = m_blocks.rbegin(); iter != m_blocks.rend() && !block; ++iter)
+    {
+        if(allocateIn(iter->get(), size, allocation))
+        {
+            block = iter->get();
+        }
+    }
+    if(!block)
+    {
+        block = createBlock(std::max(size, m_blockSize));
+        allocateIn(block, size, allocation);
+    }
+    block->usedBytes += size;
+    block->rangeCount++;
+
+    uint32_t id;
+    if(m_freeAllocations.empty())
+    {
+        id = static_cast<uint32_t>(m_allocations.size());
+        m_allocations.emplace_back();
+    }
+    else
+    {
+        id = m_freeAllocations.back();
+        m_freeAllocations.pop_back();
+    }
+    Allocation& entry = m_allocations[id];
+    entry.block       = block;
+    entry.allocation  = allocation;
+    entry.range       = {block->buffer, allocation.offset * m_alignment, size, entry.range.generation + 1};
+    entry.isLive      = true;
+
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    m_allocUs += us;
+    m_maxAllocUs = std::max(m_maxAllocUs, us);
+    m_allocCalls++;
+    return id;
+}
+
+void BufferAllocator::free(uint32_t range)
+{
+    if(range == INVALID_RANGE)
+    {
+        return;
+    }
+    if(range >= m_allocations.size() || !m_allocations[range].isLive)
+    {
+        GL_LOG_E("buffer allocator: free of unknown range %u", range);
+        std::abort();
+    }
+    Allocation& entry = m_allocations[range];
+    entry.block->allocator.free(entry.allocation);
+    entry.block->usedBytes -= entry.range.size;
+    entry.block->rangeCount--;
+    entry.isLive = false;
+    m_freeAllocations.push_back(range);
+}
+
+void BufferAllocator::upload(uint32_t range, size_t offset, const void* data, size_t size)
+{
+    const BufferRange& target = this->range(range);
+    if(offset + size > target.size)
+    {
+        GL_LOG_E("buffer allocator: upload of %zu bytes at %zu overflows range %u of %zu bytes", size, offset, range, target.size);
+        std::abort();
+    }
+    glNamedBufferSubData(target.buffer, target.offset + offset, size, data);
+}
+
+void BufferAllocator::copy(uint32_t range, size_t offset, unsigned int buffer, size_t bufferOffset, size_t size)
+{
+    const BufferRange& target = this->range(range);
+    if(offset + size > target.size)
+    {
+        GL_LOG_E("buffer allocator: copy of %zu bytes at %zu overflows range %u of %zu bytes", size, offset, range, target.size);
+        std::abort();
+    }
+    glCopyNamedBufferSubData(buffer, target.buffer, bufferOffset, target.offset + offset, size);
+}
+
+const BufferRange& BufferAllocator::range(uint32_t range) const
+{
+    if(range >= m_allocations.size() || !m_allocations[range].isLive)
+    {
+        GL_LOG_E("buffer allocator: unknown range %u", range);
+        std::abort();
+    }
+    return m_allocations[range].range;
+}
+
+bool BufferAllocator::move(uint32_t range, Block* target)
+{
+    Allocation&                 entry = m_allocations[range];
+    OffsetAllocator::Allocation allocation;
+    if(!allocateIn(target, entry.range.size, allocation))
+    {
+        return false;
+    }
+    if(target == entry.block && allocation.offset >= entry.allocation.offset)
+    {
+        target->allocator.free(allocation);
+        return false;
+    }
+
+    // ordered with the draws around it, earlier ones read the old copy and later ones the new. the
+    // old range may be handed out again right away, writes to it queue behind this copy
+    size_t offset = allocation.offset * m_alignment;
+    glCopyNamedBufferSubData(entry.block->buffer, target->buffer, entry.range.offset, offset, entry.range.size);
+
+    entry.block->allocator.free(entry.allocation);
+    entry.block->usedBytes -= entry.range.size;
+    entry.block->rangeCount--;
+    target->usedBytes += entry.range.size;
+    target->rangeCount++;
+
+    entry.block        = target;
+    entry.allocation   = allocation;
+    entry.range.buffer = target->buffer;
+    entry.range.offset = offset;
+    entry.range.generation++;
+    m_movedBytes += entry.range.size;
+    return true;
+}
+
+size_t BufferAllocator::compact(size_t maxBytes)
+{
+    size_t moved = 0;
+
+    // with several buffers, empty the least used one into the others so it can go
+    if(m_blocks.size() > 1)
+    {
+        Block* victim    = nullptr;
+        size_t freeBytes = 0;
+        for(auto& block : m_blocks)
+        {
+            if(!victim || block->usedBytes < victim->usedBytes)
+            {
+                victim = block.get();
+            }
+        }
+        for(auto& block : m_blocks)
+        {
+            freeBytes += block.get() == victim ? 0 : block->allocator.freeSize() * m_alignment;
+        }
+        if(victim->usedBytes < victim->size * EVACUATE_USAGE && victim->usedBytes <= freeBytes / 2)
+        {
+            // a scan of every range, compaction runs a few times a frame at most
+            for(uint32_t i = 0; i < m_allocations.size() && moved < maxBytes && victim->rangeCount > 0; i++)
+            {
+                if(!m_allocations[i].isLive || m_allocations[i].block != victim)
+                {
+                    continue;
+                }
+                for(auto& block : m_blocks)
+                {
+                    size_t size = m_allocations[i].range.size;
+                    if(block.get() != victim && move(i, block.get()))
+                    {
+                        moved += size;
+                        break;
+                    }
+                }
+            }
+            if(victim->rangeCount == 0)
+            {
+                releaseBlock(victim);
+            }
+            return moved;
+        }
+    }
+
+    // otherwise slide the last ranges of a fragmented buffer down into its holes
+    for(auto& item : m_blocks)
+    {
+        Block*   block     = item.get();
+        uint32_t freeUnits = block->allocator.freeSize();
+        if(freeUnits == 0 || block->allocator.largestFreeRegion() >= freeUnits * (1.0f - COMPACT_FRAGMENTATION))
+        {
+            continue;
+        }
+        std::vector<uint32_t> ranges;
+        for(uint32_t i = 0; i < m_allocations.size(); i++)
+        {
+            if(m_allocations[i].isLive && m_allocations[i].block == block)
+            {
+                ranges.push_back(i);
+            }
+        }
+        std::sort(ranges.begin(), ranges.end(), [this](uint32_t a, uint32_t b) { return m_allocations[a].range.offset > m_allocations[b].range.offset; });
+        for(uint32_t i : ranges)
+        {
+            size_t size = m_allocations[i].range.size;
+            if(moved >= maxBytes || !move(i, block))
+            {
+                break;
+            }
+            moved += size;
+        }
+        if(moved >= maxBytes)
+        {
+            break;
+        }
+    }
+    return moved;
+}
+
+BufferAllocatorStats BufferAllocator::stats() const
+{
+    BufferAllocatorStats stats;
+    size_t               largestSum = 0;
+    stats.bufferCount               = static_cast<int>(m_blocks.size());
+    for(const auto& block : m_blocks)
+    {
+        size_t freeBytes = block->allocator.freeSize() * m_alignment;
+        size_t largest   = block->allocator.largestFreeRegion() * m_alignment;
+        stats.capacity += block->size;
+        stats.usedBytes += block->usedBytes;
+        stats.freeBytes += freeBytes;
+        stats.paddingBytes += block->size - freeBytes - block->usedBytes;
+        stats.allocationCount += block->rangeCount;
+        stats.largestFree = std::max(stats.largestFree, largest);
+        largestSum += largest;
+    }
+    stats.fragmentation   = stats.freeBytes ? 1.0f - static_cast<float>(largestSum) / stats.freeBytes : 0.0f;
+    stats.averageAllocUs  = m_allocCalls ? m_allocUs / m_allocCalls : 0.0;
+    stats.maxAllocUs      = m_maxAllocUs;
+    stats.movedBytes      = m_movedBytes;
+    stats.releasedBuffers = m_releasedCount;
+    return stats;
+}
+
+void BufferAllocator::logStats() const
+{
+    auto stats = this->stats();
+    GL_LOG_I("buffer allocator: %d buffers for %d ranges, %.2f of %.2f MB used, %.2f KB padding, %.1f%% of free memory fragmented, alloc avg %.2f us max %.2f us, "
+             "%.2f MB moved, %d buffers released",
+             stats.bufferCount, stats.allocationCount, stats.usedBytes / (1024.0 * 1024.0), stats.capacity / (1024.0 * 1024.0), stats.paddingBytes / 1024.0,
+             stats.fragmentation * 100.0f, stats.averageAllocUs, stats.maxAllocUs, stats.movedBytes / (1024.0 * 1024.0), stats.releasedBuffers);
+}
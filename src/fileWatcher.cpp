@@ -0,0 +1,128 @@
+#include "fileWatcher.h"
+#include "log.h"
+#ifdef __linux__
+#    include <cerrno>
+#    include <sys/inotify.h>
+#    include <unistd.h>
+#endif
+
+std::string FileWatcher::normalize(const std::string& path)
+{
+    return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+#ifdef __linux__
+
+FileWatcher::FileWatcher()
+{
+    m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if(m_fd < 0)
+    {
+        GL_LOG_W("inotify_init1 failed (%d), file watching disabled", errno);
+    }
+}
+
+FileWatcher::~FileWatcher()
+{
+    if(m_fd >= 0)
+    {
+        close(m_fd);
+    }
+}
+
+void FileWatcher::watch(const std::string& path)
+{
+    std::string file = normalize(path);
+    if(m_fd < 0 || !m_files.insert(file).second)
+    {
+        return;
+    }
+
+    std::string directory = std::filesystem::path(file).parent_path().generic_string();
+    directory             = directory.empty() ? "." : directory;
+    if(m_watchedDirectories.count(directory))
+    {
+        return;
+    }
+    int wd = inotify_add_watch(m_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if(wd < 0)
+    {
+        GL_LOG_W("can't watch %s (%d)", directory.c_str(), errno);
+        return;
+    }
+    m_directories[wd] = directory;
+    m_watchedDirectories.insert(directory);
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+    std::unordered_set<std::string> changed;
+    if(m_fd >= 0)
+    {
+        alignas(inotify_event) char buffer[4096];
+        ssize_t                     length;
+        while((length = read(m_fd, buffer, sizeof(buffer))) > 0)
+        {
+            for(char* ptr = buffer; ptr < buffer + length;)
+            {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+                ptr += sizeof(inotify_event) + event->len;
+
+                auto directory = m_directories.find(event->wd);
+                if(directory == m_directories.end() || event->len == 0)
+                {
+                    continue;
+                }
+                std::string file = normalize(directory->second + "/" + event->name);
+                if(m_files.count(file))
+                {
+                    changed.insert(file);
+                }
+            }
+        }
+    }
+    return std::vector<std::string>(changed.begin(), changed.end());
+}
+
+#else
+
+FileWatcher::FileWatcher()
+    : m_lastPoll(std::chrono::steady_clock::now())
+{ }
+
+FileWatcher::~FileWatcher() { }
+
+void FileWatcher::watch(const std::string& path)
+{
+    std::string     file = normalize(path);
+    std::error_code error;
+    if(m_files.insert(file).second)
+    {
+        m_writeTimes[file] = std::filesystem::last_write_time(file, error);
+    }
+}
+
+std::vector<std::string> FileWatcher::poll()
+{
+    std::vector<std::string> changed;
+    auto                     now = std::chrono::steady_clock::now();
+    if(now - m_lastPoll < std::chrono::milliseconds(POLL_INTERVAL_MS))
+    {
+        return changed;
+    }
+    m_lastPoll = now;
+
+    for(auto& file : m_writeTimes)
+    {
+        std::error_code error;
+        auto            writeTime = std::filesystem::last_write_time(file.first, error);
+        if(!error && writeTime != file.second)
+        {
+            file.second = writeTime;
+            changed.push_back(file.first);
+        }
+    }
+    return changed;
+}
+
+#endif
@@ -0,0 +1,337 @@
+#include "frameGraph.h"
+#include "log.h"
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+// ------------------ FrameGraphBuilder ------------------
+
+FrameGraphBuilder::FrameGraphBuilder(FrameGraph& graph, int passIdx)
+    : m_graph(graph)
+    , m_passIdx(passIdx)
+{ }
+
+FrameGraphResource FrameGraphBuilder::create(const std::string& name, const RenderTargetDesc& desc)
+{
+    FrameGraph::ResourceNode node;
+    node.name            = name;
+    node.desc            = desc;
+    node.imported        = false;
+    node.isBackbuffer    = false;
+    node.target          = nullptr;
+    node.firstPass       = -1;
+    node.lastPass        = -1;
+    node.lastWriteAccess = ACCESS_RENDER_TARGET;
+    node.written         = false;
+    m_graph.m_resources.push_back(node);
+    return static_cast<FrameGraphResource>(m_graph.m_resources.size() - 1);
+}
+
+FrameGraphResource FrameGraphBuilder::read(FrameGraphResource resource, FrameGraphAccess access)
+{
+    m_graph.checkResource(resource);
+    m_graph.m_passes[m_passIdx].reads.push_back({resource, access});
+    return resource;
+}
+
+FrameGraphResource FrameGraphBuilder::write(FrameGraphResource resource, FrameGraphAccess access)
+{
+    m_graph.checkResource(resource);
+    m_graph.m_passes[m_passIdx].writes.push_back({resource, access});
+    return resource;
+}
+
+void FrameGraphBuilder::sideEffect()
+{
+    m_graph.m_passes[m_passIdx].sideEffect = true;
+}
+
+// ------------------ FrameGraphResources ------------------
+
+FrameGraphResources::FrameGraphResources(const FrameGraph& graph)
+    : m_graph(graph)
+{ }
+
+RenderTarget* FrameGraphResources::target(FrameGraphResource resource) const
+{
+    m_graph.checkResource(resource);
+    return m_graph.m_resources[resource].target;
+}
+
+unsigned int FrameGraphResources::colorTexture(FrameGraphResource resource, size_t idx) const
+{
+    RenderTarget* renderTarget = target(resource);
+    if(!renderTarget)
+    {
+        GL_LOG_E("frame graph resource %s can't be sampled", m_graph.m_resources[resource].name.c_str());
+        std::abort();
+    }
+    return renderTarget->colorTexture(idx);
+}
+
+void FrameGraphResources::bind(FrameGraphResource resource) const
+{
+    m_graph.checkResource(resource);
+    const auto& node = m_graph.m_resources[resource];
+    if(node.isBackbuffer)
+    {
+        RenderTarget::bindDefault(node.desc.width, node.desc.height);
+    }
+    else
+    {
+        node.target->bind();
+    }
+}
+
+// ------------------ FrameGraph ------------------
+
+FrameGraph::FrameGraph(RenderTargetPool& pool)
+    : m_pool(pool)
+{ }
+
+FrameGraphResource FrameGraph::importBackbuffer(const std::string& name, int width, int height)
+{
+    ResourceNode node;
+    node.name            = name;
+    node.desc.width      = width;
+    node.desc.height     = height;
+    node.imported        = true;
+    node.isBackbuffer    = true;
+    node.target          = nullptr;
+    node.firstPass       = -1;
+    node.lastPass        = -1;
+    node.lastWriteAccess = ACCESS_RENDER_TARGET;
+    node.written         = false;
+    m_resources.push_back(node);
+    return static_cast<FrameGraphResource>(m_resources.size() - 1);
+}
+
+FrameGraphResource FrameGraph::importTarget(const std::string& name, RenderTarget* target)
+{
+    ResourceNode node;
+    node.name            = name;
+    node.desc            = target->desc();
+    node.imported        = true;
+    node.isBackbuffer    = false;
+    node.target          = target;
+    node.firstPass       = -1;
+    node.lastPass        = -1;
+    node.lastWriteAccess = ACCESS_RENDER_TARGET;
+    node.written         = false;
+    m_resources.push_back(node);
+    return static_cast<FrameGraphResource>(m_resources.size() - 1);
+}
+
+void FrameGraph::addPass(const std::string& name, const SetupFunc& setup, const ExecuteFunc& execute)
+{
+    PassNode pass;
+    pass.name       = name;
+    pass.execute    = execute;
+    pass.sideEffect = false;
+    pass.culled     = false;
+    m_passes.push_back(pass);
+
+    FrameGraphBuilder builder(*this, static_cast<int>(m_passes.size() - 1));
+    setup(builder);
+    m_compiled = false;
+}
+
+void FrameGraph::compile()
+{
+    // walk backwards from the outputs: a pass survives if it has side effects, writes an imported
+    // resource, or writes something a surviving later pass reads.
+    std::vector<bool> needed(m_resources.size(), false);
+    m_culledPassCount = 0;
+    for(int i = static_cast<int>(m_passes.size()) - 1; i >= 0; i--)
+    {
+        PassNode& pass = m_passes[i];
+        bool      keep = pass.sideEffect;
+        for(const auto& write : pass.writes)
+        {
+            keep = keep || m_resources[write.resource].imported || needed[write.resource];
+        }
+
+        pass.culled = !keep;
+        if(pass.culled)
+        {
+            m_culledPassCount++;
+            GL_LOG_D("frame graph cull pass %s", pass.name.c_str());
+            continue;
+        }
+        for(const auto& read : pass.reads)
+        {
+            needed[read.resource] = true;
+        }
+    }
+
+    // lifetimes of the transient resources over the surviving passes
+    for(auto& resource : m_resources)
+    {
+        resource.firstPass = -1;
+        resource.lastPass  = -1;
+    }
+    for(int i = 0; i < static_cast<int>(m_passes.size()); i++)
+    {
+        if(m_passes[i].culled)
+        {
+            continue;
+        }
+        for(const auto* accesses : {&m_passes[i].reads, &m_passes[i].writes})
+        {
+            for(const auto& access : *accesses)
+            {
+                auto& resource = m_resources[access.resource];
+                if(resource.firstPass < 0)
+                {
+                    resource.firstPass = i;
+                }
+                resource.lastPass = i;
+            }
+        }
+    }
+
+    for(size_t r = 0; r < m_resources.size(); r++)
+    {
+        const auto& resource = m_resources[r];
+        if(resource.imported || resource.firstPass < 0)
+        {
+            continue;
+        }
+        bool writtenFirst = false;
+        for(const auto& write : m_passes[resource.firstPass].writes)
+        {
+            writtenFirst = writtenFirst || write.resource == static_cast<FrameGraphResource>(r);
+        }
+        if(!writtenFirst)
+        {
+            GL_LOG_W("frame graph resource %s is read before it is written", resource.name.c_str());
+        }
+    }
+    m_compiled = true;
+}
+
+void FrameGraph::execute()
+{
+    if(!m_compiled)
+    {
+        compile();
+    }
+
+    for(auto& resource : m_resources)
+    {
+        resource.written = false;
+    }
+
+    FrameGraphResources resources(*this);
+    size_t              transientMemory = 0;
+    m_peakTransientMemory               = 0;
+    for(int i = 0; i < static_cast<int>(m_passes.size()); i++)
+    {
+        PassNode& pass = m_passes[i];
+        if(pass.culled)
+        {
+            continue;
+        }
+
+        // allocate transient targets at their first use
+        for(auto& resource : m_resources)
+        {
+            if(!resource.imported && resource.firstPass == i)
+            {
+                resource.target = m_pool.acquire(resource.desc);
+                transientMemory += resource.target->memorySize();
+            }
+        }
+        if(transientMemory > m_peakTransientMemory)
+        {
+            m_peakTransientMemory = transientMemory;
+        }
+
+        insertBarriers(pass);
+        pass.execute(resources);
+
+        for(const auto& write : pass.writes)
+        {
+            m_resources[write.resource].written         = true;
+            m_resources[write.resource].lastWriteAccess = write.access;
+        }
+
+        // hand transient targets back after their last use, a later pass can get the same memory
+        for(auto& resource : m_resources)
+        {
+            if(!resource.imported && resource.lastPass == i)
+            {
+                transientMemory -= resource.target->memorySize();
+                m_pool.release(resource.target);
+                resource.target = nullptr;
+            }
+        }
+    }
+}
+
+void FrameGraph::reset()
+{
+    m_resources.clear();
+    m_passes.clear();
+    m_compiled        = false;
+    m_culledPassCount = 0;
+}
+
+void FrameGraph::checkResource(FrameGraphResource resource) const
+{
+    if(resource < 0 || resource >= static_cast<int>(m_resources.size()))
+    {
+        GL_LOG_E("invalid frame graph resource %d", resource);
+        std::abort();
+    }
+}
+
+void FrameGraph::insertBarriers(PassNode& pass)
+{
+    // rendering into a framebuffer and sampling it afterwards is ordered by GL already. what isn't:
+    // multisample targets need a resolve, and anything written through image stores needs a barrier.
+    unsigned int barrierBits = 0;
+    for(const auto& read : pass.reads)
+    {
+        auto& resource = m_resources[read.resource];
+        if(!resource.written)
+        {
+            continue;
+        }
+        if(resource.lastWriteAccess == ACCESS_RENDER_TARGET && read.access != ACCESS_RENDER_TARGET && resource.target && resource.desc.samples > 1)
+        {
+            resource.target->resolve();
+        }
+        if(resource.lastWriteAccess == ACCESS_STORAGE)
+        {
+            barrierBits |= read.access == ACCESS_SAMPLED ? GL_TEXTURE_FETCH_BARRIER_BIT : GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        }
+    }
+    for(const auto& write : pass.writes)
+    {
+        auto& resource = m_resources[write.resource];
+        if(resource.written && resource.lastWriteAccess == ACCESS_STORAGE)
+        {
+            barrierBits |= write.access == ACCESS_RENDER_TARGET ? GL_FRAMEBUFFER_BARRIER_BIT : GL_SHADER_IMAGE_ACCESS_BARRIER_BIT;
+        }
+    }
+
+    if(barrierBits)
+    {
+        glMemoryBarrier(barrierBits);
+    }
+
+    // sampling a texture that is also attached to the bound framebuffer
+    for(const auto& read : pass.reads)
+    {
+        for(const auto& write : pass.writes)
+        {
+            if(read.resource == write.resource && read.access == ACCESS_SAMPLED && write.access == ACCESS_RENDER_TARGET)
+            {
+                glTextureBarrier();
+                return;
+            }
+        }
+    }
+}
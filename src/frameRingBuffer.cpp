@@ -0,0 +1,145 @@
+#include "frameRingBuffer.h"
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+// a section still busy after this long means the GPU hung, there is no point in waiting longer
+static const uint64_t FENCE_TIMEOUT_NS = 1000000000;
+
+static size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+FrameRingBuffer::FrameRingBuffer(size_t frameSize, int frameCount)
+    : m_frameCount(frameCount)
+    , m_fences(frameCount, nullptr)
+{
+    if(frameCount < 1 || frameSize == 0)
+    {
+        GL_LOG_E("invalid frame ring buffer of %d frames of %zu bytes", frameCount, frameSize);
+        std::abort();
+    }
+    int uniformAlignment = 0;
+    int storageAlignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+    m_uniformAlignment = std::max(uniformAlignment, 1);
+    m_storageAlignment = std::max(storageAlignment, 1);
+
+    // every section starts aligned for both kinds of binding
+    m_frameSize        = alignUp(frameSize, std::max(m_uniformAlignment, m_storageAlignment));
+    unsigned int flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &m_buffer);
+    glNamedBufferStorage(m_buffer, m_frameSize * m_frameCount, nullptr, flags);
+    m_mapped = static_cast<unsigned char*>(glMapNamedBufferRange(m_buffer, 0, m_frameSize * m_frameCount, flags));
+    if(!m_mapped)
+    {
+        GL_LOG_E("can't map frame ring buffer of %zu bytes", m_frameSize * m_frameCount);
+        std::abort();
+    }
+    // the first beginFrame moves to section 0
+    m_section = m_frameCount - 1;
+}
+
+FrameRingBuffer::~FrameRingBuffer()
+{
+    for(auto* fence : m_fences)
+    {
+        if(fence)
+        {
+            glClientWaitSync(static_cast<GLsync>(fence), GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+            glDeleteSync(static_cast<GLsync>(fence));
+        }
+    }
+    glUnmapNamedBuffer(m_buffer);
+    glDeleteBuffers(1, &m_buffer);
+    GL_LOG_I("frame ring buffer: %d sections of %.2f KB, peak %.2f KB, waited on the GPU %d times in %d frames for %.2f ms", m_frameCount, m_frameSize / 1024.0, m_peakBytes / 1024.0,
+             m_waitCount, m_frames, m_waitMs);
+}
+
+void FrameRingBuffer::beginFrame()
+{
+    if(m_isInFrame)
+    {
+        GL_LOG_W("frame ring buffer: beginFrame without endFrame");
+        endFrame();
+    }
+    m_section = (m_section + 1) % m_frameCount;
+    m_head    = 0;
+
+    GLsync fence = static_cast<GLsync>(m_fences[m_section]);
+    if(fence)
+    {
+        // a zero timeout only polls, anything else is a real stall and gets counted
+        if(glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+        {
+            auto   start  = std::chrono::steady_clock::now();
+            GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_TIMEOUT_NS);
+            m_waitMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            m_waitCount++;
+            if(status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+            {
+                GL_LOG_W("frame ring buffer: section %d still busy, overwriting it anyway", m_section);
+            }
+        }
+        glDeleteSync(fence);
+        m_fences[m_section] = nullptr;
+    }
+    m_isInFrame = true;
+}
+
+void FrameRingBuffer::endFrame()
+{
+    m_fences[m_section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_peakBytes         = std::max(m_peakBytes, m_head);
+    m_isInFrame         = false;
+    m_frames++;
+}
+
+RingAllocation FrameRingBuffer::allocate(size_t size, size_t alignment)
+{
+    if(!m_isInFrame)
+    {
+        GL_LOG_E("frame ring buffer: allocate outside beginFrame/endFrame");
+        std::abort();
+    }
+    size_t offset = alignUp(m_head, alignment);
+    if(offset + size > m_frameSize)
+    {
+        GL_LOG_E("frame ring buffer: %zu bytes don't fit, %zu of %zu used this frame", size, m_head, m_frameSize);
+        std::abort();
+    }
+    m_head = offset + size;
+
+    RingAllocation allocation;
+    allocation.offset = m_section * m_frameSize + offset;
+    allocation.data   = m_mapped + allocation.offset;
+    allocation.buffer = m_buffer;
+    allocation.size   = size;
+    return allocation;
+}
+
+RingAllocation FrameRingBuffer::allocateUniform(size_t size)
+{
+    return allocate(size, m_uniformAlignment);
+}
+
+RingAllocation FrameRingBuffer::allocateStorage(size_t size)
+{
+    return allocate(size, m_storageAlignment);
+}
+
+void FrameRingBuffer::bindUniform(unsigned int binding, const RingAllocation& allocation) const
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding, allocation.buffer, allocation.offset, allocation.size);
+}
+
+void FrameRingBuffer::bindStorage(unsigned int binding, const RingAllocation& allocation) const
+{
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, allocation.buffer, allocation.offset, allocation.size);
+}
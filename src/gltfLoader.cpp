@@ -0,0 +1,1027 @@
+#include "gltfLoader.h"
+#include "log.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+// clang-format off
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+// clang-format on
+
+// glTF component types, the values of the GL enums
+static const unsigned int GLTF_BYTE           = 5120;
+static const unsigned int GLTF_UNSIGNED_BYTE  = 5121;
+static const unsigned int GLTF_SHORT          = 5122;
+static const unsigned int GLTF_UNSIGNED_SHORT = 5123;
+static const unsigned int GLTF_UNSIGNED_INT   = 5125;
+static const unsigned int GLTF_FLOAT          = 5126;
+static const int          GLTF_TRIANGLES      = 4;
+
+static const uint32_t GLB_MAGIC      = 0x46546c67; // "glTF"
+static const uint32_t GLB_CHUNK_JSON = 0x4e4f534a;
+static const uint32_t GLB_CHUNK_BIN  = 0x004e4942;
+
+// deeper documents are rejected instead of recursing on
+static const int JSON_MAX_DEPTH = 64;
+
+struct JsonValue
+{
+    enum Type
+    {
+        JSON_NULL = 0,
+        JSON_BOOL,
+        JSON_NUMBER,
+        JSON_STRING,
+        JSON_ARRAY,
+        JSON_OBJECT,
+    };
+
+    Type                     type   = JSON_NULL;
+    double                   number = 0.0; // bools too, as 0 or 1
+    std::string              string;
+    std::vector<JsonValue>   items; // of arrays and objects
+    std::vector<std::string> keys;  // of objects, one per item
+
+    // a null value when missing, so lookups can be chained
+    const JsonValue& operator[](const std::string& key) const;
+    const JsonValue& operator[](size_t index) const;
+
+    size_t size() const
+    {
+        return items.size();
+    }
+
+    bool has(const char* key) const
+    {
+        return std::find(keys.begin(), keys.end(), key) != keys.end();
+    }
+
+    double asNumber(double fallback = 0.0) const
+    {
+        return type == JSON_NUMBER || type == JSON_BOOL ? number : fallback;
+    }
+
+    // fallback too for numbers that aren't a non negative int
+    int asIndex(int fallback = -1) const
+    {
+        return type == JSON_NUMBER && number >= 0.0 && number <= INT32_MAX && number == static_cast<int>(number) ? static_cast<int>(number) : fallback;
+    }
+
+    size_t asSize(size_t fallback = 0) const
+    {
+        return type == JSON_NUMBER && number >= 0.0 && number < 9007199254740992.0 && number == static_cast<size_t>(number) ? static_cast<size_t>(number) : fallback;
+    }
+};
+
+static const JsonValue JSON_NULL_VALUE;
+
+const JsonValue& JsonValue::operator[](const std::string& key) const
+{
+    auto iter = std::find(keys.begin(), keys.end(), key);
+    return iter == keys.end() ? JSON_NULL_VALUE : items[iter - keys.begin()];
+}
+
+const JsonValue& JsonValue::operator[](size_t index) const
+{
+    return type == JSON_ARRAY && index < items.size() ? items[index] : JSON_NULL_VALUE;
+}
+
+// strict rfc 8259, without the extensions some writers allow like comments or trailing commas
+class JsonParser
+{
+public:
+    JsonParser(const char* begin, const char* end)
+        : m_begin(begin)
+        , m_p(begin)
+        , m_end(end)
+    {
+    }
+
+    bool parse(JsonValue& value)
+    {
+        skipSpace();
+        if(!parseValue(value, 0))
+        {
+            return false;
+        }
+        skipSpace();
+        return m_p == m_end;
+    }
+
+    // where parsing stopped
+    size_t offset() const
+    {
+        return m_p - m_begin;
+    }
+
+private:
+    void skipSpace()
+    {
+        while(m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+        {
+            m_p++;
+        }
+    }
+
+    bool literal(const char* word)
+    {
+        size_t length = strlen(word);
+        if(static_cast<size_t>(m_end - m_p) < length || memcmp(m_p, word, length) != 0)
+        {
+            return false;
+        }
+        m_p += length;
+        return true;
+    }
+
+    bool parseValue(JsonValue& value, int depth)
+    {
+        if(m_p == m_end || depth > JSON_MAX_DEPTH)
+        {
+            return false;
+        }
+        switch(*m_p)
+        {
+        case '{':
+            return parseObject(value, depth);
+        case '[':
+            return parseArray(value, depth);
+        case '"':
+            value.type = JsonValue::JSON_STRING;
+            return parseString(value.string);
+        case 't':
+            value.type   = JsonValue::JSON_BOOL;
+            value.number = 1.0;
+            return literal("true");
+        case 'f':
+            value.type = JsonValue::JSON_BOOL;
+            return literal("false");
+        case 'n':
+            return literal("null");
+        default:
+            value.type = JsonValue::JSON_NUMBER;
+            return parseNumber(value.number);
+        }
+    }
+
+    bool parseObject(JsonValue& value, int depth)
+    {
+        value.type = JsonValue::JSON_OBJECT;
+        m_p++;
+        skipSpace();
+        if(m_p < m_end && *m_p == '}')
+        {
+            m_p++;
+            return true;
+        }
+        while(true)
+        {
+            value.keys.emplace_back();
+            value.items.emplace_back();
+            skipSpace();
+            if(m_p == m_end || *m_p != '"' || !parseString(value.keys.back()))
+            {
+                return false;
+            }
+            skipSpace();
+            if(m_p == m_end || *m_p++ != ':')
+            {
+                return false;
+            }
+            skipSpace();
+            if(!parseValue(value.items.back(), depth + 1))
+            {
+                return false;
+            }
+            skipSpace();
+            if(m_p == m_end)
+            {
+                return false;
+            }
+            if(*m_p == '}')
+            {
+                m_p++;
+                return true;
+            }
+            if(*m_p++ != ',')
+            {
+                return false;
+            }
+        }
+    }
+
+    bool parseArray(JsonValue& value, int depth)
+    {
+        value.type = JsonValue::JSON_ARRAY;
+        m_p++;
+        skipSpace();
+        if(m_p < m_end && *m_p == ']')
+        {
+            m_p++;
+            return true;
+        }
+        while(true)
+        {
+            value.items.emplace_back();
+            skipSpace();
+            if(!parseValue(value.items.back(), depth + 1))
+            {
+                return false;
+            }
+            skipSpace();
+            if(m_p == m_end)
+            {
+                return false;
+            }
+            if(*m_p == ']')
+            {
+                m_p++;
+                return true;
+            }
+            if(*m_p++ != ',')
+            {
+                return false;
+            }
+        }
+    }
+
+    bool parseHex(uint32_t& code)
+    {
+        if(m_end - m_p < 4)
+        {
+            return false;
+        }
+        code = 0;
+        for(int i = 0; i < 4; i++, m_p++)
+        {
+            char c = *m_p;
+            int  digit;
+            if(c >= '0' && c <= '9')
+            {
+                digit = c - '0';
+            }
+            else if(c >= 'a' && c <= 'f')
+            {
+                digit = c - 'a' + 10;
+            }
+            else if(c >= 'A' && c <= 'F')
+            {
+                digit = c - 'A' + 10;
+            }
+            else
+            {
+                return false;
+            }
+            code = code * 16 + digit;
+        }
+        return true;
+    }
+
+    bool parseString(std::string& string)
+    {
+        m_p++;
+        while(m_p < m_end && *m_p != '"')
+        {
+            // copy up to the next escape or the end at once
+            const char* run = m_p;
+            while(m_p < m_end && *m_p != '"' && *m_p != '\\')
+            {
+                if(static_cast<unsigned char>(*m_p) < 0x20)
+                {
+                    return false;
+                }
+                m_p++;
+            }
+            string.append(run, m_p);
+            if(m_p == m_end || *m_p == '"')
+            {
+                break;
+            }
+            if(++m_p == m_end)
+            {
+                return false;
+            }
+            char     escape = *m_p++;
+            uint32_t code   = 0;
+            switch(escape)
+            {
+            case '"':
+            case '\\':
+            case '/':
+                string += escape;
+                continue;
+            case 'b':
+                string += '\b';
+                continue;
+            case 'f':
+                string += '\f';
+                continue;
+            case 'n':
+                string += '\n';
+                continue;
+            case 'r':
+                string += '\r';
+                continue;
+            case 't':
+                string += '\t';
+                continue;
+            case 'u':
+                if(!parseHex(code))
+                {
+                    return false;
+                }
+                break;
+            default:
+                return false;
+            }
+            // a surrogate pair is one code point
+            uint32_t low = 0;
+            if(code >= 0xd800 && code < 0xdc00 && m_end - m_p >= 2 && m_p[0] == '\\' && m_p[1] == 'u')
+            {
+                m_p += 2;
+                if(!parseHex(low) || low < 0xdc00 || low >= 0xe000)
+                {
+                    return false;
+                }
+                code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+            }
+            if(code < 0x80)
+            {
+                string += static_cast<char>(code);
+            }
+            else if(code < 0x800)
+            {
+                string += static_cast<char>(0xc0 | (code >> 6));
+                string += static_cast<char>(0x80 | (code & 0x3f));
+            }
+            else if(code < 0x10000)
+            {
+                string += static_cast<char>(0xe0 | (code >> 12));
+                string += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                string += static_cast<char>(0x80 | (code & 0x3f));
+            }
+            else
+            {
+                string += static_cast<char>(0xf0 | (code >> 18));
+                string += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+                string += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+                string += static_cast<char>(0x80 | (code & 0x3f));
+            }
+        }
+        if(m_p == m_end)
+        {
+            return false;
+        }
+        m_p++;
+        return true;
+    }
+
+    bool parseNumber(double& number)
+    {
+        // the json grammar is stricter than strtod's, checked here before it converts a copy
+        const char* start = m_p;
+        if(m_p < m_end && *m_p == '-')
+        {
+            m_p++;
+        }
+        if(m_p == m_end || !isdigit(static_cast<unsigned char>(*m_p)) || (*m_p == '0' && m_p + 1 < m_end && isdigit(static_cast<unsigned char>(m_p[1]))))
+        {
+            return false;
+        }
+        while(m_p < m_end && isdigit(static_cast<unsigned char>(*m_p)))
+        {
+            m_p++;
+        }
+        if(m_p < m_end && *m_p == '.')
+        {
+            const char* fraction = ++m_p;
+            while(m_p < m_end && isdigit(static_cast<unsigned char>(*m_p)))
+            {
+                m_p++;
+            }
+            if(m_p == fraction)
+            {
+                return false;
+            }
+        }
+        if(m_p < m_end && (*m_p == 'e' || *m_p == 'E'))
+        {
+            m_p++;
+            if(m_p < m_end && (*m_p == '+' || *m_p == '-'))
+            {
+                m_p++;
+            }
+            const char* exponent = m_p;
+            while(m_p < m_end && isdigit(static_cast<unsigned char>(*m_p)))
+            {
+                m_p++;
+            }
+            if(m_p == exponent)
+            {
+                return false;
+            }
+        }
+        char token[64];
+        if(static_cast<size_t>(m_p - start) >= sizeof(token))
+        {
+            return false;
+        }
+        memcpy(token, start, m_p - start);
+        token[m_p - start] = '\0';
+        number             = strtod(token, nullptr);
+        return true;
+    }
+
+private:
+    const char* m_begin;
+    const char* m_p;
+    const char* m_end;
+};
+
+struct GltfBuffer
+{
+    const unsigned char* data = nullptr;
+    size_t               size = 0;
+};
+
+struct GltfBufferView
+{
+    const unsigned char* data   = nullptr;
+    size_t               size   = 0;
+    size_t               stride = 0; // 0 for tightly packed
+};
+
+static size_t componentSize(unsigned int componentType)
+{
+    switch(componentType)
+    {
+    case GLTF_BYTE:
+    case GLTF_UNSIGNED_BYTE:
+        return 1;
+    case GLTF_SHORT:
+    case GLTF_UNSIGNED_SHORT:
+        return 2;
+    case GLTF_UNSIGNED_INT:
+    case GLTF_FLOAT:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static int componentCount(const std::string& type)
+{
+    static const char* TYPES[]  = {"SCALAR", "VEC2", "VEC3", "VEC4", "MAT2", "MAT3", "MAT4"};
+    static const int   COUNTS[] = {1, 2, 3, 4, 4, 9, 16};
+    for(int i = 0; i < 7; i++)
+    {
+        if(type == TYPES[i])
+        {
+            return COUNTS[i];
+        }
+    }
+    return 0;
+}
+
+// uris are relative references, %xx escapes are undone
+static std::string decodeUri(const std::string& uri)
+{
+    std::string path;
+    for(size_t i = 0; i < uri.size(); i++)
+    {
+        if(uri[i] == '%' && i + 2 < uri.size() && isxdigit(static_cast<unsigned char>(uri[i + 1])) && isxdigit(static_cast<unsigned char>(uri[i + 2])))
+        {
+            path += static_cast<char>(std::stoi(uri.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        }
+        else
+        {
+            path += uri[i];
+        }
+    }
+    return path;
+}
+
+// indices are uploaded as they are, one past the vertices would read outside the mesh on the GPU
+template<typename Index>
+static bool indicesInRange(const unsigned char* data, size_t count, size_t vertexCount)
+{
+    Index maximum = 0;
+    for(size_t i = 0; i < count; i++)
+    {
+        Index index;
+        memcpy(&index, data + i * sizeof(Index), sizeof(Index));
+        maximum = std::max(maximum, index);
+    }
+    return count == 0 || maximum < vertexCount;
+}
+
+static glm::mat4 nodeTransform(const JsonValue& node)
+{
+    glm::mat4        transform(1.0f);
+    const JsonValue& matrix = node["matrix"];
+    if(matrix.size() == 16)
+    {
+        // column major, like glm
+        for(int i = 0; i < 16; i++)
+        {
+            transform[i / 4][i % 4] = static_cast<float>(matrix[i].asNumber());
+        }
+        return transform;
+    }
+    const JsonValue& translation = node["translation"];
+    const JsonValue& rotation    = node["rotation"];
+    const JsonValue& scale       = node["scale"];
+    if(translation.size() == 3)
+    {
+        transform = glm::translate(transform, glm::vec3(translation[0].asNumber(), translation[1].asNumber(), translation[2].asNumber()));
+    }
+    if(rotation.size() == 4)
+    {
+        // stored x y z w
+        glm::quat quaternion(rotation[3].asNumber(1.0), rotation[0].asNumber(), rotation[1].asNumber(), rotation[2].asNumber());
+        transform = transform * glm::mat4_cast(quaternion);
+    }
+    if(scale.size() == 3)
+    {
+        transform = glm::scale(transform, glm::vec3(scale[0].asNumber(1.0), scale[1].asNumber(1.0), scale[2].asNumber(1.0)));
+    }
+    return transform;
+}
+
+size_t GltfAccessor::elementSize() const
+{
+    return componentSize(componentType) * size;
+}
+
+glm::vec4 GltfAccessor::read(size_t i) const
+{
+    glm::vec4            value(0.0f);
+    const unsigned char* element = data + i * stride;
+    for(int c = 0; c < size && c < 4; c++)
+    {
+        switch(componentType)
+        {
+        case GLTF_FLOAT:
+            memcpy(&value[c], element + c * 4, 4);
+            break;
+        case GLTF_BYTE:
+        {
+            int8_t component = static_cast<int8_t>(element[c]);
+            value[c]         = isNormalized ? std::max(component / 127.0f, -1.0f) : component;
+            break;
+        }
+        case GLTF_UNSIGNED_BYTE:
+            value[c] = isNormalized ? element[c] / 255.0f : element[c];
+            break;
+        case GLTF_SHORT:
+        {
+            int16_t component;
+            memcpy(&component, element + c * 2, 2);
+            value[c] = isNormalized ? std::max(component / 32767.0f, -1.0f) : component;
+            break;
+        }
+        case GLTF_UNSIGNED_SHORT:
+        {
+            uint16_t component;
+            memcpy(&component, element + c * 2, 2);
+            value[c] = isNormalized ? component / 65535.0f : component;
+            break;
+        }
+        case GLTF_UNSIGNED_INT:
+        {
+            uint32_t component;
+            memcpy(&component, element + c * 4, 4);
+            value[c] = static_cast<float>(component);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    return value;
+}
+
+unsigned int GltfAccessor::readIndex(size_t i) const
+{
+    const unsigned char* element = data + i * stride;
+    if(componentType == GLTF_UNSIGNED_BYTE)
+    {
+        return element[0];
+    }
+    if(componentType == GLTF_UNSIGNED_SHORT)
+    {
+        uint16_t index;
+        memcpy(&index, element, 2);
+        return index;
+    }
+    uint32_t index;
+    memcpy(&index, element, 4);
+    return index;
+}
+
+bool GltfLoader::isGltf(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    if(dot == std::string::npos)
+    {
+        return false;
+    }
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension == "glb" || extension == "gltf";
+}
+
+bool GltfLoader::load(const std::string& path, GltfScene& scene)
+{
+    auto start = std::chrono::steady_clock::now();
+    auto file  = std::make_unique<MappedFile>(path);
+    if(!file->isOpen())
+    {
+        GL_LOG_E("can't read gltf %s", path.c_str());
+        return false;
+    }
+
+    // a .glb is a header and chunks, the json first and the binary buffer after it
+    const unsigned char* bytes    = file->data();
+    size_t               size     = file->size();
+    const char*          json     = reinterpret_cast<const char*>(bytes);
+    size_t               jsonSize = size;
+    GltfBuffer           binChunk;
+    uint32_t             header[5] = {};
+    memcpy(header, bytes, std::min<size_t>(size, sizeof(header)));
+    if(size >= 12 && header[0] == GLB_MAGIC)
+    {
+        // every chunk has to fit in the length the header declares, and that in the file
+        size_t length = header[2];
+        if(header[1] != 2 || size < 20 || length < 20 || length > size || header[4] != GLB_CHUNK_JSON || header[3] > length - 20)
+        {
+            GL_LOG_E("gltf %s isn't a version 2 binary", path.c_str());
+            return false;
+        }
+        json            = reinterpret_cast<const char*>(bytes + 20);
+        jsonSize        = header[3];
+        size_t binStart = 20 + ((jsonSize + 3) & ~size_t(3));
+        uint32_t chunk[2];
+        if(binStart + 8 <= length)
+        {
+            memcpy(chunk, bytes + binStart, sizeof(chunk));
+            if(chunk[1] == GLB_CHUNK_BIN && chunk[0] <= length - binStart - 8)
+            {
+                binChunk.data = bytes + binStart + 8;
+                binChunk.size = chunk[0];
+            }
+        }
+    }
+
+    JsonValue  root;
+    JsonParser parser(json, json + jsonSize);
+    if(!parser.parse(root) || root.type != JsonValue::JSON_OBJECT)
+    {
+        GL_LOG_E("gltf %s: bad json at byte %zu", path.c_str(), parser.offset());
+        return false;
+    }
+    if(root["asset"]["version"].string.compare(0, 2, "2.") != 0)
+    {
+        GL_LOG_E("gltf %s: version %s isn't supported", path.c_str(), root["asset"]["version"].string.c_str());
+        return false;
+    }
+    for(const auto& extension : root["extensionsRequired"].items)
+    {
+        GL_LOG_E("gltf %s: requires extension %s", path.c_str(), extension.string.c_str());
+        return false;
+    }
+    size_t      slash     = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : path.substr(0, slash);
+    scene.files.push_back(std::move(file));
+
+    std::vector<GltfBuffer> buffers;
+    for(const auto& item : root["buffers"].items)
+    {
+        size_t     byteLength = item["byteLength"].asSize();
+        GltfBuffer buffer     = binChunk;
+        if(item.has("uri"))
+        {
+            const std::string& uri = item["uri"].string;
+            if(uri.compare(0, 5, "data:") == 0)
+            {
+                GL_LOG_E("gltf %s: buffers in data uris aren't supported, export it as .glb", path.c_str());
+                return false;
+            }
+            auto bufferFile = std::make_unique<MappedFile>(directory + "/" + decodeUri(uri));
+            if(!bufferFile->isOpen())
+            {
+                GL_LOG_E("gltf %s: can't read buffer %s", path.c_str(), uri.c_str());
+                return false;
+            }
+            buffer = {bufferFile->data(), bufferFile->size()};
+            scene.files.push_back(std::move(bufferFile));
+        }
+        else if(!buffers.empty())
+        {
+            // only the first buffer may be the binary chunk
+            buffer = GltfBuffer();
+        }
+        if(byteLength > buffer.size)
+        {
+            GL_LOG_E("gltf %s: buffer %zu is shorter than its %zu bytes", path.c_str(), buffers.size(), byteLength);
+            return false;
+        }
+        buffers.push_back(buffer);
+    }
+
+    std::vector<GltfBufferView> views;
+    for(const auto& item : root["bufferViews"].items)
+    {
+        int    buffer     = item["buffer"].asIndex();
+        size_t byteOffset = item["byteOffset"].asSize();
+        size_t byteLength = item["byteLength"].asSize();
+        if(buffer < 0 || static_cast<size_t>(buffer) >= buffers.size() || byteOffset > buffers[buffer].size || byteLength > buffers[buffer].size - byteOffset)
+        {
+            GL_LOG_E("gltf %s: buffer view %zu is outside its buffer", path.c_str(), views.size());
+            return false;
+        }
+        views.push_back({buffers[buffer].data + byteOffset, byteLength, item["byteStride"].asSize()});
+    }
+
+    std::vector<GltfAccessor> accessors;
+    for(const auto& item : root["accessors"].items)
+    {
+        size_t       index = accessors.size();
+        GltfAccessor accessor;
+        int          view       = item["bufferView"].asIndex();
+        size_t       byteOffset = item["byteOffset"].asSize();
+        accessor.count          = item["count"].asSize();
+        accessor.componentType  = item["componentType"].asIndex(0);
+        accessor.size           = componentCount(item["type"].string);
+        accessor.isNormalized   = item["normalized"].asNumber() != 0.0;
+        if(item.has("sparse") || view < 0)
+        {
+            GL_LOG_E("gltf %s: accessor %zu is sparse or has no buffer view, that isn't supported", path.c_str(), index);
+            return false;
+        }
+        if(static_cast<size_t>(view) >= views.size() || accessor.elementSize() == 0)
+        {
+            GL_LOG_E("gltf %s: accessor %zu is invalid", path.c_str(), index);
+            return false;
+        }
+        const GltfBufferView& bufferView = views[view];
+        size_t                elementSize = accessor.elementSize();
+        accessor.stride                   = bufferView.stride ? bufferView.stride : elementSize;
+        if(accessor.stride < elementSize)
+        {
+            GL_LOG_E("gltf %s: accessor %zu has a stride of %zu, shorter than its elements", path.c_str(), index, accessor.stride);
+            return false;
+        }
+        // stride * (count - 1) + elementSize <= available, without the product overflowing
+        size_t available = byteOffset <= bufferView.size ? bufferView.size - byteOffset : 0;
+        bool   isInside  = byteOffset <= bufferView.size &&
+                         (accessor.count == 0 || (elementSize <= available && (accessor.count - 1) <= (available - elementSize) / accessor.stride));
+        if(!isInside)
+        {
+            GL_LOG_E("gltf %s: accessor %zu is outside its buffer view", path.c_str(), index);
+            return false;
+        }
+        accessor.data           = bufferView.data + byteOffset;
+        const JsonValue& minimum = item["min"];
+        const JsonValue& maximum = item["max"];
+        if(minimum.size() >= 3 && maximum.size() >= 3)
+        {
+            accessor.hasBounds = true;
+            accessor.min       = glm::vec3(minimum[0].asNumber(), minimum[1].asNumber(), minimum[2].asNumber());
+            accessor.max       = glm::vec3(maximum[0].asNumber(), maximum[1].asNumber(), maximum[2].asNumber());
+        }
+        accessors.push_back(accessor);
+    }
+    auto accessorAt = [&accessors](const JsonValue& index, GltfAccessor& accessor) {
+        int i = index.asIndex();
+        if(i < 0 || static_cast<size_t>(i) >= accessors.size())
+        {
+            return false;
+        }
+        accessor = accessors[i];
+        return true;
+    };
+
+    static const char* ATTRIBUTE_NAMES[GLTF_ATTRIBUTE_COUNT] = {"POSITION", "NORMAL", "TEXCOORD_0"};
+    static const int   ATTRIBUTE_SIZES[GLTF_ATTRIBUTE_COUNT] = {3, 3, 2};
+    size_t             primitiveCount                        = 0;
+    size_t             bufferBytes                           = 0;
+    for(const auto& item : root["meshes"].items)
+    {
+        GltfMesh mesh;
+        mesh.name = item["name"].string;
+        for(const auto& primitiveItem : item["primitives"].items)
+        {
+            GltfPrimitive    primitive;
+            const JsonValue& attributes = primitiveItem["attributes"];
+            if(primitiveItem["mode"].asIndex(GLTF_TRIANGLES) != GLTF_TRIANGLES || !attributes.has("POSITION"))
+            {
+                GL_LOG_W("gltf %s: mesh %s has a primitive that isn't triangles with positions, it is skipped", path.c_str(), mesh.name.c_str());
+                continue;
+            }
+            for(int i = 0; i < GLTF_ATTRIBUTE_COUNT; i++)
+            {
+                GltfAccessor& accessor = primitive.attributes[i];
+                if(!attributes.has(ATTRIBUTE_NAMES[i]))
+                {
+                    continue;
+                }
+                if(!accessorAt(attributes[ATTRIBUTE_NAMES[i]], accessor) || accessor.size != ATTRIBUTE_SIZES[i] || accessor.componentType == GLTF_UNSIGNED_INT ||
+                   accessor.count != primitive.attributes[GLTF_POSITION].count)
+                {
+                    GL_LOG_E("gltf %s: mesh %s has an invalid %s", path.c_str(), mesh.name.c_str(), ATTRIBUTE_NAMES[i]);
+                    return false;
+                }
+            }
+            if(primitiveItem.has("indices"))
+            {
+                GltfAccessor& indices = primitive.indices;
+                if(!accessorAt(primitiveItem["indices"], indices) || indices.size != 1 || indices.stride != indices.elementSize() ||
+                   (indices.componentType != GLTF_UNSIGNED_BYTE && indices.componentType != GLTF_UNSIGNED_SHORT && indices.componentType != GLTF_UNSIGNED_INT))
+                {
+                    GL_LOG_E("gltf %s: mesh %s has invalid indices", path.c_str(), mesh.name.c_str());
+                    return false;
+                }
+                size_t vertexCount = primitive.attributes[GLTF_POSITION].count;
+                bool   isInRange   = indices.componentType == GLTF_UNSIGNED_BYTE    ? indicesInRange<uint8_t>(indices.data, indices.count, vertexCount)
+                                     : indices.componentType == GLTF_UNSIGNED_SHORT ? indicesInRange<uint16_t>(indices.data, indices.count, vertexCount)
+                                                                                    : indicesInRange<uint32_t>(indices.data, indices.count, vertexCount);
+                if(!isInRange)
+                {
+                    GL_LOG_E("gltf %s: mesh %s has indices past its vertices", path.c_str(), mesh.name.c_str());
+                    return false;
+                }
+            }
+            primitive.material = primitiveItem["material"].asIndex();
+
+            // what the vertex buffer needs, accessors reading the same interleaved bytes share them
+            std::vector<GltfSpan> ranges;
+            for(const auto& accessor : primitive.attributes)
+            {
+                if(accessor.data && accessor.count > 0)
+                {
+                    ranges.push_back({accessor.data, accessor.stride * (accessor.count - 1) + accessor.elementSize(), 0});
+                }
+            }
+            std::sort(ranges.begin(), ranges.end(), [](const GltfSpan& a, const GltfSpan& b) { return a.data < b.data; });
+            for(const auto& range : ranges)
+            {
+                if(!primitive.spans.empty() && range.data < primitive.spans.back().data + primitive.spans.back().size)
+                {
+                    GltfSpan& last = primitive.spans.back();
+                    last.size      = std::max(last.size, static_cast<size_t>(range.data + range.size - last.data));
+                    continue;
+                }
+                primitive.spans.push_back(range);
+            }
+            for(auto& span : primitive.spans)
+            {
+                // attribute data stays 4 byte aligned
+                span.offset = (primitive.vertexSize + 3) & ~size_t(3);
+                primitive.vertexSize = span.offset + span.size;
+            }
+            for(int i = 0; i < GLTF_ATTRIBUTE_COUNT; i++)
+            {
+                const GltfAccessor& accessor = primitive.attributes[i];
+                for(const auto& span : primitive.spans)
+                {
+                    if(accessor.data >= span.data && accessor.data < span.data + span.size)
+                    {
+                        primitive.attributeOffsets[i] = span.offset + (accessor.data - span.data);
+                    }
+                }
+            }
+            bufferBytes += primitive.vertexSize + primitive.indices.count * primitive.indices.elementSize();
+            mesh.primitives.push_back(primitive);
+            primitiveCount++;
+        }
+        scene.meshes.push_back(std::move(mesh));
+    }
+
+    for(const auto& item : root["images"].items)
+    {
+        GltfImage image;
+        if(item.has("bufferView"))
+        {
+            int view = item["bufferView"].asIndex();
+            if(view < 0 || static_cast<size_t>(view) >= views.size())
+            {
+                GL_LOG_E("gltf %s: image %zu is invalid", path.c_str(), scene.images.size());
+                return false;
+            }
+            image.path = path + "#image" + std::to_string(scene.images.size());
+            image.data = views[view].data;
+            image.size = views[view].size;
+        }
+        else if(item["uri"].string.compare(0, 5, "data:") == 0)
+        {
+            GL_LOG_W("gltf %s: image %zu is in a data uri, that isn't supported", path.c_str(), scene.images.size());
+        }
+        else
+        {
+            image.path = directory + "/" + decodeUri(item["uri"].string);
+        }
+        scene.images.push_back(image);
+    }
+
+    // textures only add samplers to images, the sampling options come from TextureOptions
+    const JsonValue& textures = root["textures"];
+    for(const auto& item : root["materials"].items)
+    {
+        GltfMaterial material;
+        material.name              = item["name"].string;
+        const JsonValue& baseColor = item["pbrMetallicRoughness"]["baseColorTexture"];
+        int              image     = textures[baseColor["index"].asIndex(INT32_MAX)]["source"].asIndex();
+        if(image >= 0 && static_cast<size_t>(image) < scene.images.size() && !scene.images[image].path.empty())
+        {
+            material.baseColorImage = image;
+        }
+        if(baseColor["texCoord"].asIndex(0) != 0)
+        {
+            GL_LOG_W("gltf %s: material %s samples texture coordinates %d, 0 is used", path.c_str(), material.name.c_str(), baseColor["texCoord"].asIndex(0));
+        }
+        scene.materials.push_back(material);
+    }
+    for(auto& mesh : scene.meshes)
+    {
+        for(auto& primitive : mesh.primitives)
+        {
+            primitive.material = primitive.material < static_cast<int>(scene.materials.size()) ? primitive.material : -1;
+        }
+    }
+
+    // the nodes of the default scene depth first, parents before children. without scenes every
+    // node that isn't a child is a root
+    const JsonValue& nodes = root["nodes"];
+    std::vector<int> roots;
+    const JsonValue& sceneItem = root["scenes"][root["scene"].asIndex(0)];
+    if(!sceneItem.has("nodes"))
+    {
+        std::vector<bool> isChild(nodes.size(), false);
+        for(const auto& node : nodes.items)
+        {
+            for(const auto& child : node["children"].items)
+            {
+                int index       = child.asIndex();
+                bool valid      = index >= 0 && static_cast<size_t>(index) < isChild.size();
+                isChild[valid ? index : 0] = isChild[valid ? index : 0] || valid;
+            }
+        }
+        for(size_t i = 0; i < nodes.size(); i++)
+        {
+            if(!isChild[i])
+            {
+                roots.push_back(static_cast<int>(i));
+            }
+        }
+    }
+    for(const auto& node : sceneItem["nodes"].items)
+    {
+        roots.push_back(node.asIndex());
+    }
+    std::vector<bool>                visited(nodes.size(), false);
+    std::vector<std::pair<int, int>> stack; // node and the index of its parent in scene.nodes
+    for(auto iter = roots.rbegin(); iter != roots.rend(); ++iter)
+    {
+        stack.emplace_back(*iter, -1);
+    }
+    while(!stack.empty())
+    {
+        auto [index, parent] = stack.back();
+        stack.pop_back();
+        if(index < 0 || static_cast<size_t>(index) >= nodes.size() || visited[index])
+        {
+            GL_LOG_E("gltf %s: node %d is invalid or in a cycle", path.c_str(), index);
+            return false;
+        }
+        visited[index]        = true;
+        const JsonValue& item = nodes[index];
+        GltfNode         node;
+        node.name      = item["name"].string;
+        node.parent    = parent;
+        node.transform = nodeTransform(item);
+        node.mesh      = item["mesh"].asIndex();
+        node.mesh      = node.mesh < static_cast<int>(scene.meshes.size()) ? node.mesh : -1;
+        scene.nodes.push_back(node);
+        const JsonValue& children = item["children"];
+        for(size_t i = children.size(); i > 0; i--)
+        {
+            stack.emplace_back(children[i - 1].asIndex(), static_cast<int>(scene.nodes.size()) - 1);
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    GL_LOG_I("parse gltf %s: %zu meshes %zu primitives %zu nodes %zu images, %.2f MB of geometry, %.1f ms",
+             path.c_str(),
+             scene.meshes.size(),
+             primitiveCount,
+             scene.nodes.size(),
+             scene.images.size(),
+             bufferBytes / (1024.0 * 1024.0),
+             std::chrono::duration<double, std::milli>(end - start).count());
+    return true;
+}
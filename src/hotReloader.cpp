@@ -0,0 +1,168 @@
+#include "hotReloader.h"
+#include "log.h"
+#include "model.h"
+#include "texture.h"
+#include <memory>
+
+HotReloader::HotReloader()
+    : m_worker(&HotReloader::workerLoop, this)
+{ }
+
+HotReloader::~HotReloader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+    m_worker.join();
+}
+
+void HotReloader::watch(const std::string& name, const std::vector<std::string>& paths, const PrepareFunc& prepare)
+{
+    size_t entry = m_entries.size();
+    m_entries.push_back({name, prepare, false, false});
+    for(const auto& path : paths)
+    {
+        m_watcher.watch(path);
+        m_fileEntries.emplace(FileWatcher::normalize(path), entry);
+    }
+    GL_LOG_D("hot reload %s, %zu files", name.c_str(), paths.size());
+}
+
+void HotReloader::watch(ShaderProgram& program, const std::string& vertexPath, const std::string& fragmentPath, const ShaderDefines& defines)
+{
+    std::vector<std::string> dependencies;
+    ShaderProgram::preprocess(vertexPath, defines, &dependencies);
+    ShaderProgram::preprocess(fragmentPath, defines, &dependencies);
+
+    watch(fragmentPath, dependencies, [&program, vertexPath, fragmentPath, defines]() -> ApplyFunc {
+        // an editor may be halfway through saving, don't compile an error for it
+        for(const auto& path : {vertexPath, fragmentPath})
+        {
+            std::error_code error;
+            if(!std::filesystem::exists(path, error))
+            {
+                GL_LOG_W("%s disappeared, not reloading", path.c_str());
+                return ApplyFunc();
+            }
+        }
+        auto sources = std::make_shared<std::vector<ShaderSource>>(std::vector<ShaderSource>{
+            {VERTEX_SHADER, ShaderProgram::preprocess(vertexPath, defines), vertexPath},
+            {FRAGMENT_SHADER, ShaderProgram::preprocess(fragmentPath, defines), fragmentPath},
+        });
+        return [&program, sources]() { return program.reload(*sources); };
+    });
+}
+
+void HotReloader::watch(Texture& texture)
+{
+    if(texture.isCubeMap())
+    {
+        GL_LOG_W("hot reload of cube maps isn't supported, %s not watched", texture.path().c_str());
+        return;
+    }
+
+    std::string    path    = texture.path();
+    bool           isFlip  = texture.isFlip();
+    TextureOptions options = texture.options();
+    watch(path, {path}, [&texture, path, isFlip, options]() -> ApplyFunc {
+        auto image = std::make_shared<TextureImage>();
+        if(!Texture::load(path, isFlip, options, *image))
+        {
+            return ApplyFunc();
+        }
+        return [&texture, image]() { return texture.reload(*image); };
+    });
+}
+
+void HotReloader::watch(Model& model)
+{
+    std::string path       = model.path();
+    bool              isStreamed = model.isStreamed();
+    GeometryResidency residency  = model.residency();
+    watch(path, model.dependencies(), [&model, path, isStreamed, residency]() -> ApplyFunc {
+        auto data = std::make_shared<ModelData>();
+        if(!Model::import(path, *data, isStreamed, residency))
+        {
+            return ApplyFunc();
+        }
+        return [&model, data]() {
+            model.reload(*data);
+            return true;
+        };
+    });
+}
+
+void HotReloader::enqueue(size_t entry)
+{
+    Entry& target = m_entries[entry];
+    if(target.isBusy)
+    {
+        // rebuild again once the running one is done, its result may already be stale
+        target.isDirty = true;
+        return;
+    }
+    target.isBusy = true;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_jobs.push_back({entry, target.prepare});
+    }
+    m_condition.notify_one();
+}
+
+void HotReloader::update()
+{
+    for(const auto& file : m_watcher.poll())
+    {
+        auto range = m_fileEntries.equal_range(file);
+        for(auto iter = range.first; iter != range.second; ++iter)
+        {
+            GL_LOG_I("%s changed, rebuilding %s", file.c_str(), m_entries[iter->second].name.c_str());
+            enqueue(iter->second);
+        }
+    }
+
+    std::vector<Result> results;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        results.swap(m_results);
+    }
+    for(auto& result : results)
+    {
+        Entry& entry = m_entries[result.entry];
+        entry.isBusy = false;
+        if(!result.apply || !result.apply())
+        {
+            GL_LOG_W("rebuild of %s failed, keeping the old one", entry.name.c_str());
+        }
+        if(entry.isDirty)
+        {
+            entry.isDirty = false;
+            enqueue(result.entry);
+        }
+    }
+}
+
+void HotReloader::workerLoop()
+{
+    while(true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_isStopping || !m_jobs.empty(); });
+            if(m_isStopping)
+            {
+                return;
+            }
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        ApplyFunc apply = job.prepare();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_results.push_back({job.entry, std::move(apply)});
+    }
+}
@@ -1,14 +1,41 @@
 #include "mesh.h"
 #include "log.h"
 #include "shader.h"
+#include <algorithm>
+#include <cmath>
 
-Mesh::Mesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<Texture>& textures)
+Mesh::Mesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, std::vector<Texture>& textures, GeometryResidency residency)
     : m_vertices(vertices)
     , m_indices(indices)
     , m_texture(textures)
 {
-    m_refCnt = new unsigned(1);
-    setupMesh();
+    MeshGeometry geometry;
+    geometry.vertices    = m_vertices.data();
+    geometry.indices     = m_indices.data();
+    geometry.vertexCount = m_vertices.size();
+    geometry.indexCount  = m_indices.size();
+    setupMesh(geometry);
+    computeBounds();
+    setResidency(residency);
+}
+
+Mesh::Mesh(const MeshGeometry& geometry, std::vector<Texture>& textures, MeshCpuGeometry cpuGeometry)
+    : m_vertices(std::move(cpuGeometry.vertices))
+    , m_positions(std::move(cpuGeometry.positions))
+    , m_indices(std::move(cpuGeometry.indices))
+    , m_residency(cpuGeometry.residency)
+    , m_texture(textures)
+    , m_boundsCenter(geometry.boundsCenter)
+    , m_boundsRadius(geometry.boundsRadius)
+    , m_uvDensity(geometry.uvDensity)
+{
+    size_t expected = m_residency == GEOMETRY_RESIDENCY_FULL ? m_vertices.size() : m_residency == GEOMETRY_RESIDENCY_POSITIONS ? m_positions.size() : geometry.vertexCount;
+    if(expected != geometry.vertexCount || (m_residency != GEOMETRY_RESIDENCY_NONE && m_indices.size() != geometry.indexCount))
+    {
+        GL_LOG_E("cpu copy of a mesh doesn't match its %zu vertices and %zu indices", geometry.vertexCount, geometry.indexCount);
+        std::abort();
+    }
+    setupMesh(geometry);
 }
 
 Mesh::Mesh(const Mesh& other)
@@ -19,15 +46,28 @@ Mesh& Mesh::operator=(const Mesh& other)
 {
     if(this != &other)
     {
-        m_vertices = other.m_vertices;
-        m_indices  = other.m_indices;
-        m_texture  = other.m_texture;
-        m_VAO      = other.m_VAO;
-        m_VBO      = other.m_VBO;
-        m_EBO      = other.m_EBO;
-        (*other.m_refCnt)++;
-        m_refCnt = other.m_refCnt;
-        (*m_refCnt)++;
+        // take the new references before dropping the old ones, both may be the same resources
+        ResourceManager::acquire(other.m_vertexArray);
+        ResourceManager::acquire(other.m_geometry);
+        releaseResources();
+
+        m_vertices        = other.m_vertices;
+        m_positions       = other.m_positions;
+        m_indices         = other.m_indices;
+        m_residency       = other.m_residency;
+        m_texture         = other.m_texture;
+        m_vertexArray     = other.m_vertexArray;
+        m_geometry        = other.m_geometry;
+        m_layout          = other.m_layout;
+        m_VAO             = other.m_VAO;
+        m_range           = other.m_range;
+        m_indexOffset     = other.m_indexOffset;
+        m_vertexCount     = other.m_vertexCount;
+        m_indexCount      = other.m_indexCount;
+        m_rangeGeneration = other.m_rangeGeneration;
+        m_boundsCenter    = other.m_boundsCenter;
+        m_boundsRadius    = other.m_boundsRadius;
+        m_uvDensity       = other.m_uvDensity;
     }
     return *this;
 }
@@ -39,18 +79,30 @@ Mesh& Mesh::operator=(Mesh&& other)
 {
     if(this != &other)
     {
-        m_vertices = std::move(other.m_vertices);
-        m_indices  = std::move(other.m_indices);
-        m_texture  = std::move(other.m_texture);
-        m_VAO      = other.m_VAO;
-        m_VBO      = other.m_VBO;
-        m_EBO      = other.m_EBO;
-        m_refCnt   = other.m_refCnt;
+        releaseResources();
 
-        other.m_VAO    = 0;
-        other.m_EBO    = 0;
-        other.m_VBO    = 0;
-        other.m_refCnt = nullptr;
+        m_vertices        = std::move(other.m_vertices);
+        m_positions       = std::move(other.m_positions);
+        m_indices         = std::move(other.m_indices);
+        m_residency       = other.m_residency;
+        m_texture         = std::move(other.m_texture);
+        m_vertexArray     = other.m_vertexArray;
+        m_geometry        = other.m_geometry;
+        m_layout          = other.m_layout;
+        m_VAO             = other.m_VAO;
+        m_range           = other.m_range;
+        m_indexOffset     = other.m_indexOffset;
+        m_vertexCount     = other.m_vertexCount;
+        m_indexCount      = other.m_indexCount;
+        m_rangeGeneration = other.m_rangeGeneration;
+        m_boundsCenter    = other.m_boundsCenter;
+        m_boundsRadius    = other.m_boundsRadius;
+        m_uvDensity       = other.m_uvDensity;
+
+        other.m_vertexArray = ResourceHandle();
+        other.m_geometry    = ResourceHandle();
+        other.m_VAO         = 0;
+        other.m_range       = BufferAllocator::INVALID_RANGE;
     }
     return *this;
 }
@@ -64,7 +116,6 @@ void Mesh::draw(ShaderProgram& shader)
     shader.use();
     for(size_t i = 0; i < m_texture.size(); i++)
     {
-        glActiveTexture(GL_TEXTURE0 + i);
         std::string number      = "";
         auto        textureType = m_texture[i].type();
         switch(textureType)
@@ -89,52 +140,200 @@ void Mesh::draw(ShaderProgram& shader)
 
         std::string textureName = "material" + number + "." + Texture::translateTextureTypeName(textureType);
         shader.setInt(textureName, i);
-        glBindTexture(GL_TEXTURE_2D, m_texture[i].id());
+        m_texture[i].bind(i);
+    }
+    if(m_range == BufferAllocator::INVALID_RANGE)
+    {
+        return;
+    }
+    // compaction may have moved the geometry since the last draw
+    const BufferRange& range = BufferAllocator::geometry()->range(m_range);
+    if(range.generation != m_rangeGeneration)
+    {
+        bindBuffers(range);
     }
+
     // draw mesh
     glBindVertexArray(m_VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(m_indices.size()), GL_UNSIGNED_INT, 0);
+    glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(m_indexCount), m_layout.indexType, reinterpret_cast<void*>(range.offset + m_indexOffset));
     glBindVertexArray(0);
-
-    glActiveTexture(GL_TEXTURE0);
 }
 
 Mesh::~Mesh()
 {
-    if(m_refCnt)
+    releaseResources();
+}
+
+void Mesh::releaseResources()
+{
+    ResourceManager::release(m_vertexArray);
+    ResourceManager::release(m_geometry);
+    m_vertexArray = ResourceHandle();
+    m_geometry    = ResourceHandle();
+    m_VAO         = 0;
+    m_range       = BufferAllocator::INVALID_RANGE;
+}
+
+void Mesh::setupMesh(const MeshGeometry& geometry)
+{
+    // vertices and indices share one range of the geometry buffers, next to every other mesh's. the
+    // indices start aligned to their size, vertex bytes of other layouts can end anywhere
+    size_t vertexSize = geometry.vertexSize();
+    size_t indexSize  = geometry.indexSize();
+    auto*  allocator  = BufferAllocator::geometry();
+    m_layout          = geometry.layout;
+    m_indexOffset     = (vertexSize + 3) & ~size_t(3);
+    m_vertexCount     = geometry.vertexCount;
+    m_indexCount      = geometry.indexCount;
+    m_range           = allocator->allocate(m_indexOffset + indexSize);
+    if(m_range == BufferAllocator::INVALID_RANGE)
+    {
+        GL_LOG_W("mesh without geometry");
+        return;
+    }
+    m_geometry = ResourceManager::create(RESOURCE_GEOMETRY_RANGE, m_range);
+    if(geometry.buffer)
+    {
+        allocator->copy(m_range, 0, geometry.buffer, geometry.vertexOffset, vertexSize);
+        allocator->copy(m_range, m_indexOffset, geometry.buffer, geometry.indexOffset, indexSize);
+    }
+    else
+    {
+        allocator->upload(m_range, 0, geometry.vertices, vertexSize);
+        allocator->upload(m_range, m_indexOffset, geometry.indices, indexSize);
+    }
+
+    glCreateVertexArrays(1, &m_VAO);
+    m_vertexArray = ResourceManager::create(RESOURCE_VERTEX_ARRAY, m_VAO);
+    if(!m_layout.isInterleaved())
     {
-        (*m_refCnt)--;
-        if(*m_refCnt == 0)
+        // every attribute has the binding of its location, with its own offset and stride
+        for(int i = 0; i < VERTEX_ATTRIBUTE_COUNT; i++)
         {
-            GL_LOG_D("release vao %d vbo %d ebo %d", m_VAO, m_VBO, m_EBO);
-            glDeleteBuffers(1, &m_VBO);
-            glDeleteBuffers(1, &m_EBO);
-            glDeleteVertexArrays(1, &m_VAO);
+            const VertexAttribute& attribute = m_layout.attributes[i];
+            if(attribute.isEnabled)
+            {
+                glEnableVertexArrayAttrib(m_VAO, i);
+                glVertexArrayAttribFormat(m_VAO, i, attribute.size, attribute.type, attribute.isNormalized ? GL_TRUE : GL_FALSE, 0);
+                glVertexArrayAttribBinding(m_VAO, i, i);
+            }
         }
+        bindBuffers(allocator->range(m_range));
+        return;
     }
+    // every attribute reads from binding 0, the interleaved vertices
+    glEnableVertexArrayAttrib(m_VAO, 0);
+    glVertexArrayAttribFormat(m_VAO, 0, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, position));
+    glVertexArrayAttribBinding(m_VAO, 0, 0);
+    // vertex normals
+    glEnableVertexArrayAttrib(m_VAO, 1);
+    glVertexArrayAttribFormat(m_VAO, 1, 3, GL_FLOAT, GL_FALSE, offsetof(Vertex, normal));
+    glVertexArrayAttribBinding(m_VAO, 1, 0);
+    // vertex texture coords
+    glEnableVertexArrayAttrib(m_VAO, 2);
+    glVertexArrayAttribFormat(m_VAO, 2, 2, GL_FLOAT, GL_FALSE, offsetof(Vertex, texCoords));
+    glVertexArrayAttribBinding(m_VAO, 2, 0);
+    bindBuffers(allocator->range(m_range));
 }
 
-void Mesh::setupMesh()
+void Mesh::bindBuffers(const BufferRange& range)
 {
-    glGenVertexArrays(1, &m_VAO);
-    glGenBuffers(1, &m_VBO);
-    glGenBuffers(1, &m_EBO);
+    // the indices are addressed by their offset into the whole buffer at draw time
+    if(m_layout.isInterleaved())
+    {
+        glVertexArrayVertexBuffer(m_VAO, 0, range.buffer, range.offset, sizeof(Vertex));
+    }
+    for(int i = 0; i < VERTEX_ATTRIBUTE_COUNT; i++)
+    {
+        const VertexAttribute& attribute = m_layout.attributes[i];
+        if(attribute.isEnabled)
+        {
+            glVertexArrayVertexBuffer(m_VAO, i, range.buffer, range.offset + attribute.offset, attribute.stride);
+        }
+    }
+    glVertexArrayElementBuffer(m_VAO, range.buffer);
+    m_rangeGeneration = range.generation;
+}
 
-    glBindVertexArray(m_VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, m_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex) * m_vertices.size(), &m_vertices[0], GL_STATIC_DRAW);
+void Mesh::setResidency(GeometryResidency residency)
+{
+    if(residency == m_residency)
+    {
+        return;
+    }
+    if(residency > m_residency)
+    {
+        GL_LOG_W("mesh geometry was dropped already, it stays at residency %d", m_residency);
+        return;
+    }
+    if(residency == GEOMETRY_RESIDENCY_POSITIONS)
+    {
+        m_positions.resize(m_vertices.size());
+        for(size_t i = 0; i < m_vertices.size(); i++)
+        {
+            m_positions[i] = m_vertices[i].position;
+        }
+    }
+    else
+    {
+        std::vector<glm::vec3>().swap(m_positions);
+        std::vector<unsigned int>().swap(m_indices);
+    }
+    // swapped, clear() would keep the capacity
+    std::vector<Vertex>().swap(m_vertices);
+    m_residency = residency;
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * m_indices.size(), &m_indices[0], GL_STATIC_DRAW);
+size_t Mesh::cpuMemorySize() const
+{
+    return m_vertices.capacity() * sizeof(Vertex) + m_positions.capacity() * sizeof(glm::vec3) + m_indices.capacity() * sizeof(unsigned int);
+}
 
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // vertex normals
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    // vertex texture coords
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+size_t Mesh::cpuMemorySize(GeometryResidency residency) const
+{
+    switch(residency)
+    {
+    case GEOMETRY_RESIDENCY_POSITIONS:
+        return m_vertexCount * sizeof(glm::vec3) + m_indexCount * sizeof(unsigned int);
+    case GEOMETRY_RESIDENCY_FULL:
+        return m_vertexCount * sizeof(Vertex) + m_indexCount * sizeof(unsigned int);
+    default:
+        return 0;
+    }
+}
 
-    glBindVertexArray(0);
-}
\ No newline at end of file
+void Mesh::computeBounds()
+{
+    if(m_vertices.empty())
+    {
+        return;
+    }
+    glm::vec3 minCorner = m_vertices[0].position;
+    glm::vec3 maxCorner = m_vertices[0].position;
+    for(const auto& vertex : m_vertices)
+    {
+        minCorner = glm::min(minCorner, vertex.position);
+        maxCorner = glm::max(maxCorner, vertex.position);
+    }
+    m_boundsCenter = (minCorner + maxCorner) * 0.5f;
+    m_boundsRadius = 0.0f;
+    for(const auto& vertex : m_vertices)
+    {
+        m_boundsRadius = std::max(m_boundsRadius, glm::length(vertex.position - m_boundsCenter));
+    }
+
+    // ratio of the areas, so stretched or mirrored mappings still average out
+    double worldArea = 0.0;
+    double uvArea    = 0.0;
+    for(size_t i = 0; i + 2 < m_indices.size(); i += 3)
+    {
+        const Vertex& a = m_vertices[m_indices[i]];
+        const Vertex& b = m_vertices[m_indices[i + 1]];
+        const Vertex& c = m_vertices[m_indices[i + 2]];
+        worldArea += 0.5 * glm::length(glm::cross(b.position - a.position, c.position - a.position));
+        glm::vec2 ab = b.texCoords - a.texCoords;
+        glm::vec2 ac = c.texCoords - a.texCoords;
+        uvArea += 0.5 * std::fabs(ab.x * ac.y - ab.y * ac.x);
+    }
+    m_uvDensity = worldArea > 0.0 ? static_cast<float>(std::sqrt(uvArea / worldArea)) : 0.0f;
+}
@@ -1,11 +1,184 @@
 #include "model.h"
 #include "log.h"
+#include "packFile.h"
 #include "shader.h"
+#include "textureUploader.h"
 #include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <utility>
+#include <assimp/DefaultIOSystem.h>
+#include <assimp/IOStream.hpp>
+// clang-format off
+#include <glm/gtc/type_ptr.hpp>
+// clang-format on
+#ifdef __linux__
+#    include <sys/resource.h>
+#endif
 
-Model::Model(const std::string path)
+// every staged range starts here, like the uploader's own ranges
+static const size_t GEOMETRY_ALIGNMENT = 16;
+
+// triangles of a glTF primitive read back for its texel density, a sample is as good as all of them
+static const size_t GLTF_DENSITY_SAMPLES = 4096;
+
+static size_t alignUp(size_t size)
+{
+    return (size + GEOMETRY_ALIGNMENT - 1) & ~(GEOMETRY_ALIGNMENT - 1);
+}
+
+// highest resident memory of the process so far, 0 where it can't be asked for
+static double peakRssMb()
+{
+#ifdef __linux__
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) == 0)
+    {
+        return usage.ru_maxrss / 1024.0;
+    }
+#endif
+    return 0.0;
+}
+
+// bounds and texel density of a mesh, read from the importer's arrays since staged memory is write
+// combined. position(i) and texCoord(i) of a vertex, triangle(i, corners) false if face i isn't one
+template<typename Position, typename TexCoord, typename Triangle>
+static void measureGeometry(size_t vertexCount, size_t faceCount, bool hasTexCoords, Position position, TexCoord texCoord, Triangle triangle, MeshGeometry& geometry)
+{
+    glm::vec3 minCorner(0.0f);
+    glm::vec3 maxCorner(0.0f);
+    for(size_t i = 0; i < vertexCount; i++)
+    {
+        glm::vec3 point = position(i);
+        minCorner       = i == 0 ? point : glm::min(minCorner, point);
+        maxCorner       = i == 0 ? point : glm::max(maxCorner, point);
+    }
+    geometry.boundsCenter = (minCorner + maxCorner) * 0.5f;
+    for(size_t i = 0; i < vertexCount; i++)
+    {
+        geometry.boundsRadius = std::max(geometry.boundsRadius, glm::length(position(i) - geometry.boundsCenter));
+    }
+    if(!hasTexCoords)
+    {
+        return;
+    }
+    double worldArea = 0.0;
+    double uvArea    = 0.0;
+    for(size_t i = 0; i < faceCount; i++)
+    {
+        unsigned int corners[3];
+        if(!triangle(i, corners))
+        {
+            continue;
+        }
+        glm::vec3 a  = position(corners[0]);
+        glm::vec2 ab = texCoord(corners[1]) - texCoord(corners[0]);
+        glm::vec2 ac = texCoord(corners[2]) - texCoord(corners[0]);
+        worldArea += 0.5 * glm::length(glm::cross(position(corners[1]) - a, position(corners[2]) - a));
+        uvArea += 0.5 * std::fabs(ab.x * ac.y - ab.y * ac.x);
+    }
+    geometry.uvDensity = worldArea > 0.0 ? static_cast<float>(std::sqrt(uvArea / worldArea)) : 0.0f;
+}
+
+// a file of a mounted pack, read by assimp like any other file
+class PackIOStream : public Assimp::IOStream
+{
+public:
+    explicit PackIOStream(FileData&& file)
+        : m_file(std::move(file))
+    {
+    }
+
+    size_t Read(void* buffer, size_t size, size_t count) override
+    {
+        if(size == 0)
+        {
+            return 0;
+        }
+        count = std::min(count, (m_file.size - m_position) / size);
+        memcpy(buffer, m_file.data + m_position, size * count);
+        m_position += size * count;
+        return count;
+    }
+
+    size_t Write(const void*, size_t, size_t) override
+    {
+        return 0;
+    }
+
+    aiReturn Seek(size_t offset, aiOrigin origin) override
+    {
+        size_t position = origin == aiOrigin_SET ? offset : origin == aiOrigin_CUR ? m_position + offset : m_file.size + offset;
+        if(position > m_file.size)
+        {
+            return aiReturn_FAILURE;
+        }
+        m_position = position;
+        return aiReturn_SUCCESS;
+    }
+
+    size_t Tell() const override
+    {
+        return m_position;
+    }
+
+    size_t FileSize() const override
+    {
+        return m_file.size;
+    }
+
+    void Flush() override
+    {
+    }
+
+private:
+    FileData m_file;
+    size_t   m_position = 0;
+};
+
+// serves the files of mounted packs, .mtl and .bin files next to a model included, and leaves the
+// rest to the default
+class PackIOSystem : public Assimp::DefaultIOSystem
 {
-    loadModel(path);
+public:
+    bool Exists(const char* file) const override
+    {
+        return PackFile::isPacked(file) || Assimp::DefaultIOSystem::Exists(file);
+    }
+
+    Assimp::IOStream* Open(const char* file, const char* mode) override
+    {
+        FileData data;
+        if(!strchr(mode, 'w') && PackFile::isPacked(file) && PackFile::load(file, data))
+        {
+            return new PackIOStream(std::move(data));
+        }
+        return Assimp::DefaultIOSystem::Open(file, mode);
+    }
+
+    void Close(Assimp::IOStream* stream) override
+    {
+        delete stream;
+    }
+};
+
+bool Model::s_nativeObj  = true;
+bool Model::s_nativeGltf = true;
+
+Model::Model(const std::string path, bool isStreamed, GeometryResidency residency)
+    : m_path(path)
+    , m_isStreamed(isStreamed)
+    , m_residency(residency)
+{
+    auto      start = std::chrono::steady_clock::now();
+    ModelData data;
+    if(import(path, data, isStreamed, residency))
+    {
+        create(data);
+    }
+    auto end = std::chrono::steady_clock::now();
+    GL_LOG_I("load model %s in %.1f ms", path.c_str(), std::chrono::duration<double, std::milli>(end - start).count());
 }
 
 void Model::draw(ShaderProgram& shader)
@@ -16,105 +189,619 @@ void Model::draw(ShaderProgram& shader)
     }
 }
 
-void Model::loadModel(const std::string& path)
+void Model::draw(ShaderProgram& shader, const glm::mat4& transform)
+{
+    if(m_nodes.empty())
+    {
+        shader.setMat4("model", glm::value_ptr(transform));
+        draw(shader);
+        return;
+    }
+    for(const auto& node : m_nodes)
+    {
+        if(node.meshes.empty())
+        {
+            continue;
+        }
+        glm::mat4 model = transform * node.globalTransform;
+        shader.setMat4("model", glm::value_ptr(model));
+        for(size_t mesh : node.meshes)
+        {
+            m_meshes[mesh].draw(shader);
+        }
+    }
+}
+
+void Model::reload(ModelData& data)
+{
+    // the old meshes and textures are released here, nothing can be using them mid frame
+    m_meshes.clear();
+    m_nodes.clear();
+    m_loadedTextures.clear();
+    create(data);
+    setResidency(m_residency);
+    GL_LOG_I("reload model %s: %zu meshes %zu textures", m_path.c_str(), m_meshes.size(), m_loadedTextures.size());
+}
+
+void Model::setResidency(GeometryResidency residency)
+{
+    for(auto& mesh : m_meshes)
+    {
+        mesh.setResidency(residency);
+    }
+    m_residency = std::min(m_residency, residency);
+}
+
+size_t Model::cpuGeometrySize() const
+{
+    size_t size = 0;
+    for(const auto& mesh : m_meshes)
+    {
+        size += mesh.cpuMemorySize();
+    }
+    return size;
+}
+
+size_t Model::cpuGeometrySize(GeometryResidency residency) const
+{
+    size_t size = 0;
+    for(const auto& mesh : m_meshes)
+    {
+        size += mesh.cpuMemorySize(residency);
+    }
+    return size;
+}
+
+void Model::logGeometryMemory() const
+{
+    static const char* NAMES[] = {"none", "positions", "full"};
+    GL_LOG_I("model %s: residency %s keeps %.2f MB of geometry in memory, would be %.2f MB with positions and %.2f MB with full",
+             m_path.c_str(),
+             NAMES[m_residency],
+             cpuGeometrySize() / (1024.0 * 1024.0),
+             cpuGeometrySize(GEOMETRY_RESIDENCY_POSITIONS) / (1024.0 * 1024.0),
+             cpuGeometrySize(GEOMETRY_RESIDENCY_FULL) / (1024.0 * 1024.0));
+}
+
+std::vector<std::string> Model::dependencies() const
+{
+    std::vector<std::string> paths = {m_path};
+    for(const auto& texture : m_loadedTextures)
+    {
+        // embedded textures change with the model file
+        if(texture.path().compare(0, m_path.size() + 1, m_path + "#") != 0)
+        {
+            paths.push_back(texture.path());
+        }
+    }
+    return paths;
+}
+
+void Model::create(ModelData& data)
+{
+    for(auto& texture : data.textures)
+    {
+        m_loadedTextures.emplace_back(texture.image, texture.type, false, texture.options);
+    }
+
+    m_meshes.reserve(data.meshes.size());
+    for(auto& meshData : data.meshes)
+    {
+        std::vector<Texture> textures;
+        for(size_t textureIdx : meshData.textures)
+        {
+            textures.push_back(m_loadedTextures[textureIdx]);
+        }
+        MeshGeometry geometry = meshData.geometry;
+        if(data.geometryStaging)
+        {
+            geometry.buffer = data.geometryStaging->buffer;
+        }
+        else
+        {
+            geometry.vertices = reinterpret_cast<const Vertex*>(data.geometryArena.get() + geometry.vertexOffset);
+            geometry.indices  = reinterpret_cast<const unsigned int*>(data.geometryArena.get() + geometry.indexOffset);
+        }
+        m_meshes.emplace_back(geometry, textures, std::move(meshData.cpuGeometry));
+    }
+    m_nodes = std::move(data.nodes);
+    if(data.geometryStaging)
+    {
+        // the staged ranges go back to the uploader once these copies are done
+        data.geometryStaging->uploader->fence(*data.geometryStaging);
+    }
+
+    size_t textureMemory      = 0;
+    size_t uncompressedMemory = 0;
+    for(const auto& texture : m_loadedTextures)
+    {
+        textureMemory += texture.memorySize();
+        uncompressedMemory += texture.uncompressedSize();
+    }
+    GL_LOG_I("model %s: %zu textures use %.2f MB of video memory, %.2f MB saved over rgba8",
+             m_path.c_str(),
+             m_loadedTextures.size(),
+             textureMemory / (1024.0 * 1024.0),
+             (uncompressedMemory - std::min(textureMemory, uncompressedMemory)) / (1024.0 * 1024.0));
+    logGeometryMemory();
+}
+
+bool Model::import(const std::string& path, ModelData& data, bool isStreamed, GeometryResidency residency)
+{
+    auto        start  = std::chrono::steady_clock::now();
+    const char* loader = "assimp";
+    bool        isOk   = false;
+    if(s_nativeObj && ObjLoader::isObj(path))
+    {
+        loader = "obj loader";
+        isOk   = importObj(path, data, isStreamed, residency);
+    }
+    else if(s_nativeGltf && GltfLoader::isGltf(path))
+    {
+        loader = "gltf loader";
+        isOk   = importGltf(path, data, isStreamed, residency);
+    }
+    else
+    {
+        isOk = importAssimp(path, data, isStreamed, residency);
+    }
+    if(!isOk)
+    {
+        return false;
+    }
+    auto end = std::chrono::steady_clock::now();
+    GL_LOG_I("import model %s with %s: %zu meshes, %.2f MB geometry %s, %.1f ms, peak rss %.1f MB",
+             path.c_str(),
+             loader,
+             data.meshes.size(),
+             data.geometrySize / (1024.0 * 1024.0),
+             data.geometryStaging ? "staged" : "in memory",
+             std::chrono::duration<double, std::milli>(end - start).count(),
+             peakRssMb());
+    return true;
+}
+
+bool Model::importAssimp(const std::string& path, ModelData& data, bool isStreamed, GeometryResidency residency)
 {
     Assimp::Importer importer;
-    const aiScene*   scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    if(PackFile::hasMounts())
+    {
+        // the importer owns it
+        importer.SetIOHandler(new PackIOSystem());
+    }
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
     if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode)
     {
         GL_LOG_E("Failed to load model: %s", importer.GetErrorString());
-        return;
+        return false;
     }
 
-    m_directory = path.substr(0, path.find_last_of('/'));
-    processNode(scene->mRootNode, scene);
+    std::vector<aiMesh*> meshes;
+    processNode(scene->mRootNode, scene, meshes);
+    data.meshes.resize(meshes.size());
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        MeshGeometry& geometry = data.meshes[i].geometry;
+        geometry.vertexCount   = meshes[i]->mNumVertices;
+        geometry.indexCount    = 0;
+        for(size_t j = 0; j < meshes[i]->mNumFaces; j++)
+        {
+            geometry.indexCount += meshes[i]->mFaces[j].mNumIndices;
+        }
+    }
+    reserveGeometry(data);
+
+    std::string directory = path.substr(0, path.find_last_of('/'));
+    for(size_t i = 0; i < meshes.size(); i++)
+    {
+        if(!processMesh(meshes[i], scene, directory, isStreamed, residency, data, data.meshes[i]))
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+bool Model::importObj(const std::string& path, ModelData& data, bool isStreamed, GeometryResidency residency)
 {
-    for(size_t i = 0; i < node->mNumMeshes; i++)
+    ObjScene scene;
+    if(!ObjLoader::load(path, scene))
     {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        m_meshes.push_back(processMesh(mesh, scene));
+        return false;
     }
+    data.meshes.resize(scene.meshes.size());
+    for(size_t i = 0; i < scene.meshes.size(); i++)
+    {
+        data.meshes[i].geometry.vertexCount = scene.meshes[i].vertices.size();
+        data.meshes[i].geometry.indexCount  = scene.meshes[i].indices.size();
+    }
+    reserveGeometry(data);
 
-    for(size_t i = 0; i < node->mNumChildren; i++)
+    // the same texture types loadMaterialTextures takes from assimp
+    std::string directory = path.substr(0, path.find_last_of('/'));
+    for(size_t i = 0; i < scene.meshes.size(); i++)
     {
-        processNode(node->mChildren[i], scene);
+        const ObjMesh& mesh = scene.meshes[i];
+        processObjGeometry(scene, mesh, residency, data, data.meshes[i]);
+        if(mesh.material < 0)
+        {
+            continue;
+        }
+        const ObjMaterial& material = scene.materials[mesh.material];
+        for(const auto& map : {std::make_pair(&material.diffuseMap, TEXTURE_DIFFUSE), std::make_pair(&material.specularMap, TEXTURE_SPECULAR), std::make_pair(&material.ambientMap, TEXTURE_AMBIENT)})
+        {
+            if(!map.first->empty() && !loadTexture(directory + "/" + *map.first, map.second, isStreamed, data, data.meshes[i]))
+            {
+                return false;
+            }
+        }
     }
+    return true;
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+bool Model::importGltf(const std::string& path, ModelData& data, bool isStreamed, GeometryResidency residency)
 {
-    std::vector<Vertex>       vertices;
-    std::vector<unsigned int> indices;
-    std::vector<Texture>      textures;
+    GltfScene scene;
+    if(!GltfLoader::load(path, scene))
+    {
+        return false;
+    }
 
-    // vertex
-    for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+    // every primitive becomes a mesh with the layout its accessors have in the file, the meshes of
+    // glTF mesh i are firstMesh[i] up to firstMesh[i + 1]
+    std::vector<size_t> firstMesh;
+    for(const auto& mesh : scene.meshes)
     {
-        Vertex vertex;
+        firstMesh.push_back(data.meshes.size());
+        for(const auto& primitive : mesh.primitives)
+        {
+            data.meshes.emplace_back();
+            MeshGeometry& geometry = data.meshes.back().geometry;
+            geometry.vertexCount   = primitive.attributes[GLTF_POSITION].count;
+            geometry.indexCount    = primitive.indices.data ? primitive.indices.count : geometry.vertexCount;
+            VertexLayout& layout   = geometry.layout;
+            layout.vertexSize      = primitive.vertexSize;
+            layout.indexType       = primitive.indices.data ? primitive.indices.componentType : GL_UNSIGNED_INT;
+            // GltfAttribute is in the order of VertexAttributeLocation
+            for(int i = 0; i < GLTF_ATTRIBUTE_COUNT; i++)
+            {
+                const GltfAccessor& accessor = primitive.attributes[i];
+                VertexAttribute&    attribute = layout.attributes[i];
+                attribute.isEnabled           = accessor.data != nullptr;
+                attribute.offset              = primitive.attributeOffsets[i];
+                attribute.stride              = static_cast<unsigned int>(accessor.stride);
+                attribute.size                = accessor.size;
+                attribute.type                = accessor.componentType;
+                attribute.isNormalized        = accessor.isNormalized;
+            }
+        }
+    }
+    firstMesh.push_back(data.meshes.size());
+    reserveGeometry(data);
 
-        // position
-        vertex.position.x = mesh->mVertices[i].x;
-        vertex.position.y = mesh->mVertices[i].y;
-        vertex.position.z = mesh->mVertices[i].z;
+    for(size_t i = 0; i < scene.meshes.size(); i++)
+    {
+        for(size_t j = 0; j < scene.meshes[i].primitives.size(); j++)
+        {
+            const GltfPrimitive& primitive = scene.meshes[i].primitives[j];
+            ModelData::MeshData& meshData  = data.meshes[firstMesh[i] + j];
+            processGltfGeometry(primitive, residency, data, meshData);
+            int image = primitive.material >= 0 ? scene.materials[primitive.material].baseColorImage : -1;
+            if(image >= 0 && !loadTexture(scene.images[image].path, TEXTURE_DIFFUSE, isStreamed, data, meshData, scene.images[image].data, scene.images[image].size))
+            {
+                return false;
+            }
+        }
+    }
 
-        // normal
-        vertex.normal.x = mesh->mNormals[i].x;
-        vertex.normal.y = mesh->mNormals[i].y;
-        vertex.normal.z = mesh->mNormals[i].z;
+    for(const auto& node : scene.nodes)
+    {
+        ModelNode modelNode;
+        modelNode.name            = node.name;
+        modelNode.parent          = node.parent;
+        modelNode.transform       = node.transform;
+        modelNode.globalTransform = node.parent >= 0 ? data.nodes[node.parent].globalTransform * node.transform : node.transform;
+        for(size_t i = node.mesh >= 0 ? firstMesh[node.mesh] : 0; node.mesh >= 0 && i < firstMesh[node.mesh + 1]; i++)
+        {
+            modelNode.meshes.push_back(i);
+        }
+        data.nodes.push_back(std::move(modelNode));
+    }
+    return true;
+}
 
-        // texcoords
-        vertex.texCoords = glm::vec2(0.0);
-        if(mesh->mTextureCoords[0])
+void Model::processNode(aiNode* node, const aiScene* scene, std::vector<aiMesh*>& meshes)
+{
+    for(size_t i = 0; i < node->mNumMeshes; i++)
+    {
+        meshes.push_back(scene->mMeshes[node->mMeshes[i]]);
+    }
+    for(size_t i = 0; i < node->mNumChildren; i++)
+    {
+        processNode(node->mChildren[i], scene, meshes);
+    }
+}
+
+void Model::reserveGeometry(ModelData& data)
+{
+    // the vertices and then the indices of every mesh, in the order they are processed
+    std::vector<size_t> sizes;
+    for(const auto& meshData : data.meshes)
+    {
+        sizes.push_back(meshData.geometry.vertexSize());
+        sizes.push_back(meshData.geometry.indexSize());
+    }
+
+    data.geometrySize = 0;
+    for(size_t size : sizes)
+    {
+        data.geometrySize += alignUp(size);
+    }
+    if(Texture::uploader() && data.geometrySize > 0)
+    {
+        data.geometryStaging = Texture::uploader()->reserve(sizes);
+    }
+
+    if(data.geometryStaging)
+    {
+        for(size_t i = 0; i < data.meshes.size(); i++)
         {
-            vertex.texCoords.x = mesh->mTextureCoords[0][i].x;
-            vertex.texCoords.y = mesh->mTextureCoords[0][i].y;
+            data.meshes[i].geometry.vertexOffset = data.geometryStaging->offsets[i * 2];
+            data.meshes[i].geometry.indexOffset  = data.geometryStaging->offsets[i * 2 + 1];
         }
+        return;
+    }
+    // no uploader or no room in it, one block for the whole model instead of two vectors per mesh
+    data.geometryArena.reset(new unsigned char[data.geometrySize]);
+    size_t offset = 0;
+    for(size_t i = 0; i < data.meshes.size(); i++)
+    {
+        data.meshes[i].geometry.vertexOffset = offset;
+        offset += alignUp(sizes[i * 2]);
+        data.meshes[i].geometry.indexOffset = offset;
+        offset += alignUp(sizes[i * 2 + 1]);
+    }
+}
 
-        vertices.push_back(vertex);
+void Model::processGeometry(aiMesh* mesh, GeometryResidency residency, ModelData& data, ModelData::MeshData& meshData)
+{
+    MeshGeometry&  geometry = meshData.geometry;
+    unsigned char* base     = data.geometryStaging ? data.geometryStaging->mapped : data.geometryArena.get();
+    Vertex*        vertices = reinterpret_cast<Vertex*>(base + geometry.vertexOffset);
+    unsigned int*  indices  = reinterpret_cast<unsigned int*>(base + geometry.indexOffset);
+    // the cpu copy is filled in the same passes, only as much of it as the residency keeps
+    MeshCpuGeometry& cpuGeometry = meshData.cpuGeometry;
+    cpuGeometry.residency        = residency;
+    if(residency == GEOMETRY_RESIDENCY_FULL)
+    {
+        cpuGeometry.vertices.resize(geometry.vertexCount);
+    }
+    else if(residency == GEOMETRY_RESIDENCY_POSITIONS)
+    {
+        cpuGeometry.positions.resize(geometry.vertexCount);
+    }
+    if(residency != GEOMETRY_RESIDENCY_NONE)
+    {
+        cpuGeometry.indices.resize(geometry.indexCount);
+    }
+
+    // staged memory is write combined, every vertex is built here and written once, nothing is read back
+    for(unsigned int i = 0; i < mesh->mNumVertices; i++)
+    {
+        Vertex vertex;
+        vertex.position  = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+        vertex.normal    = mesh->mNormals ? glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z) : glm::vec3(0.0f);
+        vertex.texCoords = mesh->mTextureCoords[0] ? glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y) : glm::vec2(0.0f);
+        vertices[i]      = vertex;
+        if(residency == GEOMETRY_RESIDENCY_FULL)
+        {
+            cpuGeometry.vertices[i] = vertex;
+        }
+        else if(residency == GEOMETRY_RESIDENCY_POSITIONS)
+        {
+            cpuGeometry.positions[i] = vertex.position;
+        }
     }
 
-    // indices
+    size_t index = 0;
     for(size_t i = 0; i < mesh->mNumFaces; i++)
     {
-        aiFace face = mesh->mFaces[i];
+        const aiFace& face = mesh->mFaces[i];
         for(size_t j = 0; j < face.mNumIndices; j++)
         {
-            indices.push_back(face.mIndices[j]);
+            indices[index] = face.mIndices[j];
+            if(residency != GEOMETRY_RESIDENCY_NONE)
+            {
+                cpuGeometry.indices[index] = face.mIndices[j];
+            }
+            index++;
         }
     }
 
-    // material
-    if(mesh->mMaterialIndex >= 0)
+    measureGeometry(
+        mesh->mNumVertices,
+        mesh->mNumFaces,
+        mesh->mTextureCoords[0] != nullptr,
+        [mesh](size_t i) { return glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z); },
+        [mesh](size_t i) { return glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y); },
+        [mesh](size_t i, unsigned int* corners) {
+            const aiFace& face = mesh->mFaces[i];
+            if(face.mNumIndices != 3)
+            {
+                return false;
+            }
+            std::copy(face.mIndices, face.mIndices + 3, corners);
+            return true;
+        },
+        geometry);
+}
+
+void Model::processObjGeometry(const ObjScene& scene, const ObjMesh& mesh, GeometryResidency residency, ModelData& data, ModelData::MeshData& meshData)
+{
+    MeshGeometry&  geometry = meshData.geometry;
+    unsigned char* base     = data.geometryStaging ? data.geometryStaging->mapped : data.geometryArena.get();
+    Vertex*        vertices = reinterpret_cast<Vertex*>(base + geometry.vertexOffset);
+    unsigned int*  indices  = reinterpret_cast<unsigned int*>(base + geometry.indexOffset);
+
+    // each distinct corner is assembled from the parsed arrays and written once, like processGeometry
+    MeshCpuGeometry& cpuGeometry = meshData.cpuGeometry;
+    cpuGeometry.residency        = residency;
+    if(residency == GEOMETRY_RESIDENCY_FULL)
     {
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        cpuGeometry.vertices.resize(geometry.vertexCount);
+    }
+    else if(residency == GEOMETRY_RESIDENCY_POSITIONS)
+    {
+        cpuGeometry.positions.resize(geometry.vertexCount);
+    }
+    for(size_t i = 0; i < mesh.vertices.size(); i++)
+    {
+        const ObjIndex& corner = mesh.vertices[i];
+        Vertex          vertex;
+        vertex.position  = scene.positions[corner.position];
+        vertex.normal    = corner.normal >= 0 ? scene.normals[corner.normal] : glm::vec3(0.0f);
+        vertex.texCoords = corner.texCoord >= 0 ? scene.texCoords[corner.texCoord] : glm::vec2(0.0f);
+        vertices[i]      = vertex;
+        if(residency == GEOMETRY_RESIDENCY_FULL)
+        {
+            cpuGeometry.vertices[i] = vertex;
+        }
+        else if(residency == GEOMETRY_RESIDENCY_POSITIONS)
+        {
+            cpuGeometry.positions[i] = vertex.position;
+        }
+    }
+    memcpy(indices, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+    if(residency != GEOMETRY_RESIDENCY_NONE)
+    {
+        cpuGeometry.indices = mesh.indices;
+    }
 
-        aiTextureType        type        = aiTextureType_DIFFUSE;
-        std::vector<Texture> diffuseMaps = loadMaterialTextures(material, &type, "texture_diffuse");
-        textures.insert(textures.end(), std::make_move_iterator(diffuseMaps.begin()), std::make_move_iterator(diffuseMaps.end()));
+    measureGeometry(
+        mesh.vertices.size(),
+        mesh.indices.size() / 3,
+        mesh.hasTexCoords,
+        [&](size_t i) { return scene.positions[mesh.vertices[i].position]; },
+        [&](size_t i) { return mesh.vertices[i].texCoord >= 0 ? scene.texCoords[mesh.vertices[i].texCoord] : glm::vec2(0.0f); },
+        [&](size_t i, unsigned int* corners) {
+            std::copy(mesh.indices.data() + i * 3, mesh.indices.data() + i * 3 + 3, corners);
+            return true;
+        },
+        geometry);
+}
 
-        type                              = aiTextureType_SPECULAR;
-        std::vector<Texture> specularMaps = loadMaterialTextures(material, &type, "texture_specular");
-        textures.insert(textures.end(), std::make_move_iterator(specularMaps.begin()), std::make_move_iterator(specularMaps.end()));
+void Model::processGltfGeometry(const GltfPrimitive& primitive, GeometryResidency residency, ModelData& data, ModelData::MeshData& meshData)
+{
+    MeshGeometry&       geometry  = meshData.geometry;
+    unsigned char*      base      = data.geometryStaging ? data.geometryStaging->mapped : data.geometryArena.get();
+    const GltfAccessor& positions = primitive.attributes[GLTF_POSITION];
+    const GltfAccessor& normals   = primitive.attributes[GLTF_NORMAL];
+    const GltfAccessor& texCoords = primitive.attributes[GLTF_TEXCOORD_0];
+    const GltfAccessor& indices   = primitive.indices;
 
-        type                             = aiTextureType_AMBIENT;
-        std::vector<Texture> ambientMaps = loadMaterialTextures(material, &type, "texture_ambient");
-        textures.insert(textures.end(), std::make_move_iterator(ambientMaps.begin()), std::make_move_iterator(ambientMaps.end()));
+    // the mapped file already holds the buffers the layout describes, they are copied as they are
+    for(const auto& span : primitive.spans)
+    {
+        memcpy(base + geometry.vertexOffset + span.offset, span.data, span.size);
+    }
+    if(indices.data)
+    {
+        memcpy(base + geometry.indexOffset, indices.data, geometry.indexSize());
     }
+    else
+    {
+        unsigned int* generated = reinterpret_cast<unsigned int*>(base + geometry.indexOffset);
+        for(size_t i = 0; i < geometry.indexCount; i++)
+        {
+            generated[i] = static_cast<unsigned int>(i);
+        }
+    }
+    auto index = [&indices](size_t i) { return indices.data ? indices.readIndex(i) : static_cast<unsigned int>(i); };
 
-    return Mesh(vertices, indices, textures);
+    // only the cpu copy is converted to Vertex, and only as much of it as the residency keeps
+    MeshCpuGeometry& cpuGeometry = meshData.cpuGeometry;
+    cpuGeometry.residency        = residency;
+    if(residency == GEOMETRY_RESIDENCY_FULL)
+    {
+        cpuGeometry.vertices.resize(geometry.vertexCount);
+        for(size_t i = 0; i < geometry.vertexCount; i++)
+        {
+            Vertex& vertex   = cpuGeometry.vertices[i];
+            vertex.position  = glm::vec3(positions.read(i));
+            vertex.normal    = normals.data ? glm::vec3(normals.read(i)) : glm::vec3(0.0f);
+            vertex.texCoords = texCoords.data ? glm::vec2(texCoords.read(i)) : glm::vec2(0.0f);
+        }
+    }
+    else if(residency == GEOMETRY_RESIDENCY_POSITIONS)
+    {
+        cpuGeometry.positions.resize(geometry.vertexCount);
+        for(size_t i = 0; i < geometry.vertexCount; i++)
+        {
+            cpuGeometry.positions[i] = glm::vec3(positions.read(i));
+        }
+    }
+    if(residency != GEOMETRY_RESIDENCY_NONE)
+    {
+        cpuGeometry.indices.resize(geometry.indexCount);
+        for(size_t i = 0; i < geometry.indexCount; i++)
+        {
+            cpuGeometry.indices[i] = index(i);
+        }
+    }
+
+    // float positions come with their bounds, the vertices are only walked without them. the
+    // density is measured on evenly spread triangles
+    bool   hasBounds     = positions.hasBounds && positions.componentType == GL_FLOAT;
+    size_t triangleCount = geometry.indexCount / 3;
+    size_t step          = std::max<size_t>(triangleCount / GLTF_DENSITY_SAMPLES, 1);
+    measureGeometry(
+        hasBounds ? 0 : geometry.vertexCount,
+        triangleCount / step,
+        texCoords.data != nullptr,
+        [&positions](size_t i) { return glm::vec3(positions.read(i)); },
+        [&texCoords](size_t i) { return glm::vec2(texCoords.read(i)); },
+        [&index, step](size_t i, unsigned int* corners) {
+            for(size_t j = 0; j < 3; j++)
+            {
+                corners[j] = index(i * step * 3 + j);
+            }
+            return true;
+        },
+        geometry);
+    if(hasBounds)
+    {
+        geometry.boundsCenter = (positions.min + positions.max) * 0.5f;
+        geometry.boundsRadius = glm::length(positions.max - positions.min) * 0.5f;
+    }
+}
+
+bool Model::processMesh(aiMesh* mesh, const aiScene* scene, const std::string& directory, bool isStreamed, GeometryResidency residency, ModelData& data, ModelData::MeshData& meshData)
+{
+    processGeometry(mesh, residency, data, meshData);
+
+    // material
+    if(mesh->mMaterialIndex >= 0)
+    {
+        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
+        for(aiTextureType type : {aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_AMBIENT})
+        {
+            if(!loadMaterialTextures(material, type, directory, isStreamed, data, meshData))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
 }
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial* material, aiTextureType* type, std::string typeName)
+
+bool Model::loadMaterialTextures(aiMaterial* material, aiTextureType type, const std::string& directory, bool isStreamed, ModelData& data, ModelData::MeshData& meshData)
 {
-    std::vector<Texture> textures;
-    for(size_t i = 0; i < material->GetTextureCount(*type); i++)
+    for(size_t i = 0; i < material->GetTextureCount(type); i++)
     {
         aiString str;
-        material->GetTexture(*type, i, &str);
+        material->GetTexture(type, i, &str);
         TextureType textureType;
-        switch(*type)
+        switch(type)
         {
         case aiTextureType_DIFFUSE:
             textureType = TextureType::TEXTURE_DIFFUSE;
@@ -126,21 +813,36 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial* material, aiTexture
             textureType = TextureType::TEXTURE_AMBIENT;
             break;
         default:
-            GL_LOG_E("don't support texture %d yet", *type);
+            GL_LOG_E("don't support texture %d yet", type);
             std::abort();
         }
 
-        std::string fullPath      = m_directory + "/" + std::string(str.C_Str());
-        auto        loadedTexture = std::find_if(m_loadedTextures.begin(), m_loadedTextures.end(), [&fullPath](Texture& texture) { return texture.path() == fullPath; });
-        if(loadedTexture == m_loadedTextures.end())
-        {
-            textures.emplace_back(fullPath, textureType, false);
-            m_loadedTextures.push_back(textures.back());
-        }
-        else
+        if(!loadTexture(directory + "/" + std::string(str.C_Str()), textureType, isStreamed, data, meshData))
         {
-            textures.push_back(*loadedTexture);
+            return false;
         }
     }
-    return textures;
-}
\ No newline at end of file
+    return true;
+}
+
+bool Model::loadTexture(const std::string& path, TextureType type, bool isStreamed, ModelData& data, ModelData::MeshData& meshData, const unsigned char* bytes, size_t size)
+{
+    auto loadedTexture = std::find_if(data.textures.begin(), data.textures.end(), [&path](const ModelData::TextureData& texture) { return texture.image.path == path; });
+    if(loadedTexture != data.textures.end())
+    {
+        meshData.textures.push_back(loadedTexture - data.textures.begin());
+        return true;
+    }
+    ModelData::TextureData texture;
+    texture.type               = type;
+    texture.options            = TextureOptions::forType(type);
+    texture.options.isStreamed = isStreamed;
+    bool isLoaded = bytes ? Texture::load(path, bytes, size, false, texture.options, texture.image) : Texture::load(path, false, texture.options, texture.image);
+    if(!isLoaded)
+    {
+        return false;
+    }
+    data.textures.push_back(std::move(texture));
+    meshData.textures.push_back(data.textures.size() - 1);
+    return true;
+}
@@ -0,0 +1,680 @@
+#include "objLoader.h"
+#include "log.h"
+#include "packFile.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+// smaller chunks aren't worth a thread
+static const size_t MIN_CHUNK_BYTES = 256 * 1024;
+// more chunks than threads, a chunk of long face lines doesn't hold up the others
+static const size_t CHUNKS_PER_THREAD = 4;
+
+// exactly representable, a mantissa below 2^53 times or over one of these is correctly rounded
+static const double POWERS_OF_TEN[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                       1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+// the same for a mantissa below 2^24 in float, 5^10 is the last power of five that fits its 24 bits
+static const float FLOAT_POWERS_OF_TEN[] = {1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f};
+// the 29 bits a double carries below a float's mantissa, set to exactly half a float ulp
+static const uint64_t FLOAT_HALFWAY_MASK = (1ull << 29) - 1;
+static const uint64_t FLOAT_HALFWAY      = 1ull << 28;
+
+struct ObjStatement
+{
+    enum Kind
+    {
+        GROUP = 0, // o or g
+        MATERIAL,
+        LIBRARY,
+    };
+
+    Kind        kind;
+    size_t      triangle; // triangles of the chunk before it
+    std::string value;
+};
+
+struct ObjChunk
+{
+    const char* begin = nullptr;
+    const char* end   = nullptr;
+
+    // vertex statements in the chunk, and in the chunks before it
+    size_t positionCount = 0;
+    size_t texCoordCount = 0;
+    size_t normalCount   = 0;
+    size_t faceCount     = 0;
+    size_t positionBase  = 0;
+    size_t texCoordBase  = 0;
+    size_t normalBase    = 0;
+
+    std::vector<ObjIndex>     corners; // three per triangle
+    std::vector<ObjStatement> statements;
+    const char*               error = nullptr; // start of the first line that couldn't be parsed
+};
+
+// runs of triangles of the chunks that make up one mesh
+struct ObjSpan
+{
+    size_t chunk;
+    size_t begin;
+    size_t end;
+};
+
+struct ObjMeshSpans
+{
+    std::string          name;
+    std::string          material;
+    std::vector<ObjSpan> spans;
+    size_t               triangleCount = 0;
+};
+
+static inline bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool isDigit(char c)
+{
+    return static_cast<unsigned char>(c - '0') < 10;
+}
+
+static inline const char* skipSpace(const char* p, const char* end)
+{
+    while(p < end && isSpace(*p))
+    {
+        p++;
+    }
+    return p;
+}
+
+static inline const char* lineEnd(const char* p, const char* end)
+{
+    const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+    return newline ? newline : end;
+}
+
+// keyword at p followed by a space or the end of the line
+static inline bool isKeyword(const char* p, const char* end, const char* keyword, size_t length)
+{
+    return static_cast<size_t>(end - p) >= length && memcmp(p, keyword, length) == 0 && (p + length == end || isSpace(p[length]));
+}
+
+// the rest of the line without the spaces around it
+static std::string restOfLine(const char* p, const char* end)
+{
+    p = skipSpace(p, end);
+    while(end > p && isSpace(end[-1]))
+    {
+        end--;
+    }
+    return std::string(p, end);
+}
+
+// decimal floats of up to 19 digits and small exponents, everything assets are written with, are
+// parsed without strtod. anything else, like inf or long mantissas, goes through it
+static const char* parseFloat(const char* p, const char* end, float& value)
+{
+    const char* start    = p;
+    bool        negative = false;
+    if(p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+    // digits past the 19th overflow the mantissa, such numbers take the slow path below
+    uint64_t    mantissa = 0;
+    const char* digits   = p;
+    for(; p < end && isDigit(*p); p++)
+    {
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+    int exponent = 0;
+    if(p < end && *p == '.')
+    {
+        const char* fraction = ++p;
+        for(; p < end && isDigit(*p); p++)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+        exponent = -static_cast<int>(p - fraction);
+        digits++; // the point isn't a digit
+    }
+    int  digitCount = static_cast<int>(p - digits);
+    bool truncated  = digitCount > 19;
+    if(digitCount > 0 && p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char* e           = p + 1;
+        bool        negativeExp = false;
+        if(e < end && (*e == '-' || *e == '+'))
+        {
+            negativeExp = *e == '-';
+            e++;
+        }
+        int written = 0;
+        for(; e < end && isDigit(*e) && written < 10000; e++)
+        {
+            written = written * 10 + (*e - '0');
+        }
+        if(e > p + 1 && isDigit(e[-1]))
+        {
+            exponent += negativeExp ? -written : written;
+            p = e;
+        }
+    }
+    bool isFast = digitCount > 0 && (p == end || isSpace(*p) || *p == '#') && !truncated;
+    if(isFast && mantissa < (1ull << 24) && exponent >= -10 && exponent <= 10)
+    {
+        // both operands are exact floats, so the one float operation rounds once
+        float result = static_cast<float>(mantissa);
+        result       = exponent < 0 ? result / FLOAT_POWERS_OF_TEN[-exponent] : result * FLOAT_POWERS_OF_TEN[exponent];
+        value        = negative ? -result : result;
+        return p;
+    }
+    if(isFast && mantissa < (1ull << 53) && exponent >= -22 && exponent <= 22)
+    {
+        // rounded once to double. narrowing rounds again, which only goes wrong when the double
+        // lands exactly halfway between two floats, those take the slow path
+        double result = static_cast<double>(mantissa);
+        result        = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+        uint64_t bits;
+        memcpy(&bits, &result, sizeof(bits));
+        if((bits & FLOAT_HALFWAY_MASK) != FLOAT_HALFWAY)
+        {
+            value = static_cast<float>(negative ? -result : result);
+            return p;
+        }
+    }
+
+    // the mapping isn't terminated, strtod gets a copy of the token
+    const char* tokenEnd = start;
+    while(tokenEnd < end && !isSpace(*tokenEnd))
+    {
+        tokenEnd++;
+    }
+    char token[64];
+    if(tokenEnd == start || static_cast<size_t>(tokenEnd - start) >= sizeof(token))
+    {
+        return nullptr;
+    }
+    memcpy(token, start, tokenEnd - start);
+    token[tokenEnd - start] = '\0';
+    char* parsed;
+    value = strtof(token, &parsed);
+    return parsed == token + (tokenEnd - start) ? tokenEnd : nullptr;
+}
+
+static inline const char* parseInt(const char* p, const char* end, int& value)
+{
+    bool negative = false;
+    if(p < end && *p == '-')
+    {
+        negative = true;
+        p++;
+    }
+    const char* digits = p;
+    int64_t     result = 0;
+    for(; p < end && isDigit(*p) && result < INT32_MAX; p++)
+    {
+        result = result * 10 + (*p - '0');
+    }
+    if(p == digits || result >= INT32_MAX)
+    {
+        return nullptr;
+    }
+    value = static_cast<int>(negative ? -result : result);
+    return p;
+}
+
+// one based, or back from the last one defined so far when negative. -1 if out of range
+static inline int resolveIndex(int index, size_t defined, size_t total)
+{
+    int64_t resolved = index > 0 ? static_cast<int64_t>(index) - 1 : static_cast<int64_t>(defined) + index;
+    return index != 0 && resolved >= 0 && resolved < static_cast<int64_t>(total) ? static_cast<int>(resolved) : -1;
+}
+
+enum ObjVertexKind
+{
+    OBJ_VERTEX_NONE = 0,
+    OBJ_VERTEX_POSITION,
+    OBJ_VERTEX_TEXCOORD,
+    OBJ_VERTEX_NORMAL,
+};
+
+// the counting and the parsing pass have to agree on this, the parsed vertices go where the counts say
+static inline ObjVertexKind vertexKind(const char* p, const char* end)
+{
+    if(end - p < 2 || p[0] != 'v')
+    {
+        return OBJ_VERTEX_NONE;
+    }
+    if(isKeyword(p, end, "v", 1))
+    {
+        return OBJ_VERTEX_POSITION;
+    }
+    if(isKeyword(p, end, "vt", 2))
+    {
+        return OBJ_VERTEX_TEXCOORD;
+    }
+    return isKeyword(p, end, "vn", 2) ? OBJ_VERTEX_NORMAL : OBJ_VERTEX_NONE;
+}
+
+static void countChunk(ObjChunk& chunk)
+{
+    for(const char* p = chunk.begin; p < chunk.end;)
+    {
+        const char* end   = lineEnd(p, chunk.end);
+        const char* start = skipSpace(p, end);
+        chunk.faceCount += isKeyword(start, end, "f", 1);
+        switch(vertexKind(start, end))
+        {
+        case OBJ_VERTEX_POSITION:
+            chunk.positionCount++;
+            break;
+        case OBJ_VERTEX_TEXCOORD:
+            chunk.texCoordCount++;
+            break;
+        case OBJ_VERTEX_NORMAL:
+            chunk.normalCount++;
+            break;
+        default:
+            break;
+        }
+        p = end + 1;
+    }
+}
+
+static void parseChunk(ObjChunk& chunk, ObjScene& scene)
+{
+    size_t positionCount = 0;
+    size_t texCoordCount = 0;
+    size_t normalCount   = 0;
+    // exact for triangles, polygons grow it
+    chunk.corners.reserve(chunk.faceCount * 3);
+    for(const char* line = chunk.begin; line < chunk.end;)
+    {
+        const char* end = lineEnd(line, chunk.end);
+        const char*   p    = skipSpace(line, end);
+        ObjVertexKind kind = vertexKind(p, end);
+        bool          ok   = true;
+        if(kind == OBJ_VERTEX_POSITION)
+        {
+            glm::vec3& position = scene.positions[chunk.positionBase + positionCount++];
+            for(int i = 0; i < 3 && ok; i++)
+            {
+                p  = parseFloat(skipSpace(p + (i == 0 ? 1 : 0), end), end, position[i]);
+                ok = p != nullptr;
+            }
+        }
+        else if(kind == OBJ_VERTEX_TEXCOORD)
+        {
+            // v is optional, a third coordinate is ignored
+            glm::vec2 texCoord(0.0f);
+            p  = parseFloat(skipSpace(p + 2, end), end, texCoord.x);
+            ok = p != nullptr;
+            if(ok && (p = skipSpace(p, end)) < end && *p != '#')
+            {
+                p  = parseFloat(p, end, texCoord.y);
+                ok = p != nullptr;
+            }
+            scene.texCoords[chunk.texCoordBase + texCoordCount++] = glm::vec2(texCoord.x, 1.0f - texCoord.y);
+        }
+        else if(kind == OBJ_VERTEX_NORMAL)
+        {
+            glm::vec3& normal = scene.normals[chunk.normalBase + normalCount++];
+            for(int i = 0; i < 3 && ok; i++)
+            {
+                p  = parseFloat(skipSpace(p + (i == 0 ? 2 : 0), end), end, normal[i]);
+                ok = p != nullptr;
+            }
+        }
+        else if(isKeyword(p, end, "f", 1))
+        {
+            // a fan over the corners, polygons are convex in practice
+            ObjIndex first;
+            ObjIndex previous;
+            int      cornerCount = 0;
+            p                    = skipSpace(p + 1, end);
+            while(ok && p < end && *p != '#')
+            {
+                ObjIndex corner;
+                int      index;
+                p               = parseInt(p, end, index);
+                corner.position = p ? resolveIndex(index, chunk.positionBase + positionCount, scene.positions.size()) : -1;
+                ok              = corner.position >= 0;
+                if(ok && p < end && *p == '/')
+                {
+                    p++;
+                    if(p < end && *p != '/')
+                    {
+                        p               = parseInt(p, end, index);
+                        corner.texCoord = p ? resolveIndex(index, chunk.texCoordBase + texCoordCount, scene.texCoords.size()) : -1;
+                        ok              = corner.texCoord >= 0;
+                    }
+                    if(ok && p < end && *p == '/')
+                    {
+                        p             = parseInt(p + 1, end, index);
+                        corner.normal = p ? resolveIndex(index, chunk.normalBase + normalCount, scene.normals.size()) : -1;
+                        ok            = corner.normal >= 0;
+                    }
+                }
+                ok = ok && (p == end || isSpace(*p));
+                if(!ok)
+                {
+                    break;
+                }
+                if(cornerCount >= 2)
+                {
+                    chunk.corners.push_back(first);
+                    chunk.corners.push_back(previous);
+                    chunk.corners.push_back(corner);
+                }
+                first    = cornerCount == 0 ? corner : first;
+                previous = corner;
+                cornerCount++;
+                p = skipSpace(p, end);
+            }
+            ok = ok && cornerCount >= 3;
+        }
+        else if(isKeyword(p, end, "o", 1) || isKeyword(p, end, "g", 1))
+        {
+            chunk.statements.push_back({ObjStatement::GROUP, chunk.corners.size() / 3, restOfLine(p + 1, end)});
+        }
+        else if(isKeyword(p, end, "usemtl", 6))
+        {
+            chunk.statements.push_back({ObjStatement::MATERIAL, chunk.corners.size() / 3, restOfLine(p + 6, end)});
+        }
+        else if(isKeyword(p, end, "mtllib", 6))
+        {
+            chunk.statements.push_back({ObjStatement::LIBRARY, chunk.corners.size() / 3, restOfLine(p + 6, end)});
+        }
+        // comments, smoothing groups, lines and points are skipped
+
+        if(!ok)
+        {
+            chunk.error = line;
+            return;
+        }
+        line = end + 1;
+    }
+}
+
+static std::string directoryOf(const std::string& path)
+{
+    size_t slash = path.find_last_of('/');
+    return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+// newmtl and the texture maps Model loads. map options come before the file name, the last token is taken
+static void loadMaterials(const std::string& path, std::vector<ObjMaterial>& materials)
+{
+    FileData file;
+    if(!PackFile::load(path, file))
+    {
+        GL_LOG_W("can't read material library %s, its materials have no textures", path.c_str());
+        return;
+    }
+    const char* data = reinterpret_cast<const char*>(file.data);
+    for(const char* p = data; p < data + file.size;)
+    {
+        const char* end = lineEnd(p, data + file.size);
+        p               = skipSpace(p, end);
+        std::string* map = nullptr;
+        if(isKeyword(p, end, "newmtl", 6))
+        {
+            materials.push_back({});
+            materials.back().name = restOfLine(p + 6, end);
+        }
+        else if(!materials.empty() && isKeyword(p, end, "map_Kd", 6))
+        {
+            map = &materials.back().diffuseMap;
+        }
+        else if(!materials.empty() && isKeyword(p, end, "map_Ks", 6))
+        {
+            map = &materials.back().specularMap;
+        }
+        else if(!materials.empty() && isKeyword(p, end, "map_Ka", 6))
+        {
+            map = &materials.back().ambientMap;
+        }
+        if(map)
+        {
+            std::string value = restOfLine(p + 6, end);
+            size_t      space = value.find_last_of(" \t");
+            *map              = space == std::string::npos ? value : value.substr(space + 1);
+        }
+        p = end + 1;
+    }
+}
+
+// every distinct corner of the mesh becomes one vertex. corners sharing a position are chained off
+// it, and usually there are only a few of them
+static void buildMesh(const std::vector<ObjChunk>& chunks, const ObjMeshSpans& spans, ObjMesh& mesh)
+{
+    int minPosition = INT32_MAX;
+    int maxPosition = -1;
+    for(const auto& span : spans.spans)
+    {
+        const std::vector<ObjIndex>& corners = chunks[span.chunk].corners;
+        for(size_t i = span.begin * 3; i < span.end * 3; i++)
+        {
+            minPosition = std::min(minPosition, corners[i].position);
+            maxPosition = std::max(maxPosition, corners[i].position);
+        }
+    }
+    std::vector<int> heads(maxPosition - minPosition + 1, -1);
+    std::vector<int> next;
+    mesh.indices.reserve(spans.triangleCount * 3);
+    for(const auto& span : spans.spans)
+    {
+        const std::vector<ObjIndex>& corners = chunks[span.chunk].corners;
+        for(size_t i = span.begin * 3; i < span.end * 3; i++)
+        {
+            const ObjIndex& corner = corners[i];
+            int&            head   = heads[corner.position - minPosition];
+            int             vertex = head;
+            while(vertex >= 0 && (mesh.vertices[vertex].texCoord != corner.texCoord || mesh.vertices[vertex].normal != corner.normal))
+            {
+                vertex = next[vertex];
+            }
+            if(vertex < 0)
+            {
+                vertex = static_cast<int>(mesh.vertices.size());
+                mesh.vertices.push_back(corner);
+                next.push_back(head);
+                head = vertex;
+                mesh.hasTexCoords |= corner.texCoord >= 0;
+            }
+            mesh.indices.push_back(vertex);
+        }
+    }
+}
+
+bool ObjLoader::isObj(const std::string& path)
+{
+    size_t dot = path.find_last_of('.');
+    if(dot == std::string::npos || path.size() - dot != 4)
+    {
+        return false;
+    }
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+    return extension == "obj";
+}
+
+bool ObjLoader::load(const std::string& path, ObjScene& scene)
+{
+    auto    start = std::chrono::steady_clock::now();
+    MappedFile file(path);
+    if(!file.isOpen())
+    {
+        GL_LOG_E("can't read obj %s", path.c_str());
+        return false;
+    }
+
+    // cut at line ends
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunkCount  = std::max<size_t>(1, std::min(file.size() / MIN_CHUNK_BYTES, threadCount * CHUNKS_PER_THREAD));
+    const char*           data = reinterpret_cast<const char*>(file.data());
+    const char*           end  = data + file.size();
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char*           begin = data;
+    for(size_t i = 0; i < chunkCount; i++)
+    {
+        const char* cut = i + 1 == chunkCount ? end : data + file.size() * (i + 1) / chunkCount;
+        if(cut < begin)
+        {
+            cut = begin;
+        }
+        const char* newline = cut < end ? lineEnd(cut, end) : end;
+        chunks[i].begin     = begin;
+        chunks[i].end       = newline < end ? newline + 1 : end;
+        begin               = chunks[i].end;
+    }
+
+    // counted first, so every chunk knows where its vertices go and what negative indices refer to
+    parallelFor(static_cast<int>(chunkCount), 1, 1, [&](int first, int last) {
+        for(int i = first; i < last; i++)
+        {
+            countChunk(chunks[i]);
+        }
+    });
+    size_t positionCount = 0;
+    size_t texCoordCount = 0;
+    size_t normalCount   = 0;
+    for(auto& chunk : chunks)
+    {
+        chunk.positionBase = positionCount;
+        chunk.texCoordBase = texCoordCount;
+        chunk.normalBase   = normalCount;
+        positionCount += chunk.positionCount;
+        texCoordCount += chunk.texCoordCount;
+        normalCount += chunk.normalCount;
+    }
+    if(positionCount > INT32_MAX || texCoordCount > INT32_MAX || normalCount > INT32_MAX)
+    {
+        GL_LOG_E("obj %s has more vertices than fit an index", path.c_str());
+        return false;
+    }
+    scene.positions.resize(positionCount);
+    scene.texCoords.resize(texCoordCount);
+    scene.normals.resize(normalCount);
+    parallelFor(static_cast<int>(chunkCount), 1, 1, [&](int first, int last) {
+        for(int i = first; i < last; i++)
+        {
+            parseChunk(chunks[i], scene);
+        }
+    });
+    for(const auto& chunk : chunks)
+    {
+        if(chunk.error)
+        {
+            size_t      line      = std::count(data, chunk.error, '\n') + 1;
+            const char* errorEnd  = lineEnd(chunk.error, end);
+            int         errorSize = static_cast<int>(std::min<size_t>(errorEnd - chunk.error, 80));
+            GL_LOG_E("obj %s line %zu: can't parse \"%.*s\"", path.c_str(), line, errorSize, chunk.error);
+            return false;
+        }
+    }
+
+    // a new mesh starts at every object or group and material change that has triangles after it
+    std::vector<ObjMeshSpans> meshSpans(1);
+    std::vector<std::string>  libraries;
+    for(size_t c = 0; c < chunks.size(); c++)
+    {
+        size_t triangle = 0;
+        auto   addSpan  = [&](size_t spanEnd) {
+            if(spanEnd > triangle)
+            {
+                meshSpans.back().spans.push_back({c, triangle, spanEnd});
+                meshSpans.back().triangleCount += spanEnd - triangle;
+            }
+            triangle = spanEnd;
+        };
+        for(const auto& statement : chunks[c].statements)
+        {
+            addSpan(statement.triangle);
+            if(statement.kind == ObjStatement::LIBRARY)
+            {
+                libraries.push_back(statement.value);
+                continue;
+            }
+            if(statement.kind == ObjStatement::MATERIAL && statement.value == meshSpans.back().material)
+            {
+                continue;
+            }
+            if(meshSpans.back().triangleCount > 0)
+            {
+                meshSpans.push_back({meshSpans.back().name, meshSpans.back().material, {}, 0});
+            }
+            (statement.kind == ObjStatement::GROUP ? meshSpans.back().name : meshSpans.back().material) = statement.value;
+        }
+        addSpan(chunks[c].corners.size() / 3);
+    }
+    if(meshSpans.back().triangleCount == 0)
+    {
+        meshSpans.pop_back();
+    }
+
+    std::string directory = directoryOf(path);
+    for(const auto& library : libraries)
+    {
+        // a library line can name several files
+        size_t first = 0;
+        while((first = library.find_first_not_of(" \t", first)) != std::string::npos)
+        {
+            size_t last = library.find_first_of(" \t", first);
+            loadMaterials(directory + "/" + library.substr(first, last - first), scene.materials);
+            first = last;
+        }
+    }
+    std::unordered_map<std::string, int> materialIndices;
+    for(size_t i = 0; i < scene.materials.size(); i++)
+    {
+        materialIndices.emplace(scene.materials[i].name, static_cast<int>(i));
+    }
+
+    scene.meshes.resize(meshSpans.size());
+    for(size_t i = 0; i < meshSpans.size(); i++)
+    {
+        scene.meshes[i].name = meshSpans[i].name;
+        auto material        = materialIndices.find(meshSpans[i].material);
+        if(material != materialIndices.end())
+        {
+            scene.meshes[i].material = material->second;
+        }
+        else if(!meshSpans[i].material.empty())
+        {
+            GL_LOG_W("obj %s uses material %s that no library defines", path.c_str(), meshSpans[i].material.c_str());
+        }
+    }
+    parallelFor(static_cast<int>(meshSpans.size()), 1, 1, [&](int first, int last) {
+        for(int i = first; i < last; i++)
+        {
+            buildMesh(chunks, meshSpans[i], scene.meshes[i]);
+        }
+    });
+
+    size_t vertexCount   = 0;
+    size_t triangleCount = 0;
+    for(const auto& mesh : scene.meshes)
+    {
+        vertexCount += mesh.vertices.size();
+        triangleCount += mesh.indices.size() / 3;
+    }
+    auto stop = std::chrono::steady_clock::now();
+    GL_LOG_I("parse obj %s: %.2f MB in %zu chunks, %zu meshes %zu vertices %zu triangles, %.1f ms",
+             path.c_str(),
+             file.size() / (1024.0 * 1024.0),
+             chunkCount,
+             scene.meshes.size(),
+             vertexCount,
+             triangleCount,
+             std::chrono::duration<double, std::milli>(stop - start).count());
+    return true;
+}
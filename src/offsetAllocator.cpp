@@ -0,0 +1,260 @@
+#include "offsetAllocator.h"
+#include "log.h"
+#include <cstdlib>
+
+static const uint32_t MANTISSA_BITS  = 3;
+static const uint32_t MANTISSA_VALUE = 1 << MANTISSA_BITS;
+static const uint32_t MANTISSA_MASK  = MANTISSA_VALUE - 1;
+static const uint32_t LEAF_BINS      = 8;
+static const uint32_t UNUSED         = 0xffffffff;
+
+static uint32_t highestBit(uint32_t value)
+{
+    return 31 - __builtin_clz(value);
+}
+
+// lowest set bit at or above startBit, UNUSED if there is none
+static uint32_t lowestBitFrom(uint32_t mask, uint32_t startBit)
+{
+    if(startBit >= 32)
+    {
+        return UNUSED;
+    }
+    mask &= ~((1u << startBit) - 1);
+    return mask ? __builtin_ctz(mask) : UNUSED;
+}
+
+// bin of a size as a tiny float: exponent above, 3 mantissa bits below, exact up to 8. allocations
+// round up so any region in the bin fits, free regions round down so they never claim more
+static uint32_t binRoundUp(uint32_t size)
+{
+    if(size < MANTISSA_VALUE)
+    {
+        return size;
+    }
+    uint32_t mantissaStart = highestBit(size) - MANTISSA_BITS;
+    uint32_t bin           = ((mantissaStart + 1) << MANTISSA_BITS) + ((size >> mantissaStart) & MANTISSA_MASK);
+    // a mantissa overflow carries into the exponent, which is the next bin as it should be
+    return (size & ((1u << mantissaStart) - 1)) ? bin + 1 : bin;
+}
+
+static uint32_t binRoundDown(uint32_t size)
+{
+    if(size < MANTISSA_VALUE)
+    {
+        return size;
+    }
+    uint32_t mantissaStart = highestBit(size) - MANTISSA_BITS;
+    return ((mantissaStart + 1) << MANTISSA_BITS) + ((size >> mantissaStart) & MANTISSA_MASK);
+}
+
+static uint32_t binSize(uint32_t bin)
+{
+    uint32_t exponent = bin >> MANTISSA_BITS;
+    uint32_t mantissa = bin & MANTISSA_MASK;
+    return exponent == 0 ? mantissa : (mantissa | MANTISSA_VALUE) << (exponent - 1);
+}
+
+OffsetAllocator::OffsetAllocator(uint32_t size)
+    : m_size(size)
+{
+    reset();
+}
+
+void OffsetAllocator::reset()
+{
+    m_freeSize    = 0;
+    m_usedTopBins = 0;
+    for(auto& leafBins : m_usedLeafBins)
+    {
+        leafBins = 0;
+    }
+    for(auto& head : m_binHeads)
+    {
+        head = UNUSED;
+    }
+    m_nodes.clear();
+    m_freeNodes.clear();
+    if(m_size > 0)
+    {
+        insertIntoBin(m_size, 0);
+    }
+}
+
+uint32_t OffsetAllocator::newNode()
+{
+    if(!m_freeNodes.empty())
+    {
+        uint32_t node = m_freeNodes.back();
+        m_freeNodes.pop_back();
+        return node;
+    }
+    m_nodes.push_back(Node());
+    return static_cast<uint32_t>(m_nodes.size() - 1);
+}
+
+uint32_t OffsetAllocator::insertIntoBin(uint32_t size, uint32_t offset)
+{
+    uint32_t bin  = binRoundDown(size);
+    uint32_t top  = bin / LEAF_BINS;
+    uint32_t leaf = bin % LEAF_BINS;
+    if(m_binHeads[bin] == UNUSED)
+    {
+        m_usedLeafBins[top] |= 1 << leaf;
+        m_usedTopBins |= 1u << top;
+    }
+
+    uint32_t index = newNode();
+    Node&    node  = m_nodes[index];
+    node           = {offset, size, UNUSED, m_binHeads[bin], UNUSED, UNUSED, false};
+    if(node.binNext != UNUSED)
+    {
+        m_nodes[node.binNext].binPrev = index;
+    }
+    m_binHeads[bin] = index;
+    m_freeSize += size;
+    return index;
+}
+
+void OffsetAllocator::removeFromBin(uint32_t index)
+{
+    Node& node = m_nodes[index];
+    if(node.binPrev != UNUSED)
+    {
+        m_nodes[node.binPrev].binNext = node.binNext;
+        if(node.binNext != UNUSED)
+        {
+            m_nodes[node.binNext].binPrev = node.binPrev;
+        }
+    }
+    else
+    {
+        // head of its bin
+        uint32_t bin    = binRoundDown(node.size);
+        uint32_t top    = bin / LEAF_BINS;
+        uint32_t leaf   = bin % LEAF_BINS;
+        m_binHeads[bin] = node.binNext;
+        if(node.binNext != UNUSED)
+        {
+            m_nodes[node.binNext].binPrev = UNUSED;
+        }
+        else
+        {
+            m_usedLeafBins[top] &= ~(1 << leaf);
+            if(m_usedLeafBins[top] == 0)
+            {
+                m_usedTopBins &= ~(1u << top);
+            }
+        }
+    }
+    m_freeNodes.push_back(index);
+    m_freeSize -= node.size;
+}
+
+OffsetAllocator::Allocation OffsetAllocator::allocate(uint32_t size)
+{
+    Allocation allocation;
+    if(size == 0 || size > m_freeSize)
+    {
+        return allocation;
+    }
+
+    // the smallest bin that surely fits, in the same top bin first, then in any bigger one
+    uint32_t minBin = binRoundUp(size);
+    uint32_t minTop = minBin / LEAF_BINS;
+    uint32_t top    = minTop;
+    uint32_t leaf   = UNUSED;
+    if(minTop < 32 && (m_usedTopBins & (1u << minTop)))
+    {
+        leaf = lowestBitFrom(m_usedLeafBins[minTop], minBin % LEAF_BINS);
+    }
+    if(leaf == UNUSED)
+    {
+        top = lowestBitFrom(m_usedTopBins, minTop + 1);
+        if(top == UNUSED)
+        {
+            return allocation;
+        }
+        leaf = __builtin_ctz(m_usedLeafBins[top]);
+    }
+
+    uint32_t index  = m_binHeads[top * LEAF_BINS + leaf];
+    uint32_t total  = m_nodes[index].size;
+    uint32_t offset = m_nodes[index].offset;
+    removeFromBin(index);
+    // removeFromBin recycled the node, take it back as the used one
+    m_freeNodes.pop_back();
+
+    m_nodes[index].size   = size;
+    m_nodes[index].isUsed = true;
+    if(total > size)
+    {
+        // the rest goes back as a free neighbour
+        uint32_t remainder = insertIntoBin(total - size, offset + size);
+        Node&    rest      = m_nodes[remainder];
+        rest.neighborPrev  = index;
+        rest.neighborNext  = m_nodes[index].neighborNext;
+        if(rest.neighborNext != UNUSED)
+        {
+            m_nodes[rest.neighborNext].neighborPrev = remainder;
+        }
+        m_nodes[index].neighborNext = remainder;
+    }
+    allocation.offset = offset;
+    allocation.node   = index;
+    return allocation;
+}
+
+void OffsetAllocator::free(Allocation allocation)
+{
+    if(allocation.node == NO_SPACE || allocation.node >= m_nodes.size() || !m_nodes[allocation.node].isUsed)
+    {
+        GL_LOG_E("free of an allocation this allocator doesn't own, offset %u", allocation.offset);
+        std::abort();
+    }
+
+    Node     node   = m_nodes[allocation.node];
+    uint32_t offset = node.offset;
+    uint32_t size   = node.size;
+    if(node.neighborPrev != UNUSED && !m_nodes[node.neighborPrev].isUsed)
+    {
+        const Node& prev  = m_nodes[node.neighborPrev];
+        offset            = prev.offset;
+        size             += prev.size;
+        uint32_t prevPrev = prev.neighborPrev;
+        removeFromBin(node.neighborPrev);
+        node.neighborPrev = prevPrev;
+    }
+    if(node.neighborNext != UNUSED && !m_nodes[node.neighborNext].isUsed)
+    {
+        const Node& next  = m_nodes[node.neighborNext];
+        size             += next.size;
+        uint32_t nextNext = next.neighborNext;
+        removeFromBin(node.neighborNext);
+        node.neighborNext = nextNext;
+    }
+    m_freeNodes.push_back(allocation.node);
+
+    uint32_t merged              = insertIntoBin(size, offset);
+    m_nodes[merged].neighborPrev = node.neighborPrev;
+    m_nodes[merged].neighborNext = node.neighborNext;
+    if(node.neighborPrev != UNUSED)
+    {
+        m_nodes[node.neighborPrev].neighborNext = merged;
+    }
+    if(node.neighborNext != UNUSED)
+    {
+        m_nodes[node.neighborNext].neighborPrev = merged;
+    }
+}
+
+uint32_t OffsetAllocator::largestFreeRegion() const
+{
+    if(m_usedTopBins == 0)
+    {
+        return 0;
+    }
+    uint32_t top  = highestBit(m_usedTopBins);
+    uint32_t leaf = highestBit(m_usedLeafBins[top]);
+    return binSize(top * LEAF_BINS + leaf);
+}
@@ -0,0 +1,432 @@
+#include "packFile.h"
+#include "log.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <zlib.h>
+#ifdef __linux__
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+static_assert(sizeof(PackHeader) == 32, "pack header layout");
+static_assert(sizeof(PackEntry) == 48, "pack entry layout");
+
+static const char PACK_MAGIC[4] = {'P', 'A', 'C', 'K'};
+
+std::vector<std::pair<std::string, std::unique_ptr<PackFile>>> PackFile::s_mounts;
+
+// absolute, so the same file reached through different relative paths finds the same entry
+static std::string normalize(const std::string& path)
+{
+    std::error_code error;
+    std::string     normal = std::filesystem::absolute(path, error).lexically_normal().generic_string();
+    while(normal.size() > 1 && normal.back() == '/')
+    {
+        normal.pop_back();
+    }
+    return normal;
+}
+
+static bool readDisk(const std::string& path, std::vector<unsigned char>& data)
+{
+    std::ifstream ifs(path, std::ios::binary | std::ios::ate);
+    if(!ifs)
+    {
+        return false;
+    }
+    data.resize(static_cast<size_t>(ifs.tellg()));
+    ifs.seekg(0);
+    return static_cast<bool>(ifs.read(reinterpret_cast<char*>(data.data()), data.size()));
+}
+
+PackFile::PackFile(const std::string& path)
+    : m_path(path)
+{
+#ifdef __linux__
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0)
+    {
+        return;
+    }
+    struct stat info;
+    if(fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping != MAP_FAILED)
+        {
+            m_data = static_cast<const unsigned char*>(mapping);
+            m_size = info.st_size;
+        }
+    }
+    // the mapping keeps the file alive
+    close(fd);
+#else
+    if(readDisk(path, m_buffer))
+    {
+        m_data = m_buffer.data();
+        m_size = m_buffer.size();
+    }
+#endif
+    if(!m_data)
+    {
+        return;
+    }
+
+    if(!validate())
+    {
+        GL_LOG_E("%s isn't a valid pack of version %u", path.c_str(), VERSION);
+#ifdef __linux__
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+#endif
+        m_data = nullptr;
+        m_buffer.clear();
+        return;
+    }
+    const PackHeader* header = reinterpret_cast<const PackHeader*>(m_data);
+    m_entries                = reinterpret_cast<const PackEntry*>(m_data + header->directoryOffset);
+    m_names                  = reinterpret_cast<const char*>(m_data + header->namesOffset);
+    m_entryCount             = header->entryCount;
+    std::error_code error;
+    m_modifiedTime = std::filesystem::last_write_time(path, error);
+}
+
+bool PackFile::validate() const
+{
+    const PackHeader* header = reinterpret_cast<const PackHeader*>(m_data);
+    if(m_size < sizeof(PackHeader) || memcmp(header->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || header->version != VERSION)
+    {
+        return false;
+    }
+    // the directory is read in place, it has to be aligned and whole
+    if(header->directoryOffset % alignof(PackEntry) != 0 || header->directoryOffset > m_size ||
+       header->entryCount > (m_size - header->directoryOffset) / sizeof(PackEntry) || header->namesOffset > m_size)
+    {
+        return false;
+    }
+    const PackEntry* entries   = reinterpret_cast<const PackEntry*>(m_data + header->directoryOffset);
+    size_t           namesSize = m_size - header->namesOffset;
+    // every entry inside the pack with a known method, sorted by hash for find()
+    for(uint32_t i = 0; i < header->entryCount; i++)
+    {
+        const PackEntry& entry    = entries[i];
+        bool             isInside = entry.nameOffset <= namesSize && entry.nameLength <= namesSize - entry.nameOffset && entry.offset <= m_size && entry.packedSize <= m_size - entry.offset;
+        bool             isMethod = entry.method == PACK_METHOD_ZLIB || (entry.method == PACK_METHOD_STORED && entry.size == entry.packedSize);
+        bool             isSorted = i == 0 || entries[i - 1].hash <= entry.hash;
+        if(!isInside || !isMethod || !isSorted)
+        {
+            GL_LOG_E("pack %s: entry %u is corrupt", m_path.c_str(), i);
+            return false;
+        }
+    }
+    return true;
+}
+
+PackFile::~PackFile()
+{
+#ifdef __linux__
+    if(m_data)
+    {
+        munmap(const_cast<unsigned char*>(m_data), m_size);
+    }
+#endif
+}
+
+MappedFile::MappedFile(const std::string& path)
+{
+#ifdef __linux__
+    if(!PackFile::isPacked(path))
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if(fd < 0)
+        {
+            return;
+        }
+        struct stat info;
+        if(fstat(fd, &info) == 0 && info.st_size > 0)
+        {
+            void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapping != MAP_FAILED)
+            {
+                // readers go through most of it right away, fault it in ahead of them
+                madvise(mapping, info.st_size, MADV_WILLNEED);
+                m_mapping   = mapping;
+                m_file.data = static_cast<const unsigned char*>(mapping);
+                m_file.size = info.st_size;
+            }
+        }
+        close(fd);
+        if(m_mapping)
+        {
+            m_isOpen = true;
+            return;
+        }
+    }
+#endif
+    m_isOpen = PackFile::load(path, m_file);
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef __linux__
+    if(m_mapping)
+    {
+        munmap(m_mapping, m_file.size);
+    }
+#endif
+}
+
+uint64_t PackFile::hash(const void* data, size_t size)
+{
+    // fnv-1a
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    uint64_t             value = 0xcbf29ce484222325ull;
+    for(size_t i = 0; i < size; i++)
+    {
+        value ^= bytes[i];
+        value *= 0x100000001b3ull;
+    }
+    return value;
+}
+
+uint64_t PackFile::hash(const std::string& name)
+{
+    return hash(name.data(), name.size());
+}
+
+std::string PackFile::name(const PackEntry& entry) const
+{
+    return std::string(m_names + entry.nameOffset, entry.nameLength);
+}
+
+const PackEntry* PackFile::find(const std::string& name) const
+{
+    uint64_t key   = hash(name);
+    auto     entry = std::lower_bound(m_entries, m_entries + m_entryCount, key, [](const PackEntry& item, uint64_t value) { return item.hash < value; });
+    // names sharing a hash sit next to each other
+    for(; entry != m_entries + m_entryCount && entry->hash == key; ++entry)
+    {
+        if(entry->nameLength == name.size() && memcmp(m_names + entry->nameOffset, name.data(), name.size()) == 0)
+        {
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+bool PackFile::read(const PackEntry& entry, FileData& file) const
+{
+    // entries were validated at mount
+    const unsigned char* packed = m_data + entry.offset;
+    if(entry.method == PACK_METHOD_STORED)
+    {
+        file.data = packed;
+        file.size = entry.size;
+        return true;
+    }
+
+    file.storage.resize(entry.size);
+    uLongf size = static_cast<uLongf>(entry.size);
+    if(entry.method != PACK_METHOD_ZLIB || uncompress(file.storage.data(), &size, packed, static_cast<uLong>(entry.packedSize)) != Z_OK || size != entry.size)
+    {
+        GL_LOG_E("can't inflate %s from pack %s", name(entry).c_str(), m_path.c_str());
+        file.storage.clear();
+        return false;
+    }
+    file.data = file.storage.data();
+    file.size = file.storage.size();
+    return true;
+}
+
+bool PackFile::mount(const std::string& packPath, const std::string& directory)
+{
+    auto pack = std::make_unique<PackFile>(packPath);
+    if(!pack->isOpen())
+    {
+        GL_LOG_W("can't mount pack %s, loading loose files", packPath.c_str());
+        return false;
+    }
+    GL_LOG_I("mount pack %s at %s, %zu entries %.2f MB", packPath.c_str(), directory.c_str(), pack->entryCount(), pack->m_size / (1024.0 * 1024.0));
+    s_mounts.emplace_back(normalize(directory), std::move(pack));
+    return true;
+}
+
+void PackFile::unmountAll()
+{
+    s_mounts.clear();
+}
+
+bool PackFile::hasMounts()
+{
+    return !s_mounts.empty();
+}
+
+const PackFile* PackFile::resolve(const std::string& path, std::string& name)
+{
+    if(s_mounts.empty())
+    {
+        return nullptr;
+    }
+    std::string     normal    = normalize(path);
+    const PackFile* pack      = nullptr;
+    size_t          bestMatch = 0;
+    for(const auto& mount : s_mounts)
+    {
+        const std::string& directory = mount.first;
+        if(directory.size() >= bestMatch && normal.size() > directory.size() && normal.compare(0, directory.size(), directory) == 0 && normal[directory.size()] == '/')
+        {
+            pack      = mount.second.get();
+            bestMatch = directory.size();
+        }
+    }
+    if(pack)
+    {
+        name = normal.substr(bestMatch + 1);
+    }
+    return pack;
+}
+
+const PackEntry* PackFile::lookup(const std::string& path, const PackFile*& pack)
+{
+    std::string name;
+    pack                   = resolve(path, name);
+    const PackEntry* entry = pack ? pack->find(name) : nullptr;
+    if(!entry)
+    {
+        return nullptr;
+    }
+    // an edit since the pack was made, e.g. one hot reload picks up
+    std::error_code error;
+    auto            modifiedTime = std::filesystem::last_write_time(path, error);
+    return !error && modifiedTime > pack->m_modifiedTime ? nullptr : entry;
+}
+
+bool PackFile::load(const std::string& path, FileData& file)
+{
+    const PackFile*  pack  = nullptr;
+    const PackEntry* entry = lookup(path, pack);
+    if(entry)
+    {
+        return pack->read(*entry, file);
+    }
+    if(!readDisk(path, file.storage))
+    {
+        return false;
+    }
+    file.data = file.storage.data();
+    file.size = file.storage.size();
+    return true;
+}
+
+bool PackFile::isPacked(const std::string& path, uint64_t* size, uint64_t* contentHash)
+{
+    const PackFile*  pack  = nullptr;
+    const PackEntry* entry = lookup(path, pack);
+    if(!entry)
+    {
+        return false;
+    }
+    if(size)
+    {
+        *size = entry->size;
+    }
+    if(contentHash)
+    {
+        *contentHash = entry->contentHash;
+    }
+    return true;
+}
+
+bool PackFile::write(const std::string& packPath, const std::vector<std::pair<std::string, std::string>>& files, int level, float minSaving)
+{
+    // written next to the target and renamed, a reader never sees half a pack
+    std::string   tmpPath = packPath + ".tmp";
+    std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+    if(!ofs)
+    {
+        GL_LOG_E("can't write pack %s", tmpPath.c_str());
+        return false;
+    }
+    PackHeader header = {};
+    memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+    header.version    = VERSION;
+    header.entryCount = static_cast<uint32_t>(files.size());
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::vector<PackEntry>     entries;
+    std::string                names;
+    std::vector<unsigned char> data;
+    std::vector<unsigned char> packed;
+    uint64_t                   offset      = sizeof(header);
+    uint64_t                   totalSize   = 0;
+    uint64_t                   totalPacked = 0;
+    for(const auto& file : files)
+    {
+        if(file.first.size() > 0xffff || !readDisk(file.second, data))
+        {
+            GL_LOG_E("can't add %s to pack %s", file.second.c_str(), packPath.c_str());
+            std::error_code error;
+            ofs.close();
+            std::filesystem::remove(tmpPath, error);
+            return false;
+        }
+        PackEntry entry   = {};
+        entry.hash        = hash(file.first);
+        entry.offset      = offset;
+        entry.size        = data.size();
+        entry.contentHash = hash(data.data(), data.size());
+        entry.nameOffset  = static_cast<uint32_t>(names.size());
+        entry.nameLength  = static_cast<uint16_t>(file.first.size());
+        entry.method      = PACK_METHOD_STORED;
+        names += file.first;
+
+        const unsigned char* bytes = data.data();
+        entry.packedSize           = data.size();
+        if(level > 0 && !data.empty())
+        {
+            uLongf packedSize = compressBound(static_cast<uLong>(data.size()));
+            packed.resize(packedSize);
+            if(compress2(packed.data(), &packedSize, data.data(), static_cast<uLong>(data.size()), level) == Z_OK && packedSize < data.size() * (1.0f - minSaving))
+            {
+                entry.method     = PACK_METHOD_ZLIB;
+                entry.packedSize = packedSize;
+                bytes            = packed.data();
+            }
+        }
+        ofs.write(reinterpret_cast<const char*>(bytes), entry.packedSize);
+        offset += entry.packedSize;
+        totalSize += entry.size;
+        totalPacked += entry.packedSize;
+        entries.push_back(entry);
+    }
+
+    // the directory is read in place, keep it aligned
+    uint64_t padding = (8 - offset % 8) % 8;
+    ofs.write("\0\0\0\0\0\0\0", padding);
+    header.directoryOffset = offset + padding;
+    header.namesOffset     = header.directoryOffset + entries.size() * sizeof(PackEntry);
+    std::sort(entries.begin(), entries.end(), [](const PackEntry& a, const PackEntry& b) { return a.hash < b.hash; });
+    ofs.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PackEntry));
+    ofs.write(names.data(), names.size());
+    ofs.seekp(0);
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.close();
+    if(!ofs)
+    {
+        GL_LOG_E("can't write pack %s", tmpPath.c_str());
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tmpPath, packPath, error);
+    if(error)
+    {
+        GL_LOG_E("can't move pack to %s: %s", packPath.c_str(), error.message().c_str());
+        return false;
+    }
+    GL_LOG_I("write pack %s: %zu files, %.2f MB packed into %.2f MB", packPath.c_str(), files.size(), totalSize / (1024.0 * 1024.0), totalPacked / (1024.0 * 1024.0));
+    return true;
+}
@@ -0,0 +1,32 @@
+#include "parallel.h"
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+void parallelFor(int count, size_t costPerItem, size_t minCost, const std::function<void(int begin, int end)>& func)
+{
+    if(count <= 0)
+    {
+        return;
+    }
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    threadCount        = std::min(threadCount, count * costPerItem / std::max<size_t>(minCost, 1) + 1);
+    threadCount        = std::min(threadCount, static_cast<size_t>(count));
+    if(threadCount <= 1)
+    {
+        func(0, count);
+        return;
+    }
+
+    std::vector<std::thread> workers;
+    int                      chunk = static_cast<int>((count + threadCount - 1) / threadCount);
+    for(int begin = chunk; begin < count; begin += chunk)
+    {
+        workers.emplace_back(func, begin, std::min(begin + chunk, count));
+    }
+    func(0, std::min(chunk, count));
+    for(auto& worker : workers)
+    {
+        worker.join();
+    }
+}
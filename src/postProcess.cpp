@@ -0,0 +1,480 @@
+#include "postProcess.h"
+#include "log.h"
+#include "texture.h"
+#include <cmath>
+#include <sstream>
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+static bool isKernelEffect(PostEffectType type)
+{
+    return type == POST_EFFECT_SHARPEN || type == POST_EFFECT_EDGE_DETECT;
+}
+
+static const char* FULLSCREEN_VERTEX_SHADER = R"(#version 460 core
+
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+layout(location = 0) out vec2 TexCoords;
+
+// one triangle covering the screen, no vertex buffer needed
+void main()
+{
+    vec2 pos    = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    TexCoords   = pos;
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+static const char* FRAGMENT_SHADER_FUNCTIONS = R"(
+// clang-format off
+const float sharpenKernel[9] = float[](
+    -1, -1, -1,
+    -1,  9, -1,
+    -1, -1, -1
+);
+const float edgeDetectionKernel[9] = float[](
+    1,  1, 1,
+    1, -8, 1,
+    1,  1, 1
+);
+// clang-format on
+
+vec3 doKernel(vec2 inTexCoords, const float kernel[9])
+{
+    vec2 texel = 1.0 / vec2(textureSize(screenTexture, 0));
+    vec3 color = vec3(0.0);
+    for(int y = 0; y < 3; y++)
+    {
+        for(int x = 0; x < 3; x++)
+        {
+            vec2 offset = vec2(x - 1, 1 - y) * texel;
+            color += texture(screenTexture, inTexCoords + offset).rgb * kernel[y * 3 + x];
+        }
+    }
+    return color;
+}
+
+vec3 toneMapping(vec3 inColor, float exposure)
+{
+    return vec3(1.0) - exp(-inColor * exposure);
+}
+
+vec3 gammaCorrect(vec3 inColor, float gamma)
+{
+    return pow(max(inColor, vec3(0.0)), vec3(1.0 / gamma));
+}
+
+vec3 inversion(vec3 inColor)
+{
+    return (1.0 - inColor);
+}
+
+vec3 grayscale(vec3 inColor)
+{
+    float average = (inColor.x + inColor.y + inColor.z) / 3.0;
+    return vec3(average, average, average);
+}
+)";
+
+PostProcessChain::PostProcessChain()
+{
+    glCreateVertexArrays(1, &m_emptyVAO);
+    glGenQueries(TIMER_QUERY_COUNT, m_timerQueries);
+}
+
+PostProcessChain::~PostProcessChain()
+{
+    glDeleteVertexArrays(1, &m_emptyVAO);
+    glDeleteQueries(TIMER_QUERY_COUNT, m_timerQueries);
+}
+
+void PostProcessChain::add(PostEffectType type, float param)
+{
+    if(type == POST_EFFECT_BLUR && (param < 1.0f || param > POST_BLUR_MAX_RADIUS))
+    {
+        GL_LOG_W("blur radius %f out of range, clamped to [1, %d]", param, POST_BLUR_MAX_RADIUS);
+        param = std::fmin(std::fmax(param, 1.0f), static_cast<float>(POST_BLUR_MAX_RADIUS));
+    }
+    m_effects.push_back({type, param});
+    m_isDirty = true;
+}
+
+void PostProcessChain::clear()
+{
+    m_effects.clear();
+    m_isDirty = true;
+}
+
+void PostProcessChain::setFusion(bool isFused)
+{
+    if(m_isFused != isFused)
+    {
+        m_isFused = isFused;
+        m_isDirty = true;
+    }
+}
+
+int PostProcessChain::passCount()
+{
+    build();
+    int count = 0;
+    for(const auto& stage : m_stages)
+    {
+        count += stage.isCompute ? 2 : 1;
+    }
+    return count;
+}
+
+void PostProcessChain::build()
+{
+    if(!m_isDirty)
+    {
+        return;
+    }
+    m_stages.clear();
+
+    for(const auto& effect : m_effects)
+    {
+        if(effect.type == POST_EFFECT_BLUR)
+        {
+            m_stages.push_back({true, {effect}, nullptr, nullptr, nullptr});
+            continue;
+        }
+
+        bool canAppend = m_isFused && !m_stages.empty() && !m_stages.back().isCompute && !isKernelEffect(effect.type);
+        if(canAppend)
+        {
+            m_stages.back().effects.push_back(effect);
+        }
+        else
+        {
+            m_stages.push_back({false, {effect}, nullptr, nullptr, nullptr});
+        }
+    }
+
+    // the last pass draws into the output, a compute pass can't write the default framebuffer
+    if(m_stages.empty() || m_stages.back().isCompute)
+    {
+        m_stages.push_back({false, {}, nullptr, nullptr, nullptr});
+    }
+
+    // submit every program of the chain at once, the driver compiles them in parallel. fragment
+    // stages are separable programs sharing one vertex program through a pipeline each
+    std::string                            blurSources[2] = {generateBlurShader(true), generateBlurShader(false)};
+    std::vector<std::vector<ShaderSource>> computeSources;
+    std::vector<std::vector<ShaderSource>> fragmentSources;
+    for(const auto& stage : m_stages)
+    {
+        if(stage.isCompute)
+        {
+            computeSources.push_back({{COMPUTE_SHADER, blurSources[0], "post-blur-horizontal"}});
+            computeSources.push_back({{COMPUTE_SHADER, blurSources[1], "post-blur-vertical"}});
+        }
+        else
+        {
+            fragmentSources.push_back({{FRAGMENT_SHADER, generateFragmentShader(stage), "post-generated.fs"}});
+        }
+    }
+    if(!m_vertexProgram)
+    {
+        m_vertexProgram = std::make_unique<ShaderProgram>(std::vector<ShaderSource>{{VERTEX_SHADER, FULLSCREEN_VERTEX_SHADER, "post-fullscreen.vs"}}, true);
+    }
+    auto computePrograms  = ShaderProgram::createBatch(computeSources);
+    auto fragmentPrograms = ShaderProgram::createBatch(fragmentSources, true);
+
+    size_t computeIdx  = 0;
+    size_t fragmentIdx = 0;
+    for(auto& stage : m_stages)
+    {
+        if(stage.isCompute)
+        {
+            stage.program         = std::move(computePrograms[computeIdx++]);
+            stage.verticalProgram = std::move(computePrograms[computeIdx++]);
+
+            // normalized gaussian weights, sigma = radius / 2
+            int   radius = static_cast<int>(stage.effects[0].param);
+            float sigma  = std::fmax(radius * 0.5f, 0.5f);
+            float weights[POST_BLUR_MAX_RADIUS + 1];
+            float sum = 0.0f;
+            for(int i = 0; i <= radius; i++)
+            {
+                weights[i] = std::exp(-(i * i) / (2.0f * sigma * sigma));
+                sum += i == 0 ? weights[i] : 2.0f * weights[i];
+            }
+            for(ShaderProgram* program : {stage.program.get(), stage.verticalProgram.get()})
+            {
+                program->setInt("inputTexture", 0);
+                program->setInt("radius", radius);
+                for(int i = 0; i <= radius; i++)
+                {
+                    program->setFloat("weights[" + std::to_string(i) + "]", weights[i] / sum);
+                }
+            }
+        }
+        else
+        {
+            stage.program  = std::move(fragmentPrograms[fragmentIdx++]);
+            stage.pipeline = std::make_unique<ProgramPipeline>();
+            stage.pipeline->setProgram(*m_vertexProgram);
+            stage.pipeline->setProgram(*stage.program);
+            stage.program->setInt("screenTexture", 0);
+            for(size_t i = 0; i < stage.effects.size(); i++)
+            {
+                stage.program->setFloat("params[" + std::to_string(i) + "]", stage.effects[i].param);
+            }
+        }
+    }
+
+    m_isDirty = false;
+    GL_LOG_I("post process chain: %zu effects -> %d passes (%s)", m_effects.size(), passCount(), m_isFused ? "fused" : "unfused");
+}
+
+std::string PostProcessChain::generateFragmentShader(const Stage& stage) const
+{
+    std::stringstream ss;
+    ss << "#version 460 core\n\n"
+       << "layout(location = 0) in vec2 TexCoords;\n"
+       << "out vec4 FragColor;\n\n"
+       << "uniform sampler2D screenTexture;\n"
+       << "uniform float     params[" << (stage.effects.empty() ? 1 : stage.effects.size()) << "];\n"
+       << FRAGMENT_SHADER_FUNCTIONS << "\n"
+       << "void main()\n"
+       << "{\n";
+
+    size_t first = 0;
+    if(!stage.effects.empty() && isKernelEffect(stage.effects[0].type))
+    {
+        ss << "    vec3 color = doKernel(TexCoords, " << (stage.effects[0].type == POST_EFFECT_SHARPEN ? "sharpenKernel" : "edgeDetectionKernel") << ");\n";
+        first = 1;
+    }
+    else
+    {
+        ss << "    vec3 color = texture(screenTexture, TexCoords).rgb;\n";
+    }
+
+    for(size_t i = first; i < stage.effects.size(); i++)
+    {
+        switch(stage.effects[i].type)
+        {
+        case POST_EFFECT_TONE_MAPPING:
+            ss << "    color = toneMapping(color, params[" << i << "]);\n";
+            break;
+        case POST_EFFECT_GAMMA:
+            ss << "    color = gammaCorrect(color, params[" << i << "]);\n";
+            break;
+        case POST_EFFECT_INVERSION:
+            ss << "    color = inversion(color);\n";
+            break;
+        case POST_EFFECT_GRAYSCALE:
+            ss << "    color = grayscale(color);\n";
+            break;
+        default:
+            GL_LOG_E("post effect %d can't be fused at position %zu", stage.effects[i].type, i);
+            std::abort();
+        }
+    }
+
+    ss << "    FragColor = vec4(color, 1.0);\n"
+       << "}\n";
+    return ss.str();
+}
+
+std::string PostProcessChain::generateBlurShader(bool isHorizontal) const
+{
+    // every work group blurs a row (or column) segment of GROUP_SIZE pixels. the segment plus its
+    // apron is fetched once into shared memory, so each texel is read once instead of 2 * radius + 1 times.
+    std::stringstream ss;
+    ss << "#version 460 core\n\n"
+       << "#define RADIUS " << POST_BLUR_MAX_RADIUS << "\n"
+       << "#define GROUP_SIZE " << POST_BLUR_GROUP_SIZE << "\n"
+       << (isHorizontal ? "#define HORIZONTAL\n" : "") << R"(
+layout(local_size_x = GROUP_SIZE, local_size_y = 1) in;
+layout(rgba16f, binding = 0) uniform writeonly image2D outputImage;
+
+uniform sampler2D inputTexture;
+uniform int       radius;
+uniform float     weights[RADIUS + 1];
+
+shared vec3 cache[GROUP_SIZE + 2 * RADIUS];
+
+void main()
+{
+    ivec2 size  = imageSize(outputImage);
+    int   local = int(gl_LocalInvocationID.x);
+#ifdef HORIZONTAL
+    ivec2 axis  = ivec2(1, 0);
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.x, gl_WorkGroupID.y);
+#else
+    ivec2 axis  = ivec2(0, 1);
+    ivec2 pixel = ivec2(gl_WorkGroupID.y, gl_GlobalInvocationID.x);
+#endif
+
+    ivec2 segmentStart = pixel - axis * local;
+    for(int i = local; i < GROUP_SIZE + 2 * RADIUS; i += GROUP_SIZE)
+    {
+        ivec2 samplePos = clamp(segmentStart + axis * (i - RADIUS), ivec2(0), size - 1);
+        cache[i]        = texelFetch(inputTexture, samplePos, 0).rgb;
+    }
+    barrier();
+
+    if(pixel.x >= size.x || pixel.y >= size.y)
+        return;
+
+    vec3 color = cache[local + RADIUS] * weights[0];
+    for(int i = 1; i <= radius; i++)
+    {
+        color += (cache[local + RADIUS - i] + cache[local + RADIUS + i]) * weights[i];
+    }
+    imageStore(outputImage, pixel, vec4(color, 1.0));
+}
+)";
+    return ss.str();
+}
+
+void PostProcessChain::addPasses(FrameGraph& graph, FrameGraphResource input, FrameGraphResource output, int width, int height)
+{
+    build();
+
+    RenderTargetDesc intermediateDesc;
+    intermediateDesc.width        = width;
+    intermediateDesc.height       = height;
+    intermediateDesc.colorFormats = {RT_FORMAT_RGBA16F};
+
+    FrameGraphResource current = input;
+    for(size_t i = 0; i < m_stages.size(); i++)
+    {
+        Stage* stage   = &m_stages[i];
+        bool   isFirst = i == 0;
+        bool   isLast  = i == m_stages.size() - 1;
+
+        if(stage->isCompute)
+        {
+            auto horizontal = std::make_shared<FrameGraphResource>(FRAME_GRAPH_INVALID_RESOURCE);
+            auto vertical   = std::make_shared<FrameGraphResource>(FRAME_GRAPH_INVALID_RESOURCE);
+            graph.addPass(
+                "post-blur-h",
+                [=](FrameGraphBuilder& builder) {
+                    builder.read(current);
+                    *horizontal = builder.write(builder.create("post-blur-h", intermediateDesc), ACCESS_STORAGE);
+                },
+                [=](const FrameGraphResources& resources) {
+                    if(isFirst)
+                    {
+                        beginTiming();
+                    }
+                    executeBlurPass(*stage, true, resources.colorTexture(current), resources.colorTexture(*horizontal), width, height);
+                });
+            graph.addPass(
+                "post-blur-v",
+                [=](FrameGraphBuilder& builder) {
+                    builder.read(*horizontal);
+                    *vertical = builder.write(builder.create("post-blur-v", intermediateDesc), ACCESS_STORAGE);
+                },
+                [=](const FrameGraphResources& resources) {
+                    executeBlurPass(*stage, false, resources.colorTexture(*horizontal), resources.colorTexture(*vertical), width, height);
+                });
+            current = *vertical;
+            continue;
+        }
+
+        auto target = std::make_shared<FrameGraphResource>(output);
+        graph.addPass(
+            "post-" + std::to_string(i),
+            [=](FrameGraphBuilder& builder) {
+                builder.read(current);
+                if(!isLast)
+                {
+                    *target = builder.create("post-" + std::to_string(i), intermediateDesc);
+                }
+                builder.write(*target);
+            },
+            [=](const FrameGraphResources& resources) {
+                if(isFirst)
+                {
+                    beginTiming();
+                }
+                resources.bind(*target);
+                executeFragmentStage(*stage, resources.colorTexture(current));
+                if(isLast)
+                {
+                    endTiming();
+                }
+            });
+        current = *target;
+    }
+}
+
+void PostProcessChain::executeFragmentStage(Stage& stage, unsigned int inputTexture)
+{
+    glDisable(GL_DEPTH_TEST);
+    stage.pipeline->bind();
+    Texture::bindUnit(0, inputTexture);
+    glBindVertexArray(m_emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    glBindProgramPipeline(0);
+}
+
+void PostProcessChain::executeBlurPass(Stage& stage, bool isHorizontal, unsigned int inputTexture, unsigned int outputTexture, int width, int height)
+{
+    ShaderProgram* program = isHorizontal ? stage.program.get() : stage.verticalProgram.get();
+    Texture::bindUnit(0, inputTexture);
+    glBindImageTexture(0, outputTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+
+    int lineLength = isHorizontal ? width : height;
+    int lineCount  = isHorizontal ? height : width;
+    program->dispatch(ShaderProgram::groupCount(lineLength, POST_BLUR_GROUP_SIZE), lineCount);
+}
+
+void PostProcessChain::beginTiming()
+{
+    // collect whatever finished without waiting
+    for(int i = 0; i < TIMER_QUERY_COUNT; i++)
+    {
+        if(!m_timerPending[i])
+        {
+            continue;
+        }
+        int available = 0;
+        glGetQueryObjectiv(m_timerQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+        if(available)
+        {
+            GLuint64 elapsedNs = 0;
+            glGetQueryObjectui64v(m_timerQueries[i], GL_QUERY_RESULT, &elapsedNs);
+            m_gpuTimeSumMs += elapsedNs / 1.0e6;
+            m_gpuTimeSamples++;
+            m_timerPending[i] = false;
+        }
+    }
+
+    m_isTiming = !m_timerPending[m_timerIdx];
+    if(m_isTiming)
+    {
+        glBeginQuery(GL_TIME_ELAPSED, m_timerQueries[m_timerIdx]);
+    }
+}
+
+void PostProcessChain::endTiming()
+{
+    if(!m_isTiming)
+    {
+        return;
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    m_timerPending[m_timerIdx] = true;
+    m_timerIdx                 = (m_timerIdx + 1) % TIMER_QUERY_COUNT;
+    m_isTiming                 = false;
+}
+
+double PostProcessChain::averageGpuTimeMs()
+{
+    double average   = m_gpuTimeSamples ? m_gpuTimeSumMs / m_gpuTimeSamples : 0.0;
+    m_gpuTimeSumMs   = 0.0;
+    m_gpuTimeSamples = 0;
+    return average;
+}
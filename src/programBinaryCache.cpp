@@ -0,0 +1,171 @@
+#include "programBinaryCache.h"
+#include "log.h"
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+static const uint32_t PROGRAM_BINARY_MAGIC = 0x42504c47; // "GLPB"
+
+std::string ProgramBinaryCache::s_directory = "program-cache";
+bool        ProgramBinaryCache::s_isEnabled = true;
+
+// fnv-1a, stable across runs and platforms unlike std::hash
+static uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for(size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static uint64_t hashString(uint64_t hash, const char* str)
+{
+    // glGetString may return null without a context
+    str = str ? str : "";
+    // include the terminator so "ab" + "c" and "a" + "bc" differ
+    return hashBytes(hash, str, std::strlen(str) + 1);
+}
+
+void ProgramBinaryCache::setDirectory(const std::string& directory)
+{
+    s_directory = directory;
+}
+
+void ProgramBinaryCache::setEnabled(bool isEnabled)
+{
+    s_isEnabled = isEnabled;
+}
+
+bool ProgramBinaryCache::isEnabled()
+{
+    return s_isEnabled && !s_directory.empty() && isSupported();
+}
+
+bool ProgramBinaryCache::isSupported()
+{
+    static int formatCount = -1;
+    if(formatCount < 0)
+    {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        if(formatCount == 0)
+        {
+            GL_LOG_W("driver supports no program binary formats, program cache disabled");
+        }
+    }
+    return formatCount > 0;
+}
+
+uint64_t ProgramBinaryCache::hash(const std::vector<ShaderSource>& sources, bool isSeparable)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    hash          = hashBytes(hash, &isSeparable, sizeof(isSeparable));
+    hash          = hashString(hash, reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+    hash          = hashString(hash, reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+    hash          = hashString(hash, reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+    for(const auto& source : sources)
+    {
+        int type = source.type;
+        hash     = hashBytes(hash, &type, sizeof(type));
+        hash     = hashString(hash, source.source.c_str());
+    }
+    return hash;
+}
+
+std::string ProgramBinaryCache::filePath(uint64_t key)
+{
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(key));
+    return s_directory + "/" + name;
+}
+
+bool ProgramBinaryCache::load(unsigned int program, uint64_t key)
+{
+    if(!isEnabled())
+    {
+        return false;
+    }
+
+    std::ifstream ifs(filePath(key), std::ios::binary);
+    if(!ifs)
+    {
+        return false;
+    }
+
+    uint32_t magic  = 0;
+    uint32_t format = 0;
+    uint32_t length = 0;
+    ifs.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    ifs.read(reinterpret_cast<char*>(&format), sizeof(format));
+    ifs.read(reinterpret_cast<char*>(&length), sizeof(length));
+    if(!ifs || magic != PROGRAM_BINARY_MAGIC || length == 0)
+    {
+        GL_LOG_W("corrupt program binary %s", filePath(key).c_str());
+        return false;
+    }
+    std::vector<char> binary(length);
+    if(!ifs.read(binary.data(), length))
+    {
+        GL_LOG_W("truncated program binary %s", filePath(key).c_str());
+        return false;
+    }
+
+    // the driver may still reject a blob it produced itself, e.g. after an update with the same version string
+    glProgramBinary(program, format, binary.data(), static_cast<int>(length));
+    int success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if(!success)
+    {
+        GL_LOG_W("driver rejected program binary %s, compiling from source", filePath(key).c_str());
+        return false;
+    }
+    return true;
+}
+
+void ProgramBinaryCache::store(unsigned int program, uint64_t key)
+{
+    if(!isEnabled())
+    {
+        return;
+    }
+
+    int length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if(length <= 0)
+    {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum            format = 0;
+    glGetProgramBinary(program, length, &length, &format, binary.data());
+
+    std::error_code error;
+    std::filesystem::create_directories(s_directory, error);
+
+    // write to a temporary name first so a crash never leaves a half written blob behind
+    std::string path    = filePath(key);
+    std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!ofs)
+        {
+            GL_LOG_W("can't write program binary %s", tmpPath.c_str());
+            return;
+        }
+        uint32_t header[3] = {PROGRAM_BINARY_MAGIC, static_cast<uint32_t>(format), static_cast<uint32_t>(length)};
+        ofs.write(reinterpret_cast<const char*>(header), sizeof(header));
+        ofs.write(binary.data(), length);
+    }
+    std::filesystem::rename(tmpPath, path, error);
+    if(error)
+    {
+        GL_LOG_W("can't write program binary %s: %s", path.c_str(), error.message().c_str());
+    }
+}
@@ -0,0 +1,52 @@
+#include "programPipeline.h"
+#include "log.h"
+#include "shader.h"
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+ProgramPipeline::ProgramPipeline()
+{
+    glCreateProgramPipelines(1, &m_id);
+}
+
+ProgramPipeline::~ProgramPipeline()
+{
+    glDeleteProgramPipelines(1, &m_id);
+}
+
+void ProgramPipeline::setProgram(const ShaderProgram& program)
+{
+    setStages(program.stageBits(), program);
+}
+
+void ProgramPipeline::setStages(unsigned int stageBits, const ShaderProgram& program)
+{
+    if(!program.isSeparable())
+    {
+        GL_LOG_E("program %d isn't separable, it can't be used in pipeline %d", program.id(), m_id);
+        std::abort();
+    }
+    glUseProgramStages(m_id, stageBits, program.id());
+}
+
+void ProgramPipeline::bind()
+{
+    glUseProgram(0);
+    glBindProgramPipeline(m_id);
+}
+
+bool ProgramPipeline::validate()
+{
+    glValidateProgramPipeline(m_id);
+    int isValid = 0;
+    glGetProgramPipelineiv(m_id, GL_VALIDATE_STATUS, &isValid);
+    if(!isValid)
+    {
+        char infoLog[512];
+        glGetProgramPipelineInfoLog(m_id, sizeof(infoLog), nullptr, infoLog);
+        GL_LOG_E("program pipeline %d invalid: %s", m_id, infoLog);
+    }
+    return isValid;
+}
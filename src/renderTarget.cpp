@@ -0,0 +1,424 @@
+#include "renderTarget.h"
+#include "log.h"
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+static bool isDepthFormat(RenderTargetFormat format)
+{
+    return format == RT_FORMAT_DEPTH24_STENCIL8 || format == RT_FORMAT_DEPTH32F;
+}
+
+// pixel format of the texture's channels, the storage itself comes from the internal format
+static unsigned int translatePixelFormat(RenderTargetFormat format)
+{
+    switch(format)
+    {
+    case RT_FORMAT_RGBA8:
+    case RT_FORMAT_RGBA16F:
+        return GL_RGBA;
+    case RT_FORMAT_R11G11B10F:
+        return GL_RGB;
+    case RT_FORMAT_R8:
+    case RT_FORMAT_R16F:
+        return GL_RED;
+    case RT_FORMAT_DEPTH24_STENCIL8:
+        return GL_DEPTH_STENCIL;
+    case RT_FORMAT_DEPTH32F:
+        return GL_DEPTH_COMPONENT;
+    default:
+        GL_LOG_E("don't support render target format %d", format);
+        std::abort();
+    }
+}
+
+bool RenderTargetDesc::operator==(const RenderTargetDesc& other) const
+{
+    return width == other.width && height == other.height && samples == other.samples && colorFormats == other.colorFormats && depthFormat == other.depthFormat &&
+           sampledDepth == other.sampledDepth;
+}
+
+unsigned int RenderTarget::translateInternalFormat(RenderTargetFormat format)
+{
+    switch(format)
+    {
+    case RT_FORMAT_RGBA8:
+        return GL_RGBA8;
+    case RT_FORMAT_RGBA16F:
+        return GL_RGBA16F;
+    case RT_FORMAT_R11G11B10F:
+        return GL_R11F_G11F_B10F;
+    case RT_FORMAT_R8:
+        return GL_R8;
+    case RT_FORMAT_R16F:
+        return GL_R16F;
+    case RT_FORMAT_DEPTH24_STENCIL8:
+        return GL_DEPTH24_STENCIL8;
+    case RT_FORMAT_DEPTH32F:
+        return GL_DEPTH_COMPONENT32F;
+    default:
+        GL_LOG_E("don't support render target format %d", format);
+        std::abort();
+    }
+}
+
+int RenderTarget::bytesPerPixel(RenderTargetFormat format)
+{
+    switch(format)
+    {
+    case RT_FORMAT_RGBA8:
+    case RT_FORMAT_R11G11B10F:
+    case RT_FORMAT_DEPTH24_STENCIL8:
+    case RT_FORMAT_DEPTH32F:
+        return 4;
+    case RT_FORMAT_RGBA16F:
+        return 8;
+    case RT_FORMAT_R8:
+        return 1;
+    case RT_FORMAT_R16F:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+void RenderTarget::bindDefault(int width, int height)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+}
+
+RenderTarget::RenderTarget(const RenderTargetDesc& desc)
+    : m_desc(desc)
+{
+    if(m_desc.width <= 0 || m_desc.height <= 0 || m_desc.samples < 1)
+    {
+        GL_LOG_E("invalid render target size %dx%d samples %d", m_desc.width, m_desc.height, m_desc.samples);
+        std::abort();
+    }
+    for(auto format : m_desc.colorFormats)
+    {
+        if(format == RT_FORMAT_NONE || isDepthFormat(format))
+        {
+            GL_LOG_E("render target color attachment can't use format %d", format);
+            std::abort();
+        }
+    }
+    if(m_desc.depthFormat != RT_FORMAT_NONE && !isDepthFormat(m_desc.depthFormat))
+    {
+        GL_LOG_E("render target depth attachment can't use format %d", m_desc.depthFormat);
+        std::abort();
+    }
+    create();
+}
+
+RenderTarget::~RenderTarget()
+{
+    release();
+}
+
+void RenderTarget::create()
+{
+    bool multisample = m_desc.samples > 1;
+
+    glCreateFramebuffers(1, &m_fbo);
+
+    // textures that get sampled later. with MSAA they live in the resolve framebuffer
+    std::vector<unsigned int> drawBuffers;
+    for(size_t i = 0; i < m_desc.colorFormats.size(); i++)
+    {
+        m_colorTextures.emplace_back(m_desc.width, m_desc.height, translateInternalFormat(m_desc.colorFormats[i]), translatePixelFormat(m_desc.colorFormats[i]));
+        drawBuffers.push_back(GL_COLOR_ATTACHMENT0 + i);
+
+        if(multisample)
+        {
+            unsigned int rbo;
+            glCreateRenderbuffers(1, &rbo);
+            glNamedRenderbufferStorageMultisample(rbo, m_desc.samples, translateInternalFormat(m_desc.colorFormats[i]), m_desc.width, m_desc.height);
+            glNamedFramebufferRenderbuffer(m_fbo, GL_COLOR_ATTACHMENT0 + i, GL_RENDERBUFFER, rbo);
+            m_msaaColorRbos.push_back(rbo);
+        }
+        else
+        {
+            glNamedFramebufferTexture(m_fbo, GL_COLOR_ATTACHMENT0 + i, m_colorTextures.back().id(), 0);
+        }
+    }
+
+    if(drawBuffers.empty())
+    {
+        // depth only, e.g. shadow maps
+        glNamedFramebufferDrawBuffer(m_fbo, GL_NONE);
+        glNamedFramebufferReadBuffer(m_fbo, GL_NONE);
+    }
+    else
+    {
+        glNamedFramebufferDrawBuffers(m_fbo, drawBuffers.size(), &drawBuffers[0]);
+    }
+
+    if(m_desc.depthFormat != RT_FORMAT_NONE)
+    {
+        unsigned int depthAttachment = m_desc.depthFormat == RT_FORMAT_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+        unsigned int internalFormat  = translateInternalFormat(m_desc.depthFormat);
+        if(multisample)
+        {
+            glCreateRenderbuffers(1, &m_msaaDepthRbo);
+            glNamedRenderbufferStorageMultisample(m_msaaDepthRbo, m_desc.samples, internalFormat, m_desc.width, m_desc.height);
+            glNamedFramebufferRenderbuffer(m_fbo, depthAttachment, GL_RENDERBUFFER, m_msaaDepthRbo);
+        }
+
+        if(m_desc.sampledDepth)
+        {
+            m_depthTexture = std::make_unique<Texture>(m_desc.width, m_desc.height, internalFormat, translatePixelFormat(m_desc.depthFormat));
+            if(!multisample)
+            {
+                glNamedFramebufferTexture(m_fbo, depthAttachment, m_depthTexture->id(), 0);
+            }
+        }
+        else if(!multisample)
+        {
+            glCreateRenderbuffers(1, &m_depthRbo);
+            glNamedRenderbufferStorage(m_depthRbo, internalFormat, m_desc.width, m_desc.height);
+            glNamedFramebufferRenderbuffer(m_fbo, depthAttachment, GL_RENDERBUFFER, m_depthRbo);
+        }
+    }
+    checkStatus(m_fbo);
+
+    if(multisample)
+    {
+        glCreateFramebuffers(1, &m_resolveFbo);
+        for(size_t i = 0; i < m_colorTextures.size(); i++)
+        {
+            glNamedFramebufferTexture(m_resolveFbo, GL_COLOR_ATTACHMENT0 + i, m_colorTextures[i].id(), 0);
+        }
+        if(m_depthTexture)
+        {
+            unsigned int depthAttachment = m_desc.depthFormat == RT_FORMAT_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+            glNamedFramebufferTexture(m_resolveFbo, depthAttachment, m_depthTexture->id(), 0);
+        }
+        if(m_colorTextures.empty())
+        {
+            glNamedFramebufferDrawBuffer(m_resolveFbo, GL_NONE);
+            glNamedFramebufferReadBuffer(m_resolveFbo, GL_NONE);
+        }
+        checkStatus(m_resolveFbo);
+    }
+
+    GL_LOG_D("create render target %d %dx%d samples %d colors %zu depth %d", m_fbo, m_desc.width, m_desc.height, m_desc.samples, m_desc.colorFormats.size(), m_desc.depthFormat);
+}
+
+void RenderTarget::release()
+{
+    GL_LOG_D("release render target %d", m_fbo);
+    if(!m_msaaColorRbos.empty())
+    {
+        glDeleteRenderbuffers(m_msaaColorRbos.size(), &m_msaaColorRbos[0]);
+        m_msaaColorRbos.clear();
+    }
+    if(m_msaaDepthRbo)
+    {
+        glDeleteRenderbuffers(1, &m_msaaDepthRbo);
+        m_msaaDepthRbo = 0;
+    }
+    if(m_depthRbo)
+    {
+        glDeleteRenderbuffers(1, &m_depthRbo);
+        m_depthRbo = 0;
+    }
+    if(m_resolveFbo)
+    {
+        glDeleteFramebuffers(1, &m_resolveFbo);
+        m_resolveFbo = 0;
+    }
+    if(m_fbo)
+    {
+        glDeleteFramebuffers(1, &m_fbo);
+        m_fbo = 0;
+    }
+    m_colorTextures.clear();
+    m_depthTexture.reset();
+}
+
+void RenderTarget::checkStatus(unsigned int fbo) const
+{
+    if(glCheckNamedFramebufferStatus(fbo, GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        GL_LOG_E("ERROR::FRAMEBUFFER:: Framebuffer %d is not complete!", fbo);
+        std::abort();
+    }
+}
+
+void RenderTarget::bind()
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, m_desc.width, m_desc.height);
+}
+
+void RenderTarget::resolve()
+{
+    if(m_desc.samples <= 1)
+    {
+        return;
+    }
+
+    // named blits leave the framebuffer bindings of the pass alone
+    for(size_t i = 0; i < m_colorTextures.size(); i++)
+    {
+        glNamedFramebufferReadBuffer(m_fbo, GL_COLOR_ATTACHMENT0 + i);
+        glNamedFramebufferDrawBuffer(m_resolveFbo, GL_COLOR_ATTACHMENT0 + i);
+        glBlitNamedFramebuffer(m_fbo, m_resolveFbo, 0, 0, m_desc.width, m_desc.height, 0, 0, m_desc.width, m_desc.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    }
+    if(m_depthTexture)
+    {
+        glBlitNamedFramebuffer(m_fbo, m_resolveFbo, 0, 0, m_desc.width, m_desc.height, 0, 0, m_desc.width, m_desc.height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    }
+    glNamedFramebufferReadBuffer(m_fbo, m_colorTextures.empty() ? GL_NONE : GL_COLOR_ATTACHMENT0);
+}
+
+void RenderTarget::resize(int width, int height)
+{
+    if(width <= 0 || height <= 0 || (width == m_desc.width && height == m_desc.height))
+    {
+        return;
+    }
+    release();
+    m_desc.width  = width;
+    m_desc.height = height;
+    create();
+}
+
+void RenderTarget::shareDepth(const RenderTarget& other)
+{
+    if(m_desc.depthFormat != RT_FORMAT_NONE || m_desc.samples != other.m_desc.samples || m_desc.width != other.m_desc.width || m_desc.height != other.m_desc.height)
+    {
+        GL_LOG_E("render target %d can't share depth of %d", m_fbo, other.m_fbo);
+        std::abort();
+    }
+
+    unsigned int depthAttachment = other.m_desc.depthFormat == RT_FORMAT_DEPTH24_STENCIL8 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+    if(other.m_msaaDepthRbo)
+    {
+        glNamedFramebufferRenderbuffer(m_fbo, depthAttachment, GL_RENDERBUFFER, other.m_msaaDepthRbo);
+    }
+    else if(other.m_depthRbo)
+    {
+        glNamedFramebufferRenderbuffer(m_fbo, depthAttachment, GL_RENDERBUFFER, other.m_depthRbo);
+    }
+    else if(other.m_depthTexture)
+    {
+        glNamedFramebufferTexture(m_fbo, depthAttachment, other.m_depthTexture->id(), 0);
+    }
+    else
+    {
+        GL_LOG_E("render target %d has no depth to share", other.m_fbo);
+        std::abort();
+    }
+    checkStatus(m_fbo);
+}
+
+unsigned int RenderTarget::colorTexture(size_t idx) const
+{
+    if(idx >= m_colorTextures.size())
+    {
+        GL_LOG_E("render target %d has no color attachment %zu", m_fbo, idx);
+        std::abort();
+    }
+    return m_colorTextures[idx].id();
+}
+
+unsigned int RenderTarget::depthTexture() const
+{
+    if(!m_depthTexture)
+    {
+        GL_LOG_E("render target %d has no sampled depth", m_fbo);
+        std::abort();
+    }
+    return m_depthTexture->id();
+}
+
+size_t RenderTarget::memorySize() const
+{
+    size_t pixels = static_cast<size_t>(m_desc.width) * m_desc.height;
+    size_t bytes  = 0;
+    for(auto format : m_desc.colorFormats)
+    {
+        bytes += pixels * bytesPerPixel(format);
+        if(m_desc.samples > 1)
+        {
+            bytes += pixels * m_desc.samples * bytesPerPixel(format);
+        }
+    }
+    if(m_desc.depthFormat != RT_FORMAT_NONE)
+    {
+        bytes += pixels * (m_desc.samples > 1 ? m_desc.samples : 1) * bytesPerPixel(m_desc.depthFormat);
+        if(m_desc.samples > 1 && m_desc.sampledDepth)
+        {
+            bytes += pixels * bytesPerPixel(m_desc.depthFormat);
+        }
+    }
+    return bytes;
+}
+
+// ------------------ RenderTargetPool ------------------
+
+RenderTarget* RenderTargetPool::acquire(const RenderTargetDesc& desc)
+{
+    for(auto& entry : m_entries)
+    {
+        if(!entry.inUse && entry.target->desc() == desc)
+        {
+            entry.inUse         = true;
+            entry.lastUsedFrame = m_frame;
+            return entry.target.get();
+        }
+    }
+
+    m_entries.push_back({std::make_unique<RenderTarget>(desc), true, m_frame});
+    return m_entries.back().target.get();
+}
+
+void RenderTargetPool::release(RenderTarget* target)
+{
+    for(auto& entry : m_entries)
+    {
+        if(entry.target.get() == target)
+        {
+            entry.inUse         = false;
+            entry.lastUsedFrame = m_frame;
+            return;
+        }
+    }
+    GL_LOG_W("render target %d doesn't belong to this pool", target ? target->id() : 0);
+}
+
+void RenderTargetPool::endFrame(unsigned int maxIdleFrames)
+{
+    for(size_t i = 0; i < m_entries.size();)
+    {
+        if(!m_entries[i].inUse && m_frame - m_entries[i].lastUsedFrame >= maxIdleFrames)
+        {
+            m_entries[i] = std::move(m_entries.back());
+            m_entries.pop_back();
+        }
+        else
+        {
+            i++;
+        }
+    }
+    m_frame++;
+}
+
+void RenderTargetPool::clear()
+{
+    m_entries.clear();
+}
+
+size_t RenderTargetPool::memorySize() const
+{
+    size_t bytes = 0;
+    for(const auto& entry : m_entries)
+    {
+        bytes += entry.target->memorySize();
+    }
+    return bytes;
+}
@@ -0,0 +1,264 @@
+#include "resourceManager.h"
+#include "bufferAllocator.h"
+#include "log.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+// slots are added a chunk at a time and never move, readers on other threads don't take the lock
+static const uint32_t CHUNK_SLOTS = 1024;
+static const uint32_t MAX_CHUNKS  = 1024;
+
+struct ResourceSlot
+{
+    std::atomic<uint32_t>     generation {0};
+    std::atomic<uint32_t>     refCount {0};
+    std::atomic<unsigned int> name {0};
+};
+
+struct ResourcePool
+{
+    std::unique_ptr<ResourceSlot[]> chunks[MAX_CHUNKS];
+    uint32_t                        size = 0; // slots ever handed out
+    std::vector<uint32_t>           freeSlots;
+    std::atomic<int>                liveCount {0};
+    std::mutex                      mutex;
+};
+
+struct PendingDelete
+{
+    ResourceType type;
+    unsigned int name;
+    uint64_t     frame; // released in
+};
+
+static ResourcePool              s_pools[RESOURCE_TYPE_COUNT];
+static std::mutex                s_pendingMutex;
+static std::deque<PendingDelete> s_pending;
+static uint64_t                  s_frame            = 0;
+static int                       s_peakPendingCount = 0;
+static std::atomic<int>          s_createdCount {0};
+static std::atomic<int>          s_deletedCount {0};
+
+static const char* typeName(ResourceType type)
+{
+    static const char* NAMES[] = {"texture", "buffer", "vertex array", "program", "geometry range"};
+    return NAMES[type];
+}
+
+static ResourceSlot* findSlot(const ResourceHandle& handle)
+{
+    if(!handle.isValid() || handle.type >= RESOURCE_TYPE_COUNT || handle.index / CHUNK_SLOTS >= MAX_CHUNKS)
+    {
+        return nullptr;
+    }
+    ResourceSlot* chunk = s_pools[handle.type].chunks[handle.index / CHUNK_SLOTS].get();
+    if(!chunk)
+    {
+        return nullptr;
+    }
+    ResourceSlot* slot = &chunk[handle.index % CHUNK_SLOTS];
+    return slot->generation.load(std::memory_order_acquire) == handle.generation ? slot : nullptr;
+}
+
+static void destroy(ResourceType type, unsigned int name)
+{
+    switch(type)
+    {
+    case RESOURCE_TEXTURE:
+        glDeleteTextures(1, &name);
+        break;
+    case RESOURCE_BUFFER:
+        glDeleteBuffers(1, &name);
+        break;
+    case RESOURCE_VERTEX_ARRAY:
+        glDeleteVertexArrays(1, &name);
+        break;
+    case RESOURCE_PROGRAM:
+        glDeleteProgram(name);
+        break;
+    case RESOURCE_GEOMETRY_RANGE:
+        BufferAllocator::geometry()->free(name);
+        break;
+    default:
+        break;
+    }
+    s_deletedCount++;
+}
+
+ResourceHandle ResourceManager::create(ResourceType type, unsigned int name)
+{
+    ResourcePool&  pool = s_pools[type];
+    ResourceHandle handle;
+    handle.type = type;
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        if(!pool.freeSlots.empty())
+        {
+            handle.index = pool.freeSlots.back();
+            pool.freeSlots.pop_back();
+        }
+        else
+        {
+            if(pool.size == CHUNK_SLOTS * MAX_CHUNKS)
+            {
+                GL_LOG_E("resource manager: more than %u live %ss", pool.size, typeName(type));
+                std::abort();
+            }
+            if(pool.size % CHUNK_SLOTS == 0)
+            {
+                pool.chunks[pool.size / CHUNK_SLOTS].reset(new ResourceSlot[CHUNK_SLOTS]);
+            }
+            handle.index = pool.size++;
+        }
+    }
+    ResourceSlot& slot = pool.chunks[handle.index / CHUNK_SLOTS][handle.index % CHUNK_SLOTS];
+    slot.name.store(name, std::memory_order_relaxed);
+    slot.refCount.store(1, std::memory_order_relaxed);
+    handle.generation = slot.generation.load(std::memory_order_relaxed);
+    pool.liveCount++;
+    s_createdCount++;
+    return handle;
+}
+
+void ResourceManager::acquire(const ResourceHandle& handle)
+{
+    if(!handle.isValid())
+    {
+        return;
+    }
+    ResourceSlot* slot = findSlot(handle);
+    if(!slot)
+    {
+        GL_LOG_E("resource manager: acquire of a released %s, slot %u", typeName(handle.type), handle.index);
+        std::abort();
+    }
+    // the caller holds a reference already, nothing can drop the count to zero meanwhile
+    slot->refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ResourceManager::release(const ResourceHandle& handle)
+{
+    if(!handle.isValid())
+    {
+        return;
+    }
+    ResourceSlot* slot = findSlot(handle);
+    if(!slot)
+    {
+        GL_LOG_E("resource manager: release of a released %s, slot %u", typeName(handle.type), handle.index);
+        std::abort();
+    }
+    if(slot->refCount.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    {
+        return;
+    }
+
+    // last reference. stale handles stop resolving now, the slot can be reused right away since
+    // the queue keeps the name
+    unsigned int  name = slot->name.load(std::memory_order_relaxed);
+    ResourcePool& pool = s_pools[handle.type];
+    slot->generation.fetch_add(1, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        pool.freeSlots.push_back(handle.index);
+    }
+    pool.liveCount--;
+
+    std::lock_guard<std::mutex> lock(s_pendingMutex);
+    s_pending.push_back({handle.type, name, s_frame});
+    s_peakPendingCount = std::max(s_peakPendingCount, static_cast<int>(s_pending.size()));
+}
+
+unsigned int ResourceManager::name(const ResourceHandle& handle)
+{
+    ResourceSlot* slot = findSlot(handle);
+    return slot ? slot->name.load(std::memory_order_relaxed) : 0;
+}
+
+bool ResourceManager::isAlive(const ResourceHandle& handle)
+{
+    return findSlot(handle) != nullptr;
+}
+
+uint32_t ResourceManager::refCount(const ResourceHandle& handle)
+{
+    ResourceSlot* slot = findSlot(handle);
+    return slot ? slot->refCount.load(std::memory_order_relaxed) : 0;
+}
+
+void ResourceManager::collect()
+{
+    // take the due ones out first, deleting may release other resources
+    std::vector<PendingDelete> due;
+    {
+        std::lock_guard<std::mutex> lock(s_pendingMutex);
+        s_frame++;
+        while(!s_pending.empty() && s_pending.front().frame + DELETE_DELAY <= s_frame)
+        {
+            due.push_back(s_pending.front());
+            s_pending.pop_front();
+        }
+    }
+    for(const auto& pending : due)
+    {
+        destroy(pending.type, pending.name);
+    }
+}
+
+void ResourceManager::shutdown()
+{
+    std::deque<PendingDelete> pending;
+    {
+        std::lock_guard<std::mutex> lock(s_pendingMutex);
+        pending.swap(s_pending);
+    }
+    for(const auto& item : pending)
+    {
+        destroy(item.type, item.name);
+    }
+    logStats();
+    for(int type = 0; type < RESOURCE_TYPE_COUNT; type++)
+    {
+        if(s_pools[type].liveCount > 0)
+        {
+            GL_LOG_W("resource manager: %d %ss still referenced at shutdown", s_pools[type].liveCount.load(), typeName(static_cast<ResourceType>(type)));
+        }
+    }
+}
+
+ResourceManagerStats ResourceManager::stats()
+{
+    ResourceManagerStats stats;
+    for(int type = 0; type < RESOURCE_TYPE_COUNT; type++)
+    {
+        ResourcePool&               pool = s_pools[type];
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        stats.liveCount[type] = pool.liveCount;
+        stats.poolBytes += (pool.size + CHUNK_SLOTS - 1) / CHUNK_SLOTS * CHUNK_SLOTS * sizeof(ResourceSlot) + pool.freeSlots.capacity() * sizeof(uint32_t);
+    }
+    std::lock_guard<std::mutex> lock(s_pendingMutex);
+    stats.createdCount     = s_createdCount;
+    stats.deletedCount     = s_deletedCount;
+    stats.pendingCount     = static_cast<int>(s_pending.size());
+    stats.peakPendingCount = s_peakPendingCount;
+    return stats;
+}
+
+void ResourceManager::logStats()
+{
+    auto stats = ResourceManager::stats();
+    GL_LOG_I("resource manager: %d textures %d buffers %d vertex arrays %d programs %d geometry ranges live, %d created %d deleted, %d pending (peak %d), "
+             "pools %.2f KB",
+             stats.liveCount[RESOURCE_TEXTURE], stats.liveCount[RESOURCE_BUFFER], stats.liveCount[RESOURCE_VERTEX_ARRAY], stats.liveCount[RESOURCE_PROGRAM],
+             stats.liveCount[RESOURCE_GEOMETRY_RANGE], stats.createdCount, stats.deletedCount, stats.pendingCount, stats.peakPendingCount, stats.poolBytes / 1024.0);
+}
@@ -0,0 +1,58 @@
+#include "samplerCache.h"
+#include "log.h"
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+std::vector<std::pair<SamplerDesc, unsigned int>> SamplerCache::s_samplers;
+
+bool SamplerDesc::operator==(const SamplerDesc& other) const
+{
+    return minFilter == other.minFilter && magFilter == other.magFilter && wrapS == other.wrapS && wrapT == other.wrapT && wrapR == other.wrapR && anisotropy == other.anisotropy &&
+           borderColor == other.borderColor;
+}
+
+unsigned int SamplerCache::get(const SamplerDesc& desc)
+{
+    SamplerDesc resolved = desc;
+    resolved.minFilter   = desc.minFilter ? desc.minFilter : GL_LINEAR;
+    resolved.magFilter   = desc.magFilter ? desc.magFilter : GL_LINEAR;
+    resolved.wrapS       = desc.wrapS ? desc.wrapS : GL_REPEAT;
+    resolved.wrapT       = desc.wrapT ? desc.wrapT : GL_REPEAT;
+    resolved.wrapR       = desc.wrapR ? desc.wrapR : GL_REPEAT;
+
+    // a scene has few distinct samplers, a linear search beats hashing them
+    for(const auto& sampler : s_samplers)
+    {
+        if(sampler.first == resolved)
+        {
+            return sampler.second;
+        }
+    }
+
+    unsigned int id;
+    glCreateSamplers(1, &id);
+    glSamplerParameteri(id, GL_TEXTURE_MIN_FILTER, resolved.minFilter);
+    glSamplerParameteri(id, GL_TEXTURE_MAG_FILTER, resolved.magFilter);
+    glSamplerParameteri(id, GL_TEXTURE_WRAP_S, resolved.wrapS);
+    glSamplerParameteri(id, GL_TEXTURE_WRAP_T, resolved.wrapT);
+    glSamplerParameteri(id, GL_TEXTURE_WRAP_R, resolved.wrapR);
+    glSamplerParameterfv(id, GL_TEXTURE_BORDER_COLOR, resolved.borderColor.data());
+    if(resolved.anisotropy > 1.0f)
+    {
+        glSamplerParameterf(id, GL_TEXTURE_MAX_ANISOTROPY, resolved.anisotropy);
+    }
+    s_samplers.emplace_back(resolved, id);
+    GL_LOG_D("create sampler %d min 0x%x mag 0x%x wrap 0x%x 0x%x 0x%x anisotropy %.1f", id, resolved.minFilter, resolved.magFilter, resolved.wrapS, resolved.wrapT, resolved.wrapR, resolved.anisotropy);
+    return id;
+}
+
+void SamplerCache::clear()
+{
+    for(const auto& sampler : s_samplers)
+    {
+        glDeleteSamplers(1, &sampler.second);
+    }
+    s_samplers.clear();
+}
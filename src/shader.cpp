@@ -1,6 +1,10 @@
 #include "shader.h"
 #include "log.h"
-#include <fstream>
+#include "packFile.h"
+#include "programBinaryCache.h"
+#include <chrono>
+#include <filesystem>
+#include <memory>
 #include <sstream>
 
 // clang-format off
@@ -9,13 +13,20 @@
 // clang-format off
 
 ShaderProgram::Shader::Shader(const std::string& path, ShaderType type)
-    :m_type(type)
+    :m_type(type), m_name(path)
 {
-    std::ifstream     ifs(path);
-    std::stringstream ss;
-    ss << ifs.rdbuf();
+    compile(readFile(path));
+}
 
-    switch (type)
+ShaderProgram::Shader::Shader(const ShaderSource& source)
+    :m_type(source.type), m_name(source.name)
+{
+    compile(source.source);
+}
+
+void ShaderProgram::Shader::compile(const std::string& source)
+{
+    switch (m_type)
     {
     case VERTEX_SHADER:
         m_id = glCreateShader(GL_VERTEX_SHADER);
@@ -26,19 +37,16 @@ ShaderProgram::Shader::Shader(const std::string& path, ShaderType type)
     case GEOMETRY_SHADER:
         m_id = glCreateShader(GL_GEOMETRY_SHADER);
         break;     
+    case COMPUTE_SHADER:
+        m_id = glCreateShader(GL_COMPUTE_SHADER);
+        break;
     default:
-        GL_LOG_E("you must set shaderType, now is %d", type);
+        GL_LOG_E("you must set shaderType, now is %d", m_type);
         std::abort();   
     }
-    std::string sourceStr = ss.str();
-    const char* shaderSource = sourceStr.c_str();
+    const char* shaderSource = source.c_str();
     glShaderSource(m_id, 1, &shaderSource, nullptr);
     glCompileShader(m_id);
-    if (!checkError())
-    {
-        GL_LOG_E("complie shader error. path %s type %d", path.c_str(), type);
-        std::abort();
-    }
 }
 
 bool ShaderProgram::Shader::checkError()
@@ -49,6 +57,7 @@ bool ShaderProgram::Shader::checkError()
     if (!success)
     {
         glGetShaderInfoLog(m_id, 512, NULL, infoLog);
+        GL_LOG_E("complie shader error. path %s type %d", m_name.c_str(), m_type);
         GL_LOG_E("gl error : %s", infoLog);
         return false;
     }
@@ -64,69 +73,425 @@ ShaderProgram::Shader::~Shader()
 // ------------------ ShaderProgram ------------------
 
 ShaderProgram::ShaderProgram(const std::string& vertextPath, const std::string& fragmentPath)
-    :m_id(glCreateProgram())
+    : ShaderProgram(std::vector<ShaderSource>{{VERTEX_SHADER, preprocess(vertextPath), vertextPath},
+                                              {FRAGMENT_SHADER, preprocess(fragmentPath), fragmentPath}})
 {
-    Shader vertextShader(vertextPath, ShaderType::VERTEX_SHADER);
-    Shader fragmentShader(fragmentPath, ShaderType::FRAGMENT_SHADER);
-    linkShader(vertextShader.id(), fragmentShader.id());
-    GL_LOG_D("init shader suceess:");
-    GL_LOG_D("vertex: %s ", vertextPath.c_str());
-    GL_LOG_D("fragment: %s ", fragmentPath.c_str());
-
 }
 
 ShaderProgram::ShaderProgram(const std::string& vertextPath,
                 const std::string& fragmentPath,
                 const std::string& geometryPath)
+    : ShaderProgram(std::vector<ShaderSource>{{VERTEX_SHADER, preprocess(vertextPath), vertextPath},
+                                              {FRAGMENT_SHADER, preprocess(fragmentPath), fragmentPath},
+                                              {GEOMETRY_SHADER, preprocess(geometryPath), geometryPath}})
 {
-    Shader vertextShader(vertextPath, ShaderType::VERTEX_SHADER);
-    Shader fragmentShader(fragmentPath, ShaderType::FRAGMENT_SHADER);
-    Shader geometryShader(geometryPath, ShaderType::GEOMETRY_SHADER);
-    linkShader(vertextShader.id(), fragmentShader.id(), geometryShader.id());
-    GL_LOG_D("init shader suceess:");
-    GL_LOG_D("vertex: %s ", vertextPath.c_str());
-    GL_LOG_D("fragment: %s ", fragmentPath.c_str());
-    GL_LOG_D("geometry: %s ", geometryPath.c_str());
+}
 
+ShaderProgram::ShaderProgram(const std::vector<ShaderSource>& sources, bool isSeparable)
+    : ShaderProgram(sources, isSeparable, DeferredTag())
+{
+    submitLink();
+}
+
+ShaderProgram::ShaderProgram(const std::vector<ShaderSource>& sources, bool isSeparable, DeferredTag)
+    :m_id(0), m_isSeparable(isSeparable)
+{
+    static const unsigned int STAGE_BITS[] = {GL_VERTEX_SHADER_BIT, GL_FRAGMENT_SHADER_BIT, GL_GEOMETRY_SHADER_BIT, GL_COMPUTE_SHADER_BIT};
+    for (const auto& source : sources)
+    {
+        m_stageBits |= STAGE_BITS[source.type];
+    }
+
+    enableParallelCompile();
+    m_startTime = std::chrono::steady_clock::now();
+    m_name      = sources.empty() ? "" : sources.back().name;
+    m_cacheKey  = ProgramBinaryCache::hash(sources, m_isSeparable);
+    m_id        = glCreateProgram();
+    glProgramParameteri(m_id, GL_PROGRAM_SEPARABLE, m_isSeparable);
+    m_isCached  = ProgramBinaryCache::load(m_id, m_cacheKey);
+    if (m_isCached)
+    {
+        m_handle    = ResourceManager::create(RESOURCE_PROGRAM, m_id);
+        m_isPending = true;
+        return;
+    }
+
+    // a program that failed to load a binary may be left in a failed state, start clean
+    glDeleteProgram(m_id);
+    m_id     = glCreateProgram();
+    m_handle = ResourceManager::create(RESOURCE_PROGRAM, m_id);
+    glProgramParameteri(m_id, GL_PROGRAM_SEPARABLE, m_isSeparable);
+    submitCompile(sources);
 }
 
 ShaderProgram::~ShaderProgram()
 {
     GL_LOG_D("release shader program %d", m_id);
-    glDeleteProgram(m_id);
+    ResourceManager::release(m_handle);
 }
 
-void ShaderProgram::linkShader(unsigned int vertexId, unsigned int fragmentId)
+std::vector<std::unique_ptr<ShaderProgram>> ShaderProgram::createBatch(const std::vector<std::vector<ShaderSource>>& programs, bool isSeparable)
 {
-    glAttachShader(m_id, vertexId);
-    glAttachShader(m_id, fragmentId);
-    glLinkProgram(m_id);
-    if (!checkError())
+    std::vector<std::unique_ptr<ShaderProgram>> result;
+    result.reserve(programs.size());
+    for (const auto& sources : programs)
     {
-        GL_LOG_E("link shader error %d", m_id);
-        std::abort();
+        result.emplace_back(new ShaderProgram(sources, isSeparable, DeferredTag()));
+    }
+    for (auto& program : result)
+    {
+        program->submitLink();
+    }
+    return result;
+}
+
+void ShaderProgram::enableParallelCompile()
+{
+    static bool isEnabled = false;
+    if (!isEnabled && GLAD_GL_KHR_parallel_shader_compile)
+    {
+        // let the driver pick the number of threads
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+        GL_LOG_I("GL_KHR_parallel_shader_compile enabled");
+    }
+    isEnabled = true;
+}
+
+void ShaderProgram::submitCompile(const std::vector<ShaderSource>& sources)
+{
+    for (const auto& source : sources)
+    {
+        m_shaders.push_back(std::make_unique<Shader>(source));
+        glAttachShader(m_id, m_shaders.back()->id());
     }
 }
 
-void ShaderProgram::linkShader(unsigned int vertexId, unsigned int fragmentId, unsigned int geometryId)
+void ShaderProgram::submitLink()
 {
-    glAttachShader(m_id, vertexId);
-    glAttachShader(m_id, fragmentId);
-    glAttachShader(m_id, geometryId);
+    if (m_isCached)
+    {
+        return;
+    }
+    if (ProgramBinaryCache::isEnabled())
+    {
+        glProgramParameteri(m_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     glLinkProgram(m_id);
-    if (!checkError())
+    m_isPending = true;
+}
+
+bool ShaderProgram::isReady() const
+{
+    if (!m_isPending || !GLAD_GL_KHR_parallel_shader_compile)
+    {
+        return true;
+    }
+    int isCompleted = 0;
+    glGetProgramiv(m_id, GL_COMPLETION_STATUS_KHR, &isCompleted);
+    return isCompleted;
+}
+
+void ShaderProgram::finish() const
+{
+    if (!m_isPending)
     {
-        GL_LOG_E("link shader error");
+        return;
+    }
+    m_isPending = false;
+
+    if (!m_isCached)
+    {
+        if (!checkError())
+        {
+            // the link log rarely says which stage failed, the compile logs do
+            for (const auto& shader : m_shaders)
+            {
+                shader->checkError();
+            }
+            GL_LOG_E("link shader error %d %s", m_id, m_name.c_str());
+            std::abort();
+        }
+        ProgramBinaryCache::store(m_id, m_cacheKey);
+        for (const auto& shader : m_shaders)
+        {
+            glDetachShader(m_id, shader->id());
+        }
+        m_shaders.clear();
+    }
+
+    // time from construction to first use, for deferred programs this overlaps other work
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count();
+    GL_LOG_I("program %s: %.2f ms (%s)", m_name.c_str(), ms, m_isCached ? "warm, binary cache" : "cold, compiled");
+}
+
+std::string ShaderProgram::readFile(const std::string& path)
+{
+    FileData file;
+    if (!PackFile::load(path, file))
+    {
+        GL_LOG_E("can't open shader file %s", path.c_str());
         std::abort();
     }
+    return std::string(reinterpret_cast<const char*>(file.data), file.size);
+}
+
+std::string ShaderProgram::preprocess(const std::string& path, const ShaderDefines& defines, std::vector<std::string>* dependencies)
+{
+    std::set<std::string> included;
+    std::string           body;
+    appendFile(path, body, included, 0);
+    if (dependencies)
+    {
+        dependencies->insert(dependencies->end(), included.begin(), included.end());
+    }
+
+    // #version has to stay the first statement, the defines go right after it
+    size_t versionEnd = 0;
+    if (body.compare(0, 8, "#version") == 0)
+    {
+        versionEnd = body.find('\n');
+        versionEnd = versionEnd == std::string::npos ? body.size() : versionEnd + 1;
+    }
+    std::string source = body.substr(0, versionEnd);
+    for (const auto& define : defines)
+    {
+        source += "#define " + define.first + (define.second.empty() ? "" : " " + define.second) + "\n";
+    }
+    if (!defines.empty())
+    {
+        source += versionEnd > 0 ? "#line 2\n" : "#line 1\n";
+    }
+    source += body.substr(versionEnd);
+    return source;
+}
+
+void ShaderProgram::appendFile(const std::string& path, std::string& out, std::set<std::string>& included, int depth)
+{
+    // problems are spliced in as #error, so they fail the compile like any other shader error and
+    // a hot reload keeps the running program instead of aborting the worker
+    if (depth > 16)
+    {
+        GL_LOG_E("shader include depth exceeded at %s", path.c_str());
+        out += "#error include depth exceeded at " + path + "\n";
+        return;
+    }
+    included.insert(path);
+
+    FileData file;
+    if (!PackFile::load(path, file))
+    {
+        GL_LOG_E("can't open shader file %s", path.c_str());
+        out += "#error missing shader file " + path + "\n";
+        return;
+    }
+    std::string        directory = path.substr(0, path.find_last_of("/\\") + 1);
+    std::istringstream iss(std::string(reinterpret_cast<const char*>(file.data), file.size));
+    std::string        line;
+    int                lineNumber = 0;
+    while (std::getline(iss, line))
+    {
+        lineNumber++;
+        size_t first = line.find_first_not_of(" \t");
+        if (first == std::string::npos || line.compare(first, 8, "#include") != 0)
+        {
+            out += line;
+            out += '\n';
+            continue;
+        }
+
+        size_t open  = line.find('"', first + 8);
+        size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+        if (close == std::string::npos)
+        {
+            GL_LOG_E("bad #include in %s:%d", path.c_str(), lineNumber);
+            out += "#error bad include\n";
+            continue;
+        }
+        std::string includePath = std::filesystem::path(directory + line.substr(open + 1, close - open - 1)).lexically_normal().generic_string();
+        // keep compile errors pointing at the right line, of the included file and of this one
+        if (included.count(includePath) == 0)
+        {
+            out += "#line 1\n";
+            appendFile(includePath, out, included, depth + 1);
+        }
+        out += "#line " + std::to_string(lineNumber + 1) + "\n";
+    }
 }
 
 void ShaderProgram::use()
 {
+    finish();
     glUseProgram(m_id);
 }
 
+void ShaderProgram::memoryBarrier(unsigned int barrierBits)
+{
+    glMemoryBarrier(barrierBits);
+}
+
+bool ShaderProgram::checkCompute() const
+{
+    if (!(m_stageBits & GL_COMPUTE_SHADER_BIT))
+    {
+        GL_LOG_E("program %s has no compute stage", m_name.c_str());
+        return false;
+    }
+    return true;
+}
+
+void ShaderProgram::dispatch(unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ)
+{
+    if (!checkCompute())
+    {
+        std::abort();
+    }
+    use();
+    glDispatchCompute(groupsX, groupsY, groupsZ);
+}
+
+void ShaderProgram::dispatchIndirect(unsigned int buffer, size_t offset)
+{
+    if (!checkCompute())
+    {
+        std::abort();
+    }
+    use();
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, buffer);
+    glDispatchComputeIndirect(static_cast<GLintptr>(offset));
+    glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+}
+
+void ShaderProgram::localSize(int size[3]) const
+{
+    size[0] = size[1] = size[2] = 0;
+    if (checkCompute())
+    {
+        glGetProgramiv(id(), GL_COMPUTE_WORK_GROUP_SIZE, size);
+    }
+}
+
+bool ShaderProgram::reload(const std::vector<ShaderSource>& sources)
+{
+    finish();
+
+    // compile synchronously, the caller wants to know right away whether the swap happened
+    unsigned int program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_SEPARABLE, m_isSeparable);
+    std::vector<std::unique_ptr<Shader>> shaders;
+    bool isCompiled = true;
+    for (const auto& source : sources)
+    {
+        shaders.push_back(std::make_unique<Shader>(source));
+        isCompiled = shaders.back()->checkError() && isCompiled;
+        glAttachShader(program, shaders.back()->id());
+    }
+    int isLinked = 0;
+    if (isCompiled)
+    {
+        if (ProgramBinaryCache::isEnabled())
+        {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(program);
+        glGetProgramiv(program, GL_LINK_STATUS, &isLinked);
+        if (!isLinked)
+        {
+            char infoLog[512];
+            glGetProgramInfoLog(program, 512, nullptr, infoLog);
+            GL_LOG_E("gl error : %s", infoLog);
+        }
+    }
+    if (!isLinked)
+    {
+        GL_LOG_W("reload of program %s failed, keeping the old one", m_name.c_str());
+        glDeleteProgram(program);
+        return false;
+    }
+
+    copyUniforms(m_id, program);
+    ResourceManager::release(m_handle);
+    m_id       = program;
+    m_handle   = ResourceManager::create(RESOURCE_PROGRAM, m_id);
+    m_cacheKey = ProgramBinaryCache::hash(sources, m_isSeparable);
+    ProgramBinaryCache::store(m_id, m_cacheKey);
+    GL_LOG_I("reload program %s", m_name.c_str());
+    return true;
+}
+
+void ShaderProgram::copyUniforms(unsigned int from, unsigned int to)
+{
+    // usecases set samplers and constants once at startup, a reloaded program must not lose them
+    int uniformCount = 0;
+    glGetProgramiv(from, GL_ACTIVE_UNIFORMS, &uniformCount);
+    for (int i = 0; i < uniformCount; i++)
+    {
+        char   name[256];
+        int    size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(from, i, sizeof(name), nullptr, &size, &type, name);
+
+        // arrays are reported once as "name[0]"
+        std::string baseName = name;
+        if (size > 1 && baseName.size() > 3 && baseName.compare(baseName.size() - 3, 3, "[0]") == 0)
+        {
+            baseName.resize(baseName.size() - 3);
+        }
+        for (int element = 0; element < size; element++)
+        {
+            std::string elementName = size > 1 ? baseName + "[" + std::to_string(element) + "]" : baseName;
+            int fromLocation = glGetUniformLocation(from, elementName.c_str());
+            int toLocation   = glGetUniformLocation(to, elementName.c_str());
+            if (fromLocation < 0 || toLocation < 0)
+            {
+                continue;
+            }
+
+            float floats[16];
+            int   ints[4];
+            switch (type)
+            {
+            case GL_FLOAT:
+                glGetUniformfv(from, fromLocation, floats);
+                glProgramUniform1fv(to, toLocation, 1, floats);
+                break;
+            case GL_FLOAT_VEC2:
+                glGetUniformfv(from, fromLocation, floats);
+                glProgramUniform2fv(to, toLocation, 1, floats);
+                break;
+            case GL_FLOAT_VEC3:
+                glGetUniformfv(from, fromLocation, floats);
+                glProgramUniform3fv(to, toLocation, 1, floats);
+                break;
+            case GL_FLOAT_VEC4:
+                glGetUniformfv(from, fromLocation, floats);
+                glProgramUniform4fv(to, toLocation, 1, floats);
+                break;
+            case GL_FLOAT_MAT3:
+                glGetUniformfv(from, fromLocation, floats);
+                glProgramUniformMatrix3fv(to, toLocation, 1, GL_FALSE, floats);
+                break;
+            case GL_FLOAT_MAT4:
+                glGetUniformfv(from, fromLocation, floats);
+                glProgramUniformMatrix4fv(to, toLocation, 1, GL_FALSE, floats);
+                break;
+            case GL_INT:
+            case GL_BOOL:
+            case GL_SAMPLER_2D:
+            case GL_SAMPLER_2D_ARRAY:
+            case GL_SAMPLER_CUBE:
+                glGetUniformiv(from, fromLocation, ints);
+                glProgramUniform1iv(to, toLocation, 1, ints);
+                break;
+            default:
+                break;
+            }
+        }
+    }
+}
+
 // ----------------- uniform util function -----------------
+// glProgramUniform works without binding the program first, which also covers programs used
+// through a ProgramPipeline
 void ShaderProgram::setBool(const std::string& name, bool value) const
 {
     setInt(name, static_cast<int>(value));
@@ -134,25 +499,30 @@ void ShaderProgram::setBool(const std::string& name, bool value) const
 
 void ShaderProgram::setInt(const std::string& name, int value) const
 {
-    glUniform1i(glGetUniformLocation(m_id, name.c_str()), value);
+    glProgramUniform1i(id(), glGetUniformLocation(id(), name.c_str()), value);
 }
 
 void ShaderProgram::setFloat(const std::string& name, float value) const
 {
-    glUniform1f(glGetUniformLocation(m_id, name.c_str()), value);
+    glProgramUniform1f(id(), glGetUniformLocation(id(), name.c_str()), value);
 }
 
 void ShaderProgram::setMat4(const std::string& name, const float* value) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(m_id, name.c_str()), 1, GL_FALSE, value);
+    glProgramUniformMatrix4fv(id(), glGetUniformLocation(id(), name.c_str()), 1, GL_FALSE, value);
 }
 
 void ShaderProgram::setVec3(const std::string& name, const float* value) const
 {
-    glUniform3fv(glGetUniformLocation(m_id, name.c_str()), 1, value); 
+    glProgramUniform3fv(id(), glGetUniformLocation(id(), name.c_str()), 1, value);
+}
+
+void ShaderProgram::setVec4(const std::string& name, const float* value) const
+{
+    glProgramUniform4fv(id(), glGetUniformLocation(id(), name.c_str()), 1, value);
 }
 
-bool ShaderProgram::checkError()
+bool ShaderProgram::checkError() const
 {
     int success;
     glGetProgramiv(m_id, GL_LINK_STATUS, &success);
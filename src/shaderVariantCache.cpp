@@ -0,0 +1,37 @@
+#include "shaderVariantCache.h"
+#include "log.h"
+
+ShaderVariantCache::ShaderVariantCache(const std::string& vertexPath, const std::string& fragmentPath)
+    : m_vertexPath(vertexPath)
+    , m_fragmentPath(fragmentPath)
+{ }
+
+ShaderProgram& ShaderVariantCache::get(const ShaderDefines& defines)
+{
+    std::string variantKey = key(defines);
+    auto        iter       = m_variants.find(variantKey);
+    if(iter != m_variants.end())
+    {
+        return *iter->second;
+    }
+
+    GL_LOG_I("compile variant of %s: [%s]", m_fragmentPath.c_str(), variantKey.c_str());
+    std::vector<ShaderSource> sources = {
+        {VERTEX_SHADER, ShaderProgram::preprocess(m_vertexPath, defines), m_vertexPath},
+        {FRAGMENT_SHADER, ShaderProgram::preprocess(m_fragmentPath, defines), m_fragmentPath},
+    };
+    auto& program = m_variants[variantKey];
+    program       = std::make_unique<ShaderProgram>(sources);
+    return *program;
+}
+
+std::string ShaderVariantCache::key(const ShaderDefines& defines)
+{
+    std::string result;
+    for(const auto& define : defines)
+    {
+        result += result.empty() ? "" : " ";
+        result += define.second.empty() ? define.first : define.first + "=" + define.second;
+    }
+    return result;
+}
@@ -1,5 +1,15 @@
 #include "texture.h"
 #include "log.h"
+#include "packFile.h"
+#include "parallel.h"
+#include "resourceManager.h"
+#include "samplerCache.h"
+#include "textureCompressor.h"
+#include "textureUploader.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 // clang-format off
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -8,6 +18,61 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
+// ARB_sparse_texture, on most desktop drivers but not in every glad build
+#ifndef GL_TEXTURE_SPARSE_ARB
+#    define GL_TEXTURE_SPARSE_ARB 0x91A6
+#    define GL_VIRTUAL_PAGE_SIZE_X_ARB 0x9195
+#    define GL_VIRTUAL_PAGE_SIZE_Y_ARB 0x9196
+#    define GL_NUM_SPARSE_LEVELS_ARB 0x91AA
+#endif
+
+// streamed textures start with the levels up to this size resident
+static const int STREAM_RESIDENT_SIZE = 128;
+
+struct TextureStream
+{
+    TextureImage image;         // every level, uncompressed or as the texture stores them
+    int          residentLevel; // largest level in video memory
+    int          minLevel;      // never released below this
+    int          tailLevel;     // sparse levels from here on share pages and are committed together
+    bool         isSparse;
+};
+
+struct TextureSampler
+{
+    SamplerDesc  desc;
+    unsigned int id;
+};
+
+using TexPageCommitmentFunc = void(APIENTRY*)(GLenum, GLint, GLint, GLint, GLint, GLsizei, GLsizei, GLsizei, GLboolean);
+
+static TexPageCommitmentFunc texPageCommitment()
+{
+    static bool                  isChecked = false;
+    static TexPageCommitmentFunc func      = nullptr;
+    if (!isChecked)
+    {
+        isChecked     = true;
+        int extensions = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensions);
+        for (int i = 0; i < extensions; i++)
+        {
+            if (strcmp(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)), "GL_ARB_sparse_texture") == 0)
+            {
+                func = reinterpret_cast<TexPageCommitmentFunc>(glfwGetProcAddress("glTexPageCommitmentARB"));
+                break;
+            }
+        }
+        if (!func)
+        {
+            GL_LOG_W("no sparse textures, streamed textures keep every level allocated");
+        }
+    }
+    return func;
+}
+
+TextureUploader* Texture::s_uploader = nullptr;
+
 std::string Texture::translateTextureTypeName(TextureType textureType)
 {
     std::string textureTypename = "";
@@ -35,130 +100,760 @@ std::string Texture::translateTextureTypeName(TextureType textureType)
 }
 
 
-Texture::Texture(const std::string& path, TextureType textureType, bool isFlip)
-    :m_type(textureType)
+TextureOptions TextureOptions::forType(TextureType textureType)
 {
-    m_refCnt = new unsigned(1);
-    glGenTextures(1, &m_id);
-    glBindTexture(GL_TEXTURE_2D, m_id);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);   
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    TextureOptions options;
+    options.isSrgb      = textureType == TextureType::TEXTURE_DIFFUSE || textureType == TextureType::TEXTURE_AMBIENT;
+    options.compression = textureType == TextureType::TEXTURE_NORMAL ? TEXTURE_COMPRESSION_BC5 : TEXTURE_COMPRESSION_AUTO;
+    return options;
+}
 
-    TextureProperty property;
-    property.path = path;
-
-    stbi_set_flip_vertically_on_load(isFlip);
-    unsigned char* data = stbi_load(path.c_str(), &property.width, &property.height, &property.nrChannels, 0);
-    if (data)
-    {
-        switch (property.nrChannels)
-        {
-        case 3:
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, property.width, property.height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            break;
-        case 4:
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, property.width, property.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-            // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);   
-            // glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-            break;
-        default:
-            GL_LOG_E("load texture failed. don't support nr channels %d", property.nrChannels);
-            std::abort();
-            break;
+// ------------------ mip generation ------------------
+
+// half width of the kaiser window in destination texels, and its shape
+static const float KAISER_WIDTH = 2.0f;
+static const float KAISER_ALPHA = 4.0f;
+// below this many source texels a pass isn't worth a thread
+static const size_t MIP_TEXELS_PER_THREAD = 64 * 1024;
+
+static float srgbToLinear(float c)
+{
+    return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linearToSrgb(float c)
+{
+    return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+// zeroth order modified bessel function of the first kind
+static float besselI0(float x)
+{
+    float sum  = 1.0f;
+    float term = 1.0f;
+    for (int k = 1; k < 32 && term > sum * 1e-8f; k++)
+    {
+        term *= (x * x) / (4.0f * k * k);
+        sum += term;
+    }
+    return sum;
+}
+
+static float kaiserWeight(float t)
+{
+    if (std::fabs(t) >= KAISER_WIDTH)
+    {
+        return 0.0f;
+    }
+    float sinc   = t == 0.0f ? 1.0f : std::sin(3.14159265f * t) / (3.14159265f * t);
+    float r      = t / KAISER_WIDTH;
+    float window = besselI0(KAISER_ALPHA * std::sqrt(1.0f - r * r)) / besselI0(KAISER_ALPHA);
+    return sinc * window;
+}
+
+struct FilterTaps
+{
+    int                first; // source texel of weights[0], may be outside the image, clamped on use
+    std::vector<float> weights;
+};
+
+// weights of every destination texel along one axis, the filter is separable
+static std::vector<FilterTaps> computeTaps(int srcSize, int dstSize, MipFilter filter)
+{
+    float scale  = static_cast<float>(srcSize) / dstSize;
+    float radius = filter == MIP_FILTER_KAISER ? KAISER_WIDTH * scale : 0.5f * scale;
+
+    std::vector<FilterTaps> taps(dstSize);
+    for (int x = 0; x < dstSize; x++)
+    {
+        float center = (x + 0.5f) * scale;
+        int   first  = static_cast<int>(std::floor(center - radius));
+        int   last   = static_cast<int>(std::ceil(center + radius)) - 1;
+        float sum    = 0.0f;
+        taps[x].first = first;
+        for (int i = first; i <= last; i++)
+        {
+            float weight;
+            if (filter == MIP_FILTER_KAISER)
+            {
+                weight = kaiserWeight((i + 0.5f - center) / scale);
+            }
+            else
+            {
+                // covered part of the texel, odd sizes give the border texels partial weight
+                weight = std::max(0.0f, std::min(i + 1.0f, center + radius) - std::max(static_cast<float>(i), center - radius));
+            }
+            taps[x].weights.push_back(weight);
+            sum += weight;
+        }
+        for (auto& weight : taps[x].weights)
+        {
+            weight /= sum;
         }
-        
-        glGenerateMipmap(m_id);
     }
-    else
+    return taps;
+}
+
+void Texture::generateMips(TextureImage& image, const TextureOptions& options)
+{
+    image.mips = buildMipChain(image, options);
+}
+
+int Texture::mipLevelCount(int width, int height)
+{
+    int levels = 1;
+    for (int size = std::max(width, height); size > 1; size /= 2)
+    {
+        levels++;
+    }
+    return levels;
+}
+
+Texture::MipChain Texture::buildMipChain(const TextureImage& image, const TextureOptions& options)
+{
+    MipChain mips;
+    int      levels = mipLevelCount(image.width, image.height);
+    if (options.mipFilter == MIP_FILTER_NONE || levels <= 1)
+    {
+        return mips;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // filter in float and from the previous float level, so rounding doesn't pile up down the chain.
+    // srgb colors are averaged as linear light, alpha is always linear
+    const int channels   = image.nrChannels;
+    const int colorCount = options.isSrgb ? std::min(channels, 3) : 0;
+    float     toLinear[256];
+    for (int i = 0; i < 256; i++)
+    {
+        toLinear[i] = srgbToLinear(i / 255.0f);
+    }
+
+    int                srcW = image.width;
+    int                srcH = image.height;
+    std::vector<float> src(image.pixels.size());
+    parallelFor(srcH, srcW, MIP_TEXELS_PER_THREAD, [&](int begin, int end) {
+        for (size_t i = static_cast<size_t>(begin) * srcW * channels; i < static_cast<size_t>(end) * srcW * channels; i++)
+        {
+            src[i] = i % channels < static_cast<size_t>(colorCount) ? toLinear[image.pixels[i]] : image.pixels[i] / 255.0f;
+        }
+    });
+
+    std::vector<float> tmp;
+    std::vector<float> dst;
+    for (int level = 1; level < levels; level++)
+    {
+        int  dstW   = std::max(1, srcW / 2);
+        int  dstH   = std::max(1, srcH / 2);
+        auto tapsX  = computeTaps(srcW, dstW, options.mipFilter);
+        auto tapsY  = computeTaps(srcH, dstH, options.mipFilter);
+        tmp.assign(static_cast<size_t>(dstW) * srcH * channels, 0.0f);
+        dst.assign(static_cast<size_t>(dstW) * dstH * channels, 0.0f);
+        mips.emplace_back(dst.size());
+        auto& out = mips.back();
+
+        // horizontal: srcW x srcH -> dstW x srcH
+        parallelFor(srcH, srcW, MIP_TEXELS_PER_THREAD, [&](int begin, int end) {
+            for (int y = begin; y < end; y++)
+            {
+                const float* row = &src[static_cast<size_t>(y) * srcW * channels];
+                for (int x = 0; x < dstW; x++)
+                {
+                    float* texel = &tmp[(static_cast<size_t>(y) * dstW + x) * channels];
+                    for (size_t t = 0; t < tapsX[x].weights.size(); t++)
+                    {
+                        int          sx     = std::min(std::max(tapsX[x].first + static_cast<int>(t), 0), srcW - 1);
+                        const float* sample = row + sx * channels;
+                        for (int c = 0; c < channels; c++)
+                        {
+                            texel[c] += tapsX[x].weights[t] * sample[c];
+                        }
+                    }
+                }
+            }
+        });
+
+        // vertical: dstW x srcH -> dstW x dstH, then quantize
+        parallelFor(dstH, static_cast<size_t>(dstW) * 2, MIP_TEXELS_PER_THREAD, [&](int begin, int end) {
+            for (int y = begin; y < end; y++)
+            {
+                float* row = &dst[static_cast<size_t>(y) * dstW * channels];
+                for (size_t t = 0; t < tapsY[y].weights.size(); t++)
+                {
+                    int          sy     = std::min(std::max(tapsY[y].first + static_cast<int>(t), 0), srcH - 1);
+                    const float* sample = &tmp[static_cast<size_t>(sy) * dstW * channels];
+                    for (int i = 0; i < dstW * channels; i++)
+                    {
+                        row[i] += tapsY[y].weights[t] * sample[i];
+                    }
+                }
+                for (int i = 0; i < dstW * channels; i++)
+                {
+                    // the kaiser lobes can overshoot
+                    row[i]     = std::min(std::max(row[i], 0.0f), 1.0f);
+                    float c    = i % channels < colorCount ? linearToSrgb(row[i]) : row[i];
+                    out[static_cast<size_t>(y) * dstW * channels + i] = static_cast<unsigned char>(c * 255.0f + 0.5f);
+                }
+            }
+        });
+
+        std::swap(src, dst);
+        srcW = dstW;
+        srcH = dstH;
+    }
+
+    auto end = std::chrono::steady_clock::now();
+    GL_LOG_D("generate %d mips of %s (%dx%d) in %.2f ms", levels - 1, image.path.c_str(), image.width, image.height, std::chrono::duration<double, std::milli>(end - start).count());
+    return mips;
+}
+
+// ------------------ Texture ------------------
+
+bool Texture::decode(const std::string& path, bool isFlip, TextureImage& image)
+{
+    // from a mounted pack if it has the file, decoded straight from the mapping when stored
+    FileData file;
+    if (!PackFile::load(path, file))
     {
         GL_LOG_E("Failed to load texture %s", path.c_str());
-        std::abort();
+        return false;
     }
-    m_properties.push_back(property);
+    return decode(path, file.data, file.size, isFlip, image);
+}
 
-    GL_LOG_D("load texture %s type %s witdh %d height %d nrChannels %d", property.path.c_str(), translateTextureTypeName(m_type).c_str(), property.width, property.height, property.nrChannels);
+bool Texture::decode(const std::string& path, const unsigned char* file, size_t fileSize, bool isFlip, TextureImage& image)
+{
+    // flip by hand, stbi_set_flip_vertically_on_load is global state shared by every thread
+    int            fileChannels = 0;
+    unsigned char* data         = stbi_load_from_memory(file, static_cast<int>(fileSize), &image.width, &image.height, &fileChannels, 0);
+    if (!data)
+    {
+        GL_LOG_E("Failed to load texture %s", path.c_str());
+        return false;
+    }
+    if (fileChannels < 1 || fileChannels > 4)
+    {
+        GL_LOG_E("load texture failed. don't support nr channels %d", fileChannels);
+        stbi_image_free(data);
+        return false;
+    }
+
+    // gray and gray + alpha become rgb and rgba
+    image.nrChannels = fileChannels <= 2 ? fileChannels + 2 : fileChannels;
+    size_t rowSize   = static_cast<size_t>(image.width) * image.nrChannels;
+    image.path       = path;
+    image.pixels.resize(rowSize * image.height);
+    for (int y = 0; y < image.height; y++)
+    {
+        int                  srcRow = isFlip ? image.height - 1 - y : y;
+        const unsigned char* src    = data + static_cast<size_t>(srcRow) * image.width * fileChannels;
+        unsigned char*       dst    = &image.pixels[y * rowSize];
+        if (fileChannels > 2)
+        {
+            memcpy(dst, src, rowSize);
+            continue;
+        }
+        for (int x = 0; x < image.width; x++, src += fileChannels, dst += image.nrChannels)
+        {
+            dst[0] = dst[1] = dst[2] = src[0];
+            if (fileChannels == 2)
+            {
+                dst[3] = src[1];
+            }
+        }
+    }
     stbi_image_free(data);
+    return true;
 }
 
-Texture::Texture(const std::vector<std::string>& paths, TextureType textureType, bool isFlip)
-    :m_type(textureType)
+bool Texture::load(const std::string& path, bool isFlip, const TextureOptions& options, TextureImage& image, bool isStaged)
 {
-    m_refCnt = new unsigned(1);
-    glGenTextures(1, &m_id);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, m_id);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);   
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    bool     isCached = options.compression != TEXTURE_COMPRESSION_NONE && options.isCached;
+    uint64_t key      = 0;
+    if (isCached)
+    {
+        key = TextureCompressor::cacheKey(path, isFlip, options);
+        if (TextureCompressor::loadCache(path, key, image))
+        {
+            if (isStaged && !options.isStreamed)
+            {
+                stage(image);
+            }
+            return true;
+        }
+    }
 
-    stbi_set_flip_vertically_on_load(isFlip);
-    for (size_t i = 0; i < paths.size(); i++)
+    if (!decode(path, isFlip, image))
     {
-        TextureProperty property;
-        property.path = paths[i];
-        unsigned char* data = stbi_load(property.path.c_str(), &property.width, &property.height, &property.nrChannels, 0);   
-        if (data)
+        return false;
+    }
+    prepare(image, options, isStaged, isCached ? &key : nullptr);
+    return true;
+}
+
+bool Texture::load(const std::string& name, const unsigned char* data, size_t size, bool isFlip, const TextureOptions& options, TextureImage& image, bool isStaged)
+{
+    if (!decode(name, data, size, isFlip, image))
+    {
+        return false;
+    }
+    prepare(image, options, isStaged, nullptr);
+    return true;
+}
+
+void Texture::prepare(TextureImage& image, const TextureOptions& options, bool isStaged, const uint64_t* cacheKey)
+{
+    generateMips(image, options);
+    if (options.compression != TEXTURE_COMPRESSION_NONE)
+    {
+        auto start = std::chrono::steady_clock::now();
+        TextureCompressor::compress(image, options.compression);
+        auto end = std::chrono::steady_clock::now();
+        GL_LOG_I("compress texture %s to %s in %.2f ms", image.path.c_str(), TextureCompressor::name(image.compression), std::chrono::duration<double, std::milli>(end - start).count());
+        if (cacheKey)
+        {
+            TextureCompressor::storeCache(image.path, *cacheKey, image);
+        }
+    }
+    // streamed textures upload from their own copy for as long as they live
+    if (isStaged && !options.isStreamed)
+    {
+        stage(image);
+    }
+}
+
+void Texture::setUploader(TextureUploader* uploader)
+{
+    s_uploader = uploader;
+}
+
+void Texture::stage(TextureImage& image)
+{
+    if (!s_uploader)
+    {
+        return;
+    }
+    auto levels = TextureCompressor::levelsOf(image);
+
+    // the uploader's copy is the only one needed from here on
+    image.staging = s_uploader->stage(levels);
+    if (image.staging)
+    {
+        image.pixels = std::vector<unsigned char>();
+        image.mips   = MipChain();
+        image.levels = MipChain();
+    }
+}
+
+int Texture::levelCount(const TextureImage& image)
+{
+    if (image.staging)
+    {
+        return static_cast<int>(image.staging->offsets.size());
+    }
+    if (image.compression != TEXTURE_COMPRESSION_NONE)
+    {
+        return static_cast<int>(image.levels.size());
+    }
+    return 1 + static_cast<int>(image.mips.size());
+}
+
+void Texture::levelData(const TextureImage& image, int level, const void*& data, size_t& size)
+{
+    if (image.staging)
+    {
+        // with the uploader's buffer bound to GL_PIXEL_UNPACK_BUFFER the pointer is an offset into it
+        data = reinterpret_cast<const void*>(image.staging->offsets[level]);
+        size = image.staging->sizes[level];
+        return;
+    }
+    const auto& pixels = image.compression != TEXTURE_COMPRESSION_NONE ? image.levels[level] : level == 0 ? image.pixels : image.mips[level - 1];
+    data               = pixels.data();
+    size               = pixels.size();
+}
+
+TextureImage Texture::loadImage(const std::string& path, bool isFlip, const TextureOptions& options)
+{
+    TextureImage image;
+    if (!load(path, isFlip, options, image))
+    {
+        std::abort();
+    }
+    return image;
+}
+
+void Texture::uploadLevels(const TextureImage& image, int face, int firstLevel, int lastLevel)
+{
+    // images that didn't come through Texture::load get their mips and compression here
+    TextureImage        prepared;
+    const TextureImage* source = &image;
+    if (!image.staging && image.compression == TEXTURE_COMPRESSION_NONE && (m_compression != TEXTURE_COMPRESSION_NONE || levelCount(image) < m_levels))
+    {
+        prepared = image;
+        if (levelCount(prepared) < m_levels)
+        {
+            generateMips(prepared, m_options);
+        }
+        if (m_compression != TEXTURE_COMPRESSION_NONE)
+        {
+            TextureCompressor::compress(prepared, m_compression);
+        }
+        source = &prepared;
+    }
+    if (levelCount(*source) < m_levels)
+    {
+        GL_LOG_E("image %s has %d levels, texture %d needs %d", image.path.c_str(), levelCount(*source), m_id, m_levels);
+        std::abort();
+    }
+
+    if (source->staging)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, source->staging->buffer);
+    }
+    unsigned int format = image.nrChannels == 4 ? GL_RGBA : GL_RGB;
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int level = firstLevel; level <= (lastLevel < 0 ? m_levels - 1 : lastLevel); level++)
+    {
+        int         width  = std::max(1, image.width >> level);
+        int         height = std::max(1, image.height >> level);
+        const void* data;
+        size_t      size;
+        levelData(*source, level, data, size);
+        // a cube map is written like an array of 6 layers
+        if (m_compression != TEXTURE_COMPRESSION_NONE)
         {
-            switch (property.nrChannels)
+            unsigned int internalFormat = TextureCompressor::internalFormat(m_compression, m_options.isSrgbFormat);
+            if (face < 0)
             {
-            case 3:
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, property.width, property.height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-                break;
-            case 4:
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA, property.width, property.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, data);
-                break;
-            default:
-                GL_LOG_E("load texture failed. don't support nr channels %d", property.nrChannels);
-                std::abort();
-                break;
+                glCompressedTextureSubImage2D(m_id, level, 0, 0, width, height, internalFormat, static_cast<int>(size), data);
+            }
+            else
+            {
+                glCompressedTextureSubImage3D(m_id, level, 0, 0, face, width, height, 1, internalFormat, static_cast<int>(size), data);
             }
-            
-            glGenerateMipmap(m_id);
+        }
+        else if (face < 0)
+        {
+            glTextureSubImage2D(m_id, level, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data);
         }
         else
         {
-            GL_LOG_E("Failed to load texture %s", property.path.c_str());
+            glTextureSubImage3D(m_id, level, 0, 0, face, width, height, 1, format, GL_UNSIGNED_BYTE, data);
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // the copies only read the buffer when the GPU gets to them, the fence tells when the range is free
+    if (source->staging)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        source->staging->uploader->fence(*source->staging);
+    }
+}
+
+Texture::Texture(const std::string& path, TextureType textureType, bool isFlip)
+    :Texture(path, textureType, isFlip, TextureOptions::forType(textureType))
+{
+}
+
+Texture::Texture(const std::string& path, TextureType textureType, bool isFlip, const TextureOptions& options)
+    :Texture(loadImage(path, isFlip, options), textureType, isFlip, options)
+{
+}
+
+Texture::Texture(const TextureImage& image, TextureType textureType, bool isFlip)
+    :Texture(image, textureType, isFlip, TextureOptions::forType(textureType))
+{
+}
+
+Texture::Texture(const TextureImage& image, TextureType textureType, bool isFlip, const TextureOptions& options)
+    :m_type(textureType), m_isFlip(isFlip), m_options(options)
+{
+    if (image.compression != TEXTURE_COMPRESSION_NONE)
+    {
+        m_compression = image.compression;
+        m_levels      = levelCount(image);
+    }
+    else
+    {
+        m_compression = TextureCompressor::resolve(options.compression, image.nrChannels);
+        m_levels      = options.mipFilter == MIP_FILTER_NONE ? 1 : mipLevelCount(image.width, image.height);
+    }
+
+    unsigned int internalFormat;
+    if (m_compression != TEXTURE_COMPRESSION_NONE)
+    {
+        internalFormat = TextureCompressor::internalFormat(m_compression, options.isSrgbFormat);
+    }
+    else if (image.nrChannels == 4)
+    {
+        internalFormat = options.isSrgbFormat ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    }
+    else
+    {
+        internalFormat = options.isSrgbFormat ? GL_SRGB8 : GL_RGB8;
+    }
+
+    bool isStreamed = options.isStreamed && m_levels > 1;
+    if (options.isStreamed && (!isStreamed || image.staging))
+    {
+        GL_LOG_W("texture %s isn't streamed, it has no mips or its levels were staged", image.path.c_str());
+        isStreamed = false;
+    }
+
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_id);
+    m_handle = ResourceManager::create(RESOURCE_TEXTURE, m_id);
+    if (isStreamed)
+    {
+        int pageWidth  = 0;
+        int pageHeight = 0;
+        if (texPageCommitment())
+        {
+            glGetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, &pageWidth);
+            glGetInternalformativ(GL_TEXTURE_2D, internalFormat, GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, &pageHeight);
+        }
+        m_stream           = std::make_shared<TextureStream>();
+        m_stream->isSparse = pageWidth > 0 && pageHeight > 0 && image.width % pageWidth == 0 && image.height % pageHeight == 0;
+        if (m_stream->isSparse)
+        {
+            glTextureParameteri(m_id, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+        }
+    }
+    glTextureStorage2D(m_id, m_levels, internalFormat, image.width, image.height);
+    initSampler(m_levels == 1 ? GL_LINEAR : options.isTrilinear ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR_MIPMAP_NEAREST, GL_REPEAT);
+    if (m_stream)
+    {
+        // keep every level in the form the texture stores it, streaming copies straight from it
+        m_stream->image = image;
+        if (levelCount(m_stream->image) < m_levels && image.compression == TEXTURE_COMPRESSION_NONE)
+        {
+            generateMips(m_stream->image, options);
+        }
+        if (m_compression != TEXTURE_COMPRESSION_NONE && image.compression == TEXTURE_COMPRESSION_NONE)
+        {
+            TextureCompressor::compress(m_stream->image, m_compression);
+        }
+
+        m_stream->tailLevel = m_levels;
+        if (m_stream->isSparse)
+        {
+            glGetTextureParameteriv(m_id, GL_NUM_SPARSE_LEVELS_ARB, &m_stream->tailLevel);
+            m_stream->tailLevel = std::min(m_stream->tailLevel, m_levels);
+        }
+        int smallLevel = 0;
+        while (smallLevel < m_levels - 1 && std::max(image.width >> smallLevel, image.height >> smallLevel) > STREAM_RESIDENT_SIZE)
+        {
+            smallLevel++;
+        }
+        m_stream->minLevel      = std::min(smallLevel, m_stream->tailLevel);
+        m_stream->residentLevel = m_levels;
+        setResidentLevel(m_stream->minLevel);
+    }
+    else
+    {
+        uploadLevels(image);
+    }
+    setAnisotropy(options.anisotropy);
+
+    TextureProperty property;
+    property.path       = image.path;
+    property.width      = image.width;
+    property.height     = image.height;
+    property.nrChannels = image.nrChannels;
+    m_properties.push_back(property);
+
+    GL_LOG_D("load texture %s type %s witdh %d height %d nrChannels %d levels %d compression %s", property.path.c_str(), translateTextureTypeName(m_type).c_str(), property.width, property.height, property.nrChannels, m_levels, TextureCompressor::name(m_compression));
+}
+
+Texture::Texture(const std::vector<std::string>& paths, TextureType textureType, bool isFlip, const std::string& bakedPath)
+    :m_type(textureType), m_isFlip(isFlip), m_options(TextureOptions::forType(textureType))
+{
+    if (paths.size() != 6)
+    {
+        GL_LOG_E("cube map needs 6 faces, got %zu", paths.size());
+        std::abort();
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // a baked file holds every face with its mips, one read and no decoding
+    std::vector<TextureImage> faces;
+    uint64_t                  key     = bakedPath.empty() ? 0 : TextureCompressor::cacheKey(paths, isFlip, m_options);
+    bool                      isBaked = !bakedPath.empty() && TextureCompressor::loadContainer(bakedPath, key, faces) && faces.size() == paths.size();
+    if (!isBaked)
+    {
+        // decode, filter and compress the faces at the same time, so this takes as long as the slowest
+        // face. the baked file is their cache, the faces aren't cached on their own as well
+        faces.assign(paths.size(), TextureImage());
+        std::vector<double> faceMs(paths.size());
+        TextureOptions      faceOptions = m_options;
+        faceOptions.isCached            = bakedPath.empty();
+        parallelFor(static_cast<int>(paths.size()), 1, 1, [&](int begin, int end) {
+            for (int i = begin; i < end; i++)
+            {
+                auto faceStart = std::chrono::steady_clock::now();
+                if (!load(paths[i], isFlip, faceOptions, faces[i], false))
+                {
+                    std::abort();
+                }
+                faceMs[i] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - faceStart).count();
+            }
+        });
+        GL_LOG_D("cube map faces loaded in %.2f ms, the slowest took %.2f ms", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count(), *std::max_element(faceMs.begin(), faceMs.end()));
+    }
+
+    const TextureImage& first = faces[0];
+    for (const auto& face : faces)
+    {
+        if (face.width != first.width || face.height != first.height || face.nrChannels != first.nrChannels || face.compression != first.compression)
+        {
+            GL_LOG_E("cube map face %s is %dx%dx%d, %s is %dx%dx%d", face.path.c_str(), face.width, face.height, face.nrChannels, first.path.c_str(), first.width, first.height, first.nrChannels);
             std::abort();
         }
+    }
+    if (first.width != first.height)
+    {
+        GL_LOG_E("cube map face %s isn't square: %dx%d", first.path.c_str(), first.width, first.height);
+        std::abort();
+    }
+    if (!isBaked && !bakedPath.empty())
+    {
+        std::vector<const TextureImage*> facePointers;
+        for (const auto& face : faces)
+        {
+            facePointers.push_back(&face);
+        }
+        TextureCompressor::storeContainer(bakedPath, key, facePointers);
+    }
+    // staged here on the GL thread, not by the workers: a full staging ring only frees ranges on
+    // this thread, which would be stuck joining workers waiting for room
+    for (auto& face : faces)
+    {
+        stage(face);
+    }
+
+    m_compression = first.compression;
+    m_levels      = levelCount(first);
+    unsigned int internalFormat;
+    if (m_compression != TEXTURE_COMPRESSION_NONE)
+    {
+        internalFormat = TextureCompressor::internalFormat(m_compression, m_options.isSrgbFormat);
+    }
+    else if (first.nrChannels == 4)
+    {
+        internalFormat = m_options.isSrgbFormat ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    }
+    else
+    {
+        internalFormat = m_options.isSrgbFormat ? GL_SRGB8 : GL_RGB8;
+    }
+
+    glCreateTextures(GL_TEXTURE_CUBE_MAP, 1, &m_id);
+    m_handle = ResourceManager::create(RESOURCE_TEXTURE, m_id);
+    glTextureStorage2D(m_id, m_levels, internalFormat, first.width, first.height);
+    initSampler(m_levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR, GL_CLAMP_TO_EDGE);
+
+    for (size_t i = 0; i < faces.size(); i++)
+    {
+        const TextureImage& face = faces[i];
+        uploadLevels(face, static_cast<int>(i));
+
+        TextureProperty property;
+        property.path       = isBaked ? paths[i] : face.path;
+        property.width      = face.width;
+        property.height     = face.height;
+        property.nrChannels = face.nrChannels;
         m_properties.push_back(property);
-        GL_LOG_D("load texture %s type %s witdh %d height %d nrChannels %d", property.path.c_str(), translateTextureTypeName(m_type).c_str(), property.width, property.height, property.nrChannels);
     }
+
+    auto end = std::chrono::steady_clock::now();
+    GL_LOG_I("load cube map %s%s (%dx%d, %d levels, %s) in %.2f ms", isBaked ? "baked in " : "", isBaked ? bakedPath.c_str() : paths[0].c_str(), first.width, first.height, m_levels, TextureCompressor::name(m_compression), std::chrono::duration<double, std::milli>(end - start).count());
+}
+
+bool Texture::reload(const TextureImage& image)
+{
+    if (isCubeMap() || m_properties.empty())
+    {
+        GL_LOG_W("texture %d can't be reloaded from a single image", m_id);
+        return false;
+    }
+    const TextureProperty& property = m_properties[0];
+    if (image.width != property.width || image.height != property.height || image.nrChannels != property.nrChannels)
+    {
+        // a new name would leave the copies held elsewhere on the old one
+        GL_LOG_W("can't reload texture %s: %dx%dx%d doesn't match its storage %dx%dx%d, restart to pick it up", image.path.c_str(), image.width, image.height, image.nrChannels, property.width, property.height, property.nrChannels);
+        return false;
+    }
+    if (image.compression != TEXTURE_COMPRESSION_NONE && (image.compression != m_compression || levelCount(image) != m_levels))
+    {
+        GL_LOG_W("can't reload texture %s: compressed as %s, its storage is %s", image.path.c_str(), TextureCompressor::name(image.compression), TextureCompressor::name(m_compression));
+        return false;
+    }
+    if (m_stream)
+    {
+        if (image.staging || (image.compression == TEXTURE_COMPRESSION_NONE && m_compression != TEXTURE_COMPRESSION_NONE) || levelCount(image) < m_levels)
+        {
+            GL_LOG_W("can't reload streamed texture %s: its levels weren't loaded with the texture's options", image.path.c_str());
+            return false;
+        }
+        m_stream->image = image;
+        uploadLevels(image, -1, m_stream->residentLevel);
+    }
+    else
+    {
+        uploadLevels(image);
+    }
+    GL_LOG_I("reload texture %s witdh %d height %d nrChannels %d", image.path.c_str(), image.width, image.height, image.nrChannels);
+    return true;
 }
 
 
 Texture::Texture(int width, int height, int nrChannels)
+    :Texture(width, height, nrChannels == 4 ? GL_RGBA8 : GL_RGB8, nrChannels == 4 ? GL_RGBA : GL_RGB)
+{
+    if (nrChannels != 3 && nrChannels != 4)
+    {
+        GL_LOG_E("don't support nrChannels %d yet.", nrChannels);
+        std::abort();
+    }
+}
+
+Texture::Texture(int width, int height, unsigned int internalFormat, unsigned int format)
     :m_type(TextureType::TEXTURE_BUFFER)
 {
-    m_refCnt = new unsigned(1);
+    m_options.mipFilter   = MIP_FILTER_NONE;
+    m_options.compression = TEXTURE_COMPRESSION_NONE;
     TextureProperty property;
     property.width = width;
     property.height = height;
-    property.nrChannels = nrChannels;
     property.path = "";
 
-    int colorFormat = GL_RGB;
-    switch (nrChannels)
+    switch (format)
     {
-    case 3:
-        colorFormat = GL_RGB;
+    case GL_RED:
+    case GL_DEPTH_COMPONENT:
+    case GL_DEPTH_STENCIL:
+        property.nrChannels = 1;
         break;
-    case 4:
-        colorFormat = GL_RGBA;
+    case GL_RG:
+        property.nrChannels = 2;
+        break;
+    case GL_RGB:
+        property.nrChannels = 3;
+        break;
+    case GL_RGBA:
+        property.nrChannels = 4;
         break;
     default:
-        GL_LOG_E("don't support nrChannels %d yet.", nrChannels);
+        GL_LOG_E("don't support format 0x%x yet.", format);
         std::abort();
     }
 
-    glGenTextures(1, &m_id);
-    glBindTexture(GL_TEXTURE_2D, m_id);
-    glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, property.width, property.height, 0, colorFormat, GL_UNSIGNED_BYTE, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    // immutable storage, so internalFormat has to be a sized one. filtering is the shared sampler's,
+    // bare names handed out by render targets get the same one through Texture::bindUnit
+    glCreateTextures(GL_TEXTURE_2D, 1, &m_id);
+    m_handle = ResourceManager::create(RESOURCE_TEXTURE, m_id);
+    glTextureStorage2D(m_id, 1, internalFormat, property.width, property.height);
+    initSampler(GL_LINEAR, GL_REPEAT);
 
     m_properties.push_back(property);
 
@@ -174,12 +869,20 @@ Texture& Texture::operator=(const Texture& other)
 {
     if (this != &other)
     {
+        // the new reference first, other may share this texture's name
+        ResourceManager::acquire(other.m_handle);
+        ResourceManager::release(m_handle);
+
         m_id = other.m_id;
+        m_handle = other.m_handle;
         m_properties = other.m_properties;
         m_type = other.m_type;
-        m_refCnt = other.m_refCnt;
-
-        (*m_refCnt)++;
+        m_isFlip = other.m_isFlip;
+        m_options = other.m_options;
+        m_levels = other.m_levels;
+        m_compression = other.m_compression;
+        m_stream = other.m_stream;
+        m_sampler = other.m_sampler;
     }
     return *this;
 }
@@ -193,12 +896,21 @@ Texture& Texture::operator=(Texture&& other)
 {
     if (this != &other)
     {
+        ResourceManager::release(m_handle);
+
         m_id = other.m_id;
+        m_handle = other.m_handle;
         m_properties = other.m_properties;
         m_type = other.m_type;
-        m_refCnt = other.m_refCnt;
+        m_isFlip = other.m_isFlip;
+        m_options = other.m_options;
+        m_levels = other.m_levels;
+        m_compression = other.m_compression;
+        m_stream = other.m_stream;
+        m_sampler = other.m_sampler;
 
         other.m_id = 0;
+        other.m_handle = ResourceHandle();
         for (auto& property : other.m_properties)
         {
             property.width = 0;
@@ -207,25 +919,16 @@ Texture& Texture::operator=(Texture&& other)
             property.path = "";
         }
         other.m_type = TextureType::TEXTURE_DIFFUSE;
-        other.m_refCnt = nullptr;
+        other.m_stream = nullptr;
+        other.m_sampler = nullptr;
     }
     return *this;
 }
 
 Texture::~Texture()
 {
-    if (m_refCnt)
-    {
-        (*m_refCnt)--;
-        if (*m_refCnt == 0)
-        {
-            GL_LOG_D("release texture %d", m_id);
-            glDeleteTextures(1, &m_id);
-
-            delete m_refCnt;
-            m_refCnt = nullptr;
-        }
-    }
+    // the last copy queues the name, it is deleted a few frames later by ResourceManager::collect
+    ResourceManager::release(m_handle);
 }
 
 std::string Texture::path(int idx) const
@@ -239,17 +942,165 @@ std::string Texture::path(int idx) const
 
 void Texture::setWarpType(unsigned int SWarpType, unsigned int TWarpType, const std::vector<float>& borderColor)
 {
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, SWarpType);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, TWarpType);
+    m_sampler->desc.wrapS = SWarpType;
+    m_sampler->desc.wrapT = TWarpType;
     if (SWarpType == GL_CLAMP_TO_BORDER || TWarpType == GL_CLAMP_TO_BORDER)
     {
         assert(borderColor.size() == 4);
-        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, &borderColor[0]);
+        std::copy(borderColor.begin(), borderColor.end(), m_sampler->desc.borderColor.begin());
     }
+    updateSampler();
 }
 
 void Texture::setFilterType(unsigned int minFilter, unsigned int magFilter)
 {
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, minFilter);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, magFilter);
-}
\ No newline at end of file
+    m_sampler->desc.minFilter = minFilter;
+    m_sampler->desc.magFilter = magFilter;
+    updateSampler();
+}
+
+void Texture::initSampler(unsigned int minFilter, unsigned int wrap)
+{
+    m_sampler                 = std::make_shared<TextureSampler>();
+    m_sampler->desc.minFilter = minFilter;
+    m_sampler->desc.magFilter = GL_LINEAR;
+    m_sampler->desc.wrapS     = wrap;
+    m_sampler->desc.wrapT     = wrap;
+    m_sampler->desc.wrapR     = wrap;
+    updateSampler();
+}
+
+void Texture::updateSampler()
+{
+    m_sampler->id = SamplerCache::get(m_sampler->desc);
+}
+
+void Texture::bind(unsigned int unit) const
+{
+    glBindTextureUnit(unit, m_id);
+    glBindSampler(unit, m_sampler ? m_sampler->id : 0);
+}
+
+void Texture::bindUnit(unsigned int unit, unsigned int id)
+{
+    SamplerDesc desc;
+    desc.minFilter = GL_LINEAR;
+    desc.magFilter = GL_LINEAR;
+    desc.wrapS     = GL_REPEAT;
+    desc.wrapT     = GL_REPEAT;
+    desc.wrapR     = GL_REPEAT;
+    glBindTextureUnit(unit, id);
+    glBindSampler(unit, SamplerCache::get(desc));
+}
+
+size_t Texture::memorySize() const
+{
+    // without sparse storage every level is allocated, resident or not
+    return levelsMemorySize(m_stream && m_stream->isSparse ? m_stream->residentLevel : 0);
+}
+
+size_t Texture::levelsMemorySize(int firstLevel) const
+{
+    size_t size = 0;
+    for (const auto& property : m_properties)
+    {
+        for (int level = firstLevel; level < m_levels; level++)
+        {
+            int width  = std::max(1, property.width >> level);
+            int height = std::max(1, property.height >> level);
+            if (m_compression != TEXTURE_COMPRESSION_NONE)
+            {
+                size += TextureCompressor::levelSize(m_compression, width, height);
+            }
+            else
+            {
+                size += static_cast<size_t>(width) * height * (property.nrChannels == 3 ? 4 : property.nrChannels);
+            }
+        }
+    }
+    return size;
+}
+
+size_t Texture::uncompressedSize() const
+{
+    size_t size = 0;
+    for (const auto& property : m_properties)
+    {
+        for (int level = 0; level < m_levels; level++)
+        {
+            size += static_cast<size_t>(std::max(1, property.width >> level)) * std::max(1, property.height >> level) * 4;
+        }
+    }
+    return size;
+}
+
+void Texture::setAnisotropy(float anisotropy)
+{
+    // core since 4.6, before that ARB/EXT_texture_filter_anisotropic
+    static float maxAnisotropy = -1.0f;
+    if (maxAnisotropy < 0.0f)
+    {
+        maxAnisotropy = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+    }
+    m_options.anisotropy       = std::min(std::max(anisotropy, 1.0f), maxAnisotropy);
+    m_sampler->desc.anisotropy = m_options.anisotropy;
+    updateSampler();
+}
+
+int Texture::residentLevel() const
+{
+    return m_stream ? m_stream->residentLevel : 0;
+}
+
+int Texture::minResidentLevel() const
+{
+    return m_stream ? m_stream->minLevel : 0;
+}
+
+void Texture::setResidentLevel(int level)
+{
+    if (!m_stream)
+    {
+        return;
+    }
+    level = std::min(std::max(level, 0), m_stream->minLevel);
+    int resident = m_stream->residentLevel;
+    if (level == resident)
+    {
+        return;
+    }
+
+    if (level < resident)
+    {
+        // commit and fill the new levels before sampling may reach them
+        commitLevels(level, resident - 1, true);
+        uploadLevels(m_stream->image, -1, level, std::min(resident, m_levels) - 1);
+        glTextureParameteri(m_id, GL_TEXTURE_BASE_LEVEL, level);
+    }
+    else
+    {
+        glTextureParameteri(m_id, GL_TEXTURE_BASE_LEVEL, level);
+        commitLevels(resident, level - 1, false);
+    }
+    m_stream->residentLevel = level;
+}
+
+void Texture::commitLevels(int firstLevel, int lastLevel, bool isCommitted)
+{
+    if (!m_stream->isSparse)
+    {
+        return;
+    }
+    // the tail is committed as a whole through its first level. ARB_sparse_texture has no DSA form
+    // without EXT_direct_state_access, so this is the one place left that binds
+    auto commit = texPageCommitment();
+    glBindTexture(GL_TEXTURE_2D, m_id);
+    for (int level = firstLevel; level <= std::min(lastLevel, std::min(m_stream->tailLevel, m_levels - 1)); level++)
+    {
+        int width  = std::max(1, m_stream->image.width >> level);
+        int height = std::max(1, m_stream->image.height >> level);
+        commit(GL_TEXTURE_2D, level, 0, 0, 0, width, height, 1, isCommitted ? GL_TRUE : GL_FALSE);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
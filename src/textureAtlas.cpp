@@ -0,0 +1,375 @@
+#include "textureAtlas.h"
+#include "log.h"
+#include "parallel.h"
+#include "samplerCache.h"
+#include "textureCompressor.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+// bottom left skyline packer. the skyline is the top edge of everything placed so far, a new rect
+// goes where it ends lowest
+class SkylinePacker
+{
+public:
+    SkylinePacker(int width, int height)
+        : m_width(width)
+        , m_height(height)
+    {
+        m_skyline.push_back({0, 0, width});
+    }
+
+    bool insert(int width, int height, int& x, int& y)
+    {
+        int bestIndex = -1;
+        int bestTop   = m_height + 1;
+        int bestWidth = m_width + 1;
+        for(size_t i = 0; i < m_skyline.size(); i++)
+        {
+            int top;
+            if(fit(i, width, height, top) && (top < bestTop || (top == bestTop && m_skyline[i].width < bestWidth)))
+            {
+                bestIndex = static_cast<int>(i);
+                bestTop   = top;
+                bestWidth = m_skyline[i].width;
+            }
+        }
+        if(bestIndex < 0)
+        {
+            return false;
+        }
+
+        x = m_skyline[bestIndex].x;
+        y = bestTop - height;
+        m_skyline.insert(m_skyline.begin() + bestIndex, {x, bestTop, width});
+
+        // the nodes under the new one shrink or go away
+        for(size_t i = bestIndex + 1; i < m_skyline.size();)
+        {
+            Node& node  = m_skyline[i];
+            int   right = x + width;
+            if(node.x >= right)
+            {
+                break;
+            }
+            int shrink = std::min(right - node.x, node.width);
+            node.x += shrink;
+            node.width -= shrink;
+            if(node.width == 0)
+            {
+                m_skyline.erase(m_skyline.begin() + i);
+            }
+            else
+            {
+                break;
+            }
+        }
+        for(size_t i = 0; i + 1 < m_skyline.size();)
+        {
+            if(m_skyline[i].y == m_skyline[i + 1].y)
+            {
+                m_skyline[i].width += m_skyline[i + 1].width;
+                m_skyline.erase(m_skyline.begin() + i + 1);
+            }
+            else
+            {
+                i++;
+            }
+        }
+        return true;
+    }
+
+private:
+    struct Node
+    {
+        int x, y, width;
+    };
+
+    // top of the rect if it sits on node index and the nodes right of it
+    bool fit(size_t index, int width, int height, int& top) const
+    {
+        if(m_skyline[index].x + width > m_width)
+        {
+            return false;
+        }
+        int y         = 0;
+        int remaining = width;
+        for(size_t i = index; remaining > 0; i++)
+        {
+            y = std::max(y, m_skyline[i].y);
+            remaining -= m_skyline[i].width;
+        }
+        top = y + height;
+        return top <= m_height;
+    }
+
+private:
+    int               m_width;
+    int               m_height;
+    std::vector<Node> m_skyline;
+};
+
+// rgba copy of image at x, y of layer with its edge repeated padding texels outwards
+static void blit(const TextureImage& image, int x, int y, int padding, TextureImage& layer)
+{
+    for(int dy = -padding; dy < image.height + padding; dy++)
+    {
+        int            sy  = std::min(std::max(dy, 0), image.height - 1);
+        unsigned char* dst = &layer.pixels[(static_cast<size_t>(y + dy) * layer.width + x - padding) * 4];
+        for(int dx = -padding; dx < image.width + padding; dx++, dst += 4)
+        {
+            int                  sx  = std::min(std::max(dx, 0), image.width - 1);
+            const unsigned char* src = &image.pixels[(static_cast<size_t>(sy) * image.width + sx) * image.nrChannels];
+            dst[0]                   = src[0];
+            dst[1]                   = src[1];
+            dst[2]                   = src[2];
+            dst[3]                   = image.nrChannels == 4 ? src[3] : 255;
+        }
+    }
+}
+
+TextureOptions TextureAtlas::defaultOptions()
+{
+    // box mips keep every texel's footprint inside its image, kaiser lobes would reach past the padding
+    TextureOptions options = TextureOptions::forType(TextureType::TEXTURE_DIFFUSE);
+    options.mipFilter      = MIP_FILTER_BOX;
+    options.compression    = TEXTURE_COMPRESSION_NONE;
+    return options;
+}
+
+TextureAtlas::TextureAtlas(int layerSize, int padding, const TextureOptions& options)
+    : m_layerSize(layerSize)
+    , m_padding(1)
+    , m_options(options)
+{
+    // a power of two, so image origins stay aligned down to the last level. block compressed layers
+    // need whole 4x4 blocks of padding, or a block would mix two images
+    if(TextureCompressor::resolve(m_options.compression, 4) != TEXTURE_COMPRESSION_NONE)
+    {
+        padding = std::max(padding, 4);
+    }
+    while(m_padding < padding)
+    {
+        m_padding *= 2;
+    }
+    if(m_options.mipFilter == MIP_FILTER_KAISER)
+    {
+        m_options.mipFilter = MIP_FILTER_BOX;
+    }
+}
+
+TextureAtlas::~TextureAtlas()
+{
+    if(m_id)
+    {
+        glDeleteTextures(1, &m_id);
+    }
+}
+
+void TextureAtlas::bind(unsigned int unit) const
+{
+    glBindTextureUnit(unit, m_id);
+    glBindSampler(unit, m_sampler);
+}
+
+int TextureAtlas::add(const std::string& path, bool isFlip, bool isRepeated)
+{
+    m_pending.push_back({path, isFlip, isRepeated, TextureImage()});
+    m_regions.push_back({});
+    return static_cast<int>(m_regions.size()) - 1;
+}
+
+int TextureAtlas::add(const TextureImage& image, bool isRepeated)
+{
+    m_pending.push_back({image.path, false, isRepeated, image});
+    m_regions.push_back({});
+    return static_cast<int>(m_regions.size()) - 1;
+}
+
+void TextureAtlas::build()
+{
+    if(m_id)
+    {
+        GL_LOG_E("texture atlas %d is already built", m_id);
+        std::abort();
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    parallelFor(static_cast<int>(m_pending.size()), 1, 1, [&](int begin, int end) {
+        for(int i = begin; i < end; i++)
+        {
+            if(m_pending[i].image.pixels.empty() && !Texture::decode(m_pending[i].path, m_pending[i].isFlip, m_pending[i].image))
+            {
+                std::abort();
+            }
+        }
+    });
+
+    // whole layer images first, then the rest tallest first, which packs tighter
+    std::vector<int> order(m_pending.size());
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        const TextureImage& image = m_pending[i].image;
+        if(image.pixels.empty() || image.compression != TEXTURE_COMPRESSION_NONE || image.nrChannels < 3)
+        {
+            GL_LOG_E("atlas image %s needs decoded rgb or rgba pixels", m_pending[i].path.c_str());
+            std::abort();
+        }
+        if(image.width > m_layerSize || image.height > m_layerSize || (m_pending[i].isRepeated && (image.width != m_layerSize || image.height != m_layerSize)))
+        {
+            GL_LOG_E("atlas image %s is %dx%d, layers are %dx%d and repeated images must fill one", m_pending[i].path.c_str(), image.width, image.height, m_layerSize, m_layerSize);
+            std::abort();
+        }
+        order[i] = static_cast<int>(i);
+    }
+    auto isWhole = [this](int i) { return m_pending[i].isRepeated || (m_pending[i].image.width == m_layerSize && m_pending[i].image.height == m_layerSize); };
+    std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+        if(isWhole(a) != isWhole(b))
+        {
+            return isWhole(a);
+        }
+        return m_pending[a].image.height > m_pending[b].image.height;
+    });
+
+    std::vector<SkylinePacker> packers; // per layer, empty slots for whole layer images
+    std::vector<bool>          isPackedLayer;
+    size_t                     usedArea = 0;
+    for(int i : order)
+    {
+        const TextureImage& image  = m_pending[i].image;
+        AtlasRegion&        region = m_regions[i];
+        region.width               = image.width;
+        region.height              = image.height;
+        if(isWhole(i))
+        {
+            region.layer = static_cast<int>(packers.size());
+            region.x     = 0;
+            region.y     = 0;
+            packers.emplace_back(0, 0);
+            isPackedLayer.push_back(false);
+        }
+        else
+        {
+            // padded size rounded up to the padding keeps every origin aligned to it
+            int  width   = (image.width + 2 * m_padding + m_padding - 1) / m_padding * m_padding;
+            int  height  = (image.height + 2 * m_padding + m_padding - 1) / m_padding * m_padding;
+            int  x       = 0;
+            int  y       = 0;
+            bool isFound = false;
+            for(size_t layer = 0; layer < packers.size() && !isFound; layer++)
+            {
+                if(isPackedLayer[layer] && packers[layer].insert(width, height, x, y))
+                {
+                    region.layer = static_cast<int>(layer);
+                    isFound      = true;
+                }
+            }
+            if(!isFound)
+            {
+                packers.emplace_back(m_layerSize, m_layerSize);
+                isPackedLayer.push_back(true);
+                if(!packers.back().insert(width, height, x, y))
+                {
+                    GL_LOG_E("atlas image %s doesn't fit a %dx%d layer with %d texels of padding", m_pending[i].path.c_str(), m_layerSize, m_layerSize, m_padding);
+                    std::abort();
+                }
+                region.layer = static_cast<int>(packers.size()) - 1;
+            }
+            region.x = x + m_padding;
+            region.y = y + m_padding;
+        }
+        region.uvTransform = glm::vec4(static_cast<float>(region.width) / m_layerSize,
+                                       static_cast<float>(region.height) / m_layerSize,
+                                       static_cast<float>(region.x) / m_layerSize,
+                                       static_cast<float>(region.y) / m_layerSize);
+        usedArea += static_cast<size_t>(image.width) * image.height;
+    }
+    m_layerCount = static_cast<int>(packers.size());
+    if(m_layerCount == 0)
+    {
+        GL_LOG_W("texture atlas has no images");
+        return;
+    }
+
+    // the padding halves with every level, the last one keeps a texel of it (a block when
+    // compressed), so 8 texels give 4 levels uncompressed and 2 compressed. deeper mips would
+    // average neighbours into each other
+    TextureCompression compression = TextureCompressor::resolve(m_options.compression, 4);
+    int                minPadding  = compression != TEXTURE_COMPRESSION_NONE ? 4 : 1;
+    int                levels      = 1;
+    if(m_options.mipFilter != MIP_FILTER_NONE)
+    {
+        for(int padding = m_padding; padding > minPadding && levels < Texture::mipLevelCount(m_layerSize, m_layerSize); padding /= 2)
+        {
+            levels++;
+        }
+    }
+
+    std::vector<TextureImage> layers(m_layerCount);
+    for(auto& layer : layers)
+    {
+        layer.width      = m_layerSize;
+        layer.height     = m_layerSize;
+        layer.nrChannels = 4;
+        layer.pixels.assign(static_cast<size_t>(m_layerSize) * m_layerSize * 4, 0);
+    }
+    for(size_t i = 0; i < m_pending.size(); i++)
+    {
+        const AtlasRegion& region = m_regions[i];
+        blit(m_pending[i].image, region.x, region.y, isWhole(static_cast<int>(i)) ? 0 : m_padding, layers[region.layer]);
+    }
+    m_pending.clear();
+
+    for(auto& layer : layers)
+    {
+        Texture::generateMips(layer, m_options);
+        layer.mips.resize(levels - 1);
+        if(compression != TEXTURE_COMPRESSION_NONE)
+        {
+            TextureCompressor::compress(layer, compression);
+        }
+    }
+
+    unsigned int internalFormat = compression != TEXTURE_COMPRESSION_NONE ? TextureCompressor::internalFormat(compression, m_options.isSrgbFormat) : m_options.isSrgbFormat ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_id);
+    glTextureStorage3D(m_id, levels, internalFormat, m_layerSize, m_layerSize, m_layerCount);
+    float maxAnisotropy = 1.0f;
+    glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+    SamplerDesc sampler;
+    sampler.minFilter  = levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR;
+    sampler.anisotropy = std::min(std::max(m_options.anisotropy, 1.0f), maxAnisotropy);
+    m_sampler          = SamplerCache::get(sampler);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for(int layer = 0; layer < m_layerCount; layer++)
+    {
+        auto levelData = TextureCompressor::levelsOf(layers[layer]);
+        for(int level = 0; level < levels; level++)
+        {
+            int size = std::max(1, m_layerSize >> level);
+            if(compression != TEXTURE_COMPRESSION_NONE)
+            {
+                glCompressedTextureSubImage3D(m_id, level, 0, 0, layer, size, size, 1, internalFormat, static_cast<int>(levelData[level]->size()), levelData[level]->data());
+            }
+            else
+            {
+                glTextureSubImage3D(m_id, level, 0, 0, layer, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, levelData[level]->data());
+            }
+        }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    auto end = std::chrono::steady_clock::now();
+    GL_LOG_I("texture atlas: %zu images in %d layers of %dx%d, %d levels, %.1f%% covered, built in %.2f ms",
+             m_regions.size(),
+             m_layerCount,
+             m_layerSize,
+             m_layerSize,
+             levels,
+             100.0 * usedArea / (static_cast<double>(m_layerSize) * m_layerSize * m_layerCount),
+             std::chrono::duration<double, std::milli>(end - start).count());
+}
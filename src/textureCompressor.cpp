@@ -0,0 +1,796 @@
+#include "textureCompressor.h"
+#include "log.h"
+#include "packFile.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+// s3tc is an extension in name only, every desktop driver has it
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#    define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#    define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#    define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#    define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+static const uint32_t TEXTURE_CACHE_MAGIC   = 0x43545447; // "GTTC"
+static const uint32_t TEXTURE_CACHE_VERSION = 2;          // bump when an encoder changes its output
+// below this many blocks a level isn't worth a thread
+static const size_t BLOCKS_PER_THREAD = 1024;
+
+// ------------------ block encoders ------------------
+
+// principal axis of count points with n channels, by power iteration on the covariance
+static void principalAxis(const float (*points)[4], int count, int n, float mean[4], float axis[4])
+{
+    for(int c = 0; c < n; c++)
+    {
+        mean[c] = 0.0f;
+        for(int i = 0; i < count; i++)
+        {
+            mean[c] += points[i][c];
+        }
+        mean[c] /= count;
+    }
+
+    float cov[4][4] = {};
+    for(int i = 0; i < count; i++)
+    {
+        for(int a = 0; a < n; a++)
+        {
+            for(int b = 0; b < n; b++)
+            {
+                cov[a][b] += (points[i][a] - mean[a]) * (points[i][b] - mean[b]);
+            }
+        }
+    }
+
+    for(int c = 0; c < n; c++)
+    {
+        axis[c] = 1.0f;
+    }
+    for(int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4]  = {};
+        float length   = 0.0f;
+        for(int a = 0; a < n; a++)
+        {
+            for(int b = 0; b < n; b++)
+            {
+                next[a] += cov[a][b] * axis[b];
+            }
+            length = std::max(length, std::fabs(next[a]));
+        }
+        if(length < 1e-6f)
+        {
+            break;
+        }
+        for(int c = 0; c < n; c++)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+}
+
+// endpoints at the extremes of the points projected on their principal axis
+static void fitEndpoints(const float (*points)[4], int count, int n, float e0[4], float e1[4])
+{
+    float mean[4];
+    float axis[4];
+    principalAxis(points, count, n, mean, axis);
+
+    float minT = 0.0f;
+    float maxT = 0.0f;
+    for(int i = 0; i < count; i++)
+    {
+        float t = 0.0f;
+        for(int c = 0; c < n; c++)
+        {
+            t += (points[i][c] - mean[c]) * axis[c];
+        }
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+    float axisLength = 0.0f;
+    for(int c = 0; c < n; c++)
+    {
+        axisLength += axis[c] * axis[c];
+    }
+    axisLength = std::max(axisLength, 1e-6f);
+    for(int c = 0; c < n; c++)
+    {
+        e0[c] = std::min(std::max(mean[c] + axis[c] * maxT / axisLength, 0.0f), 255.0f);
+        e1[c] = std::min(std::max(mean[c] + axis[c] * minT / axisLength, 0.0f), 255.0f);
+    }
+}
+
+// least squares endpoints for fixed weights, point i ~ w[i] * e0 + (1 - w[i]) * e1
+static bool refineEndpoints(const float (*points)[4], const float* weights, int count, int n, float e0[4], float e1[4])
+{
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float ax[4] = {}, bx[4] = {};
+    for(int i = 0; i < count; i++)
+    {
+        float a = weights[i];
+        float b = 1.0f - a;
+        aa += a * a;
+        ab += a * b;
+        bb += b * b;
+        for(int c = 0; c < n; c++)
+        {
+            ax[c] += a * points[i][c];
+            bx[c] += b * points[i][c];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if(std::fabs(det) < 1e-6f)
+    {
+        return false;
+    }
+    for(int c = 0; c < n; c++)
+    {
+        e0[c] = std::min(std::max((bb * ax[c] - ab * bx[c]) / det, 0.0f), 255.0f);
+        e1[c] = std::min(std::max((aa * bx[c] - ab * ax[c]) / det, 0.0f), 255.0f);
+    }
+    return true;
+}
+
+static uint16_t packRgb565(const float color[4])
+{
+    int r = static_cast<int>(color[0] * 31.0f / 255.0f + 0.5f);
+    int g = static_cast<int>(color[1] * 63.0f / 255.0f + 0.5f);
+    int b = static_cast<int>(color[2] * 31.0f / 255.0f + 0.5f);
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void unpackRgb565(uint16_t packed, float color[4])
+{
+    int r    = (packed >> 11) & 31;
+    int g    = (packed >> 5) & 63;
+    int b    = packed & 31;
+    color[0] = static_cast<float>((r << 3) | (r >> 2));
+    color[1] = static_cast<float>((g << 2) | (g >> 4));
+    color[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+// the 4 color block of bc1 and bc3, returns the squared error
+static float encodeColorBlock(const float (*texels)[4], uint16_t c0, uint16_t c1, unsigned char* out, float* weights)
+{
+    if(c0 < c1)
+    {
+        std::swap(c0, c1);
+    }
+    float palette[4][4];
+    unpackRgb565(c0, palette[0]);
+    unpackRgb565(c1, palette[1]);
+    static const float PALETTE_WEIGHTS[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+    for(int c = 0; c < 3; c++)
+    {
+        palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+    }
+
+    uint32_t indices = 0;
+    float    error   = 0.0f;
+    for(int i = 0; i < 16; i++)
+    {
+        int   best      = 0;
+        float bestError = 1e30f;
+        // equal endpoints, every entry is the same color
+        for(int p = 0; p < (c0 == c1 ? 1 : 4); p++)
+        {
+            float e = 0.0f;
+            for(int c = 0; c < 3; c++)
+            {
+                float d = texels[i][c] - palette[p][c];
+                e += d * d;
+            }
+            if(e < bestError)
+            {
+                best      = p;
+                bestError = e;
+            }
+        }
+        indices |= static_cast<uint32_t>(best) << (2 * i);
+        weights[i] = PALETTE_WEIGHTS[best];
+        error += bestError;
+    }
+
+    out[0] = c0 & 0xff;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xff;
+    out[3] = c1 >> 8;
+    for(int i = 0; i < 4; i++)
+    {
+        out[4 + i] = (indices >> (8 * i)) & 0xff;
+    }
+    return error;
+}
+
+static void encodeBc1Block(const float (*texels)[4], unsigned char* out)
+{
+    float e0[4], e1[4];
+    fitEndpoints(texels, 16, 3, e0, e1);
+    float weights[16];
+    float error = encodeColorBlock(texels, packRgb565(e0), packRgb565(e1), out, weights);
+
+    // one least squares pass on the chosen indices usually finds better endpoints
+    if(refineEndpoints(texels, weights, 16, 3, e0, e1))
+    {
+        unsigned char refined[8];
+        if(encodeColorBlock(texels, packRgb565(e0), packRgb565(e1), refined, weights) < error)
+        {
+            memcpy(out, refined, sizeof(refined));
+        }
+    }
+}
+
+// bc4, one channel in 8 bytes: two endpoints and 3 bit indices
+static void encodeBc4Block(const float (*texels)[4], int channel, unsigned char* out)
+{
+    float minValue = 255.0f;
+    float maxValue = 0.0f;
+    for(int i = 0; i < 16; i++)
+    {
+        minValue = std::min(minValue, texels[i][channel]);
+        maxValue = std::max(maxValue, texels[i][channel]);
+    }
+    int a0 = static_cast<int>(maxValue + 0.5f);
+    int a1 = static_cast<int>(minValue + 0.5f);
+
+    // a0 > a1 selects the 8 value mode: a0, a1 and 6 steps in between
+    float palette[8] = {static_cast<float>(a0), static_cast<float>(a1)};
+    for(int p = 1; p < 7; p++)
+    {
+        palette[p + 1] = ((7 - p) * a0 + p * a1) / 7.0f;
+    }
+
+    uint64_t indices = 0;
+    for(int i = 0; i < 16; i++)
+    {
+        int   best      = 0;
+        float bestError = 1e30f;
+        for(int p = 0; p < (a0 == a1 ? 1 : 8); p++)
+        {
+            float d = std::fabs(texels[i][channel] - palette[p]);
+            if(d < bestError)
+            {
+                best      = p;
+                bestError = d;
+            }
+        }
+        indices |= static_cast<uint64_t>(best) << (3 * i);
+    }
+
+    out[0] = static_cast<unsigned char>(a0);
+    out[1] = static_cast<unsigned char>(a1);
+    for(int i = 0; i < 6; i++)
+    {
+        out[2 + i] = (indices >> (8 * i)) & 0xff;
+    }
+}
+
+// bc7 mode 6 only: one subset, rgba 7 bit endpoints with a p-bit each, 4 bit indices. the other
+// modes split the block into partitions, which costs a lot of search for a modest gain
+static const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+static void quantizeBc7Endpoint(const float endpoint[4], int quantized[4], int& pBit)
+{
+    float bestError = 1e30f;
+    for(int p = 0; p < 2; p++)
+    {
+        int   candidate[4];
+        float error = 0.0f;
+        for(int c = 0; c < 4; c++)
+        {
+            candidate[c] = std::min(std::max(static_cast<int>((endpoint[c] - p) / 2.0f + 0.5f), 0), 127);
+            float d      = endpoint[c] - ((candidate[c] << 1) | p);
+            error += d * d;
+        }
+        if(error < bestError)
+        {
+            bestError = error;
+            pBit      = p;
+            memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+}
+
+static void writeBits(unsigned char* out, int& bit, int count, uint32_t value)
+{
+    for(int i = 0; i < count; i++, bit++)
+    {
+        if(value & (1u << i))
+        {
+            out[bit / 8] |= 1 << (bit % 8);
+        }
+    }
+}
+
+static float encodeBc7Mode6(const float (*texels)[4], const float e0[4], const float e1[4], unsigned char* out, float* weights)
+{
+    int q0[4], q1[4], p0 = 0, p1 = 0;
+    quantizeBc7Endpoint(e0, q0, p0);
+    quantizeBc7Endpoint(e1, q1, p1);
+    float endpoints[2][4];
+    for(int c = 0; c < 4; c++)
+    {
+        endpoints[0][c] = static_cast<float>((q0[c] << 1) | p0);
+        endpoints[1][c] = static_cast<float>((q1[c] << 1) | p1);
+    }
+
+    int   indices[16];
+    float error = 0.0f;
+    for(int i = 0; i < 16; i++)
+    {
+        float bestError = 1e30f;
+        for(int w = 0; w < 16; w++)
+        {
+            float e = 0.0f;
+            for(int c = 0; c < 4; c++)
+            {
+                float value = ((64 - BC7_WEIGHTS[w]) * endpoints[0][c] + BC7_WEIGHTS[w] * endpoints[1][c] + 32) / 64.0f;
+                float d     = texels[i][c] - value;
+                e += d * d;
+            }
+            if(e < bestError)
+            {
+                bestError  = e;
+                indices[i] = w;
+            }
+        }
+        weights[i] = 1.0f - BC7_WEIGHTS[indices[i]] / 64.0f;
+        error += bestError;
+    }
+
+    // the first index is stored without its top bit, swap the endpoints if it would be set
+    if(indices[0] >= 8)
+    {
+        std::swap(q0, q1);
+        std::swap(p0, p1);
+        for(int i = 0; i < 16; i++)
+        {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(out, 0, 16);
+    int bit = 0;
+    writeBits(out, bit, 7, 1 << 6);
+    for(int c = 0; c < 4; c++)
+    {
+        writeBits(out, bit, 7, q0[c]);
+        writeBits(out, bit, 7, q1[c]);
+    }
+    writeBits(out, bit, 1, p0);
+    writeBits(out, bit, 1, p1);
+    for(int i = 0; i < 16; i++)
+    {
+        writeBits(out, bit, i == 0 ? 3 : 4, indices[i]);
+    }
+    return error;
+}
+
+static void encodeBc7Block(const float (*texels)[4], unsigned char* out)
+{
+    float e0[4], e1[4];
+    fitEndpoints(texels, 16, 4, e0, e1);
+    float weights[16];
+    float error = encodeBc7Mode6(texels, e0, e1, out, weights);
+
+    if(refineEndpoints(texels, weights, 16, 4, e0, e1))
+    {
+        unsigned char refined[16];
+        if(encodeBc7Mode6(texels, e0, e1, refined, weights) < error)
+        {
+            memcpy(out, refined, sizeof(refined));
+        }
+    }
+}
+
+// ------------------ TextureCompressor ------------------
+
+TextureCompression TextureCompressor::resolve(TextureCompression compression, int nrChannels)
+{
+    if(compression == TEXTURE_COMPRESSION_AUTO)
+    {
+        return nrChannels == 4 ? TEXTURE_COMPRESSION_BC3 : TEXTURE_COMPRESSION_BC1;
+    }
+    return compression;
+}
+
+const char* TextureCompressor::name(TextureCompression compression)
+{
+    switch(compression)
+    {
+    case TEXTURE_COMPRESSION_NONE:
+        return "none";
+    case TEXTURE_COMPRESSION_AUTO:
+        return "auto";
+    case TEXTURE_COMPRESSION_BC1:
+        return "bc1";
+    case TEXTURE_COMPRESSION_BC3:
+        return "bc3";
+    case TEXTURE_COMPRESSION_BC5:
+        return "bc5";
+    case TEXTURE_COMPRESSION_BC7:
+        return "bc7";
+    }
+    return "unknown";
+}
+
+size_t TextureCompressor::blockSize(TextureCompression compression)
+{
+    return compression == TEXTURE_COMPRESSION_BC1 ? 8 : 16;
+}
+
+size_t TextureCompressor::levelSize(TextureCompression compression, int width, int height, int nrChannels)
+{
+    if(compression == TEXTURE_COMPRESSION_NONE)
+    {
+        return static_cast<size_t>(width) * height * nrChannels;
+    }
+    return static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * blockSize(compression);
+}
+
+unsigned int TextureCompressor::internalFormat(TextureCompression compression, bool isSrgb)
+{
+    switch(compression)
+    {
+    case TEXTURE_COMPRESSION_BC1:
+        return isSrgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TEXTURE_COMPRESSION_BC3:
+        return isSrgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TEXTURE_COMPRESSION_BC5:
+        return GL_COMPRESSED_RG_RGTC2;
+    case TEXTURE_COMPRESSION_BC7:
+        return isSrgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    default:
+        GL_LOG_E("texture compression %s has no GL format", name(compression));
+        std::abort();
+    }
+}
+
+std::vector<unsigned char> TextureCompressor::encode(const unsigned char* pixels, int width, int height, int nrChannels, TextureCompression compression)
+{
+    int                        blocksX = (width + 3) / 4;
+    int                        blocksY = (height + 3) / 4;
+    size_t                     size    = blockSize(compression);
+    std::vector<unsigned char> blocks(blocksX * blocksY * size);
+
+    parallelFor(blocksY, blocksX, BLOCKS_PER_THREAD, [&](int begin, int end) {
+        float texels[16][4];
+        for(int by = begin; by < end; by++)
+        {
+            for(int bx = 0; bx < blocksX; bx++)
+            {
+                for(int i = 0; i < 16; i++)
+                {
+                    int                  x     = std::min(bx * 4 + i % 4, width - 1);
+                    int                  y     = std::min(by * 4 + i / 4, height - 1);
+                    const unsigned char* texel = pixels + (static_cast<size_t>(y) * width + x) * nrChannels;
+                    for(int c = 0; c < 4; c++)
+                    {
+                        texels[i][c] = c < nrChannels ? texel[c] : 255.0f;
+                    }
+                }
+
+                unsigned char* out = &blocks[(static_cast<size_t>(by) * blocksX + bx) * size];
+                switch(compression)
+                {
+                case TEXTURE_COMPRESSION_BC1:
+                    encodeBc1Block(texels, out);
+                    break;
+                case TEXTURE_COMPRESSION_BC3:
+                    encodeBc4Block(texels, 3, out);
+                    encodeBc1Block(texels, out + 8);
+                    break;
+                case TEXTURE_COMPRESSION_BC5:
+                    encodeBc4Block(texels, 0, out);
+                    encodeBc4Block(texels, 1, out + 8);
+                    break;
+                case TEXTURE_COMPRESSION_BC7:
+                    encodeBc7Block(texels, out);
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+    });
+    return blocks;
+}
+
+void TextureCompressor::compress(TextureImage& image, TextureCompression compression)
+{
+    compression = resolve(compression, image.nrChannels);
+    if(compression == TEXTURE_COMPRESSION_NONE)
+    {
+        return;
+    }
+
+    image.levels.clear();
+    image.levels.push_back(encode(image.pixels.data(), image.width, image.height, image.nrChannels, compression));
+    for(size_t i = 0; i < image.mips.size(); i++)
+    {
+        int level = static_cast<int>(i) + 1;
+        int width = std::max(1, image.width >> level);
+        int height = std::max(1, image.height >> level);
+        image.levels.push_back(encode(image.mips[i].data(), width, height, image.nrChannels, compression));
+    }
+    image.compression = compression;
+    image.pixels      = std::vector<unsigned char>();
+    image.mips        = std::vector<std::vector<unsigned char>>();
+}
+
+uint64_t TextureCompressor::cacheKey(const std::string& path, bool isFlip, const TextureOptions& options)
+{
+    std::error_code error;
+    uint64_t        size  = 0;
+    uint64_t        mtime = 0;
+    // a packed file has no time of its own, the hash of its content changes whenever it does
+    if(!PackFile::isPacked(path, &size, &mtime))
+    {
+        size  = std::filesystem::file_size(path, error);
+        mtime = std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    }
+
+    // fnv-1a over everything that changes the bytes in the cache
+    uint64_t       hash    = 0xcbf29ce484222325ull;
+    const uint64_t parts[] = {size, mtime, isFlip, static_cast<uint64_t>(options.mipFilter), options.isSrgb, static_cast<uint64_t>(options.compression), TEXTURE_CACHE_VERSION};
+    for(uint64_t part : parts)
+    {
+        for(int i = 0; i < 8; i++)
+        {
+            hash ^= (part >> (8 * i)) & 0xff;
+            hash *= 0x100000001b3ull;
+        }
+    }
+    return hash;
+}
+
+uint64_t TextureCompressor::cacheKey(const std::vector<std::string>& paths, bool isFlip, const TextureOptions& options)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for(const auto& path : paths)
+    {
+        uint64_t part = cacheKey(path, isFlip, options);
+        for(int i = 0; i < 8; i++)
+        {
+            hash ^= (part >> (8 * i)) & 0xff;
+            hash *= 0x100000001b3ull;
+        }
+    }
+    return hash;
+}
+
+std::string TextureCompressor::cachePath(const std::string& path)
+{
+    return path + ".texcache";
+}
+
+struct TextureCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t compression;
+    int32_t  width;
+    int32_t  height;
+    int32_t  nrChannels;
+    uint32_t levelCount;
+    uint32_t faceCount;
+};
+
+struct TextureCacheLevel
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+std::vector<const std::vector<unsigned char>*> TextureCompressor::levelsOf(const TextureImage& image)
+{
+    std::vector<const std::vector<unsigned char>*> levels;
+    if(image.compression != TEXTURE_COMPRESSION_NONE)
+    {
+        for(const auto& level : image.levels)
+        {
+            levels.push_back(&level);
+        }
+    }
+    else if(!image.pixels.empty())
+    {
+        levels.push_back(&image.pixels);
+        for(const auto& mip : image.mips)
+        {
+            levels.push_back(&mip);
+        }
+    }
+    return levels;
+}
+
+bool TextureCompressor::loadCache(const std::string& path, uint64_t key, TextureImage& image)
+{
+    std::vector<TextureImage> faces;
+    if(!loadContainer(cachePath(path), key, faces) || faces.size() != 1)
+    {
+        return false;
+    }
+    image      = std::move(faces[0]);
+    image.path = path;
+    return true;
+}
+
+void TextureCompressor::storeCache(const std::string& path, uint64_t key, const TextureImage& image)
+{
+    storeContainer(cachePath(path), key, {&image});
+}
+
+bool TextureCompressor::loadContainer(const std::string& file, uint64_t key, std::vector<TextureImage>& faces)
+{
+    // caches made before packing are packed with their sources
+    FileData data;
+    if(!PackFile::load(file, data))
+    {
+        return false;
+    }
+    auto read = [&data](uint64_t offset, void* target, uint64_t size) {
+        if(offset > data.size || size > data.size - offset)
+        {
+            return false;
+        }
+        memcpy(target, data.data + offset, size);
+        return true;
+    };
+
+    TextureCacheHeader header;
+    if(!read(0, &header, sizeof(header)) || header.magic != TEXTURE_CACHE_MAGIC || header.version != TEXTURE_CACHE_VERSION)
+    {
+        GL_LOG_W("ignore texture cache %s, written by another version", file.c_str());
+        return false;
+    }
+    if(header.key != key)
+    {
+        // the source or the options changed, the caller writes a new one
+        return false;
+    }
+
+    // the counts size the index, so they are checked before anything is allocated
+    bool isValid = header.width > 0 && header.height > 0 && header.nrChannels >= 1 && header.nrChannels <= 4;
+    isValid      = isValid && header.compression != TEXTURE_COMPRESSION_AUTO && header.compression <= TEXTURE_COMPRESSION_BC7;
+    isValid      = isValid && header.faceCount >= 1 && header.faceCount <= 6;
+    isValid      = isValid && header.levelCount >= 1 && header.levelCount <= static_cast<uint32_t>(Texture::mipLevelCount(header.width, header.height));
+    if(!isValid)
+    {
+        GL_LOG_W("corrupt texture cache %s", file.c_str());
+        return false;
+    }
+
+    std::vector<TextureCacheLevel> index(static_cast<size_t>(header.faceCount) * header.levelCount);
+    if(!read(sizeof(header), index.data(), index.size() * sizeof(TextureCacheLevel)))
+    {
+        GL_LOG_W("truncated texture cache %s", file.c_str());
+        return false;
+    }
+
+    auto                      compression = static_cast<TextureCompression>(header.compression);
+    std::vector<TextureImage> images(header.faceCount);
+    for(uint32_t face = 0; face < header.faceCount; face++)
+    {
+        std::vector<std::vector<unsigned char>> levels(header.levelCount);
+        for(uint32_t i = 0; i < header.levelCount; i++)
+        {
+            const TextureCacheLevel& entry  = index[face * header.levelCount + i];
+            int                      width  = std::max(1, header.width >> i);
+            int                      height = std::max(1, header.height >> i);
+            if(entry.size != levelSize(compression, width, height, header.nrChannels) || entry.offset > data.size || entry.size > data.size - entry.offset)
+            {
+                GL_LOG_W("corrupt texture cache %s", file.c_str());
+                return false;
+            }
+            levels[i].resize(entry.size);
+            if(!read(entry.offset, levels[i].data(), entry.size))
+            {
+                GL_LOG_W("truncated texture cache %s", file.c_str());
+                return false;
+            }
+        }
+
+        TextureImage& image = images[face];
+        image.width         = header.width;
+        image.height        = header.height;
+        image.nrChannels    = header.nrChannels;
+        image.path          = file;
+        image.compression   = compression;
+        if(compression != TEXTURE_COMPRESSION_NONE)
+        {
+            image.levels = std::move(levels);
+        }
+        else if(!levels.empty())
+        {
+            image.pixels = std::move(levels[0]);
+            image.mips.assign(std::make_move_iterator(levels.begin() + 1), std::make_move_iterator(levels.end()));
+        }
+    }
+    faces = std::move(images);
+    return true;
+}
+
+void TextureCompressor::storeContainer(const std::string& file, uint64_t key, const std::vector<const TextureImage*>& faces)
+{
+    if(faces.empty())
+    {
+        return;
+    }
+    const TextureImage& first      = *faces[0];
+    auto                levelCount = levelsOf(first).size();
+
+    TextureCacheHeader header = {};
+    header.magic              = TEXTURE_CACHE_MAGIC;
+    header.version            = TEXTURE_CACHE_VERSION;
+    header.key                = key;
+    header.compression        = first.compression;
+    header.width              = first.width;
+    header.height             = first.height;
+    header.nrChannels         = first.nrChannels;
+    header.levelCount         = static_cast<uint32_t>(levelCount);
+    header.faceCount          = static_cast<uint32_t>(faces.size());
+
+    // face major, every level of face 0 first
+    std::vector<const std::vector<unsigned char>*> levels;
+    for(const auto* face : faces)
+    {
+        auto faceLevels = levelsOf(*face);
+        if(faceLevels.size() != levelCount || face->width != first.width || face->height != first.height || face->compression != first.compression)
+        {
+            GL_LOG_W("can't write texture cache %s, %s doesn't match %s or has no pixels", file.c_str(), face->path.c_str(), first.path.c_str());
+            return;
+        }
+        levels.insert(levels.end(), faceLevels.begin(), faceLevels.end());
+    }
+
+    std::vector<TextureCacheLevel> index(levels.size());
+    uint64_t                       offset = sizeof(header) + index.size() * sizeof(TextureCacheLevel);
+    for(size_t i = 0; i < levels.size(); i++)
+    {
+        offset          = (offset + 7) & ~7ull;
+        index[i].offset = offset;
+        index[i].size   = levels[i]->size();
+        offset += index[i].size;
+    }
+
+    // write to a temporary name first so a crash never leaves a half written cache behind
+    std::string tmpPath = file + ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+        if(!ofs)
+        {
+            GL_LOG_W("can't write texture cache %s", tmpPath.c_str());
+            return;
+        }
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(TextureCacheLevel));
+        for(size_t i = 0; i < levels.size(); i++)
+        {
+            static const char zeros[8] = {};
+            ofs.write(zeros, index[i].offset - ofs.tellp());
+            ofs.write(reinterpret_cast<const char*>(levels[i]->data()), levels[i]->size());
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(tmpPath, file, error);
+    if(error)
+    {
+        GL_LOG_W("can't write texture cache %s: %s", file.c_str(), error.message().c_str());
+    }
+}
@@ -0,0 +1,252 @@
+#include "textureStreamer.h"
+#include "camera.h"
+#include "log.h"
+#include "model.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/gtc/matrix_access.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+// clang-format on
+
+// only used to cull spheres, the depth range doesn't matter
+static const float STREAM_NEAR = 0.1f;
+static const float STREAM_FAR  = 1000.0f;
+// textures nobody asked for in this many frames are dropped down to their smallest level and forgotten
+static const int STREAM_FORGET_FRAMES = 600;
+
+TextureStreamer::TextureStreamer(size_t budget, size_t uploadPerFrame)
+    : m_budget(budget)
+    , m_uploadPerFrame(uploadPerFrame)
+{
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    GL_LOG_I("texture streamer: %.2f MB streamed in, %.2f MB evicted, peak %.2f MB of %.2f MB budget",
+             m_streamedBytes / (1024.0 * 1024.0),
+             m_evictedBytes / (1024.0 * 1024.0),
+             m_peakSize / (1024.0 * 1024.0),
+             m_budget / (1024.0 * 1024.0));
+}
+
+void TextureStreamer::request(const Model& model, const glm::mat4& transform)
+{
+    m_requests.push_back({&model, transform});
+}
+
+void TextureStreamer::update(const Camera& camera, float viewportWidth, float viewportHeight)
+{
+    glm::vec3 position = camera.position();
+    glm::vec3 front    = camera.front();
+    float     fov      = glm::radians(camera.fov());
+    glm::mat4 viewProjection =
+        glm::perspective(fov, viewportWidth / viewportHeight, STREAM_NEAR, STREAM_FAR) * glm::lookAt(position, position + front, glm::vec3(0.0f, 1.0f, 0.0f));
+    // pixels per unit of size at distance 1
+    float projectionScale = viewportHeight / (2.0f * std::tan(fov * 0.5f));
+
+    // left, right, bottom, top, near. a sphere is outside if it is behind any of them
+    glm::vec4 planes[5] = {
+        glm::row(viewProjection, 3) + glm::row(viewProjection, 0),
+        glm::row(viewProjection, 3) - glm::row(viewProjection, 0),
+        glm::row(viewProjection, 3) + glm::row(viewProjection, 1),
+        glm::row(viewProjection, 3) - glm::row(viewProjection, 1),
+        glm::row(viewProjection, 3) + glm::row(viewProjection, 2),
+    };
+    for(auto& plane : planes)
+    {
+        plane /= glm::length(glm::vec3(plane));
+    }
+
+    for(auto& item : m_entries)
+    {
+        item.second.wantedLevel = item.second.texture.minResidentLevel();
+        item.second.coverage    = 0.0f;
+        item.second.idleFrames++;
+    }
+
+    // a model with nodes has its meshes where the nodes holding them put them
+    std::vector<std::pair<const Mesh*, glm::mat4>> instances;
+    for(const auto& request : m_requests)
+    {
+        const Model& model = *request.model;
+        if(model.nodes().empty())
+        {
+            for(const auto& mesh : model.meshes())
+            {
+                instances.emplace_back(&mesh, request.transform);
+            }
+        }
+        for(const auto& node : model.nodes())
+        {
+            for(size_t mesh : node.meshes)
+            {
+                instances.emplace_back(&model.meshes()[mesh], request.transform * node.globalTransform);
+            }
+        }
+    }
+
+    for(const auto& instance : instances)
+    {
+        const Mesh&      mesh      = *instance.first;
+        const glm::mat4& transform = instance.second;
+        float            scale     = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+        glm::vec3 center  = glm::vec3(transform * glm::vec4(mesh.boundsCenter(), 1.0f));
+        float     radius  = mesh.boundsRadius() * scale;
+        bool      visible = true;
+        for(const auto& plane : planes)
+        {
+            visible = visible && glm::dot(glm::vec3(plane), center) + plane.w > -radius;
+        }
+
+        // the nearest point of the sphere decides the level, its size the coverage
+        float centerDistance = std::max(glm::length(center - position), STREAM_NEAR);
+        float nearDistance   = std::max(centerDistance - radius, STREAM_NEAR);
+        float screenRadius   = radius * projectionScale / centerDistance;
+        float coverage       = std::min(3.14159265f * screenRadius * screenRadius / (viewportWidth * viewportHeight), 1.0f);
+        // uv units on one pixel at the nearest point
+        float uvPerPixel = mesh.uvDensity() * nearDistance / (scale * projectionScale);
+
+        for(const auto& texture : mesh.textures())
+        {
+            if(!texture.isStreamed())
+            {
+                continue;
+            }
+            auto iter = m_entries.find(texture.id());
+            if(iter == m_entries.end())
+            {
+                Entry entry = {texture, texture.minResidentLevel(), texture.residentLevel(), 0.0f, 0};
+                iter        = m_entries.emplace(texture.id(), entry).first;
+            }
+            Entry& entry     = iter->second;
+            entry.idleFrames = 0;
+            if(!visible || mesh.uvDensity() <= 0.0f)
+            {
+                continue;
+            }
+
+            float texelsPerPixel = std::max(texture.width(), texture.height()) * uvPerPixel;
+            int   level          = texelsPerPixel > 1.0f ? static_cast<int>(std::floor(std::log2(texelsPerPixel))) : 0;
+            entry.wantedLevel    = std::min(entry.wantedLevel, level);
+            entry.coverage += coverage;
+        }
+    }
+    m_requests.clear();
+
+    for(auto iter = m_entries.begin(); iter != m_entries.end();)
+    {
+        const Texture& texture = iter->second.texture;
+        if(iter->second.idleFrames > STREAM_FORGET_FRAMES && texture.residentLevel() == texture.minResidentLevel())
+        {
+            iter = m_entries.erase(iter);
+        }
+        else
+        {
+            ++iter;
+        }
+    }
+
+    fitBudget();
+    apply();
+}
+
+void TextureStreamer::fitBudget()
+{
+    size_t total = 0;
+    for(auto& item : m_entries)
+    {
+        Entry& entry      = item.second;
+        entry.targetLevel = entry.wantedLevel;
+        total += entry.texture.levelsMemorySize(entry.targetLevel);
+    }
+    if(total <= m_budget)
+    {
+        return;
+    }
+
+    // drop one level at a time from the texture where it costs the least picture per byte saved.
+    // every further level dropped from the same texture hurts twice as much
+    struct Candidate
+    {
+        float  cost;
+        Entry* entry;
+
+        bool operator<(const Candidate& other) const
+        {
+            return cost > other.cost;
+        }
+    };
+    auto costOf = [](const Entry& entry) {
+        size_t saved = entry.texture.levelsMemorySize(entry.targetLevel) - entry.texture.levelsMemorySize(entry.targetLevel + 1);
+        float  loss  = (entry.coverage + 1e-6f) * std::ldexp(1.0f, entry.targetLevel - entry.wantedLevel);
+        return loss / std::max<size_t>(saved, 1);
+    };
+
+    std::priority_queue<Candidate> candidates;
+    for(auto& item : m_entries)
+    {
+        if(item.second.targetLevel < item.second.texture.minResidentLevel())
+        {
+            candidates.push({costOf(item.second), &item.second});
+        }
+    }
+    while(total > m_budget && !candidates.empty())
+    {
+        Entry* entry = candidates.top().entry;
+        candidates.pop();
+        total -= entry->texture.levelsMemorySize(entry->targetLevel) - entry->texture.levelsMemorySize(entry->targetLevel + 1);
+        entry->targetLevel++;
+        if(entry->targetLevel < entry->texture.minResidentLevel())
+        {
+            candidates.push({costOf(*entry), entry});
+        }
+    }
+}
+
+void TextureStreamer::apply()
+{
+    // evict first, it is free and makes room for what comes in
+    std::vector<Entry*> incoming;
+    for(auto& item : m_entries)
+    {
+        Entry& entry    = item.second;
+        int    resident = entry.texture.residentLevel();
+        if(entry.targetLevel > resident)
+        {
+            m_evictedBytes += entry.texture.levelsMemorySize(resident) - entry.texture.levelsMemorySize(entry.targetLevel);
+            entry.texture.setResidentLevel(entry.targetLevel);
+        }
+        else if(entry.targetLevel < resident)
+        {
+            incoming.push_back(&entry);
+        }
+    }
+
+    // then the biggest on screen, one level after another, until this frame's uploads are spent
+    std::sort(incoming.begin(), incoming.end(), [](const Entry* a, const Entry* b) { return a->coverage > b->coverage; });
+    size_t uploaded = 0;
+    for(Entry* entry : incoming)
+    {
+        Texture& texture = entry->texture;
+        while(texture.residentLevel() > entry->targetLevel && uploaded < m_uploadPerFrame)
+        {
+            int    level = texture.residentLevel() - 1;
+            size_t bytes = texture.levelsMemorySize(level) - texture.levelsMemorySize(level + 1);
+            texture.setResidentLevel(level);
+            uploaded += bytes;
+        }
+    }
+    m_streamedBytes += uploaded;
+
+    m_residentSize = 0;
+    for(const auto& item : m_entries)
+    {
+        m_residentSize += item.second.texture.levelsMemorySize(item.second.texture.residentLevel());
+    }
+    m_peakSize = std::max(m_peakSize, m_residentSize);
+}
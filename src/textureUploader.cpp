@@ -0,0 +1,254 @@
+#include "textureUploader.h"
+#include "log.h"
+#include "texture.h"
+#include <cstring>
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+// clang-format on
+
+// every range starts aligned for any pixel type and for compressed blocks
+static const size_t STAGING_ALIGNMENT = 16;
+// how long the GL thread waits on the oldest copy when it needs the space itself
+static const uint64_t RECYCLE_TIMEOUT_NS = 1000000000;
+
+static size_t alignUp(size_t size)
+{
+    return (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+}
+
+TextureStaging::~TextureStaging()
+{
+    uploader->release(allocation);
+}
+
+TextureUploader::TextureUploader(size_t capacity)
+    : m_capacity(alignUp(capacity))
+    , m_glThread(std::this_thread::get_id())
+{
+    unsigned int flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &m_buffer);
+    glNamedBufferStorage(m_buffer, m_capacity, nullptr, flags);
+    m_mapped = static_cast<unsigned char*>(glMapNamedBufferRange(m_buffer, 0, m_capacity, flags));
+    if(!m_mapped)
+    {
+        GL_LOG_E("can't map texture upload buffer of %zu bytes", m_capacity);
+        std::abort();
+    }
+}
+
+TextureUploader::~TextureUploader()
+{
+    if(Texture::uploader() == this)
+    {
+        Texture::setUploader(nullptr);
+    }
+    for(auto& allocation : m_allocations)
+    {
+        if(allocation.fence)
+        {
+            glClientWaitSync(static_cast<GLsync>(allocation.fence), GL_SYNC_FLUSH_COMMANDS_BIT, RECYCLE_TIMEOUT_NS);
+            glDeleteSync(static_cast<GLsync>(allocation.fence));
+        }
+    }
+    glUnmapNamedBuffer(m_buffer);
+    glDeleteBuffers(1, &m_buffer);
+    GL_LOG_I("texture uploader: %.2f MB staged, loaders waited %d times, %d images uploaded from client memory", m_stagedBytes / (1024.0 * 1024.0), m_waitCount, m_rejectCount);
+}
+
+std::shared_ptr<TextureStaging> TextureUploader::stage(const std::vector<const std::vector<unsigned char>*>& levels)
+{
+    std::vector<size_t> sizes;
+    for(const auto* level : levels)
+    {
+        sizes.push_back(level->size());
+    }
+    auto staging = reserve(sizes);
+    if(staging)
+    {
+        // the copies run unlocked, loaders fill their ranges at the same time
+        for(size_t i = 0; i < levels.size(); i++)
+        {
+            memcpy(staging->mapped + staging->offsets[i], levels[i]->data(), levels[i]->size());
+        }
+    }
+    return staging;
+}
+
+std::shared_ptr<TextureStaging> TextureUploader::reserve(const std::vector<size_t>& sizes)
+{
+    size_t total = 0;
+    for(size_t size : sizes)
+    {
+        total += alignUp(size);
+    }
+    if(total == 0)
+    {
+        return nullptr;
+    }
+
+    size_t                       offset = 0;
+    uint64_t                     id     = 0;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while(!tryAllocate(total, offset, id))
+    {
+        // the ring frees from the front. a live range there belongs to an image that hasn't been uploaded
+        // yet, maybe one held by the very thread asking, so waiting could wait forever
+        if(total > m_capacity || m_allocations.front().state == ALLOCATION_LIVE)
+        {
+            m_rejectCount++;
+            return nullptr;
+        }
+
+        if(std::this_thread::get_id() == m_glThread)
+        {
+            lock.unlock();
+            recycle(true);
+            lock.lock();
+        }
+        else
+        {
+            m_waitCount++;
+            m_recycled.wait(lock);
+        }
+    }
+    m_stagedBytes += total;
+    lock.unlock();
+
+    auto staging        = std::make_shared<TextureStaging>();
+    staging->uploader   = this;
+    staging->allocation = id;
+    staging->buffer     = m_buffer;
+    staging->mapped     = m_mapped;
+    for(size_t size : sizes)
+    {
+        staging->offsets.push_back(offset);
+        staging->sizes.push_back(size);
+        offset += alignUp(size);
+    }
+    return staging;
+}
+
+void TextureUploader::fence(const TextureStaging& staging)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Allocation*                 allocation = find(staging.allocation);
+    if(allocation->fence)
+    {
+        glDeleteSync(static_cast<GLsync>(allocation->fence));
+    }
+    allocation->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void TextureUploader::update()
+{
+    recycle(false);
+}
+
+void TextureUploader::release(uint64_t id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    find(id)->state = ALLOCATION_RELEASED;
+
+    // ranges that never reached the GPU are free right away, no GL call needed
+    while(!m_allocations.empty() && m_allocations.front().state != ALLOCATION_LIVE && !m_allocations.front().fence)
+    {
+        m_allocations.pop_front();
+    }
+    if(m_allocations.empty())
+    {
+        m_head = 0;
+    }
+    m_recycled.notify_all();
+}
+
+bool TextureUploader::tryAllocate(size_t size, size_t& offset, uint64_t& id)
+{
+    if(size > m_capacity)
+    {
+        return false;
+    }
+
+    if(m_allocations.empty())
+    {
+        offset = 0;
+    }
+    else
+    {
+        size_t tail = m_allocations.front().offset;
+        if(m_head > tail)
+        {
+            if(m_head + size <= m_capacity)
+            {
+                offset = m_head;
+            }
+            else if(size <= tail)
+            {
+                // skip the end of the buffer, it comes back when the ring gets there
+                m_allocations.push_back({0, m_head, m_capacity - m_head, ALLOCATION_PADDING, nullptr});
+                offset = 0;
+            }
+            else
+            {
+                return false;
+            }
+        }
+        else if(m_head < tail && m_head + size <= tail)
+        {
+            offset = m_head;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    id = m_nextId++;
+    m_allocations.push_back({id, offset, size, ALLOCATION_LIVE, nullptr});
+    m_head = offset + size;
+    return true;
+}
+
+void TextureUploader::recycle(bool isBlocking)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool                        isRecycled = false;
+    while(!m_allocations.empty() && m_allocations.front().state != ALLOCATION_LIVE)
+    {
+        Allocation& front = m_allocations.front();
+        if(front.fence)
+        {
+            GLenum status = glClientWaitSync(static_cast<GLsync>(front.fence), isBlocking ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, isBlocking ? RECYCLE_TIMEOUT_NS : 0);
+            if(status == GL_TIMEOUT_EXPIRED)
+            {
+                break;
+            }
+            glDeleteSync(static_cast<GLsync>(front.fence));
+        }
+        m_allocations.pop_front();
+        isRecycled = true;
+        // one wait is enough, later copies were issued after it
+        isBlocking = false;
+    }
+    if(m_allocations.empty())
+    {
+        m_head = 0;
+    }
+    if(isRecycled)
+    {
+        m_recycled.notify_all();
+    }
+}
+
+TextureUploader::Allocation* TextureUploader::find(uint64_t id)
+{
+    for(auto& allocation : m_allocations)
+    {
+        if(allocation.id == id)
+        {
+            return &allocation;
+        }
+    }
+    GL_LOG_E("unknown texture staging allocation %llu", static_cast<unsigned long long>(id));
+    std::abort();
+}
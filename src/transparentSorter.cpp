@@ -0,0 +1,150 @@
+#include "transparentSorter.h"
+#include <cstring>
+
+#if defined(__SSE2__)
+#    include <emmintrin.h>
+#    include <xmmintrin.h>
+#endif
+
+static_assert(sizeof(TransparentDraw) == 4 * sizeof(float), "TransparentDraw is loaded as one 128 bit lane");
+
+// map float bits to an unsigned key with the same ordering
+static inline unsigned int floatToKey(float value)
+{
+    unsigned int bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    unsigned int mask = (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+    return bits ^ mask;
+}
+
+const std::vector<unsigned int>& TransparentSorter::sort(const TransparentDraw* draws, size_t count, const glm::mat4& view)
+{
+    reserve(count);
+    m_keys.resize(count);
+    m_tmpKeys.resize(count);
+    m_indices.resize(count);
+    m_tmpIndices.resize(count);
+
+    computeDepthKeys(draws, count, view);
+    radixSort(count);
+    return m_indices;
+}
+
+const std::vector<unsigned int>& TransparentSorter::sort(const std::vector<TransparentDraw>& draws, const glm::mat4& view)
+{
+    return sort(draws.data(), draws.size(), view);
+}
+
+void TransparentSorter::reserve(size_t count)
+{
+    if(m_keys.capacity() >= count)
+    {
+        return;
+    }
+    m_keys.reserve(count);
+    m_tmpKeys.reserve(count);
+    m_indices.reserve(count);
+    m_tmpIndices.reserve(count);
+}
+
+void TransparentSorter::computeDepthKeys(const TransparentDraw* draws, size_t count, const glm::mat4& view)
+{
+    // only the view-space z is needed: z = row2(view) . (p, 1)
+    // the camera looks down -z, so ascending z is back to front.
+    float r0 = view[0][2];
+    float r1 = view[1][2];
+    float r2 = view[2][2];
+    float r3 = view[3][2];
+
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128  vr0      = _mm_set1_ps(r0);
+    const __m128  vr1      = _mm_set1_ps(r1);
+    const __m128  vr2      = _mm_set1_ps(r2);
+    const __m128  vr3      = _mm_set1_ps(r3);
+    const __m128i signFlip = _mm_set1_epi32(static_cast<int>(0x80000000u));
+    const __m128i lane     = _mm_setr_epi32(0, 1, 2, 3);
+    for(; i + 4 <= count; i += 4)
+    {
+        // each draw is x, y, z, id. transpose four of them into x, y, z, id lanes
+        __m128 x  = _mm_loadu_ps(reinterpret_cast<const float*>(&draws[i + 0]));
+        __m128 y  = _mm_loadu_ps(reinterpret_cast<const float*>(&draws[i + 1]));
+        __m128 z  = _mm_loadu_ps(reinterpret_cast<const float*>(&draws[i + 2]));
+        __m128 id = _mm_loadu_ps(reinterpret_cast<const float*>(&draws[i + 3]));
+        _MM_TRANSPOSE4_PS(x, y, z, id);
+
+        __m128 depth = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, vr0), _mm_mul_ps(y, vr1)), _mm_add_ps(_mm_mul_ps(z, vr2), vr3));
+
+        __m128i bits = _mm_castps_si128(depth);
+        __m128i mask = _mm_or_si128(_mm_srai_epi32(bits, 31), signFlip);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&m_keys[i]), _mm_xor_si128(bits, mask));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(&m_indices[i]), _mm_add_epi32(lane, _mm_set1_epi32(static_cast<int>(i))));
+    }
+#endif
+    for(; i < count; i++)
+    {
+        const glm::vec3& p = draws[i].position;
+        m_keys[i]          = floatToKey(p.x * r0 + p.y * r1 + p.z * r2 + r3);
+        m_indices[i]       = static_cast<unsigned int>(i);
+    }
+}
+
+void TransparentSorter::radixSort(size_t count)
+{
+    // LSD radix sort, 8 bits per pass. every pass is stable, so equal depths keep submission order.
+    if(count < 2)
+    {
+        return;
+    }
+
+    unsigned int* keys       = m_keys.data();
+    unsigned int* tmpKeys    = m_tmpKeys.data();
+    unsigned int* indices    = m_indices.data();
+    unsigned int* tmpIndices = m_tmpIndices.data();
+
+    size_t histogram[4][256] = {};
+    for(size_t i = 0; i < count; i++)
+    {
+        unsigned int key = keys[i];
+        histogram[0][key & 0xFF]++;
+        histogram[1][(key >> 8) & 0xFF]++;
+        histogram[2][(key >> 16) & 0xFF]++;
+        histogram[3][key >> 24]++;
+    }
+
+    for(int pass = 0; pass < 4; pass++)
+    {
+        size_t*      counts = histogram[pass];
+        unsigned int shift  = pass * 8;
+
+        // all keys share this digit, the pass would be an identity copy
+        if(counts[(keys[0] >> shift) & 0xFF] == count)
+        {
+            continue;
+        }
+
+        size_t offset = 0;
+        for(int digit = 0; digit < 256; digit++)
+        {
+            size_t n      = counts[digit];
+            counts[digit] = offset;
+            offset += n;
+        }
+
+        for(size_t i = 0; i < count; i++)
+        {
+            size_t dst      = counts[(keys[i] >> shift) & 0xFF]++;
+            tmpKeys[dst]    = keys[i];
+            tmpIndices[dst] = indices[i];
+        }
+        std::swap(keys, tmpKeys);
+        std::swap(indices, tmpIndices);
+    }
+
+    // an odd number of executed passes leaves the result in the scratch buffers
+    if(indices != m_indices.data())
+    {
+        m_keys.swap(m_tmpKeys);
+        m_indices.swap(m_tmpIndices);
+    }
+}
@@ -1,5 +1,8 @@
 #include "window.h"
+#include "bufferAllocator.h"
 #include "log.h"
+#include "resourceManager.h"
+#include "samplerCache.h"
 // clang-format off
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -28,6 +31,8 @@ Window::Window(float width, float height)
 
     glfwMakeContextCurrent(m_window);
     gladLoadGL();
+    // cube maps filter across face edges, the mips of each face are built on their own and seams show otherwise
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
 }
 
 Window::~Window()
@@ -36,6 +41,10 @@ Window::~Window()
     {
         // release
         GL_LOG_D("release window");
+        SamplerCache::clear();
+        // geometry ranges still queued go back to the allocator before it is deleted
+        ResourceManager::shutdown();
+        BufferAllocator::releaseGeometry();
         glfwTerminate();
     }
 }
@@ -45,6 +54,12 @@ GLFWwindow* Window::glfwWindow() const
     return m_window;
 }
 
+void Window::swapBuffers()
+{
+    ResourceManager::collect();
+    glfwSwapBuffers(m_window);
+}
+
 void Window::setFrameBufferSizeCallback(FrameBufferSizeCallbackFunc cb)
 {
     glfwSetFramebufferSizeCallback(m_window, cb);
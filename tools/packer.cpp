@@ -0,0 +1,55 @@
+#include "log.h"
+#include "packFile.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// packer <directory> <output.pack> [-l level] [--store]
+// packs every file below directory, named by its path relative to it. mount the result at the same
+// directory with PackFile::mount and the loaders find the files in it
+int main(int argc, char** argv)
+{
+    if(argc < 3)
+    {
+        fprintf(stderr, "usage: %s <directory> <output.pack> [-l level] [--store]\n", argv[0]);
+        return 1;
+    }
+    std::string directory = argv[1];
+    std::string output    = argv[2];
+    int         level     = 6;
+    for(int i = 3; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+        {
+            level = std::atoi(argv[++i]);
+        }
+        else if(strcmp(argv[i], "--store") == 0)
+        {
+            level = 0;
+        }
+    }
+
+    std::error_code                                  error;
+    std::filesystem::path                            outputPath = std::filesystem::absolute(output, error).lexically_normal();
+    std::vector<std::pair<std::string, std::string>> files;
+    for(auto iter = std::filesystem::recursive_directory_iterator(directory, error); !error && iter != std::filesystem::recursive_directory_iterator(); iter.increment(error))
+    {
+        if(!iter->is_regular_file() || std::filesystem::absolute(iter->path(), error).lexically_normal() == outputPath)
+        {
+            continue;
+        }
+        std::string name = iter->path().lexically_relative(directory).generic_string();
+        files.emplace_back(name, iter->path().string());
+    }
+    if(error)
+    {
+        GL_LOG_E("can't list %s: %s", directory.c_str(), error.message().c_str());
+        return 1;
+    }
+    // the same tree gives the same pack
+    std::sort(files.begin(), files.end());
+    return PackFile::write(output, files, level) ? 0 : 1;
+}
@@ -9,16 +9,20 @@
 #include <iostream>
 #include <memory>
 #include <cmath>
-#include <map>
 
 #include "window.h"
 #include "shader.h"
+#include "shaderVariantCache.h"
 #include "texture.h"
+#include "textureAtlas.h"
 #include "camera.h"
 #include "model.h"
+#include "transparentSorter.h"
+#include "renderTarget.h"
 
 float  windowW = 800.0f, windowH = 600.0f;
 bool   isWireframeMode = false;
+bool   isOITMode       = false;
 float  mixValue        = 0.0f;
 float  deltaTime       = 0.0f; // 当前帧与上一帧的时间差
 float  lastFrame       = 0.0f; // 上一帧的时间
@@ -27,10 +31,18 @@ bool   firstMouse = true;
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0, 0.0f);
 float  near = 0.1f;
 float  far  = 100.0f;
+bool   isFramebufferResized = false;
 
 void frameBufferSizeCallback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    // offscreen targets are resized at the start of the next frame
+    if(width > 0 && height > 0)
+    {
+        windowW              = width;
+        windowH              = height;
+        isFramebufferResized = true;
+    }
 }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode)
@@ -51,6 +63,11 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode
             glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
         }
     }
+    else if(key == GLFW_KEY_O && action == GLFW_PRESS)
+    {
+        isOITMode = !isOITMode;
+        GL_LOG_I("order independent transparency %s", isOITMode ? "on" : "off");
+    }
     else if(key == GLFW_KEY_UP && action == GLFW_PRESS)
     {
         mixValue += 0.1f;
@@ -112,7 +129,11 @@ int main()
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
-    ShaderProgram shader("../../resource/shader/4-advanced-opengl/depth-test.vs", "../../resource/shader/4-advanced-opengl/depth-test.fs");
+    ShaderVariantCache variants("../../resource/shader/4-advanced-opengl/depth-test.vs", "../../resource/shader/4-advanced-opengl/depth-test.fs");
+    ShaderVariantCache oitVariants("../../resource/shader/4-advanced-opengl/depth-test.vs", "../../resource/shader/4-advanced-opengl/oit-transparent.fs");
+    ShaderProgram&     shader    = variants.get({{"USE_ATLAS", ""}});
+    ShaderProgram&     oitShader = oitVariants.get({{"USE_ATLAS", ""}});
+    ShaderProgram compositeShader("../../resource/shader/4-advanced-opengl/screen.vs", "../../resource/shader/4-advanced-opengl/oit-composite.fs");
 
     // clang-format off
     float cubeVertices[] = {
@@ -179,6 +200,16 @@ int main()
         1.0f, -0.5f,  0.0f,  1.0f,  1.0f,
         1.0f,  0.5f,  0.0f,  1.0f,  0.0f
     };
+    float quadVertices[] = { // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
+        // positions   // texCoords
+        -1.0f,  1.0f,  0.0f, 1.0f,
+        -1.0f, -1.0f,  0.0f, 0.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+
+        -1.0f,  1.0f,  0.0f, 1.0f,
+         1.0f, -1.0f,  1.0f, 0.0f,
+         1.0f,  1.0f,  1.0f, 1.0f
+    };
 
 
     vector<glm::vec3> windows 
@@ -224,23 +255,89 @@ int main()
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 
+    unsigned int quadVAO, quadVBO;
+    glGenVertexArrays(1, &quadVAO);
+    glGenBuffers(1, &quadVBO);
+    glBindVertexArray(quadVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices[0], GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
+
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    Texture cubeTexture("../../resource/texture/marble.jpg");
-    Texture floorTexture("../../resource/texture/metal.png");
-    Texture grassTexture("../../resource/texture/grass.png", TextureType::TEXTURE_DIFFUSE, false);
-    Texture windowTexture("../../resource/texture/window.png");
+    // every texture of the scene in one array: marble and the repeating floor get a layer each, grass
+    // and window share one. drawing switches regions by uniform instead of binding
+    TextureAtlas atlas;
+    int          cubeRegion   = atlas.add("../../resource/texture/marble.jpg");
+    int          floorRegion  = atlas.add("../../resource/texture/metal.png", true, true);
+    int          windowRegion = atlas.add("../../resource/texture/window.png");
+    atlas.add("../../resource/texture/grass.png", false);
+    atlas.build();
+    auto useRegion = [&](ShaderProgram& program, int index) {
+        const AtlasRegion& region = atlas.region(index);
+        program.setVec4("uvTransform", glm::value_ptr(region.uvTransform));
+        program.setFloat("atlasLayer", static_cast<float>(region.layer));
+    };
+
+    // weighted blended OIT targets: opaque color + depth, then accumulation and revealage sharing that depth
+    RenderTargetDesc opaqueDesc;
+    opaqueDesc.width        = window.width();
+    opaqueDesc.height       = window.height();
+    opaqueDesc.colorFormats = {RT_FORMAT_RGBA8};
+    opaqueDesc.depthFormat  = RT_FORMAT_DEPTH24_STENCIL8;
+    RenderTarget opaqueTarget(opaqueDesc);
+
+    RenderTargetDesc transparentDesc;
+    transparentDesc.width        = window.width();
+    transparentDesc.height       = window.height();
+    transparentDesc.colorFormats = {RT_FORMAT_RGBA16F, RT_FORMAT_R8};
+    RenderTarget transparentTarget(transparentDesc);
+    transparentTarget.shareDepth(opaqueTarget);
 
     shader.use();
     shader.setInt("texture1", 0);
 
+    oitShader.use();
+    oitShader.setInt("texture1", 0);
+
+    compositeShader.use();
+    compositeShader.setInt("accumTexture", 0);
+    compositeShader.setInt("revealTexture", 1);
+
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
+    std::vector<TransparentDraw> windowDraws;
+    for(unsigned int i = 0; i < windows.size(); i++)
+    {
+        windowDraws.push_back({windows[i], i});
+    }
+    TransparentSorter windowSorter;
+    windowSorter.reserve(windowDraws.size());
+
     while(!glfwWindowShouldClose(glfwWindow))
     {
+        if(isFramebufferResized)
+        {
+            opaqueTarget.resize(windowW, windowH);
+            transparentTarget.resize(windowW, windowH);
+            transparentTarget.shareDepth(opaqueTarget);
+            isFramebufferResized = false;
+        }
+
         // render
+        if(isOITMode)
+        {
+            opaqueTarget.bind();
+        }
+        else
+        {
+            RenderTarget::bindDefault(windowW, windowH);
+        }
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         float currentFrame = glfwGetTime();
@@ -250,18 +347,18 @@ int main()
         shader.use();
         glm::mat4 view = camera.getViewMatrix();
         glm::mat4 projection(1.0f);
-        projection = glm::perspective(glm::radians(camera.fov()), window.width() / window.height(), near, far);
+        projection = glm::perspective(glm::radians(camera.fov()), windowW / windowH, near, far);
         shader.setMat4("view", glm::value_ptr(view));
         shader.setMat4("projection", glm::value_ptr(projection));
         shader.setFloat("near", near);
         shader.setFloat("far", far);
 
         glm::mat4 model(1.0f);
+        atlas.bind(0);
 
         //draw cube
         glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture.id());
+        useRegion(shader, cubeRegion);
         model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
         shader.setMat4("model", glm::value_ptr(model));
         glDrawArrays(GL_TRIANGLES, 0, 36);
@@ -273,34 +370,70 @@ int main()
 
         // draw floor
         glBindVertexArray(planeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTexture.id());
+        useRegion(shader, floorRegion);
         model = glm::mat4(1.0f);
         shader.setMat4("model", glm::value_ptr(model));
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
         // draw window
         glBindVertexArray(transparentVAO);
-        glBindTexture(GL_TEXTURE_2D, windowTexture.id());
-        std::map<float, glm::vec3> sotredWindows;
-
-        for(unsigned int i = 0; i < windows.size(); i++)
+        useRegion(shader, windowRegion);
+        if(!isOITMode)
         {
-            float distance          = glm::distance(camera.position(), windows[i]);
-            sotredWindows[distance] = windows[i];
+            const auto& sortedWindows = windowSorter.sort(windowDraws, view);
+            for(unsigned int idx : sortedWindows)
+            {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, windowDraws[idx].position);
+                shader.setMat4("model", glm::value_ptr(model));
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
         }
-
-        for(auto it = sotredWindows.rbegin(); it != sotredWindows.rend(); it++)
+        else
         {
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, it->second);
-            shader.setMat4("model", glm::value_ptr(model));
+            // transparent pass: no sort, depth tested against the opaque depth but not written
+            const float clearAccum[]  = {0.0f, 0.0f, 0.0f, 0.0f};
+            const float clearReveal[] = {1.0f, 0.0f, 0.0f, 0.0f};
+            transparentTarget.bind();
+            glClearBufferfv(GL_COLOR, 0, clearAccum);
+            glClearBufferfv(GL_COLOR, 1, clearReveal);
+            glDepthMask(GL_FALSE);
+            glBlendFunci(0, GL_ONE, GL_ONE);
+            glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+
+            oitShader.use();
+            oitShader.setMat4("view", glm::value_ptr(view));
+            oitShader.setMat4("projection", glm::value_ptr(projection));
+            useRegion(oitShader, windowRegion);
+            for(const auto& windowDraw : windowDraws)
+            {
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, windowDraw.position);
+                oitShader.setMat4("model", glm::value_ptr(model));
+                glDrawArrays(GL_TRIANGLES, 0, 6);
+            }
+
+            // composite over the opaque image, then present it
+            opaqueTarget.bind();
+            glDepthFunc(GL_ALWAYS);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            compositeShader.use();
+            glBindVertexArray(quadVAO);
+            Texture::bindUnit(0, transparentTarget.colorTexture(0));
+            Texture::bindUnit(1, transparentTarget.colorTexture(1));
             glDrawArrays(GL_TRIANGLES, 0, 6);
+            glDepthFunc(GL_LESS);
+            glDepthMask(GL_TRUE);
+
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, opaqueTarget.id());
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, opaqueTarget.width(), opaqueTarget.height(), 0, 0, windowW, windowH, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+            RenderTarget::bindDefault(windowW, windowH);
         }
 
         glBindVertexArray(0);
 
-        glfwSwapBuffers(glfwWindow);
+        window.swapBuffers();
         glfwPollEvents();
     }
 
@@ -12,7 +12,9 @@
 
 #include "window.h"
 #include "shader.h"
+#include "shaderVariantCache.h"
 #include "texture.h"
+#include "textureAtlas.h"
 #include "camera.h"
 #include "model.h"
 
@@ -111,7 +113,8 @@ int main()
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
-    ShaderProgram shader("../../resource/shader/4-advanced-opengl/depth-test.vs", "../../resource/shader/4-advanced-opengl/depth-test.fs");
+    ShaderVariantCache variants("../../resource/shader/4-advanced-opengl/depth-test.vs", "../../resource/shader/4-advanced-opengl/depth-test.fs");
+    ShaderProgram&     shader = variants.get({{"USE_ATLAS", ""}});
 
     // clang-format off
     float cubeVertices[] = {
@@ -195,11 +198,19 @@ int main()
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    Texture cubeTexture("../../resource/texture/marble.jpg");
-    Texture floorTexture("../../resource/texture/metal.png");
+    // both textures are layers of one array, the scene binds it once
+    TextureAtlas atlas;
+    int          cubeRegion  = atlas.add("../../resource/texture/marble.jpg");
+    int          floorRegion = atlas.add("../../resource/texture/metal.png", true, true);
+    atlas.build();
 
     shader.use();
     shader.setInt("texture1", 0);
+    auto useRegion = [&](int index) {
+        const AtlasRegion& region = atlas.region(index);
+        shader.setVec4("uvTransform", glm::value_ptr(region.uvTransform));
+        shader.setFloat("atlasLayer", static_cast<float>(region.layer));
+    };
 
     while(!glfwWindowShouldClose(glfwWindow))
     {
@@ -220,12 +231,12 @@ int main()
         shader.setFloat("far", far);
 
         glm::mat4 model(1.0f);
+        atlas.bind(0);
 
         glEnable(GL_CULL_FACE);
         //draw cube
         glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, cubeTexture.id());
+        useRegion(cubeRegion);
         model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
         shader.setMat4("model", glm::value_ptr(model));
         glDrawArrays(GL_TRIANGLES, 0, 36);
@@ -238,15 +249,14 @@ int main()
         glDisable(GL_CULL_FACE);
         // draw floor
         glBindVertexArray(planeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTexture.id());
+        useRegion(floorRegion);
         model = glm::mat4(1.0f);
         shader.setMat4("model", glm::value_ptr(model));
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
         glBindVertexArray(0);
 
-        glfwSwapBuffers(glfwWindow);
+        window.swapBuffers();
         glfwPollEvents();
     }
 
@@ -15,6 +15,8 @@
 #include "texture.h"
 #include "camera.h"
 #include "model.h"
+#include "frameGraph.h"
+#include "postProcess.h"
 
 float  windowW = 800.0f, windowH = 600.0f;
 bool   isWireframeMode = false;
@@ -26,10 +28,19 @@ bool   firstMouse = true;
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0, 0.0f);
 float  near = 0.1f;
 float  far  = 100.0f;
+bool   isFusionOn     = true;
+bool   isEdgeDetectOn = false;
+bool   isChainDirty   = true;
 
 void frameBufferSizeCallback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    // the frame graph picks up the new size next frame
+    if(width > 0 && height > 0)
+    {
+        windowW = width;
+        windowH = height;
+    }
 }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode)
@@ -66,6 +77,16 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode
             mixValue = 0.0f;
         }
     }
+    else if(key == GLFW_KEY_F && action == GLFW_PRESS)
+    {
+        isFusionOn   = !isFusionOn;
+        isChainDirty = true;
+    }
+    else if(key == GLFW_KEY_E && action == GLFW_PRESS)
+    {
+        isEdgeDetectOn = !isEdgeDetectOn;
+        isChainDirty   = true;
+    }
 
     if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.move(CameraDirection::FORWARD, deltaTime);
@@ -112,14 +133,11 @@ int main()
     glDepthFunc(GL_LESS);
 
     ShaderProgram shader("../../resource/shader/4-advanced-opengl/depth-test.vs", "../../resource/shader/4-advanced-opengl/depth-test.fs");
-    ShaderProgram screenShader("../../resource/shader/4-advanced-opengl/screen.vs", "../../resource/shader/4-advanced-opengl/screen.fs");
 
     Texture cubeTexture("../../resource/texture/marble.jpg");
     Texture floorTexture("../../resource/texture/metal.png");
     Texture containerTexture("../../resource/texture/container2.png");
 
-    Texture texColorBuffer(window.width(), window.height(), 3);
-
     // clang-format off
     float cubeVertices[] = {
         // Back face
@@ -175,16 +193,6 @@ int main()
         -5.0f, -0.5f, -5.0f,  0.0f, 2.0f,
          5.0f, -0.5f, -5.0f,  2.0f, 2.0f								
     };
-    float quadVertices[] = { // vertex attributes for a quad that fills the entire screen in Normalized Device Coordinates.
-        // positions   // texCoords
-        -1.0f,  1.0f,  0.0f, 1.0f,
-        -1.0f, -1.0f,  0.0f, 0.0f,
-         1.0f, -1.0f,  1.0f, 0.0f,
-
-        -1.0f,  1.0f,  0.0f, 1.0f,
-         1.0f, -1.0f,  1.0f, 0.0f,
-         1.0f,  1.0f,  1.0f, 1.0f
-    };
     // clang-format on
 
     unsigned int cubeVAO, cubeVBO;
@@ -209,47 +217,16 @@ int main()
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 
-    unsigned int quadVAO, quadVBO;
-    glGenVertexArrays(1, &quadVAO);
-    glGenBuffers(1, &quadVBO);
-    glBindVertexArray(quadVAO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices[0], GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 
-    // frame buffer
-    unsigned int framebuffer;
-    glGenFramebuffers(1, &framebuffer);
-    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texColorBuffer.id(), 0);
-
-    unsigned int rbo;
-    glGenRenderbuffers(1, &rbo);
-    glBindRenderbuffer(GL_RENDERBUFFER, rbo);
-    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, window.width(), window.height());
-    glBindRenderbuffer(GL_RENDERBUFFER, 0);
-
-    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, rbo);
-
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    {
-        GL_LOG_E("ERROR::FRAMEBUFFER:: Framebuffer is not complete!");
-        std::abort();
-    }
-
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
     shader.use();
     shader.setInt("texture1", 0);
 
-    screenShader.use();
-    screenShader.setInt("screenTexture", 0);
+    RenderTargetPool targetPool;
+    FrameGraph       frameGraph(targetPool);
+    PostProcessChain postChain;
+    int              frameCount = 0;
 
     while(!glfwWindowShouldClose(glfwWindow))
     {
@@ -258,58 +235,82 @@ int main()
         deltaTime          = currentFrame - lastFrame;
         lastFrame          = currentFrame;
 
+        if(isChainDirty)
+        {
+            postChain.clear();
+            postChain.add(POST_EFFECT_BLUR, 2.0f);
+            postChain.add(isEdgeDetectOn ? POST_EFFECT_EDGE_DETECT : POST_EFFECT_SHARPEN);
+            postChain.add(POST_EFFECT_TONE_MAPPING, 1.0f);
+            postChain.add(POST_EFFECT_GAMMA, 2.2f);
+            postChain.setFusion(isFusionOn);
+            isChainDirty = false;
+        }
+
+        frameGraph.reset();
+        FrameGraphResource backbuffer = frameGraph.importBackbuffer("backbuffer", windowW, windowH);
+        FrameGraphResource sceneColor = FRAME_GRAPH_INVALID_RESOURCE;
+
         // render new framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-        glEnable(GL_DEPTH_TEST);
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        shader.use();
-        glm::mat4 view = camera.getViewMatrix();
-        glm::mat4 projection(1.0f);
-        projection = glm::perspective(glm::radians(camera.fov()), window.width() / window.height(), near, far);
-        shader.setMat4("view", glm::value_ptr(view));
-        shader.setMat4("projection", glm::value_ptr(projection));
-        shader.setFloat("near", near);
-        shader.setFloat("far", far);
-
-        glm::mat4 model(1.0f);
-        //draw cube
-        glBindVertexArray(cubeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, containerTexture.id());
-        model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-        shader.setMat4("model", glm::value_ptr(model));
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-        shader.setMat4("model", glm::value_ptr(model));
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-
-        // draw floor
-        glBindVertexArray(planeVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, floorTexture.id());
-        model = glm::mat4(1.0f);
-        shader.setMat4("model", glm::value_ptr(model));
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-
-        // switch to default frame buffer
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glDisable(GL_DEPTH_TEST);
-
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0f); // set clear color to white (not really necessary actually, since we won't be able to see behind the quad anyways)
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        screenShader.use();
-        glBindVertexArray(quadVAO);
-        glBindTexture(GL_TEXTURE_2D, texColorBuffer.id());
-        glActiveTexture(GL_TEXTURE0);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        glfwSwapBuffers(glfwWindow);
+        frameGraph.addPass(
+            "scene",
+            [&](FrameGraphBuilder& builder) {
+                RenderTargetDesc sceneDesc;
+                sceneDesc.width        = windowW;
+                sceneDesc.height       = windowH;
+                sceneDesc.colorFormats = {RT_FORMAT_RGBA16F};
+                sceneDesc.depthFormat  = RT_FORMAT_DEPTH24_STENCIL8;
+                sceneColor             = builder.write(builder.create("sceneColor", sceneDesc));
+            },
+            [&](const FrameGraphResources& resources) {
+                resources.bind(sceneColor);
+                glEnable(GL_DEPTH_TEST);
+                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                shader.use();
+                glm::mat4 view = camera.getViewMatrix();
+                glm::mat4 projection(1.0f);
+                projection = glm::perspective(glm::radians(camera.fov()), windowW / windowH, near, far);
+                shader.setMat4("view", glm::value_ptr(view));
+                shader.setMat4("projection", glm::value_ptr(projection));
+                shader.setFloat("near", near);
+                shader.setFloat("far", far);
+
+                glm::mat4 model(1.0f);
+                //draw cube
+                glBindVertexArray(cubeVAO);
+                containerTexture.bind(0);
+                model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
+                shader.setMat4("model", glm::value_ptr(model));
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+
+                model = glm::mat4(1.0f);
+                model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
+                shader.setMat4("model", glm::value_ptr(model));
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+
+                // draw floor
+                glBindVertexArray(planeVAO);
+                floorTexture.bind(0);
+                model = glm::mat4(1.0f);
+                shader.setMat4("model", glm::value_ptr(model));
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                glBindVertexArray(0);
+            });
+
+        // post processing straight into the default frame buffer
+        postChain.addPasses(frameGraph, sceneColor, backbuffer, windowW, windowH);
+
+        frameGraph.compile();
+        frameGraph.execute();
+        targetPool.endFrame();
+
+        if(++frameCount % 120 == 0)
+        {
+            GL_LOG_I("post process %dx%d %s, %d passes: %.3f ms gpu", static_cast<int>(windowW), static_cast<int>(windowH), postChain.isFused() ? "fused" : "unfused", postChain.passCount(), postChain.averageGpuTimeMs());
+        }
+
+        window.swapBuffers();
         glfwPollEvents();
     }
 
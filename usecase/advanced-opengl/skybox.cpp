@@ -12,9 +12,13 @@
 
 #include "window.h"
 #include "shader.h"
+#include "shaderVariantCache.h"
 #include "texture.h"
 #include "camera.h"
 #include "model.h"
+#include "frameGraph.h"
+#include "hotReloader.h"
+#include "textureUploader.h"
 
 float  windowW = 800.0f, windowH = 600.0f;
 bool   isWireframeMode = false;
@@ -31,6 +35,11 @@ float  refectTextureShitness = 1.0f;
 void frameBufferSizeCallback(GLFWwindow* window, int width, int height)
 {
     glViewport(0, 0, width, height);
+    if(width > 0 && height > 0)
+    {
+        windowW = width;
+        windowH = height;
+    }
 }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode)
@@ -116,7 +125,14 @@ int main()
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);
 
-    ShaderProgram shader("../../resource/shader/4-advanced-opengl/skybox-model.vs", "../../resource/shader/4-advanced-opengl/skybox-model.fs");
+    // textures decode and stage on loader threads, the GL thread only issues the copies
+    TextureUploader textureUploader;
+    Texture::setUploader(&textureUploader);
+
+    // the lit model shader with the skybox reflection compiled in
+    ShaderVariantCache modelVariants("../../resource/shader/3-model/model.vs", "../../resource/shader/3-model/model.fs");
+    ShaderDefines      modelDefines = {{"HAS_DIR_LIGHT", ""}, {"NUM_POINT_LIGHTS", "1"}, {"HAS_SPOT_LIGHT", ""}, {"HAS_SPECULAR_MAP", ""}, {"HAS_REFLECTION", ""}};
+    ShaderProgram&     shader       = modelVariants.get(modelDefines);
     ShaderProgram skyboxShader("../../resource/shader/4-advanced-opengl/skybox.vs", "../../resource/shader/4-advanced-opengl/skybox.fs");
 
     // clang-format off
@@ -251,10 +267,19 @@ int main()
                                           "../../resource/texture/skybox/bottom.jpg",
                                           "../../resource/texture/skybox/front.jpg",
                                           "../../resource/texture/skybox/back.jpg"};
-    Texture             skyboxTexture(skyboxTexturePath, TextureType::TEXTURE_DIFFUSE, false);
+    // the first run decodes the faces in parallel and bakes them with their mips into one file
+    Texture             skyboxTexture(skyboxTexturePath, TextureType::TEXTURE_DIFFUSE, false, "../../resource/texture/skybox/skybox.texcache");
 
     Model model("../../resource/model/nanosuit/nanosuit.obj");
 
+    // edit a shader, texture or the model while running, it is rebuilt in the background
+    HotReloader hotReloader;
+    hotReloader.watch(shader, "../../resource/shader/3-model/model.vs", "../../resource/shader/3-model/model.fs", modelDefines);
+    hotReloader.watch(skyboxShader, "../../resource/shader/4-advanced-opengl/skybox.vs", "../../resource/shader/4-advanced-opengl/skybox.fs");
+    hotReloader.watch(cubeTexture);
+    hotReloader.watch(floorTexture);
+    hotReloader.watch(model);
+
     shader.use();
     shader.setInt("skybox", 4);
 
@@ -263,84 +288,105 @@ int main()
 
     glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
+    RenderTargetPool targetPool;
+    FrameGraph       frameGraph(targetPool);
+
     while(!glfwWindowShouldClose(glfwWindow))
     {
-        // render
-        glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        hotReloader.update();
+        textureUploader.update();
+
         float currentFrame = glfwGetTime();
         deltaTime          = currentFrame - lastFrame;
         lastFrame          = currentFrame;
 
-        shader.use();
-        glm::mat4 view = camera.getViewMatrix();
-        glm::mat4 projection(1.0f);
-        projection = glm::perspective(glm::radians(camera.fov()), window.width() / window.height(), near, far);
-        shader.setMat4("view", glm::value_ptr(view));
-        shader.setMat4("projection", glm::value_ptr(projection));
-        shader.setFloat("near", near);
-        shader.setFloat("far", far);
-        shader.setVec3("cameraPos", glm::value_ptr(camera.position()));
-
-        skyboxShader.use();
-        glm::mat4 skyboxView = glm::mat4(glm::mat3(camera.getViewMatrix()));
-        skyboxShader.setMat4("view", glm::value_ptr(skyboxView));
-        skyboxShader.setMat4("projection", glm::value_ptr(projection));
-        skyboxShader.setFloat("near", near);
-        skyboxShader.setFloat("far", far);
+        frameGraph.reset();
+        FrameGraphResource backbuffer = frameGraph.importBackbuffer("backbuffer", windowW, windowH);
 
         // draw nanosuit
-        shader.use();
-        glm::mat4 nanosuitModel(1.0f);
-        nanosuitModel = glm::scale(nanosuitModel, glm::vec3(0.1f, 0.1f, 0.1f));
-        shader.setMat4("model", glm::value_ptr(nanosuitModel));
-
-        shader.setFloat("material1.shininess", 32.0f);
-        shader.setVec3("dirLight.ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
-        shader.setVec3("dirLight.diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
-        shader.setVec3("dirLight.specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
-        shader.setVec3("dirLight.direction", glm::value_ptr(glm::vec3(0.0f, 0.0f, -2.0f)));
-
-        shader.setVec3("pointLight.ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
-        shader.setVec3("pointLight.diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
-        shader.setVec3("pointLight.specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
-        shader.setVec3("pointLight.position", glm::value_ptr(lightPos));
-        shader.setFloat("pointLight.constant", 1.0f);
-        shader.setFloat("pointLight.linear", 0.09f);
-        shader.setFloat("pointLight.quadratic", 0.032f);
-
-        shader.setVec3("spotLight.ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
-        shader.setVec3("spotLight.diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
-        shader.setVec3("spotLight.specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
-        shader.setVec3("spotLight.position", glm::value_ptr(camera.position()));
-        shader.setVec3("spotLight.direction", glm::value_ptr(camera.front()));
-        shader.setFloat("spotLight.constant", 1.0f);
-        shader.setFloat("spotLight.linear", 0.09f);
-        shader.setFloat("spotLight.quadratic", 0.032f);
-        shader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
-
-        shader.setFloat("refectTextureShitness", refectTextureShitness);
-
-        glActiveTexture(GL_TEXTURE4);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture.id());
-
-        model.draw(shader);
-
-        // draw skybox
-        skyboxShader.use();
-        glDepthFunc(GL_LEQUAL); // change depth function so depth test passes when values are equal to depth buffer's content
-        glm::mat4 skyboxModel = glm::mat4(1.0f);
-        skyboxShader.setMat4("model", glm::value_ptr(skyboxModel));
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, skyboxTexture.id());
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glDepthFunc(GL_LESS); // set depth function back to default
-
-        glBindVertexArray(0);
-
-        glfwSwapBuffers(glfwWindow);
+        frameGraph.addPass(
+            "nanosuit",
+            [&](FrameGraphBuilder& builder) { builder.write(backbuffer); },
+            [&](const FrameGraphResources& resources) {
+                resources.bind(backbuffer);
+                glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+                shader.use();
+                glm::mat4 view = camera.getViewMatrix();
+                glm::mat4 projection(1.0f);
+                projection = glm::perspective(glm::radians(camera.fov()), windowW / windowH, near, far);
+                shader.setMat4("view", glm::value_ptr(view));
+                shader.setMat4("projection", glm::value_ptr(projection));
+                shader.setFloat("near", near);
+                shader.setFloat("far", far);
+                shader.setVec3("viewPos", glm::value_ptr(camera.position()));
+
+                glm::mat4 nanosuitModel(1.0f);
+                nanosuitModel = glm::scale(nanosuitModel, glm::vec3(0.1f, 0.1f, 0.1f));
+                shader.setMat4("model", glm::value_ptr(nanosuitModel));
+
+                shader.setFloat("material1.shininess", 32.0f);
+                shader.setVec3("dirLight.ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
+                shader.setVec3("dirLight.diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
+                shader.setVec3("dirLight.specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
+                shader.setVec3("dirLight.direction", glm::value_ptr(glm::vec3(0.0f, 0.0f, -2.0f)));
+
+                shader.setVec3("pointLights[0].ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
+                shader.setVec3("pointLights[0].diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
+                shader.setVec3("pointLights[0].specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
+                shader.setVec3("pointLights[0].position", glm::value_ptr(lightPos));
+                shader.setFloat("pointLights[0].constant", 1.0f);
+                shader.setFloat("pointLights[0].linear", 0.09f);
+                shader.setFloat("pointLights[0].quadratic", 0.032f);
+
+                shader.setVec3("spotLight.ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
+                shader.setVec3("spotLight.diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
+                shader.setVec3("spotLight.specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
+                shader.setVec3("spotLight.position", glm::value_ptr(camera.position()));
+                shader.setVec3("spotLight.direction", glm::value_ptr(camera.front()));
+                shader.setFloat("spotLight.constant", 1.0f);
+                shader.setFloat("spotLight.linear", 0.09f);
+                shader.setFloat("spotLight.quadratic", 0.032f);
+                shader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
+                shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+
+                shader.setFloat("refectTextureShitness", refectTextureShitness);
+
+                skyboxTexture.bind(4);
+
+                model.draw(shader);
+            });
+
+        // draw skybox after the opaque geometry, so most of it fails the depth test
+        frameGraph.addPass(
+            "skybox",
+            [&](FrameGraphBuilder& builder) { builder.write(backbuffer); },
+            [&](const FrameGraphResources& resources) {
+                // don't rely on the nanosuit pass leaving the backbuffer bound
+                resources.bind(backbuffer);
+                skyboxShader.use();
+                glm::mat4 projection = glm::perspective(glm::radians(camera.fov()), windowW / windowH, near, far);
+                glm::mat4 skyboxView = glm::mat4(glm::mat3(camera.getViewMatrix()));
+                skyboxShader.setMat4("view", glm::value_ptr(skyboxView));
+                skyboxShader.setMat4("projection", glm::value_ptr(projection));
+                skyboxShader.setFloat("near", near);
+                skyboxShader.setFloat("far", far);
+                glDepthFunc(GL_LEQUAL); // change depth function so depth test passes when values are equal to depth buffer's content
+                glm::mat4 skyboxModel = glm::mat4(1.0f);
+                skyboxShader.setMat4("model", glm::value_ptr(skyboxModel));
+                glBindVertexArray(skyboxVAO);
+                skyboxTexture.bind(3);
+                glDrawArrays(GL_TRIANGLES, 0, 36);
+                glDepthFunc(GL_LESS); // set depth function back to default
+                glBindVertexArray(0);
+            });
+
+        frameGraph.compile();
+        frameGraph.execute();
+        targetPool.endFrame();
+
+        window.swapBuffers();
         glfwPollEvents();
     }
 
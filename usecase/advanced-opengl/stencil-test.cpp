@@ -254,7 +254,7 @@ int main()
 
         glBindVertexArray(0);
 
-        glfwSwapBuffers(glfwWindow);
+        window.swapBuffers();
         glfwPollEvents();
     }
 
@@ -268,8 +268,7 @@ void renderFloor(unsigned int VAO, ShaderProgram& shader, Texture& texture)
 {
     // draw floor
     glBindVertexArray(VAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture.id());
+    texture.bind(0);
     glm::mat4 model = glm::mat4(1.0f);
     shader.setMat4("model", glm::value_ptr(model));
     glDrawArrays(GL_TRIANGLES, 0, 36);
@@ -279,8 +278,7 @@ void renderCube(unsigned int VAO, ShaderProgram& shader, Texture& texture, glm::
 {
     //draw cube
     glBindVertexArray(VAO);
-    glActiveTexture(GL_TEXTURE0);
-    glBindTexture(GL_TEXTURE_2D, texture.id());
+    texture.bind(0);
     glm::mat4 model = glm::mat4(1.0f);
     model           = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
     model           = glm::scale(model, scaleVec);
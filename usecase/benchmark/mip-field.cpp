@@ -0,0 +1,157 @@
+#include "log.h"
+// clang-format off
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+// clang-format on
+#include <chrono>
+#include <vector>
+
+#include "window.h"
+#include "frameRingBuffer.h"
+#include "shader.h"
+#include "shaderVariantCache.h"
+#include "texture.h"
+#include "model.h"
+
+// a field of nanosuits seen from far away, so nearly every texture is minified. renders a fixed
+// number of frames per sampling mode and logs gpu time, cpu frame time and fragment count.
+// texel bandwidth itself needs vendor counters, run it under a gpu profiler for that.
+
+static const int   FIELD_SIZE      = 24;
+static const float FIELD_SPACING   = 3.0f;
+static const int   WARMUP_FRAMES   = 30;
+static const int   MEASURED_FRAMES = 300;
+static const float WINDOW_WIDTH    = 1280.0f;
+static const float WINDOW_HEIGHT   = 720.0f;
+
+// std140 blocks of model.vs with USE_FRAME_UBO
+struct CameraBlock
+{
+    glm::mat4 view;
+    glm::mat4 projection;
+};
+
+struct ObjectBlock
+{
+    glm::mat4 model;
+    glm::mat4 normalMatrix;
+};
+
+struct SamplingMode
+{
+    const char*  name;
+    unsigned int minFilter;
+    float        anisotropy;
+};
+
+void applyMode(Model& model, const SamplingMode& mode)
+{
+    // every texture of the model ends up on the same few samplers, switching modes swaps those
+    for(auto& texture : model.textures())
+    {
+        // GL_LINEAR only samples level 0, like the textures did before they had mips
+        texture.setFilterType(mode.minFilter, GL_LINEAR);
+        texture.setAnisotropy(mode.anisotropy);
+    }
+}
+
+int main()
+{
+    Window window(WINDOW_WIDTH, WINDOW_HEIGHT);
+    auto*  glfwWindow = window.glfwWindow();
+    glfwSwapInterval(0);
+    glEnable(GL_DEPTH_TEST);
+
+    ShaderVariantCache modelVariants("../../resource/shader/3-model/model.vs", "../../resource/shader/3-model/model.fs");
+    ShaderProgram&     shader = modelVariants.get({{"HAS_DIR_LIGHT", ""}, {"HAS_SPECULAR_MAP", ""}, {"USE_FRAME_UBO", ""}});
+    Model              model("../../resource/model/nanosuit2/nanosuit.obj");
+    // a camera block and FIELD_SIZE * FIELD_SIZE object blocks a frame, each padded to the uniform alignment
+    FrameRingBuffer ring(1024 * 1024);
+
+    const SamplingMode modes[] = {
+        {"level 0 only", GL_LINEAR, 1.0f},
+        {"bilinear mips", GL_LINEAR_MIPMAP_NEAREST, 1.0f},
+        {"trilinear", GL_LINEAR_MIPMAP_LINEAR, 1.0f},
+        {"trilinear + 8x aniso", GL_LINEAR_MIPMAP_LINEAR, 8.0f},
+        {"trilinear + 16x aniso", GL_LINEAR_MIPMAP_LINEAR, 16.0f},
+    };
+
+    unsigned int queries[2];
+    glGenQueries(2, queries);
+
+    // camera high above one corner looking across the field
+    glm::vec3 cameraPos(-10.0f, 12.0f, -10.0f);
+    glm::vec3 fieldCenter(FIELD_SIZE * FIELD_SPACING * 0.5f, 0.0f, FIELD_SIZE * FIELD_SPACING * 0.5f);
+    glm::mat4 view       = glm::lookAt(cameraPos, fieldCenter, glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), WINDOW_WIDTH / WINDOW_HEIGHT, 0.1f, 500.0f);
+
+    shader.setVec3("viewPos", glm::value_ptr(cameraPos));
+    shader.setFloat("material1.shininess", 32.0f);
+    shader.setVec3("dirLight.ambient", glm::value_ptr(glm::vec3(0.2f, 0.2f, 0.2f)));
+    shader.setVec3("dirLight.diffuse", glm::value_ptr(glm::vec3(0.7f, 0.7f, 0.7f)));
+    shader.setVec3("dirLight.specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
+    shader.setVec3("dirLight.direction", glm::value_ptr(glm::vec3(-0.3f, -1.0f, -0.5f)));
+
+    for(const auto& mode : modes)
+    {
+        applyMode(model, mode);
+
+        double   gpuMs     = 0.0;
+        double   cpuMs     = 0.0;
+        uint64_t fragments = 0;
+        for(int frame = 0; frame < WARMUP_FRAMES + MEASURED_FRAMES && !glfwWindowShouldClose(glfwWindow); frame++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+            glBeginQuery(GL_FRAGMENT_SHADER_INVOCATIONS, queries[1]);
+
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            shader.use();
+            ring.beginFrame();
+            ring.bindUniform(0, ring.pushUniform(CameraBlock {view, projection}));
+            for(int x = 0; x < FIELD_SIZE; x++)
+            {
+                for(int z = 0; z < FIELD_SIZE; z++)
+                {
+                    glm::mat4 transform(1.0f);
+                    transform = glm::translate(transform, glm::vec3(x * FIELD_SPACING, 0.0f, z * FIELD_SPACING));
+                    transform = glm::scale(transform, glm::vec3(0.1f));
+                    ring.bindUniform(1, ring.pushUniform(ObjectBlock {transform, glm::transpose(glm::inverse(transform))}));
+                    model.draw(shader);
+                }
+            }
+
+            glEndQuery(GL_FRAGMENT_SHADER_INVOCATIONS);
+            glEndQuery(GL_TIME_ELAPSED);
+            ring.endFrame();
+            window.swapBuffers();
+            glfwPollEvents();
+
+            // waiting on the queries every frame is fine here, nothing else overlaps anyway
+            uint64_t elapsedNs   = 0;
+            uint64_t invocations = 0;
+            glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &elapsedNs);
+            glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &invocations);
+            auto end = std::chrono::steady_clock::now();
+            if(frame >= WARMUP_FRAMES)
+            {
+                gpuMs += elapsedNs / 1e6;
+                cpuMs += std::chrono::duration<double, std::milli>(end - start).count();
+                fragments += invocations;
+            }
+        }
+
+        GL_LOG_I("%-24s gpu %.3f ms, frame %.3f ms, %.2f M fragments, %.2f ns/fragment",
+                 mode.name,
+                 gpuMs / MEASURED_FRAMES,
+                 cpuMs / MEASURED_FRAMES,
+                 fragments / 1e6 / MEASURED_FRAMES,
+                 fragments ? gpuMs * 1e6 / fragments : 0.0);
+    }
+
+    glDeleteQueries(2, queries);
+}
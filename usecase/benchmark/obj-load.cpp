@@ -0,0 +1,151 @@
+#include "log.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include <assimp/scene.h>
+
+#include "objLoader.h"
+
+// compares Assimp::Importer::ReadFile, with the flags Model uses, to ObjLoader on the same file.
+// parsing only, neither decodes textures, so no GL context is needed.
+//   obj-load [model.obj]
+//   obj-load --generate <triangles> <output.obj>   writes a grid with that many triangles first
+
+static const int RUN_COUNT = 3;
+
+static bool generateGrid(const std::string& path, size_t triangleCount)
+{
+    FILE* file = fopen(path.c_str(), "wb");
+    if(!file)
+    {
+        GL_LOG_E("can't write %s", path.c_str());
+        return false;
+    }
+    static char buffer[1 << 20];
+    setvbuf(file, buffer, _IOFBF, sizeof(buffer));
+
+    // a rippled square of side cells, two triangles per cell
+    size_t side = static_cast<size_t>(std::ceil(std::sqrt(triangleCount / 2.0)));
+    fprintf(file, "# %zu x %zu grid\no grid\n", side, side);
+    for(size_t z = 0; z <= side; z++)
+    {
+        for(size_t x = 0; x <= side; x++)
+        {
+            float u = static_cast<float>(x) / side;
+            float v = static_cast<float>(z) / side;
+            float h = 0.05f * std::sin(u * 40.0f) * std::cos(v * 40.0f);
+            fprintf(file, "v %.6f %.6f %.6f\nvt %.6f %.6f\n", u * 100.0f, h * 100.0f, v * 100.0f, u, v);
+            float dx = 2.0f * std::cos(u * 40.0f) * std::cos(v * 40.0f);
+            float dz = -2.0f * std::sin(u * 40.0f) * std::sin(v * 40.0f);
+            float l  = std::sqrt(dx * dx + 1.0f + dz * dz);
+            fprintf(file, "vn %.6f %.6f %.6f\n", -dx / l, 1.0f / l, -dz / l);
+        }
+    }
+    size_t written = 0;
+    for(size_t z = 0; z < side && written < triangleCount; z++)
+    {
+        for(size_t x = 0; x < side && written < triangleCount; x++)
+        {
+            size_t a = z * (side + 1) + x + 1;
+            size_t b = a + 1;
+            size_t c = a + side + 1;
+            size_t d = c + 1;
+            fprintf(file, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", a, a, a, c, c, c, b, b, b);
+            written++;
+            if(written < triangleCount)
+            {
+                fprintf(file, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", b, b, b, c, c, c, d, d, d);
+                written++;
+            }
+        }
+    }
+    bool ok = fclose(file) == 0;
+    GL_LOG_I("generated %s: %zu triangles", path.c_str(), written);
+    return ok;
+}
+
+static double benchAssimp(const std::string& path, size_t& vertexCount, size_t& triangleCount)
+{
+    double best = 1e30;
+    for(int run = 0; run < RUN_COUNT; run++)
+    {
+        auto             start = std::chrono::steady_clock::now();
+        Assimp::Importer importer;
+        const aiScene*   scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+        auto             end   = std::chrono::steady_clock::now();
+        if(!scene || !scene->mRootNode)
+        {
+            GL_LOG_E("assimp can't load %s: %s", path.c_str(), importer.GetErrorString());
+            return 0.0;
+        }
+        vertexCount   = 0;
+        triangleCount = 0;
+        for(unsigned int i = 0; i < scene->mNumMeshes; i++)
+        {
+            vertexCount += scene->mMeshes[i]->mNumVertices;
+            triangleCount += scene->mMeshes[i]->mNumFaces;
+        }
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+static double benchObjLoader(const std::string& path, size_t& vertexCount, size_t& triangleCount)
+{
+    double best = 1e30;
+    for(int run = 0; run < RUN_COUNT; run++)
+    {
+        auto     start = std::chrono::steady_clock::now();
+        ObjScene scene;
+        if(!ObjLoader::load(path, scene))
+        {
+            return 0.0;
+        }
+        auto end      = std::chrono::steady_clock::now();
+        vertexCount   = 0;
+        triangleCount = 0;
+        for(const auto& mesh : scene.meshes)
+        {
+            vertexCount += mesh.vertices.size();
+            triangleCount += mesh.indices.size() / 3;
+        }
+        best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    std::string path = "../../resource/model/nanosuit2/nanosuit.obj";
+    if(argc >= 4 && strcmp(argv[1], "--generate") == 0)
+    {
+        path = argv[3];
+        if(!generateGrid(path, std::strtoull(argv[2], nullptr, 10)))
+        {
+            return 1;
+        }
+    }
+    else if(argc >= 2)
+    {
+        path = argv[1];
+    }
+
+    size_t assimpVertices  = 0;
+    size_t assimpTriangles = 0;
+    size_t objVertices     = 0;
+    size_t objTriangles    = 0;
+    double assimpMs        = benchAssimp(path, assimpVertices, assimpTriangles);
+    double objMs           = benchObjLoader(path, objVertices, objTriangles);
+    GL_LOG_I("%s, best of %d", path.c_str(), RUN_COUNT);
+    GL_LOG_I("assimp:     %10.1f ms  %zu vertices %zu triangles", assimpMs, assimpVertices, assimpTriangles);
+    // assimp keeps a vertex per corner, the obj loader shares the corners that are the same
+    GL_LOG_I("obj loader: %10.1f ms  %zu vertices %zu triangles, %.1fx", objMs, objVertices, objTriangles, objMs > 0.0 ? assimpMs / objMs : 0.0);
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "log.h"
+// clang-format off
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+// clang-format on
+#include <chrono>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "transparentSorter.h"
+
+// compares the per-frame std::map sort used by the old blending usecase with TransparentSorter.
+// no GL context is needed, both paths only produce a draw order.
+
+static const int FRAME_COUNT = 100;
+
+double benchMap(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& cameraPath, size_t& drawn)
+{
+    unsigned int checksum = 0;
+    auto         start    = std::chrono::steady_clock::now();
+    for(const auto& cameraPos : cameraPath)
+    {
+        std::map<float, glm::vec3> sortedWindows;
+        for(size_t i = 0; i < positions.size(); i++)
+        {
+            float distance          = glm::distance(cameraPos, positions[i]);
+            sortedWindows[distance] = positions[i];
+        }
+        drawn = 0;
+        for(auto it = sortedWindows.rbegin(); it != sortedWindows.rend(); it++)
+        {
+            checksum += static_cast<unsigned int>(it->second.x);
+            drawn++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    (void)checksum;
+    return std::chrono::duration<double, std::micro>(end - start).count() / cameraPath.size();
+}
+
+double benchSorter(const std::vector<glm::vec3>& positions, const std::vector<glm::vec3>& cameraPath, size_t& drawn)
+{
+    std::vector<TransparentDraw> draws;
+    draws.reserve(positions.size());
+    for(size_t i = 0; i < positions.size(); i++)
+    {
+        draws.push_back({positions[i], static_cast<unsigned int>(i)});
+    }
+
+    TransparentSorter sorter;
+    sorter.reserve(draws.size());
+
+    unsigned int checksum = 0;
+    auto         start    = std::chrono::steady_clock::now();
+    for(const auto& cameraPos : cameraPath)
+    {
+        glm::mat4   view  = glm::lookAt(cameraPos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const auto& order = sorter.sort(draws, view);
+        drawn             = 0;
+        for(unsigned int idx : order)
+        {
+            checksum += static_cast<unsigned int>(draws[idx].position.x);
+            drawn++;
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    (void)checksum;
+    return std::chrono::duration<double, std::micro>(end - start).count() / cameraPath.size();
+}
+
+int main()
+{
+    std::mt19937                          rng(42);
+    std::uniform_real_distribution<float> coord(-50.0f, 50.0f);
+
+    std::vector<glm::vec3> cameraPath;
+    for(int i = 0; i < FRAME_COUNT; i++)
+    {
+        float t = static_cast<float>(i) / FRAME_COUNT * 6.2831853f;
+        cameraPath.emplace_back(60.0f * cos(t), 5.0f, 60.0f * sin(t));
+    }
+
+    for(size_t count : {10, 1000, 100000})
+    {
+        std::vector<glm::vec3> positions;
+        for(size_t i = 0; i < count; i++)
+        {
+            // snap to a grid so equal distances actually happen, like billboards placed by hand
+            positions.emplace_back(std::round(coord(rng)), 0.0f, std::round(coord(rng)));
+        }
+
+        size_t mapDrawn = 0, sorterDrawn = 0;
+        double mapUs    = benchMap(positions, cameraPath, mapDrawn);
+        double sorterUs = benchSorter(positions, cameraPath, sorterDrawn);
+        GL_LOG_I("%zu quads: std::map %.2f us/frame (%zu drawn), TransparentSorter %.2f us/frame (%zu drawn), speedup %.1fx",
+                 count,
+                 mapUs,
+                 mapDrawn,
+                 sorterUs,
+                 sorterDrawn,
+                 mapUs / sorterUs);
+    }
+}
@@ -12,6 +12,7 @@
 
 #include "window.h"
 #include "shader.h"
+#include "shaderVariantCache.h"
 #include "texture.h"
 #include "camera.h"
 
@@ -23,6 +24,10 @@ float  lastFrame       = 0.0f; // 上一帧的时间
 float  lastX = windowW / 2, lastY = windowH / 2;
 bool   firstMouse = true;
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0, 0.0f);
+// lights compiled into the cube shader, every combination is its own variant
+bool   isDirLightOn   = false;
+bool   isPointLightOn = false;
+bool   isSpotLightOn  = true;
 
 void frameBufferSizeCallback(GLFWwindow* window, int width, int height)
 {
@@ -63,6 +68,18 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mode
             mixValue = 0.0f;
         }
     }
+    else if(key == GLFW_KEY_1 && action == GLFW_PRESS)
+    {
+        isDirLightOn = !isDirLightOn;
+    }
+    else if(key == GLFW_KEY_2 && action == GLFW_PRESS)
+    {
+        isPointLightOn = !isPointLightOn;
+    }
+    else if(key == GLFW_KEY_3 && action == GLFW_PRESS)
+    {
+        isSpotLightOn = !isSpotLightOn;
+    }
 
     if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
         camera.move(CameraDirection::FORWARD, deltaTime);
@@ -108,7 +125,7 @@ int main()
     glEnable(GL_DEPTH_TEST);
 
     ShaderProgram LightingShader("../../resource/shader/2-lighting/lighting.vs", "../../resource/shader/2-lighting/lighting.fs");
-    ShaderProgram LightingCubeShader("../../resource/shader/2-lighting/lighting-cube.vs", "../../resource/shader/2-lighting/lighting-cube.fs");
+    ShaderVariantCache lightingCubeVariants("../../resource/shader/2-lighting/lighting-cube.vs", "../../resource/shader/2-lighting/lighting-cube.fs");
     ShaderProgram LightingCubeGouraudShader("../../resource/shader/2-lighting/lighting-cube-gouraud.vs", "../../resource/shader/2-lighting/lighting-cube-gouraud.fs");
 
     Texture texture("../../resource/texture/wall.jpg");
@@ -206,11 +223,6 @@ int main()
 
     glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
-    LightingCubeShader.use();
-    LightingCubeShader.setInt("material.diffuse", 0);
-    LightingCubeShader.setInt("material.specular", 1);
-    LightingCubeShader.setInt("material.emission", 2);
-
     while(!glfwWindowShouldClose(glfwWindow))
     {
 
@@ -225,14 +237,11 @@ int main()
         glm::mat4 projection(1.0f);
         projection = glm::perspective(glm::radians(camera.fov()), window.width() / window.height(), 0.1f, 100.0f);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, textureContainer2.id());
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, textureContainer2Specular.id());
-        glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, textureMatrix.id());
+        textureContainer2.bind(0);
+        textureContainer2Specular.bind(1);
+        textureMatrix.bind(2);
         // specular color
-        // glBindTexture(GL_TEXTURE_2D, textureContainer2SpecularColor.id());
+        // textureContainer2SpecularColor.bind(3);
 
         glBindVertexArray(VAO);
 
@@ -248,7 +257,19 @@ int main()
         LightingShader.setMat4("model", glm::value_ptr(lightModel));
         glDrawArrays(GL_TRIANGLES, 0, 36);
 
+        ShaderDefines lightDefines = {{"HAS_SPECULAR_MAP", ""}};
+        if(isDirLightOn)
+            lightDefines["HAS_DIR_LIGHT"] = "";
+        if(isPointLightOn)
+            lightDefines["NUM_POINT_LIGHTS"] = "1";
+        if(isSpotLightOn)
+            lightDefines["HAS_SPOT_LIGHT"] = "";
+        ShaderProgram& LightingCubeShader = lightingCubeVariants.get(lightDefines);
+
         LightingCubeShader.use();
+        LightingCubeShader.setInt("material.diffuse", 0);
+        LightingCubeShader.setInt("material.specular", 1);
+        LightingCubeShader.setInt("material.emission", 2);
         LightingCubeShader.setMat4("view", glm::value_ptr(view));
         LightingCubeShader.setMat4("projection", glm::value_ptr(projection));
         glm::mat4 lightCubeModel(1.0f);
@@ -262,13 +283,13 @@ int main()
         LightingCubeShader.setVec3("dirLight.specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
         LightingCubeShader.setVec3("dirLight.direction", glm::value_ptr(glm::vec3(0.0f, 0.0f, -2.0f)));
 
-        LightingCubeShader.setVec3("pointLight.ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
-        LightingCubeShader.setVec3("pointLight.diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
-        LightingCubeShader.setVec3("pointLight.specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
-        LightingCubeShader.setVec3("pointLight.position", glm::value_ptr(lightPos));
-        LightingCubeShader.setFloat("pointLight.constant", 1.0f);
-        LightingCubeShader.setFloat("pointLight.linear", 0.09f);
-        LightingCubeShader.setFloat("pointLight.quadratic", 0.032f);
+        LightingCubeShader.setVec3("pointLights[0].ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
+        LightingCubeShader.setVec3("pointLights[0].diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
+        LightingCubeShader.setVec3("pointLights[0].specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
+        LightingCubeShader.setVec3("pointLights[0].position", glm::value_ptr(lightPos));
+        LightingCubeShader.setFloat("pointLights[0].constant", 1.0f);
+        LightingCubeShader.setFloat("pointLights[0].linear", 0.09f);
+        LightingCubeShader.setFloat("pointLights[0].quadratic", 0.032f);
 
         LightingCubeShader.setVec3("spotLight.ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
         LightingCubeShader.setVec3("spotLight.diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
@@ -306,7 +327,7 @@ int main()
 
         // glDrawArrays(GL_TRIANGLES, 0, 36);
 
-        glfwSwapBuffers(glfwWindow);
+        window.swapBuffers();
         glfwPollEvents();
     }
 
@@ -11,7 +11,14 @@
 #include <cmath>
 
 #include "window.h"
+#include "bufferAllocator.h"
+#include "resourceManager.h"
+#include "packFile.h"
 #include "shader.h"
+#include "shaderVariantCache.h"
+#include "hotReloader.h"
+#include "textureUploader.h"
+#include "textureStreamer.h"
 #include "texture.h"
 #include "camera.h"
 #include "model.h"
@@ -108,8 +115,17 @@ int main()
     auto* glfwWindow = window.glfwWindow();
     glEnable(GL_DEPTH_TEST);
 
+    // textures decode and stage on loader threads, the GL thread only issues the copies
+    TextureUploader textureUploader;
+    Texture::setUploader(&textureUploader);
+
+    // made with `packer ../../resource ../../resource.pack`, the loose files are loaded without it
+    PackFile::mount("../../resource.pack", "../../resource");
+
     ShaderProgram LightingShader("../../resource/shader/2-lighting/lighting.vs", "../../resource/shader/2-lighting/lighting.fs");
-    ShaderProgram shader("../../resource/shader/3-model/model.vs", "../../resource/shader/3-model/model.fs");
+    ShaderVariantCache modelVariants("../../resource/shader/3-model/model.vs", "../../resource/shader/3-model/model.fs");
+    ShaderDefines      modelDefines = {{"HAS_DIR_LIGHT", ""}, {"NUM_POINT_LIGHTS", "1"}, {"HAS_SPOT_LIGHT", ""}, {"HAS_SPECULAR_MAP", ""}};
+    ShaderProgram&     shader       = modelVariants.get(modelDefines);
 
     // clang-format off
     float vertices[] = {
@@ -179,7 +195,14 @@ int main()
 
 
 
-    Model model("../../resource/model/nanosuit2/nanosuit.obj");
+    // starts with small textures, the streamer brings in the levels the view needs
+    Model           model("../../resource/model/nanosuit2/nanosuit.obj", true);
+    TextureStreamer textureStreamer;
+
+    HotReloader hotReloader;
+    hotReloader.watch(shader, "../../resource/shader/3-model/model.vs", "../../resource/shader/3-model/model.fs", modelDefines);
+    hotReloader.watch(LightingShader, "../../resource/shader/2-lighting/lighting.vs", "../../resource/shader/2-lighting/lighting.fs");
+    hotReloader.watch(model);
 
     glm::vec3 lightPos(1.2f, 1.0f, 2.0f);
 
@@ -187,6 +210,8 @@ int main()
 
     while(!glfwWindowShouldClose(glfwWindow))
     {
+        hotReloader.update();
+        textureUploader.update();
 
         // render
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -200,7 +225,7 @@ int main()
         projection = glm::perspective(glm::radians(camera.fov()), window.width() / window.height(), 0.1f, 100.0f);
 
         // specular color
-        // glBindTexture(GL_TEXTURE_2D, textureContainer2SpecularColor.id());
+        // textureContainer2SpecularColor.bind(3);
 
         // render light
         glBindVertexArray(VAO);
@@ -222,6 +247,7 @@ int main()
         nanosuitModel = glm::translate(nanosuitModel, glm::vec3(0.0f, 0.0f, 0.0f));
         nanosuitModel = glm::scale(nanosuitModel, glm::vec3(0.1f, 0.1f, 0.1f));
         shader.setMat4("model", glm::value_ptr(nanosuitModel));
+        shader.setVec3("viewPos", glm::value_ptr(camera.position()));
 
         shader.setFloat("material1.shininess", 32.0f);
         shader.setVec3("dirLight.ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
@@ -229,13 +255,13 @@ int main()
         shader.setVec3("dirLight.specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
         shader.setVec3("dirLight.direction", glm::value_ptr(glm::vec3(0.0f, 0.0f, -2.0f)));
 
-        shader.setVec3("pointLight.ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
-        shader.setVec3("pointLight.diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
-        shader.setVec3("pointLight.specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
-        shader.setVec3("pointLight.position", glm::value_ptr(lightPos));
-        shader.setFloat("pointLight.constant", 1.0f);
-        shader.setFloat("pointLight.linear", 0.09f);
-        shader.setFloat("pointLight.quadratic", 0.032f);
+        shader.setVec3("pointLights[0].ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
+        shader.setVec3("pointLights[0].diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
+        shader.setVec3("pointLights[0].specular", glm::value_ptr(glm::vec3(1.0f, 1.0f, 1.0f)));
+        shader.setVec3("pointLights[0].position", glm::value_ptr(lightPos));
+        shader.setFloat("pointLights[0].constant", 1.0f);
+        shader.setFloat("pointLights[0].linear", 0.09f);
+        shader.setFloat("pointLights[0].quadratic", 0.032f);
 
         shader.setVec3("spotLight.ambient", glm::value_ptr(glm::vec3(0.0f, 0.0f, 0.0f)));
         shader.setVec3("spotLight.diffuse", glm::value_ptr(glm::vec3(0.5f, 0.5f, 0.5f)));
@@ -249,7 +275,12 @@ int main()
         shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
 
         model.draw(shader);
-        glfwSwapBuffers(glfwWindow);
+        textureStreamer.request(model, nanosuitModel);
+        textureStreamer.update(camera, window.width(), window.height());
+        // meshes and textures dropped by model reloads are deleted a few frames later by
+        // swapBuffers, and the holes their geometry left get closed a little every frame
+        BufferAllocator::geometry()->compact();
+        window.swapBuffers();
         glfwPollEvents();
     }
 }
\ No newline at end of file
@@ -82,7 +82,7 @@ int main()
 
     while(!glfwWindowShouldClose(glfwWindow))
     {
-        glfwSwapBuffers(glfwWindow);
+        window.swapBuffers();
 
         // render
         glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
@@ -226,10 +226,8 @@ int main()
         glm::mat4 projection(1.0f);
         projection = glm::perspective(glm::radians(camera.fov()), window.width() / window.height(), 0.1f, 100.0f);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, texture.id());
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, textureFace.id());
+        texture.bind(0);
+        textureFace.bind(1);
 
         shaderProgram.use();
         shaderProgram.setFloat("mixValue", mixValue);
@@ -247,7 +245,7 @@ int main()
             glDrawArrays(GL_TRIANGLES, 0, 36);
         }
 
-        glfwSwapBuffers(glfwWindow);
+        window.swapBuffers();
         glfwPollEvents();
     }
 